@@ -85,6 +85,8 @@ extern "C" {
     #include "CO_SYNC.h"
     #include "CO_PDO.h"
     #include "Logger.h"
+    #include "CO_tmrWheel.h"
+    #include "CO_prof.h"
 
     #include "CO_HBconsumer.h"
 #if CO_NO_SDO_CLIENT == 1
@@ -123,8 +125,16 @@ typedef enum{
 }CO_Default_CAN_ID_t;
 
 
+/** Size of CO_t::RPDOpending, one bit for each RPDO */
+#define CO_RPDO_PENDING_WORDS   ((CO_NO_RPDO + 31) / 32)
+
+
 /**
  * CANopen stack object combines pointers to all CANopen objects.
+ *
+ * It is created by CO_new(). There may be several objects in one process, for
+ * example one per CAN bus or per virtual node. Objects share no data, except
+ * the logger and, if they use it, the global Object Dictionary.
  */
 
 typedef struct{
@@ -143,13 +153,59 @@ typedef struct{
 #if CO_NO_TRACE > 0
     CO_trace_t         *trace[CO_NO_TRACE]; /**< Trace object for monitoring variables */
 #endif
+    CO_tmrWheel_t      *tmrMain;        /**< Timers of mainline objects, advanced by CO_process() */
+    CO_tmrWheel_t      *tmrRT;          /**< Timers of TPDOs, advanced by CO_process_TPDO() */
+    uint8_t             TPDOoperatingState; /**< NMT state seen by the last CO_process_TPDO() */
+    /** Set from mainline after SDO access, so CO_process_TPDO() processes all
+    TPDOs with possibly new configuration. Accessed atomically */
+    uint32_t            TPDOrestart;
+    /** Set by CO_setTPDOslowdown(), accessed atomically */
+    uint32_t            TPDOslowdown;
+    /** Bit of each RPDO, which received new message. Set by CAN receive,
+    cleared by CO_process_SYNC_RPDO(). Accessed atomically */
+    uint32_t            RPDOpending[CO_RPDO_PENDING_WORDS];
+    /** RPDOs of each rate group, bits as in RPDOpending. Set by CO_init() */
+    uint32_t            RPDOgroupMask[CO_PDO_GROUPS][CO_RPDO_PENDING_WORDS];
+    /** Period of each rate group, see CO_setPDOgroupPeriod() */
+    uint32_t            PDOgroupPeriod_us[CO_PDO_GROUPS];
+    uint8_t             RPDOgroup[CO_NO_RPDO]; /**< Rate group of each RPDO, see CO_setPDOgroup() */
+    uint8_t             TPDOgroup[CO_NO_TPDO]; /**< Rate group of each TPDO, see CO_setPDOgroup() */
+    /** Time of CO_process_SYNC_RPDO() in microseconds, starts with 0 */
+    uint64_t            RPDOtime;
+    /** Next processing of each rate group on RPDOtime */
+    uint64_t            RPDOgroupNext[CO_PDO_GROUPS];
+    /** Groups with pending RPDOs, whose next processing is in the last
+    timerNext_us of CO_process_SYNC_RPDO() */
+    uint32_t            RPDOgroupsArmed;
+    /** Object Dictionary entries, CO_OD or own copy, see CO_new() */
+    const CO_OD_entry_t *OD;
+    struct sCO_OD_RAM  *ODRAM;          /**< &CO_OD_RAM or own copy */
+    struct sCO_OD_EEPROM *ODEEPROM;     /**< &CO_OD_EEPROM or own copy */
+    struct sCO_OD_ROM  *ODROM;          /**< &CO_OD_ROM or own copy */
+    CO_OD_entryRecord_t *ODrecords;     /**< Own copy of records from CO_OD or NULL */
+    CO_OD_extension_t  *ODExtensions;   /**< For SDO server */
+    uint16_t           *ODindex;        /**< Index table of SDO server, see CO_OD_find() */
+    CO_CANrx_t         *CANmodule_rxArray0; /**< Receive buffers of CANmodule[0] */
+    CO_CANtx_t         *CANmodule_txArray0; /**< Transmit buffers of CANmodule[0] */
+    CO_HBconsNode_t    *HBcons_monitoredNodes; /**< For Heartbeat consumer */
+#if CO_NO_NMT_MASTER == 1
+    CO_CANtx_t         *NMTM_txBuff;    /**< For CO_sendNMTcommand() */
+#endif
+#if CO_NO_TRACE > 0
+    uint32_t           *traceTimeBuffers[CO_NO_TRACE]; /**< For trace objects */
+    int32_t            *traceValueBuffers[CO_NO_TRACE]; /**< For trace objects */
+    uint32_t            traceBufferSize[CO_NO_TRACE]; /**< Size of the above buffers */
+#endif
+#ifdef CO_USE_LEDS
+    uint16_t            ms50;           /**< Timer for CO_NMT_blinkingProcess50ms() */
+#endif
+#if CO_CONFIG_PROFILE
+    CO_prof_t          *prof;           /**< Execution time of processing stages, kept over CO_init() */
+#endif
+    uint32_t            memoryUsed;     /**< Allocated by CO_new(), informative */
 }CO_t;
 
 
-/** CANopen object */
-    extern CO_t *CO;
-
-
 /**
  * Function CO_sendNMTcommand() is simple function, which sends CANopen message.
  * This part of code is an example of custom definition of simple CANopen
@@ -169,19 +225,48 @@ typedef struct{
 #endif
 
 
+/**
+ * Create CANopen object.
+ *
+ * Function must be called once for each CANopen object, before the first
+ * CO_init(). All CANopen objects, buffers and timer wheels are allocated here.
+ *
+ * Object either uses the global Object Dictionary (CO_OD_RAM, CO_OD_EEPROM,
+ * CO_OD_ROM from CO_OD.h), which is also accessed by application through
+ * OD_xxx macros and by OD storage, or it gets own copy of it. Only one object
+ * in a process may use the global Object Dictionary. Own copy is initialized
+ * from the global Object Dictionary at the time of this call. Its variables
+ * are accessed with CO_ODvar().
+ *
+ * If CO_USE_GLOBALS is defined, objects are static, so only one object with
+ * global Object Dictionary can be created.
+ *
+ * @param [out] pCO Pointer to created object is written here.
+ * @param ownOD If true, object gets own copy of Object Dictionary.
+ *
+ * @return #CO_ReturnError_t: CO_ERROR_NO, CO_ERROR_ILLEGAL_ARGUMENT,
+ * CO_ERROR_OUT_OF_MEMORY
+ */
+CO_ReturnError_t CO_new(CO_t **pCO, bool_t ownOD);
+
+
 /**
  * Initialize CANopen stack.
  *
- * Function must be called in the communication reset section.
+ * Function must be called in the communication reset section. If it fails,
+ * object should be deleted with CO_delete().
  *
- * @param CANbaseAddress Address of the CAN module, passed to CO_CANmodule_init().
+ * @param CO This object, from CO_new().
+ * @param CANbaseAddress Address of the CAN module, passed to
+ * CO_CANmodule_init(). It is the network interface index, see if_nametoindex().
  * @param nodeId Node ID of the CANopen device (1 ... 127).
- * @param nodeId CAN bit rate.
+ * @param bitRate CAN bit rate.
  *
  * @return #CO_ReturnError_t: CO_ERROR_NO, CO_ERROR_ILLEGAL_ARGUMENT,
  * CO_ERROR_OUT_OF_MEMORY, CO_ERROR_ILLEGAL_BAUDRATE
  */
 CO_ReturnError_t CO_init(
+        CO_t                   *CO,
         int32_t                 CANbaseAddress,
         uint8_t                 nodeId,
         uint16_t                bitRate);
@@ -189,10 +274,38 @@ CO_ReturnError_t CO_init(
 
 /**
  * Delete CANopen object and free memory. Must be called at program exit.
+ * Threads, which process the object, must be stopped before.
  *
+ * @param CO This object, from CO_new(). Nothing happens, if NULL.
  * @param CANbaseAddress Address of the CAN module, passed to CO_CANmodule_init().
  */
-void CO_delete(int32_t CANbaseAddress);
+void CO_delete(CO_t *CO, int32_t CANbaseAddress);
+
+
+/**
+ * Get address of Object Dictionary variable inside Object Dictionary of the
+ * CANopen object.
+ *
+ * @param CO This object.
+ * @param ODvariable Address of variable in global Object Dictionary, for
+ * example &OD_errorRegister.
+ *
+ * @return Address of the same variable in Object Dictionary of CO. This is
+ * ODvariable itself, if CO uses global Object Dictionary or if ODvariable is
+ * not part of it.
+ */
+void *CO_ODaddress(const CO_t *CO, const void *ODvariable);
+
+
+/**
+ * Access Object Dictionary variable of the CANopen object.
+ *
+ * Example: `CO_ODvar(CO, OD_producerHeartbeatTime) = 1000;`
+ *
+ * @param CO This object.
+ * @param var OD_xxx macro from CO_OD.h.
+ */
+#define CO_ODvar(CO, var) (*(__typeof__(&(var)))CO_ODaddress((CO), &(var)))
 
 
 /**
@@ -203,51 +316,167 @@ void CO_delete(int32_t CANbaseAddress);
  *
  * @param CO This object
  * @param timeDifference_ms Time difference from previous function call in [milliseconds].
- * @param timerNext_ms Return value - info to OS - maximum delay after function
- *        should be called next time in [milliseconds]. Value can be used for OS
- *        sleep time. Initial value must be set to something, 50ms typically.
- *        Output will be equal or lower to initial value. If there is new object
- *        to process, delay should be suspended and this function should be
- *        called immediately. Parameter is ignored if NULL.
+ * @param timerNext_us Return value - info to OS - maximum delay after function
+ *        should be called next time in [microseconds], relative to the time
+ *        accounted by timeDifference_ms. Value can be used for OS sleep time.
+ *        Initial value is the longest allowed sleep time. Each object lowers
+ *        it to its own next deadline (SDO timeout, Heartbeat producer,
+ *        Emergency inhibit time, LED blinking if CO_USE_LEDS is defined and
+ *        the first timer on CO_t::tmrMain, which holds Heartbeat consumer
+ *        timeouts), so output stays equal to initial value, if nothing is due. If there is new object to process, delay should be
+ *        suspended and this function should be called immediately. Parameter
+ *        is ignored if NULL.
  *
  * @return #CO_NMT_reset_cmd_t from CO_NMT_process().
  */
 CO_NMT_reset_cmd_t CO_process(
         CO_t                   *CO,
         uint16_t                timeDifference_ms,
-        uint16_t               *timerNext_ms);
+        uint32_t               *timerNext_us);
+
+
+/**
+ * Signals for CO_process_signaled(), they tell which objects have new work.
+ */
+#define CO_SIGNAL_SDO           0x01U   /**< SDO server received request */
+#define CO_SIGNAL_EMCY          0x02U   /**< Emergency was reported */
+#define CO_SIGNAL_NMT           0x04U   /**< NMT command was received */
+#define CO_SIGNAL_SDO_CLIENT    0x08U   /**< SDO client received response (handled by application) */
+#define CO_SIGNAL_HB_CONSUMER   0x10U   /**< Heartbeat from monitored node was received */
+#define CO_SIGNAL_ALL           0x1FU   /**< All of the above */
+
+
+/**
+ * Process only signaled CANopen objects.
+ *
+ * Function may be called between cyclic CO_process() calls, after a callback
+ * (CO_SDO_initCallback(), CO_EM_initCallback(), CO_NMT_initCallbackSignal(),
+ * CO_HBconsumer_initCallback()) signaled new work. Time is not advanced here,
+ * so CO_process() should be called just before, then timers started by
+ * signaled objects (Heartbeat consumer) count from the current time.
+ *
+ * @param CO This object
+ * @param signals Combination of CO_SIGNAL_xxx.
+ * @param timerNext_us Same as in CO_process(). Parameter is ignored if NULL.
+ *
+ * @return #CO_NMT_reset_cmd_t from CO_NMT_process(), if NMT was signaled,
+ * otherwise CO_RESET_NOT.
+ */
+CO_NMT_reset_cmd_t CO_process_signaled(
+        CO_t                   *CO,
+        uint32_t                signals,
+        uint32_t               *timerNext_us);
 
 
 /**
  * Process CANopen SYNC and RPDO objects.
  *
- * Function must be called cyclically from real time thread with constant
- * interval (1ms typically). It processes SYNC and receive PDO CANopen objects.
+ * Function must be called from real time thread, when SYNC or RPDO message is
+ * received or when timerNext_us expires. It processes SYNC and receive PDO
+ * CANopen objects. Only RPDOs marked in CO_t::RPDOpending are processed, at
+ * the rate of their group, see CO_setPDOgroupPeriod(). All are processed
+ * after SYNC.
  *
  * @param CO This object.
  * @param timeDifference_us Time difference from previous function call in [microseconds].
+ * @param timerNext_us Return value - info to OS - maximum delay after function
+ *        should be called next time in [microseconds], see CO_process().
+ *        Parameter is ignored if NULL.
  *
  * @return True, if CANopen SYNC message was just received or transmitted.
  */
 bool_t CO_process_SYNC_RPDO(
         CO_t                   *CO,
-        uint32_t                timeDifference_us);
+        uint32_t                timeDifference_us,
+        uint32_t               *timerNext_us);
+
+
+/**
+ * Check, if SYNC or RPDO message was received and waits for
+ * CO_process_SYNC_RPDO().
+ *
+ * @param CO This object.
+ *
+ * @return True, if real time processing should not wait for timerNext_us.
+ * RPDOs of periodic group, whose processing is already in timerNext_us,
+ * wait for it.
+ */
+bool_t CO_process_RT_pending(CO_t *CO);
 
 
 /**
  * Process CANopen TPDO objects.
  *
- * Function must be called cyclically from real time thread with constant.
- * interval (1ms typically). It processes transmit PDO CANopen objects.
+ * Function must be called from real time thread after CO_process_SYNC_RPDO().
+ * It advances CO_t::tmrRT, so only asynchronous TPDOs with expired timer are
+ * processed. Synchronous TPDOs are processed after SYNC. All TPDOs are
+ * processed after NMT state change and after CO_t::TPDOrestart is set.
  *
  * @param CO This object.
  * @param syncWas True, if CANopen SYNC message was just received or transmitted.
  * @param timeDifference_us Time difference from previous function call in [microseconds].
+ * @param timerNext_us Same as in CO_process_SYNC_RPDO().
  */
 void CO_process_TPDO(
         CO_t                   *CO,
         bool_t                  syncWas,
-        uint32_t                timeDifference_us);
+        uint32_t                timeDifference_us,
+        uint32_t               *timerNext_us);
+
+
+/**
+ * Degrade rate of all TPDOs.
+ *
+ * Each TPDO then runs at 1/2^slowdown of its configured rate, see
+ * CO_TPDO_SLOWDOWN_MAX. New value is applied by the next CO_process_TPDO(),
+ * so function may be called from any thread. Value is kept over CO_init().
+ *
+ * @param CO This object.
+ * @param slowdown 0 for configured rates, up to CO_TPDO_SLOWDOWN_MAX.
+ */
+void CO_setTPDOslowdown(CO_t *CO, uint8_t slowdown);
+
+
+/**
+ * Set period of PDO rate group.
+ *
+ * Realtime task processes PDOs of the group at this period, so fast PDOs
+ * run often without checking slow ones in each cycle:
+ *  - RPDO: received data are written to Object Dictionary at most once per
+ *    period, in the first cycle after a multiple of period. Later messages
+ *    overwrite earlier ones in between.
+ *  - TPDO: Change of State is checked each period instead of
+ *    CO_TPDO_COS_POLL_US. Event timer and inhibit time are not affected.
+ *
+ * Period 0 makes the group event-only: RPDOs are written in the cycle
+ * after reception, like in group 0, and Change of State of TPDOs is not
+ * checked, they are sent by event timer and SYNC only. All RPDOs are
+ * written after each SYNC. Group 0 has fixed behavior, see CO_PDO_GROUPS.
+ *
+ * Value is kept over CO_init() and used from the next CO_init().
+ *
+ * @param CO This object.
+ * @param group 1 ... CO_PDO_GROUPS - 1.
+ * @param period_us Period in microseconds or 0.
+ *
+ * @return #CO_ReturnError_t: CO_ERROR_NO or CO_ERROR_ILLEGAL_ARGUMENT.
+ */
+CO_ReturnError_t CO_setPDOgroupPeriod(CO_t *CO, uint8_t group, uint32_t period_us);
+
+
+/**
+ * Assign PDO to rate group, see CO_setPDOgroupPeriod(). All PDOs are in
+ * group 0 after CO_new(). Value is kept over CO_init() and used from the
+ * next CO_init().
+ *
+ * @param CO This object.
+ * @param tpdo True for TPDO, false for RPDO.
+ * @param pdo Index of PDO, 0 for RPDO1 or TPDO1.
+ * @param group 0 ... CO_PDO_GROUPS - 1.
+ *
+ * @return #CO_ReturnError_t: CO_ERROR_NO or CO_ERROR_ILLEGAL_ARGUMENT.
+ */
+CO_ReturnError_t CO_setPDOgroup(CO_t *CO, bool_t tpdo, uint16_t pdo, uint8_t group);
 
 #ifdef __cplusplus
 }
@@ -241,11 +241,11 @@ typedef enum{
 #define CO_EM_1F_unused                 0x1FU /**< 0x1F, (unused) */
 
 #define CO_EM_EMERGENCY_BUFFER_FULL     0x20U /**< 0x20, generic, info, Emergency buffer is full, Emergency message wasn't sent */
-#define CO_EM_21_unused                 0x21U /**< 0x21, (unused) */
+#define CO_EM_TASK_DEADLINE             0x21U /**< 0x21, generic, info, Realtime or mainline task missed its deadline */
 #define CO_EM_MICROCONTROLLER_RESET     0x22U /**< 0x22, generic, info, Microcontroller has just started */
-#define CO_EM_23_unused                 0x23U /**< 0x23, (unused) */
-#define CO_EM_24_unused                 0x24U /**< 0x24, (unused) */
-#define CO_EM_25_unused                 0x25U /**< 0x25, (unused) */
+#define CO_EM_APP_RT_OVERRUN            0x23U /**< 0x23, generic, info, Application hook of realtime task exceeded its budget */
+#define CO_EM_APP_MAIN_OVERRUN          0x24U /**< 0x24, generic, info, Application hook of mainline task exceeded its budget */
+#define CO_EM_RT_TIMER_MISSED           0x25U /**< 0x25, generic, info, Realtime task timer woke up after missed steps */
 #define CO_EM_26_unused                 0x26U /**< 0x26, (unused) */
 #define CO_EM_27_unused                 0x27U /**< 0x27, (unused) */
 
@@ -285,7 +285,9 @@ typedef struct{
     uint8_t            *bufReadPtr;     /**< Read pointer in the above buffer */
     uint8_t             bufFull;        /**< True if above buffer is full */
     uint8_t             wrongErrorReport;/**< Error in arguments to CO_errorReport() */
-    void              (*pFunctSignal)(void);/**< From CO_EM_initCallback() or NULL */
+    void              (*pFunctSignal)(void *object);/**< From CO_EM_initCallback() or NULL */
+    void               *functSignalObject;/**< From CO_EM_initCallback() or NULL */
+    CO_CANmodule_t     *CANdev;         /**< From CO_EM_init(), for CO_LOCK_EMCY() */
 }CO_EM_t;
 
 /**
@@ -406,11 +408,14 @@ CO_ReturnError_t CO_EM_init(
  * which processes mainline CANopen functions.
  *
  * @param em This object.
+ * @param object Pointer to object, which will be passed to pFunctSignal().
+ * Can be NULL.
  * @param pFunctSignal Pointer to the callback function. Not called if NULL.
  */
 void CO_EM_initCallback(
         CO_EM_t               *em,
-        void                  (*pFunctSignal)(void));
+        void                  *object,
+        void                  (*pFunctSignal)(void *object));
 
 
 /**
@@ -424,12 +429,14 @@ void CO_EM_initCallback(
  * @param NMTisPreOrOperational True if this node is NMT_PRE_OPERATIONAL or NMT_OPERATIONAL.
  * @param timeDifference_100us Time difference from previous function call in [100 * microseconds].
  * @param emInhTime _Inhibit time EMCY_ (object dictionary, index 0x1015).
+ * @param timerNext_us Return value - info to OS - see CO_process().
  */
 void CO_EM_process(
         CO_EMpr_t              *emPr,
         bool_t                  NMTisPreOrOperational,
         uint16_t                timeDifference_100us,
-        uint16_t                emInhTime);
+        uint16_t                emInhTime,
+        uint32_t               *timerNext_us);
 
 
 #endif
@@ -54,6 +54,7 @@ extern "C" {
 
 #include "Karsh.h"
 #include "Logger.h"
+#include "CO_tmrWheel.h"
 
 /**
  * @defgroup CO_HBconsumer Heartbeat consumer
@@ -68,18 +69,35 @@ extern "C" {
  * variable _allMonitoredOperational_ inside CO_HBconsumer_t is set to true.
  * Monitoring starts after the reception of the first HeartBeat (not bootup).
  *
+ * Each monitored node has own timer on the timer wheel, which is restarted by
+ * its Heartbeat. Received messages and expired timers mark the node pending
+ * and CO_HBconsumer_process() handles only pending nodes, so its cost does not
+ * grow with the number of monitored nodes.
+ *
  * @see  @ref CO_NMT_Heartbeat
  */
 
 
+/** Size of CO_HBconsumer_t::pending, one bit for each of up to 255 monitored nodes */
+#define CO_HB_CONS_PENDING_WORDS    8
+
+
 /**
  * One monitored node inside CO_HBconsumer_t.
  */
 typedef struct{
-    uint8_t             NMTstate;       /**< Of the remote node */
     bool_t              monStarted;     /**< True after reception of the first Heartbeat mesage */
-    uint16_t            timeoutTimer;   /**< Time since last heartbeat received */
+    bool_t              timeout;        /**< True if timer expired and timeout is not processed yet */
+    bool_t              operational;    /**< NMTstate is operational, counted in CO_HBconsumer_t */
     uint16_t            time;           /**< Consumer heartbeat time from OD */
+    void              (*pFunctSignal)(void *object);/**< From CO_HBconsumer_initCallback() or NULL */
+    void               *functSignalObject;/**< From CO_HBconsumer_initCallback() or NULL */
+    CO_tmr_t            tmr;            /**< Expires, when Heartbeat is late */
+    uint32_t           *pending;        /**< Word in CO_HBconsumer_t::pending with bit of this node */
+    uint32_t            pendingMask;    /**< Bit of this node */
+    /** Of the remote node. Fields from here on are written by CAN receive in
+    realtime thread and start own cache line, the rest is used by mainline. */
+    uint8_t             NMTstate CO_CACHE_ALIGNED;
     bool_t              CANrxNew;       /**< True if new Heartbeat message received from the CAN bus */
 }CO_HBconsNode_t;
 
@@ -98,8 +116,17 @@ typedef struct{
     /** True, if all monitored nodes are NMT operational or no node is
         monitored. Can be read by the application */
     uint8_t             allMonitoredOperational;
+    uint8_t             monitoredCount; /**< Number of nodes with consumer heartbeat time */
+    uint8_t             operationalCount; /**< Number of monitored nodes, which are operational */
+    bool_t              NMTisPreOrOperational; /**< From the previous CO_HBconsumer_process() */
     CO_CANmodule_t     *CANdevRx;       /**< From CO_HBconsumer_init() */
     uint16_t            CANdevRxIdxStart; /**< From CO_HBconsumer_init() */
+    void              (*pFunctSignal)(void *object);/**< From CO_HBconsumer_initCallback() or NULL */
+    void               *functSignalObject;/**< From CO_HBconsumer_initCallback() or NULL */
+    CO_tmrWheel_t      *wheel;          /**< From CO_HBconsumer_init() */
+    /** Bit for each node with received message or expired timer. Set from
+    CAN receive and from the timer, accessed atomically */
+    uint32_t            pending[CO_HB_CONS_PENDING_WORDS];
 }CO_HBconsumer_t;
 
 
@@ -119,6 +146,8 @@ typedef struct{
  * @param CANdevRx CAN device for Heartbeat reception.
  * @param CANdevRxIdxStart Starting index of receive buffer in the above CAN device.
  * Number of used indexes is equal to numberOfMonitoredNodes.
+ * @param wheel Timer wheel for timeouts. It must be advanced from the same
+ * thread, which calls CO_HBconsumer_process().
  *
  * @return #CO_ReturnError_t CO_ERROR_NO or CO_ERROR_ILLEGAL_ARGUMENT.
  */
@@ -130,22 +159,42 @@ CO_ReturnError_t CO_HBconsumer_init(
         CO_HBconsNode_t         monitoredNodes[],
         uint8_t                 numberOfMonitoredNodes,
         CO_CANmodule_t         *CANdevRx,
-        uint16_t                CANdevRxIdxStart);
+        uint16_t                CANdevRxIdxStart,
+        CO_tmrWheel_t          *wheel);
+
+
+/**
+ * Initialize Heartbeat receive callback function.
+ *
+ * Function initializes optional callback function, which is called after
+ * Heartbeat message from monitored node is received from the CAN bus. Function
+ * may wake up external task, which processes mainline CANopen functions, so
+ * timeout is measured from reception and not from the next processing.
+ *
+ * @param HBcons This object.
+ * @param object Pointer to object, which will be passed to pFunctSignal().
+ * Can be NULL.
+ * @param pFunctSignal Pointer to the callback function. Not called if NULL.
+ */
+void CO_HBconsumer_initCallback(
+        CO_HBconsumer_t        *HBcons,
+        void                   *object,
+        void                  (*pFunctSignal)(void *object));
 
 
 /**
  * Process Heartbeat consumer object.
  *
- * Function must be called cyclically.
+ * Function must be called after the timer wheel is advanced, after Heartbeat
+ * reception (see CO_HBconsumer_initCallback()) and after NMT state change.
+ * Timeouts are driven by the wheel, so there is no time argument.
  *
  * @param HBcons This object.
  * @param NMTisPreOrOperational True if this node is NMT_PRE_OPERATIONAL or NMT_OPERATIONAL.
- * @param timeDifference_ms Time difference from previous function call in [milliseconds].
  */
 void CO_HBconsumer_process(
         CO_HBconsumer_t        *HBcons,
-        bool_t                  NMTisPreOrOperational,
-        uint16_t                timeDifference_ms);
+        bool_t                  NMTisPreOrOperational);
 
 #ifdef __cplusplus
 }
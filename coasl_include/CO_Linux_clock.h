@@ -0,0 +1,136 @@
+/**
+ * Clock source of Linux task layer: CLOCK_MONOTONIC or virtual time.
+ *
+ * @file        CO_Linux_clock.h
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * CANopenNode is free and open source software: you can redistribute
+ * it and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef CO_LINUX_CLOCK_H
+#define CO_LINUX_CLOCK_H
+
+#include <time.h>
+#include "CO_driver.h"
+
+
+/**
+ * CANopen objects get time only as timeDifference from mainline and
+ * realtime task (CO_Linux_tasks.h), so the tasks are the only users of a
+ * clock. They read time and arm their timers through these functions.
+ *
+ * By default time is CLOCK_MONOTONIC and timers are timerfd. After
+ * CO_clock_setVirtual() time stands still, until the simulation advances it
+ * with CO_clock_advance(). Timers are then eventfd, which is written, when
+ * virtual time reaches its expiration. Tasks read and poll them the same
+ * way as timerfd. Simulation, which runs both tasks from one thread and
+ * advances time only when no file descriptor is ready, runs hours of bus
+ * activity in seconds and each run gives the same result, see
+ * tools/sim_vclock.c.
+ *
+ * Wakeup latency and execution time in task statistics are zero in
+ * virtual time. Watchdog (CO_Linux_wdog.h), profiling (CO_prof.h) and the
+ * logger keep real time.
+ */
+
+
+/** Maximum number of timers in virtual time, two for each CANopen object */
+#ifndef CO_CLOCK_TIMERS
+#define CO_CLOCK_TIMERS         64
+#endif
+
+
+/**
+ * Switch to virtual time. Must be called before tasks are initialized and
+ * before any thread uses the clock. There is no way back to real time.
+ *
+ * @param start_ns Initial virtual time in nanoseconds, above zero, because
+ * zero expiration disarms timer.
+ */
+void CO_clock_setVirtual(int64_t start_ns);
+
+
+/**
+ * @return True, if clock is virtual.
+ */
+bool_t CO_clock_isVirtual(void);
+
+
+/**
+ * Get current time, replaces clock_gettime(CLOCK_MONOTONIC, t).
+ *
+ * @param [out] t Current time.
+ *
+ * @return 0 on success, -1 on error (errno is set).
+ */
+int CO_clock_gettime(struct timespec *t);
+
+
+/**
+ * Create one shot timer, replaces timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK).
+ *
+ * Reading expired timer returns number of expirations as uint64_t, reading
+ * not expired timer fails with EAGAIN.
+ *
+ * @return File descriptor, or -1 on error (errno is set).
+ */
+int CO_clock_timerCreate(void);
+
+
+/**
+ * Arm timer to absolute time, replaces timerfd_settime() with
+ * TFD_TIMER_ABSTIME. Pending expirations are cleared. Only it_value is used,
+ * zero disarms the timer.
+ *
+ * @param fd Timer from CO_clock_timerCreate().
+ * @param spec Expiration time.
+ *
+ * @return 0 on success, -1 on error (errno is set).
+ */
+int CO_clock_timerSet(int fd, const struct itimerspec *spec);
+
+
+/**
+ * Close timer from CO_clock_timerCreate().
+ *
+ * @param fd Timer.
+ */
+void CO_clock_timerClose(int fd);
+
+
+/**
+ * Advance virtual time to the earliest armed timer, but not beyond until_ns.
+ *
+ * All timers, which expire at the new time, become readable. Simulation
+ * calls it, when tasks have nothing more to do at the current time.
+ *
+ * @param until_ns End of the step in nanoseconds.
+ *
+ * @return True, if timer expired. False, if time reached until_ns or the
+ * clock is not virtual.
+ */
+bool_t CO_clock_advance(int64_t until_ns);
+
+
+/**
+ * @return Current time in nanoseconds, real or virtual.
+ */
+int64_t CO_clock_ns(void);
+
+
+#endif
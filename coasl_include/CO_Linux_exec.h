@@ -0,0 +1,207 @@
+/**
+ * Executor for several CAN buses: realtime thread per bus and a shared pool
+ * of threads for mainline processing.
+ *
+ * @file        CO_Linux_exec.h
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * CANopenNode is free and open source software: you can redistribute
+ * it and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef CO_LINUX_EXEC_H
+#define CO_LINUX_EXEC_H
+
+#include <pthread.h>
+#include "CANopen.h"
+#include "CO_Linux_tasks.h"
+#include "CO_Linux_rt.h"
+
+
+/**
+ * Each bus (CANopen object) gets own realtime thread, which runs
+ * CANrx_taskTmr and may be pinned to a CPU. Mainline work of all buses (SDO,
+ * EMCY, NMT, Heartbeat consumer, CO_process() deadlines) runs on a small pool
+ * of worker threads, so idle buses cost no thread and no CPU.
+ *
+ * Bus becomes ready, when its signal callback (taskMain_cbSignal) fires or
+ * its mainline timer expires. Ready bus is pushed to the deque of the
+ * worker, which made it ready, or to the deque of its home worker, if it was
+ * made ready by realtime thread. Worker takes buses from the bottom of own
+ * deque and, when it is empty, steals from the top of other deques. One bus
+ * is processed by one worker at a time. Workers without work sleep in epoll.
+ * Deques are short (at most number of buses) and protected by own mutex.
+ */
+
+
+/** Bus is not queued and not processed */
+#define CO_EXEC_IDLE        0U
+/** Bus is in some deque */
+#define CO_EXEC_QUEUED      1U
+/** Bus is processed by a worker */
+#define CO_EXEC_RUNNING     2U
+/** Bus is processed and was made ready again meanwhile */
+#define CO_EXEC_RERUN       3U
+
+/** Pending work of bus: signal from callback */
+#define CO_EXEC_PEND_SIGNAL 0x01U
+/** Pending work of bus: mainline timer expired */
+#define CO_EXEC_PEND_TIMER  0x02U
+
+
+struct CO_exec;
+
+
+/**
+ * Bus object, one for each CANopen object run by the executor.
+ *
+ * Object must be filled with zeros before first CO_execBus_start(),
+ * statistics of its tasks are kept over following starts.
+ */
+typedef struct{
+    struct CO_exec     *exec;           /**< From CO_execBus_start() */
+    CO_t               *CO;             /**< From CO_execBus_start() */
+    CO_taskMain_t       tm;             /**< Mainline task, run by workers */
+    CO_taskRT_t         rt;             /**< Realtime task, run by rtThread */
+    int                 fdEpollRT;      /**< Epoll of rtThread */
+    pthread_t           rtThread;       /**< Realtime thread of the bus */
+    CO_rtThreadCfg_t    rtThreadCfg;    /**< From CO_execBus_start() */
+    volatile int        rtRun;          /**< rtThread runs while set */
+    volatile int        stopping;       /**< Set by CO_execBus_stop() */
+    uint32_t            state;          /**< CO_EXEC_IDLE ..., accessed atomically */
+    uint32_t            pending;        /**< CO_EXEC_PEND_xxx, accessed atomically */
+    uint32_t            home;           /**< Worker for wakeups from rtThread */
+    uint32_t            reset;          /**< Last CO_NMT_reset_cmd_t, accessed atomically */
+}CO_execBus_t;
+
+
+/**
+ * Worker thread of the pool.
+ */
+typedef struct{
+    struct CO_exec     *exec;           /**< Pool of this worker */
+    uint32_t            index;          /**< Index in the pool */
+    pthread_t           thread;         /**< Thread of this worker */
+    pthread_mutex_t     mtx;            /**< Protects deque */
+    CO_execBus_t      **deque;          /**< Ring buffer of ready buses */
+    uint32_t            top;            /**< Steal end, index into ring */
+    uint32_t            count;          /**< Number of buses in deque */
+    uint64_t            executed;       /**< Processed buses, informative */
+    uint64_t            stolen;         /**< Buses stolen from other workers, informative */
+}CO_execWorker_t;
+
+
+/**
+ * Executor object.
+ */
+typedef struct CO_exec{
+    CO_execWorker_t    *workers;        /**< Array of noWorkers */
+    uint32_t            noWorkers;      /**< From CO_exec_init() */
+    uint32_t            maxBuses;       /**< From CO_exec_init(), deque size */
+    uint32_t            noBuses;        /**< Started buses, accessed atomically */
+    uint32_t            nextHome;       /**< Home worker of next started bus */
+    uint32_t            idle;           /**< Workers going to sleep, accessed atomically */
+    int                 fdEpoll;        /**< Mainline timers of all buses and fdWake */
+    int                 fdWake;         /**< Eventfd, wakes sleeping workers */
+    volatile int        run;            /**< Workers run while set */
+    pthread_rwlock_t    dispatchLock;   /**< Held by worker, which dispatches epoll events */
+    const CO_rtCfg_t   *rtCfg;          /**< From CO_exec_init() */
+    CO_rtThreadCfg_t    workerCfg;      /**< From CO_exec_init() */
+}CO_exec_t;
+
+
+/**
+ * Initialize executor and start its worker threads.
+ *
+ * @param exec This object will be initialized.
+ * @param noWorkers Number of worker threads, 1 or more. Number of CPUs,
+ * which are not used by realtime threads, is a good choice.
+ * @param maxBuses Maximum number of buses started at the same time.
+ * @param rtCfg Realtime configuration of the program, see CO_rtCfg_load().
+ * It must exist until CO_exec_close().
+ * @param workerCfg Scheduling and CPU affinity of worker threads, for
+ * example &rtCfg->main.
+ *
+ * @return 0 on success, -1 on error (errno is set).
+ */
+int CO_exec_init(
+        CO_exec_t              *exec,
+        uint32_t                noWorkers,
+        uint32_t                maxBuses,
+        const CO_rtCfg_t       *rtCfg,
+        const CO_rtThreadCfg_t *workerCfg);
+
+
+/**
+ * Stop worker threads and free the executor. All buses must be stopped.
+ *
+ * @param exec This object.
+ */
+void CO_exec_close(CO_exec_t *exec);
+
+
+/**
+ * Start processing of bus.
+ *
+ * Must be called after CO_init() of the CANopen object. Function initializes
+ * mainline and realtime task of the bus, connects signal callbacks of CANopen
+ * objects to the mainline and creates realtime thread. Application then
+ * switches CAN module to normal mode with CO_CANsetNormalMode().
+ *
+ * @param exec Executor.
+ * @param bus This object.
+ * @param CO CANopen object.
+ * @param rtThreadCfg Scheduling and CPU affinity of realtime thread of the
+ * bus. Use cpuMask to pin it.
+ * @param intervalns Longest sleep of realtime task in nanoseconds.
+ *
+ * @return 0 on success, -1 on error (errno is set).
+ */
+int CO_execBus_start(
+        CO_exec_t              *exec,
+        CO_execBus_t           *bus,
+        CO_t                   *CO,
+        const CO_rtThreadCfg_t *rtThreadCfg,
+        long                    intervalns);
+
+
+/**
+ * Stop processing of bus.
+ *
+ * Realtime thread is joined and function waits, until no worker processes
+ * the bus. After that CANopen object may be reinitialized or deleted.
+ *
+ * @param bus This object.
+ */
+void CO_execBus_stop(CO_execBus_t *bus);
+
+
+/**
+ * Get and clear reset command, which mainline of the bus returned.
+ *
+ * Executor does not reset the bus itself. Application polls this function
+ * and for communication reset calls CO_execBus_stop(), CO_init() and
+ * CO_execBus_start().
+ *
+ * @param bus This object.
+ *
+ * @return CO_RESET_NOT or reset command from CO_process().
+ */
+CO_NMT_reset_cmd_t CO_execBus_reset(CO_execBus_t *bus);
+
+
+#endif
@@ -0,0 +1,196 @@
+/**
+ * Realtime configuration of CANopen threads in Linux.
+ *
+ * @file        CO_Linux_rt.h
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * CANopenNode is free and open source software: you can redistribute
+ * it and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef CO_LINUX_RT_H
+#define CO_LINUX_RT_H
+
+#include "CANopen.h"
+
+
+/**
+ * Scheduling policy of one thread.
+ */
+typedef enum{
+    CO_RT_POLICY_OTHER = 0,     /**< SCHED_OTHER, nothing is changed */
+    CO_RT_POLICY_FIFO = 1,      /**< SCHED_FIFO with priority */
+    CO_RT_POLICY_RR = 2,        /**< SCHED_RR with priority */
+    CO_RT_POLICY_DEADLINE = 3   /**< SCHED_DEADLINE with runtime, deadline and period */
+}CO_rtPolicy_t;
+
+
+/**
+ * Catch-up policy of realtime task, after its timer woke up late by one or
+ * more intervals, see CANrx_taskTmr_setCatchup().
+ */
+typedef enum{
+    /** Run cycles back to back, each with the programmed time step, until
+     * the task is on time. After catchupMax extra cycles one more cycle
+     * skips the rest of missed time. Each expired SYNC and TPDO timer fires. */
+    CO_RT_CATCHUP_REPEAT = 0,
+    /** Run one cycle with all the time up to now. Timers, which expired more
+     * times, fire once and keep their phase. */
+    CO_RT_CATCHUP_ACCUMULATE = 1,
+    /** Run one cycle with the programmed time step only, missed time is
+     * dropped. All deadlines move later by the wakeup latency. */
+    CO_RT_CATCHUP_SKIP = 2
+}CO_rtCatchup_t;
+
+
+/**
+ * Configuration of one thread.
+ */
+typedef struct{
+    CO_rtPolicy_t   policy;     /**< Scheduling policy */
+    int             priority;   /**< Priority for FIFO and RR, 1..99 */
+    uint32_t        runtime_us; /**< Runtime for DEADLINE */
+    uint32_t        deadline_us;/**< Relative deadline for DEADLINE */
+    uint32_t        period_us;  /**< Period for DEADLINE */
+    uint64_t        cpuMask;    /**< CPU affinity, bit n is CPU n, 0 keeps default */
+}CO_rtThreadCfg_t;
+
+
+/**
+ * Realtime configuration of the program.
+ */
+typedef struct{
+    CO_rtThreadCfg_t main;      /**< Mainline thread */
+    CO_rtThreadCfg_t rt;        /**< Realtime thread (CANrx_taskTmr) */
+    CO_rtThreadCfg_t wdog;      /**< Watchdog thread, see CO_Linux_wdog.h */
+    bool_t          lockMemory; /**< Lock all memory with mlockall() */
+    uint32_t        stackPrefault_kB;/**< Stack prefaulted in each realtime thread */
+    uint32_t        reportInterval_s;/**< Interval of taskRT jitter report, 0 = at exit only */
+    CO_rtCatchup_t  catchup;    /**< Catch-up policy of taskRT after late wakeup */
+    uint32_t        catchupMax; /**< Extra cycles for CO_RT_CATCHUP_REPEAT */
+    bool_t          syncPhase;  /**< Phase-lock taskRT timer to received SYNC */
+    uint32_t        syncOffset_us;/**< Timer cycle of taskRT after each SYNC */
+    uint32_t        wdogPeriod_ms;/**< Check interval of watchdog, 0 = no watchdog */
+    uint32_t        wdogRtTimeout_ms;/**< Longest time without taskRT cycle */
+    uint32_t        wdogMainTimeout_ms;/**< Longest time without taskMain cycle */
+    uint32_t        wdogEscalate;/**< Consecutive late checks for each escalation level */
+    uint32_t        wdogSlowdown;/**< TPDO slowdown of degraded node, see CO_setTPDOslowdown() */
+    char            wdogDevice[64];/**< Linux watchdog device, empty for none */
+    uint32_t        appRtBudget_us;/**< Budget of program1ms() in taskRT, 0 = unlimited */
+    uint32_t        appMainBudget_us;/**< Budget of programAsync() in taskMain, 0 = unlimited */
+    uint32_t        pdoGroupPeriod_us[CO_PDO_GROUPS];/**< See CO_setPDOgroupPeriod(), [0] unused */
+    uint8_t         rpdoGroup[CO_NO_RPDO];/**< Rate group of each RPDO, see CO_setPDOgroup() */
+    uint8_t         tpdoGroup[CO_NO_TPDO];/**< Rate group of each TPDO */
+}CO_rtCfg_t;
+
+
+/**
+ * Set default configuration: SCHED_OTHER for all threads, no memory locking,
+ * CO_RT_CATCHUP_REPEAT with at most 10 extra cycles, no phase lock to SYNC,
+ * no watchdog, application hook budgets of 1 ms in taskRT and 20 ms in
+ * taskMain.
+ *
+ * @param cfg Configuration to initialize.
+ */
+void CO_rtCfg_default(CO_rtCfg_t *cfg);
+
+
+/**
+ * Read configuration from file.
+ *
+ * File has one "key = value" per line, '#' starts a comment. Keys are:
+ *  - main.policy, rt.policy, wdog.policy: other, fifo, rr or deadline.
+ *  - main.priority, rt.priority, wdog.priority: 1..99 for fifo and rr.
+ *  - main.cpus, rt.cpus, wdog.cpus: CPU list, for example "1" or "0,2-3".
+ *  - main.runtime_us, main.deadline_us, main.period_us and the same with
+ *    rt and wdog prefix: parameters for deadline policy.
+ *  - lock_memory: 0 or 1.
+ *  - stack_prefault_kb: stack size touched at start of realtime thread.
+ *  - report_interval_s: interval of taskRT jitter report.
+ *  - catchup: repeat, accumulate or skip, see CO_rtCatchup_t.
+ *  - catchup_max: extra cycles for repeat.
+ *  - sync_phase: 0 or 1, see CANrx_taskTmr_setSyncPhase().
+ *  - sync_offset_us: offset of taskRT timer cycle after SYNC.
+ *  - watchdog_period_ms: check interval of watchdog, 0 disables it.
+ *  - watchdog_rt_timeout_ms, watchdog_main_timeout_ms: deadlines of tasks.
+ *  - watchdog_escalate: late checks for each escalation level.
+ *  - watchdog_slowdown: 0..4, TPDO slowdown of degraded node.
+ *  - watchdog_device: Linux watchdog device, for example /dev/watchdog.
+ *  - app_rt_budget_us, app_main_budget_us: execution budget of application
+ *    hooks, see CANrx_taskTmr_initApp() and taskMain_initApp().
+ *  - pdo_group1_us ... pdo_group3_us: period of PDO rate group, 0 for
+ *    event-only, see CO_setPDOgroupPeriod().
+ *  - rpdo_groups, tpdo_groups: rate group of each PDO, like "1,1,0,2" for
+ *    PDO1 to PDO4. Missing PDOs are in group 0.
+ *
+ * Keys not in the file keep their value from cfg.
+ *
+ * @param filename Name of the configuration file.
+ * @param cfg Configuration to update.
+ *
+ * @return 0 on success, -1 if file can not be opened, otherwise line number
+ * of the first invalid line.
+ */
+int CO_rtCfg_load(const char *filename, CO_rtCfg_t *cfg);
+
+
+/**
+ * Lock memory for the process.
+ *
+ * Locks current and future pages with mlockall() and disables trimming and
+ * mmap in malloc, so memory once allocated stays resident. Must be called
+ * before realtime threads are created.
+ *
+ * @param cfg Configuration. Nothing is done if lockMemory is false.
+ *
+ * @return 0 on success, -1 on error (errno is set).
+ */
+int CO_rtMemoryLock(const CO_rtCfg_t *cfg);
+
+
+/**
+ * Apply configuration to the calling thread.
+ *
+ * Sets CPU affinity and scheduling policy. If memory is locked, stack of
+ * the calling thread is prefaulted.
+ *
+ * @param cfg Configuration of the program.
+ * @param thread Configuration of the calling thread, cfg->main, cfg->rt or
+ * cfg->wdog.
+ *
+ * @return 0 on success, -1 on error (errno is set).
+ */
+int CO_rtThreadApply(const CO_rtCfg_t *cfg, const CO_rtThreadCfg_t *thread);
+
+
+#ifndef CO_SINGLE_THREAD
+/**
+ * Initialize mutex with priority inheritance.
+ *
+ * Realtime thread then can not be blocked by lower priority thread, which
+ * holds the mutex and is preempted. Used by CO_CANmodule_init() for mutexes
+ * from Karsh.h, before threads of the CANopen object are created.
+ *
+ * @param mutex Mutex to initialize, must not be initialized yet.
+ *
+ * @return 0 on success, error number from pthread otherwise.
+ */
+int CO_rtMutexInit(pthread_mutex_t *mutex);
+#endif
+
+
+#endif
@@ -27,92 +27,366 @@
 #ifndef CO_LINUX_TASKS_H
 #define CO_LINUX_TASKS_H
 
+#include <time.h>
 #include "stdbool.h"
-#include "CO_driver.h"
-#include "CO_NMT_Heartbeat.h"
+#include "CANopen.h"
+#include "CO_hist.h"
 #include "Karsh.h"
+#include "CO_Linux_rt.h"
+#include "CO_Linux_clock.h"
+#include "CO_async.h"
+#include "CO_syncPll.h"
+
+/**
+ * Timing statistics of one task, all values are in microseconds.
+ *
+ * Histograms are recorded by the task itself and kept from program start,
+ * also over communication reset. Use CO_hist_snapshot() to read them.
+ */
+typedef struct{
+    /** Wakeup latency: time between programmed timer expiration and start of
+     * processing. Recorded on timer cycles only. */
+    CO_hist_t   wakeup;
+    /** Execution time of one cycle, from wakeup to end of processing. */
+    CO_hist_t   exec;
+    /** Period jitter: difference of wakeup latency between consecutive
+     * timer cycles, this is deviation of measured period from programmed. */
+    CO_hist_t   period;
+    /** Timer cycles with wakeup latency of the whole programmed sleep or more. */
+    uint32_t    overruns;
+    /** Whole timer steps missed by late timer wakeups (realtime task only). */
+    uint32_t    missedTicks;
+    /** Execution time of each call of the application hook, see
+     * CANrx_taskTmr_initApp() and taskMain_initApp(). Not in snapshot. */
+    CO_hist_t   app;
+    /** Calls of the application hook longer than its budget. */
+    uint32_t    appOverruns;
+}CO_taskStats_t;
+
+
+/**
+ * Mainline task object, one for each CANopen object.
+ *
+ * Object must be filled with zeros before first taskMain_init(), statistics
+ * are kept over following initializations.
+ */
+typedef struct{
+    CO_t               *CO;             /**< From taskMain_init() */
+    int                 fdTmr;          /**< File descriptor for timer, see CO_Linux_clock.h */
+    int                 fdEvent;        /**< Eventfd for triggering mainline */
+    uint32_t            signals;        /**< Pending CO_SIGNAL_xxx, accessed atomically */
+    struct itimerspec   tmrSpec;        /**< it_value is absolute expiration */
+    struct timespec     tmrAccounted;   /**< Time, which CO_process() already got */
+    uint32_t            sleepus;        /**< Programmed sleep of the armed timer */
+    long                latencyPrev;    /**< Wakeup latency of previous timer cycle */
+    bool_t              latencyPrevValid; /**< latencyPrev is set */
+    uint16_t           *maxTime;        /**< From taskMain_init() */
+    void               *wakeObject;     /**< From taskMain_initWakeup() */
+    void              (*pFunctWake)(void *object); /**< From taskMain_initWakeup() */
+    CO_async_t         *async;          /**< From taskMain_initAsync() */
+    void              (*pFunctApp)(uint16_t timer1msDiff); /**< From taskMain_initApp() */
+    uint32_t            appBudgetus;    /**< From taskMain_initApp() */
+    uint32_t            appGood;        /**< Calls within budget since the last overrun */
+    uint32_t            progress;       /**< Completed cycles, accessed atomically, see CO_Linux_wdog.h */
+    CO_taskStats_t      stats;          /**< Updated by mainline thread */
+    CO_taskStats_t      snapshot;       /**< Last snapshot read through OD */
+}CO_taskMain_t;
+
+
+/**
+ * Realtime task object, one for each CANopen object.
+ *
+ * Object must be filled with zeros before first CANrx_taskTmr_init(),
+ * statistics are kept over following initializations.
+ */
+typedef struct{
+    CO_t               *CO;             /**< From CANrx_taskTmr_init() */
+    int                 fdRx0;          /**< File descriptor for CANrx */
+    int                 fdTmr;          /**< File descriptor for timer, see CO_Linux_clock.h */
+    struct itimerspec   tmrSpec;        /**< it_value is absolute expiration */
+    struct timespec    *tmrVal;         /**< Points to tmrSpec.it_value */
+    struct timespec     tmrAccounted;   /**< Time, which RT objects already got */
+    struct timespec     cyclePrev;      /**< Start of previous cycle */
+    long                intervalus;     /**< Maximum sleep */
+    uint32_t            sleepus;        /**< Programmed sleep of the armed timer */
+    long                latencyPrev;    /**< Wakeup latency of previous timer cycle */
+    bool_t              latencyPrevValid; /**< latencyPrev is set */
+    uint32_t            stepus;         /**< Step of the armed timer from tmrAccounted */
+    uint32_t            tmrGood;        /**< Timer wakeups without missed steps since the last report */
+    uint16_t           *maxTime;        /**< From CANrx_taskTmr_init() */
+    CO_rtCatchup_t      catchup;        /**< From CANrx_taskTmr_setCatchup() */
+    uint32_t            catchupMax;     /**< From CANrx_taskTmr_setCatchup() */
+    volatile bool_t     CANrxLocked;    /**< Set by CANrx_lockCbSync(), cleared after RPDOs are processed */
+    bool_t              syncPhase;      /**< From CANrx_taskTmr_setSyncPhase() */
+    int64_t             syncOffsetns;   /**< From CANrx_taskTmr_setSyncPhase() */
+    CO_syncPll_t        syncPll;        /**< Follows received SYNC, updated by realtime thread */
+    void              (*pFunctApp)(uint32_t timeDifference_us); /**< From CANrx_taskTmr_initApp() */
+    uint32_t            appBudgetus;    /**< From CANrx_taskTmr_initApp() */
+    uint32_t            appGood;        /**< Calls within budget since the last overrun */
+    uint32_t            progress;       /**< Completed cycles, accessed atomically, see CO_Linux_wdog.h */
+    CO_taskStats_t      stats;          /**< Updated by realtime thread */
+    CO_taskStats_t      snapshot;       /**< Last snapshot read through OD */
+}CO_taskRT_t;
+
 
 /**
  * Initialize mainline task.
  *
  * taskMain is non-realtime task for CANopenNode processing. It is nonblocking
- * and is executing cyclically in 50 ms intervals or less if necessary.
- * It uses Linux epoll, timerfd for interval and pipe for task triggering.
- * This task processes CO_process() function from CANopen.c file.
+ * and sleeps until the earliest deadline reported by CO_process() (at most
+ * one second). It uses Linux epoll, timerfd for deadlines and eventfd for task
+ * triggering. Time and timer come from CO_Linux_clock.h, so the task also runs
+ * in virtual time. This task processes CO_process() function from CANopen.c file
+ * on timer and on signal, followed by CO_process_signaled() for objects, which
+ * signaled new work.
  *
- * @param fdEpoll File descriptor for Linux epoll API.
+ * @param tm This object will be initialized.
+ * @param CO CANopen object, processed by the task.
+ * @param fdEpoll File descriptor for Linux epoll API. If negative, file
+ * descriptors are not added and caller polls tm->fdTmr itself.
  * @param maxTime Pointer to variable, where longest interval will be written
  * [in milliseconds]. If NULL, calculations won't be made.
  */
-void taskMain_init(int fdEpoll, uint16_t *maxTime);
+void taskMain_init(CO_taskMain_t *tm, CO_t *CO, int fdEpoll, uint16_t *maxTime);
+
+/**
+ * Replace eventfd wakeup of mainline task with a function.
+ *
+ * taskMain_signal() then calls pFunctWake instead of writing tm->fdEvent.
+ * It is called from the signaling thread, once for a burst of signals.
+ * Woken mainline calls taskMain_process() with tm->fdEvent, which takes the
+ * signals. Must be called after each taskMain_init().
+ *
+ * @param tm This object.
+ * @param object Argument for pFunctWake.
+ * @param pFunctWake Function, which wakes the mainline. NULL restores eventfd.
+ */
+void taskMain_initWakeup(CO_taskMain_t *tm, void *object, void (*pFunctWake)(void *object));
+
+/**
+ * Run application tasks from mainline task.
+ *
+ * taskMain_process() then calls CO_async_process() after CANopen objects and
+ * sleeps at most until the earliest deadline of tasks. Starting a task wakes
+ * the mainline. Must be called after each taskMain_init() and CO_async_init().
+ *
+ * @param tm This object.
+ * @param async Initialized scheduler, see CO_async.h. NULL disables it.
+ */
+void taskMain_initAsync(CO_taskMain_t *tm, CO_async_t *async);
+
+/**
+ * Call application hook from mainline task.
+ *
+ * taskMain_process() calls pFunctApp after CANopen objects and application
+ * tasks in each cycle, with milliseconds since the previous cycle. Execution
+ * time of each call is recorded in CO_taskStats_t::app. Call longer than
+ * budget_us is counted in CO_taskStats_t::appOverruns and reported with
+ * CO_EM_APP_MAIN_OVERRUN, info code is execution time in microseconds.
+ * Emergency is reset after 100 consecutive calls within budget. Mainline
+ * also runs SDO server and Heartbeat consumer, so hook must not block. Must
+ * be called after each taskMain_init().
+ *
+ * @param tm This object.
+ * @param pFunctApp Application hook, for example programAsync() from
+ * application.h. NULL disables it.
+ * @param budget_us Longest allowed call, 0 disables the check.
+ */
+void taskMain_initApp(CO_taskMain_t *tm, void (*pFunctApp)(uint16_t timer1msDiff), uint32_t budget_us);
 
 /**
  * Cleanup mainline task.
+ *
+ * @param tm This object.
  */
-void taskMain_close(void);
+void taskMain_close(CO_taskMain_t *tm);
 
 /**
  * Process mainline task.
  *
  * Function must be called after epoll.
  *
+ * @param tm This object.
  * @param fd Available file descriptor from epoll().
  * @param reset return value from CO_process() function.
- * @param timer1ms variable, which must increment each millisecond.
  *
  * @return True, if fd was matched.
  */
-bool_t taskMain_process(int fd, CO_NMT_reset_cmd_t *reset, uint16_t timer1ms);
+bool_t taskMain_process(CO_taskMain_t *tm, int fd, CO_NMT_reset_cmd_t *reset);
 
 /**
- * Signal function, which triggers mainline task.
+ * Trigger mainline task.
  *
- * It is used from some CANopenNode objects as callback.
+ * Signals are collected until the mainline takes them, only the first one
+ * wakes it up. Function may be called from any thread.
+ *
+ * @param tm This object.
+ * @param signals Combination of CO_SIGNAL_xxx from CANopen.h.
  */
-void taskMain_cbSignal(void);
+void taskMain_signal(CO_taskMain_t *tm, uint32_t signals);
+
+/**
+ * Signal functions, which trigger mainline task.
+ *
+ * They are used from CANopenNode objects as callbacks, object argument is
+ * CO_taskMain_t. taskMain_cbSignal() signals all objects, the others only the
+ * named one.
+ */
+void taskMain_cbSignal(void *object);
+void taskMain_cbSignalSDO(void *object);
+void taskMain_cbSignalEMCY(void *object);
+void taskMain_cbSignalNMT(void *object);
+void taskMain_cbSignalSDOclient(void *object);
+void taskMain_cbSignalHBconsumer(void *object);
 
 
 /**
  * Initialize realtime task.
  *
  * CANrx_taskTmr is realtime task for CANopenNode processing. It is nonblocking
- * and is executing on CAN message receive or periodically in 1ms (or something)
- * intervals. Inside interval is processed CANopen SYNC message, RPDOs(inputs)
- * and TPDOs(outputs). Between inputs and outputs can also be executed some
- * realtime application code.
+ * and is executing on CAN message receive. Its cycle processes CANopen SYNC
+ * message, RPDOs(inputs) and TPDOs(outputs). Between inputs and outputs can
+ * also be executed some realtime application code. Cycle runs, when SYNC or
+ * RPDO is received and when the next SYNC or TPDO deadline is due, so it does
+ * not tick without work.
  * CANrx_taskTmr uses Linux epoll, CAN socket form CO_driver.c and timerfd for
- * interval.
+ * deadlines, time and timer come from CO_Linux_clock.h.
+ *
+ * @param rt This object will be initialized.
+ * @param CO CANopen object, processed by the task.
+ * @param fdEpoll File descriptor for Linux epoll API. If negative, file
+ * descriptors are not added and caller polls rt->fdRx0 and rt->fdTmr itself.
+ * @param intervalns Longest sleep between cycles in nanoseconds.
+ * @param maxTime Pointer to variable, where longest interval between cycles
+ * will be written [in microseconds]. If NULL, calculations won't be made.
+ */
+void CANrx_taskTmr_init(CO_taskRT_t *rt, CO_t *CO, int fdEpoll, long intervalns, uint16_t *maxTime);
+
+/**
+ * Set catch-up policy of realtime task.
  *
+ * If timer wakes up late by one or more steps of the armed timer, missed
+ * steps are counted in CO_taskStats_t::missedTicks and informative
+ * CO_EM_RT_TIMER_MISSED is reported. It is reset after 100 wakeups in time.
+ * Policy then decides, how the missed time is given to SYNC, RPDO
+ * and TPDO objects. Default after CANrx_taskTmr_init() is
+ * CO_RT_CATCHUP_REPEAT with 10 extra cycles.
  *
- * @param fdEpoll File descriptor for Linux epoll API.
- * @param intervalns Interval of periodic timer in nanoseconds.
- * @param maxTime Pointer to variable, where longest interval will be written
- * [in milliseconds]. If NULL, calculations won't be made.
+ * @param rt This object.
+ * @param catchup Policy, see CO_rtCatchup_t.
+ * @param catchupMax Maximum extra cycles for CO_RT_CATCHUP_REPEAT.
+ */
+void CANrx_taskTmr_setCatchup(CO_taskRT_t *rt, CO_rtCatchup_t catchup, uint32_t catchupMax);
+
+/**
+ * Phase-lock timer of realtime task to received SYNC.
+ *
+ * Receive time of each SYNC updates CO_taskRT_t::syncPll. While PLL is
+ * locked, timer of the task is programmed to expire also offset_us after
+ * each predicted SYNC, so the timer cycle keeps fixed phase to SYNC producer
+ * instead of free-running interval. Reception of SYNC itself still runs
+ * a cycle immediately. Disabled after CANrx_taskTmr_init().
+ *
+ * @param rt This object.
+ * @param enable Enable phase lock.
+ * @param offset_us Offset of timer cycle after SYNC, shorter than SYNC period.
  */
-void CANrx_taskTmr_init(int fdEpoll, long intervalns, uint16_t *maxTime);
+void CANrx_taskTmr_setSyncPhase(CO_taskRT_t *rt, bool_t enable, uint32_t offset_us);
+
+/**
+ * Call application hook from realtime task.
+ *
+ * Each cycle calls pFunctApp after RPDOs are written to Object Dictionary
+ * and before TPDOs are read, so its time adds to PDO latency. Execution time
+ * is recorded in CO_taskStats_t::app, call longer than budget_us is counted
+ * in CO_taskStats_t::appOverruns and reported with CO_EM_APP_RT_OVERRUN, as
+ * by taskMain_initApp(). Cycles run on reception and deadlines, not each
+ * millisecond, see CANrx_taskTmr_init(), so pFunctApp gets the time since
+ * the previous cycle. Must be called after each CANrx_taskTmr_init().
+ *
+ * @param rt This object.
+ * @param pFunctApp Application hook, for example program1ms() from
+ * application.h. NULL disables it.
+ * @param budget_us Longest allowed call, 0 disables the check.
+ */
+void CANrx_taskTmr_initApp(CO_taskRT_t *rt, void (*pFunctApp)(uint32_t timeDifference_us), uint32_t budget_us);
 
 /**
  * Cleanup realtime task.
+ *
+ * @param rt This object.
  */
-void CANrx_taskTmr_close(void);
+void CANrx_taskTmr_close(CO_taskRT_t *rt);
 
 /**
  * Process realtime task.
  *
  * Function must be called after epoll.
  *
+ * @param rt This object.
  * @param fd Available file descriptor from epoll().
  *
  * @return True, if fd was matched.
  */
-bool_t CANrx_taskTmr_process(int fd);
+bool_t CANrx_taskTmr_process(CO_taskRT_t *rt, int fd);
 
 /**
- * Disable CAN receive thread temporary.
+ * Get timing statistics of realtime task.
+ *
+ * @param rt This object.
+ *
+ * @return Pointer to statistics, which are updated by realtime thread.
+ */
+CO_taskStats_t *CANrx_taskTmr_stats(CO_taskRT_t *rt);
+
+/**
+ * Get SYNC PLL of realtime task: lock state, period estimate and histogram
+ * of residual phase error, see CANrx_taskTmr_setSyncPhase().
+ *
+ * @param rt This object.
+ *
+ * @return Pointer to PLL, which is updated by realtime thread.
+ */
+const CO_syncPll_t *CANrx_taskTmr_syncPll(CO_taskRT_t *rt);
+
+/**
+ * Get timing statistics of mainline task.
+ *
+ * @param tm This object.
+ *
+ * @return Pointer to statistics, which are updated by mainline thread.
+ */
+CO_taskStats_t *taskMain_stats(CO_taskMain_t *tm);
+
+/**
+ * Configure Object Dictionary entries for task statistics.
+ *
+ * OD 0x2141 (taskRT) and 0x2142 (taskMain) are arrays of UNSIGNED32. Reading
+ * sub-index 1 (number of cycles) takes snapshot of all histograms of the task
+ * and resets them. Sub-indexes 2 to 13 then return p50, p99, p99.9 and
+ * maximum of wakeup latency, execution time and period jitter from that
+ * snapshot, see ODA_taskRTstatistics_xxx in CO_OD.h. Must be called after
+ * each CO_init().
+ *
+ * @param SDO SDO server object.
+ * @param tm Mainline task of the same CANopen object.
+ * @param rt Realtime task of the same CANopen object.
+ */
+void taskStats_configureOD(CO_SDO_t *SDO, CO_taskMain_t *tm, CO_taskRT_t *rt);
+
+/**
+ * Disable CAN receive temporary.
+ *
+ * Function is called at SYNC message on CAN bus, see CO_SYNC_initCallback().
+ * CANrx_taskTmr_init() connects it. Realtime task reads queued CAN messages
+ * in batches. After SYNC the batch ends and following messages stay in the
+ * socket, until CO_process_SYNC_RPDO() processed synchronous RPDOs received
+ * before the SYNC. So each SYNC gives consistent snapshot of RPDOs, without
+ * CO_LOCK_OD in CAN receive.
  *
- * Function is called at SYNC message on CAN bus.
- * It disables CAN receive thread until RPDOs are processed.
+ * @param object Realtime task, CO_taskRT_t.
+ * @param syncReceived True, if SYNC was received, false if transmitted.
  */
-void CANrx_lockCbSync(bool_t syncReceived);
+void CANrx_lockCbSync(void *object, bool_t syncReceived);
 
 #endif
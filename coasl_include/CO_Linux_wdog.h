@@ -0,0 +1,164 @@
+/**
+ * Deadline watchdog for realtime and mainline task, with escalation.
+ *
+ * @file        CO_Linux_wdog.h
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * CANopenNode is free and open source software: you can redistribute
+ * it and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef CO_LINUX_WDOG_H
+#define CO_LINUX_WDOG_H
+
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "CANopen.h"
+#include "CO_Linux_tasks.h"
+#include "CO_Linux_rt.h"
+
+
+/**
+ * Watchdog thread wakes every wdogPeriod_ms and checks progress counters of
+ * the tasks (CO_taskRT_t::progress and CO_taskMain_t::progress). Task is
+ * late, if its counter did not change for longer than its timeout. Realtime
+ * task is also late, if it missed timer steps since the previous check
+ * (CO_taskStats_t::missedTicks), so repeated overruns are detected even if
+ * the thread is not stuck. Heartbeat producer runs in mainline, so a hung
+ * realtime thread is not visible on the bus without the watchdog.
+ *
+ * Late checks escalate, each level after wdogEscalate more:
+ *  - CO_WDOG_EMCY: CO_EM_TASK_DEADLINE is reported with bitmask of late
+ *    tasks (CO_WDOG_LATE_xxx) as info code. It does not set error register.
+ *  - CO_WDOG_DEGRADE: TPDOs run at lower rate, see CO_setTPDOslowdown(), so
+ *    the node needs less CPU and bus time.
+ *  - CO_WDOG_PREOP: CO_EM_GENERIC_SOFTWARE_ERROR is reported and NMT state
+ *    is set to pre-operational. Error register keeps the node out of
+ *    operational, until the watchdog recovers.
+ *
+ * Late checks are counted until 2 * wdogEscalate consecutive checks without
+ * late task. Watchdog then returns to CO_WDOG_OK: emergencies are reset and
+ * TPDOs run at configured rates. NMT state stays, NMT master starts the
+ * node again.
+ *
+ * System supervisor is kicked after each check below CO_WDOG_PREOP, so it
+ * restarts the process or the machine, if the node does not recover:
+ *  - Linux watchdog device wdogDevice (for example /dev/watchdog, its
+ *    timeout must be longer than wdogEscalate periods). It is disarmed with
+ *    magic close by CO_wdog_close().
+ *  - Notify socket from NOTIFY_SOCKET environment variable, as systemd
+ *    service with WatchdogSec=. "READY=1" is sent at start, "WATCHDOG=1"
+ *    on each kick and "STOPPING=1" at close. Any process reading AF_UNIX
+ *    datagram socket may stand in for systemd.
+ */
+
+
+/** All tasks made progress */
+#define CO_WDOG_OK          0U
+/** Deadline miss is reported by emergency */
+#define CO_WDOG_EMCY        1U
+/** TPDO rates are degraded */
+#define CO_WDOG_DEGRADE     2U
+/** Node is forced to NMT pre-operational, supervisor is not kicked */
+#define CO_WDOG_PREOP       3U
+
+/** Info code bit of CO_EM_TASK_DEADLINE: realtime task made no progress */
+#define CO_WDOG_LATE_RT     0x01U
+/** Info code bit of CO_EM_TASK_DEADLINE: realtime task missed timer steps */
+#define CO_WDOG_LATE_RT_OVR 0x02U
+/** Info code bit of CO_EM_TASK_DEADLINE: mainline task made no progress */
+#define CO_WDOG_LATE_MAIN   0x04U
+
+
+/**
+ * Watchdog object. Tasks of one CANopen object are monitored.
+ */
+typedef struct{
+    const CO_rtCfg_t   *rtCfg;          /**< From CO_wdog_init() */
+    CO_t               *CO;             /**< From CO_wdog_attach(), NULL if detached */
+    CO_taskMain_t      *tm;             /**< From CO_wdog_attach() */
+    CO_taskRT_t        *rt;             /**< From CO_wdog_attach() */
+    pthread_mutex_t     mtx;            /**< Protects attachment and escalation */
+    pthread_t           thread;         /**< Watchdog thread */
+    volatile int        run;            /**< Thread runs while set */
+    uint8_t             level;          /**< CO_WDOG_OK ... */
+    uint32_t            late;           /**< Late checks since last recovery */
+    uint32_t            good;           /**< Consecutive good checks after late check */
+    uint32_t            rtProgress;     /**< Progress of taskRT at rtSeen_ns */
+    uint32_t            mainProgress;   /**< Progress of taskMain at mainSeen_ns */
+    uint32_t            rtMissed;       /**< missedTicks of taskRT at previous check */
+    int64_t             rtSeen_ns;      /**< Last change of rtProgress */
+    int64_t             mainSeen_ns;    /**< Last change of mainProgress */
+    uint32_t            lateChecks;     /**< All late checks, informative */
+    uint8_t             maxLevel;       /**< Highest level reached, informative */
+    int                 fdDev;          /**< Linux watchdog device or -1 */
+    int                 fdNotify;       /**< Notify socket or -1 */
+    struct sockaddr_un  notifyAddr;     /**< Address from NOTIFY_SOCKET */
+    socklen_t           notifyAddrLen;  /**< Length of notifyAddr */
+}CO_wdog_t;
+
+
+/**
+ * Initialize watchdog and start its thread.
+ *
+ * Watchdog device and notify socket are opened, "READY=1" is sent. Thread
+ * only kicks the supervisor, until CO_wdog_attach(). Nothing is done, if
+ * rtCfg->wdogPeriod_ms is 0.
+ *
+ * @param wd This object will be initialized.
+ * @param rtCfg Realtime configuration of the program, see CO_rtCfg_load().
+ * It must exist until CO_wdog_close(). Thread uses rtCfg->wdog.
+ *
+ * @return 0 on success, -1 on error (errno is set).
+ */
+int CO_wdog_init(CO_wdog_t *wd, const CO_rtCfg_t *rtCfg);
+
+
+/**
+ * Stop watchdog thread and disarm supervisor.
+ *
+ * @param wd This object.
+ */
+void CO_wdog_close(CO_wdog_t *wd);
+
+
+/**
+ * Start monitoring tasks of CANopen object.
+ *
+ * Must be called after the realtime thread is created. Deadlines start
+ * from now.
+ *
+ * @param wd This object.
+ * @param CO CANopen object.
+ * @param tm Mainline task of CO.
+ * @param rt Realtime task of CO.
+ */
+void CO_wdog_attach(CO_wdog_t *wd, CO_t *CO, CO_taskMain_t *tm, CO_taskRT_t *rt);
+
+
+/**
+ * Stop monitoring, before the realtime thread is stopped for communication
+ * reset or exit. Escalation returns to CO_WDOG_OK and TPDO slowdown is
+ * cleared, CO_init() clears emergencies.
+ *
+ * @param wd This object.
+ */
+void CO_wdog_detach(CO_wdog_t *wd);
+
+
+#endif
@@ -170,6 +170,8 @@ typedef struct{
     CO_EMpr_t          *emPr;           /**< From CO_NMT_init() */
     CO_CANmodule_t     *HB_CANdev;      /**< From CO_NMT_init() */
     void              (*pFunctNMT)(CO_NMT_internalState_t state); /**< From CO_NMT_initCallback() or NULL */
+    void              (*pFunctSignal)(void *object);/**< From CO_NMT_initCallbackSignal() or NULL */
+    void               *functSignalObject;/**< From CO_NMT_initCallbackSignal() or NULL */
     CO_CANtx_t         *HB_TXbuff;      /**< CAN transmit buffer */
 }CO_NMT_t;
 
@@ -225,6 +227,28 @@ void CO_NMT_initCallback(
         void                  (*pFunctNMT)(CO_NMT_internalState_t state));
 
 
+/**
+ * Initialize NMT command signal callback function.
+ *
+ * Function initializes optional callback function, which is called after
+ * NMT command for this node is received. Function may wake up external task,
+ * which processes CO_NMT_process(), so state change or reset command is
+ * handled without waiting for the next cycle.
+ *
+ * @remark Be aware that the callback function is run inside the CAN receive
+ * function context. Depending on the driver, this might be inside an interrupt!
+ *
+ * @param NMT This object.
+ * @param object Pointer to object, which will be passed to pFunctSignal().
+ * Can be NULL.
+ * @param pFunctSignal Pointer to the callback function. Not called if NULL.
+ */
+void CO_NMT_initCallbackSignal(
+        CO_NMT_t               *NMT,
+        void                   *object,
+        void                  (*pFunctSignal)(void *object));
+
+
 /**
  * Calculate blinking bytes.
  *
@@ -248,7 +272,7 @@ void CO_NMT_blinkingProcess50ms(CO_NMT_t *NMT);
  * @param errorBehavior pointer to _Error behavior_ array (object dictionary, index 0x1029).
  *        Object controls, if device should leave NMT operational state.
  *        Length of array must be 6. If pointer is NULL, no calculation is made.
- * @param timerNext_ms Return value - info to OS - see CO_process().
+ * @param timerNext_us Return value - info to OS - see CO_process().
  *
  * @return #CO_NMT_reset_cmd_t
  */
@@ -259,7 +283,7 @@ CO_NMT_reset_cmd_t CO_NMT_process(
         uint32_t                NMTstartup,
         uint8_t                 errorRegister,
         const uint8_t           errorBehavior[],
-        uint16_t               *timerNext_ms);
+        uint32_t               *timerNext_us);
 
 
 /**
@@ -111,7 +111,7 @@
 /*******************************************************************************
    OBJECT DICTIONARY
 *******************************************************************************/
-   #define CO_OD_NoOfElements             55
+   #define CO_OD_NoOfElements             59
 
 
 /*******************************************************************************
@@ -217,6 +217,10 @@ struct sCO_OD_RAM{
 /*2110      */ INTEGER32      variableInt32[16];
 /*2120      */ OD_testVar_t   testVar;
 /*2130      */ OD_time_t      time;
+/*2140      */ UNSIGNED8      logLevel[8];
+/*2141      */ UNSIGNED32     taskRTstatistics[13];
+/*2142      */ UNSIGNED32     taskMainStatistics[13];
+/*2143      */ UNSIGNED32     cycleProfile[37];
 
 //Below 6XXX look like application specific
 
@@ -430,6 +434,93 @@ extern struct sCO_OD_ROM CO_OD_ROM;
 /*2130, Data Type: OD_time_t */
       #define OD_time                                    CO_OD_RAM.time
 
+/*2140, Data Type: UNSIGNED8, Array[8] */
+      #define OD_logLevel                                CO_OD_RAM.logLevel
+      #define ODL_logLevel_arrayLength                   8
+      #define ODA_logLevel_main                          0
+      #define ODA_logLevel_driver                        1
+      #define ODA_logLevel_SDO                           2
+      #define ODA_logLevel_PDO                           3
+      #define ODA_logLevel_NMT                           4
+      #define ODA_logLevel_EMCY                          5
+      #define ODA_logLevel_storage                       6
+      #define ODA_logLevel_tasks                         7
+
+/*2141, Data Type: UNSIGNED32, Array[13] */
+      #define OD_taskRTstatistics                        CO_OD_RAM.taskRTstatistics
+      #define ODL_taskRTstatistics_arrayLength           13
+      #define ODA_taskRTstatistics_cycles                0
+      #define ODA_taskRTstatistics_wakeupP50             1
+      #define ODA_taskRTstatistics_wakeupP99             2
+      #define ODA_taskRTstatistics_wakeupP999            3
+      #define ODA_taskRTstatistics_wakeupMax             4
+      #define ODA_taskRTstatistics_execP50               5
+      #define ODA_taskRTstatistics_execP99               6
+      #define ODA_taskRTstatistics_execP999              7
+      #define ODA_taskRTstatistics_execMax               8
+      #define ODA_taskRTstatistics_periodP50             9
+      #define ODA_taskRTstatistics_periodP99             10
+      #define ODA_taskRTstatistics_periodP999            11
+      #define ODA_taskRTstatistics_periodMax             12
+
+/*2142, Data Type: UNSIGNED32, Array[13] */
+      #define OD_taskMainStatistics                      CO_OD_RAM.taskMainStatistics
+      #define ODL_taskMainStatistics_arrayLength         13
+      #define ODA_taskMainStatistics_cycles              0
+      #define ODA_taskMainStatistics_wakeupP50           1
+      #define ODA_taskMainStatistics_wakeupP99           2
+      #define ODA_taskMainStatistics_wakeupP999          3
+      #define ODA_taskMainStatistics_wakeupMax           4
+      #define ODA_taskMainStatistics_execP50             5
+      #define ODA_taskMainStatistics_execP99             6
+      #define ODA_taskMainStatistics_execP999            7
+      #define ODA_taskMainStatistics_execMax             8
+      #define ODA_taskMainStatistics_periodP50           9
+      #define ODA_taskMainStatistics_periodP99           10
+      #define ODA_taskMainStatistics_periodP999          11
+      #define ODA_taskMainStatistics_periodMax           12
+
+/*2143, Data Type: UNSIGNED32, Array[37] */
+      #define OD_cycleProfile                            CO_OD_RAM.cycleProfile
+      #define ODL_cycleProfile_arrayLength               37
+      #define ODA_cycleProfile_cycles                    0
+      #define ODA_cycleProfile_syncMin                   1
+      #define ODA_cycleProfile_syncAvg                   2
+      #define ODA_cycleProfile_syncP99                   3
+      #define ODA_cycleProfile_syncMax                   4
+      #define ODA_cycleProfile_rpdoMin                   5
+      #define ODA_cycleProfile_rpdoAvg                   6
+      #define ODA_cycleProfile_rpdoP99                   7
+      #define ODA_cycleProfile_rpdoMax                   8
+      #define ODA_cycleProfile_rtAppMin                  9
+      #define ODA_cycleProfile_rtAppAvg                  10
+      #define ODA_cycleProfile_rtAppP99                  11
+      #define ODA_cycleProfile_rtAppMax                  12
+      #define ODA_cycleProfile_tpdoMin                   13
+      #define ODA_cycleProfile_tpdoAvg                   14
+      #define ODA_cycleProfile_tpdoP99                   15
+      #define ODA_cycleProfile_tpdoMax                   16
+      #define ODA_cycleProfile_sdoMin                    17
+      #define ODA_cycleProfile_sdoAvg                    18
+      #define ODA_cycleProfile_sdoP99                    19
+      #define ODA_cycleProfile_sdoMax                    20
+      #define ODA_cycleProfile_emcyMin                   21
+      #define ODA_cycleProfile_emcyAvg                   22
+      #define ODA_cycleProfile_emcyP99                   23
+      #define ODA_cycleProfile_emcyMax                   24
+      #define ODA_cycleProfile_nmtMin                    25
+      #define ODA_cycleProfile_nmtAvg                    26
+      #define ODA_cycleProfile_nmtP99                    27
+      #define ODA_cycleProfile_nmtMax                    28
+      #define ODA_cycleProfile_HBconsMin                 29
+      #define ODA_cycleProfile_HBconsAvg                 30
+      #define ODA_cycleProfile_HBconsP99                 31
+      #define ODA_cycleProfile_HBconsMax                 32
+      #define ODA_cycleProfile_mainAppMin                33
+      #define ODA_cycleProfile_mainAppAvg                34
+      #define ODA_cycleProfile_mainAppP99                35
+      #define ODA_cycleProfile_mainAppMax                36
+
 /*6000, Data Type: UNSIGNED8, Array[8] */
       #define OD_readInput8Bit                           CO_OD_RAM.readInput8Bit
       #define ODL_readInput8Bit_arrayLength              8
@@ -56,13 +56,16 @@ CO_SDO_abortCode_t CO_ODF_1011(CO_ODF_arg_t *ODF_arg);
  * @param odAddress Address of the memory block, which will be stored.
  * @param odSize Size of the above memory block.
  * @param filename Name of the file, where data will be stored.
+ * @param CANmodule CAN module of the CANopen object, which owns the memory
+ * block. Reading the block is secured with its CO_LOCK_OD.
  *
  * @return 0 on success, -1 on error.
  */
 int CO_OD_storage_saveSecure(
         uint8_t                *odAddress,
         uint32_t                odSize,
-        char                   *filename);
+        char                   *filename,
+        CO_CANmodule_t         *CANmodule);
 
 
 /**
@@ -93,6 +96,7 @@ typedef struct {
     uint8_t    *odAddress;      /**< From CO_OD_storage_init() */
     uint32_t    odSize;         /**< From CO_OD_storage_init() */
     char       *filename;       /**< From CO_OD_storage_init() */
+    CO_CANmodule_t *CANmodule;  /**< From CO_OD_storage_init() */
     /** If CO_OD_storage_autoSave() is used, file stays opened and fp is stored here. */
     FILE       *fp;
     uint16_t    tmr1msPrev;     /**< used with CO_OD_storage_autoSave. */
@@ -112,6 +116,8 @@ typedef struct {
  * @param odAddress Address of the memory block from Object dictionary, where data will be copied.
  * @param odSize Size of the above memory block.
  * @param filename Name of the file, where data are stored.
+ * @param CANmodule CAN module of the CANopen object, which owns the memory
+ * block (CO_t::CANmodule[0]). Used for CO_LOCK_OD, when data are saved.
  *
  * @return #CO_ReturnError_t: CO_ERROR_NO, CO_ERROR_DATA_CORRUPT (Data in file corrupt),
  * CO_ERROR_CRC (CRC from MBR does not match the CRC of OD_ROM block in file),
@@ -121,7 +127,8 @@ CO_ReturnError_t CO_OD_storage_init(
         CO_OD_storage_t        *odStor,
         uint8_t                *odAddress,
         uint32_t                odSize,
-        char                   *filename);
+        char                   *filename,
+        CO_CANmodule_t         *CANmodule);
 
 
 /**
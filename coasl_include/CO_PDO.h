@@ -52,6 +52,7 @@ extern "C" {
 #endif
 
 #include "Logger.h"
+#include "CO_tmrWheel.h"
 /**
  * @defgroup CO_PDO PDO
  * @ingroup CO_CANopen
@@ -81,6 +82,36 @@ extern "C" {
  */
 
 
+/**
+ * Interval of Change of State detection for asynchronous TPDOs in
+ * microseconds. Mapped variables are only compared, when TPDO timer expires,
+ * so it is restarted at least this often.
+ */
+#ifndef CO_TPDO_COS_POLL_US
+    #define CO_TPDO_COS_POLL_US     1000U
+#endif
+
+
+/**
+ * Maximum of CO_TPDO_t::slowdown. Degraded TPDO runs at 1/2^slowdown of its
+ * configured rate: event timer, inhibit time and SYNC count are multiplied.
+ * Inhibit time is at least CO_TPDO_COS_POLL_US then, so Change of State
+ * TPDOs without inhibit time are also slowed down.
+ */
+#define CO_TPDO_SLOWDOWN_MAX        4U
+
+
+/**
+ * Number of PDO rate groups, see CO_setPDOgroup(). Group 0 is the default:
+ * its RPDOs are written to Object Dictionary in the realtime cycle after
+ * reception and Change of State of its TPDOs is checked each
+ * CO_TPDO_COS_POLL_US. Other groups have own period.
+ */
+#ifndef CO_PDO_GROUPS
+    #define CO_PDO_GROUPS           4U
+#endif
+
+
 /**
  * RPDO communication parameter. The same as record from Object dictionary (index 0x1400+).
  */
@@ -201,12 +232,19 @@ typedef struct{
     uint8_t             dataLength;
     /** Pointers to 8 data objects, where PDO will be copied */
     uint8_t            *mapPointer[8];
-    /** Variable indicates, if new PDO message received from CAN bus. */
-    volatile bool_t     CANrxNew[2];
-    /** 8 data bytes of the received message. */
-    uint8_t             CANrxData[2][8];
     CO_CANmodule_t     *CANdevRx;       /**< From CO_RPDO_init() */
     uint16_t            CANdevRxIdx;    /**< From CO_RPDO_init() */
+    /** Variable indicates, if new PDO message received from CAN bus. Written
+    by CAN receive, starts own cache line. Accessed with CO_FLAG_xxx. */
+    bool_t              CANrxNew[2] CO_CACHE_ALIGNED;
+    /** Sequence of each buffer, odd while CAN receive writes CANrxData. */
+    uint32_t            CANrxSeq[2];
+    /** 8 data bytes of the received message. */
+    uint8_t             CANrxData[2][8];
+    /** Word of pending RPDOs, where CAN receive marks this RPDO after
+    CANrxNew, NULL for none. Set by CO_init(). */
+    uint32_t           *pending;
+    uint32_t            pendingMask;    /**< Bit of this RPDO in pending */
 }CO_RPDO_t;
 
 
@@ -225,9 +263,6 @@ typedef struct{
     bool_t              valid;          /**< True, if PDO is enabled and valid */
     /** Data length of the transmitting PDO message. Calculated from mapping */
     uint8_t             dataLength;
-    /** If application set this flag, PDO will be later sent by
-    function CO_TPDO_process(). Depends on transmission type. */
-    uint8_t             sendRequest;
     /** Pointers to 8 data objects, where PDO will be copied */
     uint8_t            *mapPointer[8];
     /** Each flag bit is connected with one mapPointer. If flag bit
@@ -236,13 +271,30 @@ typedef struct{
     uint8_t             sendIfCOSFlags;
     /** SYNC counter used for PDO sending */
     uint8_t             syncCounter;
-    /** Inhibit timer used for inhibit PDO sending translated to microseconds */
-    uint32_t            inhibitTimer;
-    /** Event timer used for PDO sending translated to microseconds */
-    uint32_t            eventTimer;
+    /** Rate of TPDO is divided by 2^slowdown, set by CO_process_TPDO(), see
+    CO_TPDO_SLOWDOWN_MAX */
+    uint8_t             slowdown;
+    /** Interval of Change of State check in microseconds, 0 for none. It is
+    CO_TPDO_COS_POLL_US or period of PDO rate group, set by CO_init(). */
+    uint32_t            cosPoll_us;
+    /** End of inhibit time on the timer wheel in microseconds, 0 if not inhibited */
+    uint64_t            inhibitEnd;
+    /** Event timer expiration on the timer wheel in microseconds, 0 if event
+    timer starts with the next processing */
+    uint64_t            eventNext;
+    CO_tmrWheel_t      *wheel;          /**< From CO_TPDO_init() */
+    /** Expires, when asynchronous TPDO needs processing: event timer, end of
+    inhibit time or Change of State check */
+    CO_tmr_t            tmr;
+    /** Rate limited log of CO_TPDO_process(), while not operational or valid */
+    logSite_t           notOperationalSite;
     CO_CANmodule_t     *CANdevTx;       /**< From CO_TPDO_init() */
     CO_CANtx_t         *CANtxBuff;      /**< CAN transmit buffer inside CANdev */
     uint16_t            CANdevTxIdx;    /**< From CO_TPDO_init() */
+    /** If application set this flag, PDO will be later sent by
+    function CO_TPDO_process(). Depends on transmission type. Application
+    may write it from mainline, so it starts own cache line. */
+    uint8_t             sendRequest CO_CACHE_ALIGNED;
 }CO_TPDO_t;
 
 
@@ -318,6 +370,8 @@ CO_ReturnError_t CO_RPDO_init(
  * @param idx_TPDOMapPar Index in Object Dictionary.
  * @param CANdevTx CAN device used for PDO transmission.
  * @param CANdevTxIdx Index of transmit buffer in the above CAN device.
+ * @param wheel Timer wheel for event and inhibit timers. It must be advanced
+ * from the same thread, which calls CO_TPDO_process().
  *
  * @return #CO_ReturnError_t: CO_ERROR_NO or CO_ERROR_ILLEGAL_ARGUMENT.
  */
@@ -334,7 +388,8 @@ CO_ReturnError_t CO_TPDO_init(
         uint16_t                idx_TPDOCommPar,
         uint16_t                idx_TPDOMapPar,
         CO_CANmodule_t         *CANdevTx,
-        uint16_t                CANdevTxIdx);
+        uint16_t                CANdevTxIdx,
+        CO_tmrWheel_t          *wheel);
 
 
 /**
@@ -384,20 +439,24 @@ void CO_RPDO_process(CO_RPDO_t *RPDO, bool_t syncWas);
 /**
  * Process transmitting PDO messages.
  *
- * Function must be called cyclically in any NMT state. It prepares and sends
- * TPDO if necessary. If Change of State needs to be detected, function
- * CO_TPDOisCOS() must be called before.
+ * Function prepares and sends TPDO if necessary. If Change of State needs to
+ * be detected, function CO_TPDOisCOS() must be called before.
+ *
+ * Synchronous TPDOs are processed by this function after each SYNC.
+ * Asynchronous TPDOs are processed from own timer on the wheel, which is
+ * restarted for the next event timer, end of inhibit time or Change of State
+ * check, so they cost nothing between. This function must be called for them
+ * when they may need processing earlier: after CO_TPDO_init(), after NMT state
+ * change and after application sets _sendRequest_.
  *
  * @param TPDO This object.
  * @param SYNC SYNC object. Ignored if NULL.
  * @param syncWas True, if CANopen SYNC message was just received or transmitted.
- * @param timeDifference_us Time difference from previous function call in [microseconds].
  */
 void CO_TPDO_process(
         CO_TPDO_t              *TPDO,
         CO_SYNC_t              *SYNC,
-        bool_t                  syncWas,
-        uint32_t                timeDifference_us);
+        bool_t                  syncWas);
 
 #ifdef __cplusplus
 }
@@ -289,13 +289,20 @@ typedef enum{
  * if (p == NULL) {
  *     return;
  * }
- * CO_LOCK_OD();
+ * CO_LOCK_OD(CO->CANmodule[0]);
+ * CO_OD_seqWriteBegin(CO->CANmodule[0]);
  * *p = new_data;
- * CO_UNLOCK_OD();
+ * CO_OD_seqWriteEnd(CO->CANmodule[0]);
+ * CO_UNLOCK_OD(CO->CANmodule[0]);
  * \endcode
+ *
+ * CO_OD_seqWriteBegin() is needed only for variables, which may be mapped
+ * to PDOs, see Critical sections in Karsh.h.
  * 
  * Be aware that accessing the OD directly using CO_OD.h files is more CPU 
- * efficient as CO_OD_find() has to do a search everytime it is called.
+ * efficient as CO_OD_find() has to do a lookup everytime it is called. With
+ * index table from CO_SDO_init() the lookup is one array access, otherwise
+ * it is binary search.
  * 
  */
 
@@ -361,6 +368,13 @@ typedef enum{
     #endif
 
 
+/**
+ * Number of entries in index table for CO_SDO_init(), one for each 16-bit
+ * index. Table of uint16_t takes 128 kB.
+ */
+#define CO_OD_INDEX_TABLE_SIZE      0x10000UL
+
+
 /**
  * Object Dictionary attributes. Bit masks for attribute in CO_OD_entry_t.
  *
@@ -619,8 +633,6 @@ typedef struct{
  * SDO server object.
  */
 typedef struct{
-    /** 8 data bytes of the received message. */
-    uint8_t             CANrxData[8];
     /** SDO data buffer of size #CO_SDO_BUFFER_SIZE. */
     uint8_t             databuffer[CO_SDO_BUFFER_SIZE];
     /** Internal flag indicates, that this object has own OD */
@@ -632,6 +644,9 @@ typedef struct{
     /** Pointer to array of CO_OD_extension_t objects. Size of the array is
     equal to ODSize. */
     CO_OD_extension_t  *ODExtensions;
+    /** Entry number for each index, see CO_OD_INDEX_TABLE_SIZE. From
+    CO_SDO_init(), NULL for binary search in CO_OD_find(). */
+    const uint16_t     *ODindex;
     /** Offset in buffer of next data segment being read/written */
     uint16_t            bufferOffset;
 
@@ -664,14 +679,20 @@ typedef struct{
     /** Indication end of block transfer */
     bool_t              endOfTransfer;
 
-    /** Variable indicates, if new SDO message received from CAN bus */
-    bool_t              CANrxNew;
     /** From CO_SDO_initCallback() or NULL */
-    void              (*pFunctSignal)(void);
+    void              (*pFunctSignal)(void *object);
+    /** From CO_SDO_initCallback() or NULL */
+    void               *functSignalObject;
     /** From CO_SDO_init() */
     CO_CANmodule_t     *CANdevTx;
     /** CAN transmit buffer inside CANdev for CAN tx message */
     CO_CANtx_t         *CANtxBuff;
+    /** Variable indicates, if new SDO message received from CAN bus. Written
+    by CAN receive in realtime thread, while SDO server runs in mainline, so
+    it starts own cache line together with CANrxData. */
+    bool_t              CANrxNew CO_CACHE_ALIGNED;
+    /** 8 data bytes of the received message. */
+    uint8_t             CANrxData[8];
 }CO_SDO_t;//canopen sdo server type
 
 
@@ -798,12 +819,15 @@ void CO_memcpySwap8(void* dest, const void* src);
  * @param ObjDictIndex_SDOServerParameter Index in Object dictionary.
  * @param parentSDO Pointer to SDO object, which contains object dictionary and
  * its extension. For first (default) SDO object this argument must be NULL.
- * If this argument is specified, then OD, ODSize and ODExtensions arguments
- * are ignored.
+ * If this argument is specified, then OD, ODSize, ODExtensions and ODindex
+ * arguments are ignored.
  * @param OD Pointer to @ref CO_SDO_objectDictionary array defined externally.
  * @param ODSize Size of the above array.
  * @param ODExtensions Pointer to the externally defined array of the same size
  * as ODSize.
+ * @param ODindex Externally defined array of CO_OD_INDEX_TABLE_SIZE entries.
+ * It is filled with entry number of each index, so CO_OD_find() is one array
+ * access. If NULL, CO_OD_find() uses binary search.
  * @param nodeId CANopen Node ID of this device.
  * @param CANdevRx CAN device for SDO server reception.
  * @param CANdevRxIdx Index of receive buffer in the above CAN device.
@@ -821,6 +845,7 @@ CO_ReturnError_t CO_SDO_init(
         const CO_OD_entry_t     OD[],
         uint16_t                ODSize,
         CO_OD_extension_t       ODExtensions[],
+        uint16_t                ODindex[],
         uint8_t                 nodeId,
         CO_CANmodule_t         *CANdevRx,
         uint16_t                CANdevRxIdx,
@@ -840,11 +865,14 @@ CO_ReturnError_t CO_SDO_init(
  * which processes mainline CANopen functions.
  *
  * @param SDO This object.
+ * @param object Pointer to object, which will be passed to pFunctSignal().
+ * Can be NULL.
  * @param pFunctSignal Pointer to the callback function. Not called if NULL.
  */
 void CO_SDO_initCallback(
         CO_SDO_t               *SDO,
-        void                  (*pFunctSignal)(void));
+        void                   *object,
+        void                  (*pFunctSignal)(void *object));
 
 
 
@@ -864,7 +892,7 @@ void CO_SDO_initCallback(
  * NMT_PRE_OPERATIONAL or NMT_OPERATIONAL.
  * @param timeDifference_ms Time difference from previous function call in [milliseconds].
  * @param SDOtimeoutTime Timeout time for SDO communication in milliseconds.
- * @param timerNext_ms Return value - info to OS - see CO_process().
+ * @param timerNext_us Return value - info to OS - see CO_process().
  *
  * @return 0: SDO server is idle.
  * @return 1: SDO server is in transfer state.
@@ -875,7 +903,7 @@ int8_t CO_SDO_process(
         bool_t                  NMTisPreOrOperational,
         uint16_t                timeDifference_ms,
         uint16_t                SDOtimeoutTime,
-        uint16_t               *timerNext_ms);
+        uint32_t               *timerNext_us);
 
 
 
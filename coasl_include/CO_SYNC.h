@@ -108,22 +108,25 @@ typedef struct{
     /** True, if current time is inside synchronous window.
     In this case synchronous PDO may be sent. */
     bool_t              curentSyncTimeIsInsideWindow;
-    /** Variable indicates, if new SYNC message received from CAN bus */
-    bool_t              CANrxNew;
-    /** Variable toggles, if new SYNC message received from CAN bus */
-    bool_t              CANrxToggle;
-    /** Counter of the SYNC message if counterOverflowValue is different than zero */
-    uint8_t             counter;
     /** Timer for the SYNC message in [microseconds].
     Set to zero after received or transmitted SYNC message */
     uint32_t            timer;
-    /** Set to nonzero value, if SYNC with wrong data length is received from CAN */
-    uint16_t            receiveError;
     CO_CANmodule_t     *CANdevRx;       /**< From CO_SYNC_init() */
     uint16_t            CANdevRxIdx;    /**< From CO_SYNC_init() */
     CO_CANmodule_t     *CANdevTx;       /**< From CO_SYNC_init() */
     CO_CANtx_t         *CANtxBuff;      /**< CAN transmit buffer inside CANdevTx */
     uint16_t            CANdevTxIdx;    /**< From CO_SYNC_init() */
+    void              (*pFunctSignal)(void *object, bool_t syncReceived);/**< From CO_SYNC_initCallback() or NULL */
+    void               *functSignalObject;/**< From CO_SYNC_initCallback() or NULL */
+    /** Variable indicates, if new SYNC message received from CAN bus. Fields
+    from here on are written by CAN receive, they start own cache line. */
+    bool_t              CANrxNew CO_CACHE_ALIGNED;
+    /** Variable toggles, if new SYNC message received from CAN bus */
+    bool_t              CANrxToggle;
+    /** Counter of the SYNC message if counterOverflowValue is different than zero */
+    uint8_t             counter;
+    /** Set to nonzero value, if SYNC with wrong data length is received from CAN */
+    uint16_t            receiveError;
 }CO_SYNC_t;
 
 
@@ -160,6 +163,27 @@ CO_ReturnError_t CO_SYNC_init(
         uint16_t                CANdevTxIdx);
 
 
+/**
+ * Initialize SYNC callback function.
+ *
+ * Function initializes optional callback function, which is called, when SYNC
+ * message is received from the CAN bus (syncReceived is true, called from
+ * CAN receive) or when it was just transmitted by this SYNC producer
+ * (syncReceived is false, called from CO_SYNC_process()). CAN receive may use
+ * it to hold off further reception until synchronous RPDOs of this SYNC are
+ * processed, see CANrx_lockCbSync().
+ *
+ * @param SYNC This object.
+ * @param object Pointer to object, which will be passed to pFunctSignal().
+ * Can be NULL.
+ * @param pFunctSignal Pointer to the callback function. Not called if NULL.
+ */
+void CO_SYNC_initCallback(
+        CO_SYNC_t              *SYNC,
+        void                   *object,
+        void                  (*pFunctSignal)(void *object, bool_t syncReceived));
+
+
 /**
  * Process SYNC communication.
  *
@@ -169,6 +193,9 @@ CO_ReturnError_t CO_SYNC_init(
  * @param timeDifference_us Time difference from previous function call in [microseconds].
  * @param ObjDict_synchronousWindowLength _Synchronous window length_ variable from
  * Object dictionary (index 0x1007).
+ * @param timerNext_us Return value - info to OS - maximum delay after function
+ *        should be called next time in [microseconds]: next SYNC production,
+ *        end of synchronous window or SYNC timeout. Ignored if NULL.
  *
  * @return 0: No special meaning.
  * @return 1: New SYNC message recently received or was just transmitted.
@@ -177,7 +204,8 @@ CO_ReturnError_t CO_SYNC_init(
 uint8_t CO_SYNC_process(
         CO_SYNC_t              *SYNC,
         uint32_t                timeDifference_us,
-        uint32_t                ObjDict_synchronousWindowLength);
+        uint32_t                ObjDict_synchronousWindowLength,
+        uint32_t               *timerNext_us);
 
 #ifdef __cplusplus
 }
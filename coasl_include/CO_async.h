@@ -0,0 +1,255 @@
+/**
+ * Stackless coroutines for application code, run by the mainline task.
+ *
+ * @file        CO_async.h
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * CANopenNode is free and open source software: you can redistribute
+ * it and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef CO_ASYNC_H
+#define CO_ASYNC_H
+
+#include "CANopen.h"
+#include "CO_tmrWheel.h"
+
+
+/**
+ * Application logic is written as a sequence of steps, which wait for SDO
+ * transfers, NMT state, heartbeat of other nodes or time, without own thread
+ * and without polling. Each task is a function, which is called by
+ * CO_async_process() from mainline, after CO_process(). Function runs until
+ * it reaches an await, which is not satisfied, and returns. Next call
+ * continues at the same await (protothread style, switch on line number).
+ *
+ * Local variables of the function are lost between calls, keep state in
+ * the object of the task. Awaits may not be used inside switch statement
+ * and only one await may be on one source line.
+ *
+ * Example:
+ * @code
+static int blink(CO_async_task_t *task){
+    CO_ASYNC_BEGIN(task);
+    CO_AWAIT_NMT(task, CO_NMT_OPERATIONAL);
+    for(;;){
+        static uint8_t on = 1;
+        CO_AWAIT_SDO_DOWNLOAD(task, 5, 0x6200, 1, &on, 1, 500);
+        if(task->sdoRet < 0) break;
+        on ^= 1;
+        CO_AWAIT_DELAY(task, 1000000);
+    }
+    CO_ASYNC_END(task);
+}
+ * @endcode
+ *
+ * Mainline wakes on CANopen signals, on its timer, on deadlines of delays
+ * and SDO timeouts of the tasks, and when task is started or finished.
+ * Conditions on other application variables are evaluated only then, so
+ * use CO_AWAIT_TIMEOUT() or CO_AWAIT_YIELD() for them.
+ */
+
+
+/** Return value of task function: task waits */
+#define CO_ASYNC_WAIT       0
+/** Return value of task function: task finished */
+#define CO_ASYNC_DONE       1
+
+
+/** Task is not started or was cancelled */
+#define CO_ASYNC_IDLE       0U
+/** Task is started and waits */
+#define CO_ASYNC_RUNNING    1U
+/** Task finished */
+#define CO_ASYNC_FINISHED   2U
+
+
+struct CO_async;
+struct CO_async_task;
+
+
+/**
+ * Task function, see CO_ASYNC_BEGIN().
+ *
+ * @return CO_ASYNC_WAIT or CO_ASYNC_DONE.
+ */
+typedef int (*CO_async_fn_t)(struct CO_async_task *task);
+
+
+/**
+ * Task object, usually a member of the application object.
+ */
+typedef struct CO_async_task{
+    struct CO_async    *async;          /**< From CO_async_start() */
+    CO_async_fn_t       pFunct;         /**< From CO_async_start() */
+    void               *object;         /**< From CO_async_start(), for application */
+    void              (*pFunctDone)(struct CO_async_task *task); /**< From CO_async_start() or NULL */
+    struct CO_async_task *next;         /**< Next task in CO_async_t::tasks */
+    uint32_t            line;           /**< Resume point, 0 is start of function */
+    uint8_t             state;          /**< CO_ASYNC_IDLE ... */
+    bool_t              tmrExpired;     /**< Set by tmr, see CO_AWAIT_DELAY() */
+    CO_tmr_t            tmr;            /**< Delay and timeout of the await */
+    int16_t             sdoRet;         /**< Result of the last SDO await, see CO_SDOclient_return_t */
+    uint32_t            sdoAbortCode;   /**< Abort code of the last SDO await */
+    uint32_t            sdoSize;        /**< Data size of the last SDO upload */
+}CO_async_task_t;
+
+
+/**
+ * Scheduler of tasks, one for each CANopen object.
+ */
+typedef struct CO_async{
+    CO_t               *CO;             /**< From CO_async_init() */
+    CO_tmrWheel_t       wheel;          /**< Timers of tasks */
+    CO_async_task_t    *tasks;          /**< Started tasks */
+    CO_async_task_t    *sdoOwner;       /**< Task, which uses SDO client, or NULL */
+    uint16_t            timeDifference_ms; /**< Of the current CO_async_process() */
+    uint32_t            remainder_us;   /**< Time not yet given to SDO client */
+    bool_t              runAgain;       /**< Task finished, others may continue */
+    void              (*pFunctSignal)(void *object); /**< From CO_async_initCallback() or NULL */
+    void               *functSignalObject; /**< From CO_async_initCallback() or NULL */
+}CO_async_t;
+
+
+/** Start of task function. */
+#define CO_ASYNC_BEGIN(task)    switch((task)->line){ case 0:
+
+/** End of task function, task finishes. */
+#define CO_ASYNC_END(task)      } (task)->line = 0; return CO_ASYNC_DONE
+
+/** Finish task from inside of task function. */
+#define CO_ASYNC_EXIT(task)     do{ (task)->line = 0; return CO_ASYNC_DONE; }while(0)
+
+/** Wait until condition is true. Condition is evaluated on each mainline pass. */
+#define CO_AWAIT_UNTIL(task, cond) \
+    do{ (task)->line = __LINE__; case __LINE__: if(!(cond)) return CO_ASYNC_WAIT; }while(0)
+
+/** Give other tasks a turn, continue in the next mainline pass. */
+#define CO_AWAIT_YIELD(task) \
+    do{ CO_async_delay((task), 0); CO_AWAIT_UNTIL((task), (task)->tmrExpired); }while(0)
+
+/** Wait for delay_us microseconds. */
+#define CO_AWAIT_DELAY(task, delay_us) \
+    do{ CO_async_delay((task), (delay_us)); CO_AWAIT_UNTIL((task), (task)->tmrExpired); }while(0)
+
+/** Wait until condition is true, at most timeout_us. task->tmrExpired is then true on timeout. */
+#define CO_AWAIT_TIMEOUT(task, cond, timeout_us) \
+    do{ CO_async_delay((task), (timeout_us)); CO_AWAIT_UNTIL((task), (cond) || (task)->tmrExpired); \
+        CO_async_stopDelay(task); }while(0)
+
+/** Wait for NMT state of this node, see CO_NMT_internalState_t. */
+#define CO_AWAIT_NMT(task, nmtState) \
+    CO_AWAIT_UNTIL((task), (task)->async->CO->NMT->operatingState == (nmtState))
+
+/** Wait for heartbeat of monitored node with index idx (sub-index - 1 of 0x1016) with NMT state. */
+#define CO_AWAIT_HEARTBEAT(task, idx, nmtState) \
+    CO_AWAIT_UNTIL((task), CO_async_HBstate((task)->async, (idx)) == (int16_t)(nmtState))
+
+/** Wait for finished task other. */
+#define CO_AWAIT_TASK(task, other) \
+    CO_AWAIT_UNTIL((task), (other)->state != CO_ASYNC_RUNNING)
+
+/**
+ * SDO download to node, result is then in task->sdoRet (CO_SDOclient_return_t,
+ * 0 on success) and task->sdoAbortCode. Tasks take turns on the SDO client.
+ */
+#define CO_AWAIT_SDO_DOWNLOAD(task, nodeId, index, subIndex, data, size, timeout_ms) \
+    CO_AWAIT_UNTIL((task), CO_async_sdoDownload((task), (nodeId), (index), (subIndex), (data), (size), (timeout_ms)))
+
+/** SDO upload from node, as CO_AWAIT_SDO_DOWNLOAD(), received size is in task->sdoSize. */
+#define CO_AWAIT_SDO_UPLOAD(task, nodeId, index, subIndex, data, size, timeout_ms) \
+    CO_AWAIT_UNTIL((task), CO_async_sdoUpload((task), (nodeId), (index), (subIndex), (data), (size), (timeout_ms)))
+
+
+/**
+ * Initialize scheduler. Must be called after each CO_init(), started tasks
+ * are forgotten.
+ *
+ * @param async This object will be initialized.
+ * @param CO CANopen object.
+ */
+void CO_async_init(CO_async_t *async, CO_t *CO);
+
+
+/**
+ * Initialize function, which wakes the mainline, when task is started
+ * from outside of CO_async_process(). taskMain_initAsync() does it.
+ *
+ * @param async This object.
+ * @param object Argument for pFunctSignal.
+ * @param pFunctSignal Function, which wakes mainline.
+ */
+void CO_async_initCallback(CO_async_t *async, void *object, void (*pFunctSignal)(void *object));
+
+
+/**
+ * Start task. It runs first in the next CO_async_process().
+ *
+ * @param async Scheduler.
+ * @param task Task object, must not be running.
+ * @param pFunct Task function.
+ * @param object Argument for application, available as task->object.
+ * @param pFunctDone Called, when task finished, or NULL.
+ */
+void CO_async_start(
+        CO_async_t             *async,
+        CO_async_task_t        *task,
+        CO_async_fn_t           pFunct,
+        void                   *object,
+        void                  (*pFunctDone)(CO_async_task_t *task));
+
+
+/**
+ * Cancel running task. SDO transfer of the task is closed.
+ *
+ * @param task Task object.
+ */
+void CO_async_cancel(CO_async_task_t *task);
+
+
+/**
+ * Run tasks. Called from mainline after CO_process().
+ *
+ * @param async This object.
+ * @param timeDifference_us Time since previous call in microseconds.
+ * @param [out] timerNext_us Lowered to the earliest deadline of tasks, if
+ * it is earlier. May be NULL.
+ */
+void CO_async_process(CO_async_t *async, uint32_t timeDifference_us, uint32_t *timerNext_us);
+
+
+/** Used by CO_AWAIT_DELAY(). Starts task->tmr and clears task->tmrExpired. */
+void CO_async_delay(CO_async_task_t *task, uint32_t delay_us);
+
+/** Used by CO_AWAIT_TIMEOUT(). */
+void CO_async_stopDelay(CO_async_task_t *task);
+
+/** Used by CO_AWAIT_HEARTBEAT(). Returns NMT state of monitored node or -1, if unknown. */
+int16_t CO_async_HBstate(CO_async_t *async, uint8_t idx);
+
+#if CO_NO_SDO_CLIENT == 1
+/** Used by CO_AWAIT_SDO_DOWNLOAD(). Returns true, when transfer finished. */
+bool_t CO_async_sdoDownload(CO_async_task_t *task, uint8_t nodeId, uint16_t index,
+        uint8_t subIndex, uint8_t *data, uint32_t size, uint16_t timeout_ms);
+
+/** Used by CO_AWAIT_SDO_UPLOAD(). Returns true, when transfer finished. */
+bool_t CO_async_sdoUpload(CO_async_task_t *task, uint8_t nodeId, uint16_t index,
+        uint8_t subIndex, uint8_t *data, uint32_t size, uint16_t timeout_ms);
+#endif
+
+
+#endif
@@ -0,0 +1,116 @@
+/**
+ * Latency histogram with logarithmic buckets.
+ *
+ * @file        CO_hist.h
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * CANopenNode is free and open source software: you can redistribute
+ * it and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef CO_HIST_H
+#define CO_HIST_H
+
+#include <stdint.h>
+
+
+/**
+ * Histogram layout, HDR style.
+ *
+ * Values 0..15 have own bucket. Each higher power of two range is split into
+ * 16 buckets, so relative error of a recorded value is below 1/16. Values
+ * above CO_HIST_MAX_VALUE (about 67 s in microseconds) are counted as
+ * CO_HIST_MAX_VALUE.
+ */
+#define CO_HIST_SUB_BITS        4
+#define CO_HIST_SUB_COUNT       (1U << CO_HIST_SUB_BITS)
+#define CO_HIST_MAX_BITS        26
+#define CO_HIST_MAX_VALUE       ((1UL << CO_HIST_MAX_BITS) - 1)
+#define CO_HIST_BUCKETS         ((CO_HIST_MAX_BITS - CO_HIST_SUB_BITS + 1) * CO_HIST_SUB_COUNT)
+
+
+/**
+ * Histogram object.
+ *
+ * Values are recorded from one thread. Other threads may take a snapshot
+ * and request reset, which is then done by the next CO_hist_record().
+ * Object filled with zeros is an empty histogram.
+ */
+typedef struct{
+    uint32_t    count[CO_HIST_BUCKETS]; /**< Number of values per bucket */
+    uint64_t    total;          /**< Number of recorded values */
+    uint64_t    sum;            /**< Sum of recorded values */
+    uint32_t    min;            /**< Minimum value, valid if total > 0 */
+    uint32_t    max;            /**< Maximum value */
+    uint32_t    last;           /**< Last recorded value */
+    uint32_t    resetRequest;   /**< Set by CO_hist_reset(), accessed atomically */
+}CO_hist_t;
+
+
+/**
+ * Clear histogram immediately. Must not be called concurrently with
+ * CO_hist_record().
+ *
+ * @param hist This object.
+ */
+void CO_hist_init(CO_hist_t *hist);
+
+
+/**
+ * Record one value.
+ *
+ * @param hist This object.
+ * @param value Value, typically in microseconds.
+ */
+void CO_hist_record(CO_hist_t *hist, uint32_t value);
+
+
+/**
+ * Request reset of histogram. It is cleared by the next CO_hist_record().
+ * May be called from any thread.
+ *
+ * @param hist This object.
+ */
+void CO_hist_reset(CO_hist_t *hist);
+
+
+/**
+ * Copy histogram and request its reset (reset on read).
+ * May be called from any thread. Values recorded between copy and reset
+ * are lost.
+ *
+ * @param hist This object.
+ * @param snapshot Copy of histogram is written here. It is empty, if reset
+ * was requested and nothing was recorded since.
+ */
+void CO_hist_snapshot(CO_hist_t *hist, CO_hist_t *snapshot);
+
+
+/**
+ * Get percentile of recorded values.
+ *
+ * @param hist Histogram, typically a snapshot.
+ * @param permille Percentile in permille: 500 for p50, 990 for p99, 999 for
+ * p99.9. 1000 returns maximum.
+ *
+ * @return Highest value in bucket, which contains the percentile (not higher
+ * than maximum). 0 if histogram is empty.
+ */
+uint32_t CO_hist_percentile(const CO_hist_t *hist, uint16_t permille);
+
+
+#endif
@@ -0,0 +1,123 @@
+/**
+ * Per-stage execution time profile of CANopen processing.
+ *
+ * @file        CO_prof.h
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * CANopenNode is free and open source software: you can redistribute
+ * it and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef CO_PROF_H
+#define CO_PROF_H
+
+#include <time.h>
+#include "CO_driver.h"
+#include "CO_SDO.h"
+#include "CO_hist.h"
+
+
+/**
+ * Profiling is compiled in by default. Build with -DCO_CONFIG_PROFILE=0 to
+ * remove it, macros below then expand to nothing and CO_t has no profile.
+ *
+ * Each instrumented function takes one CLOCK_MONOTONIC_RAW timestamp at
+ * start and one at the end of each stage, so stage ends are also starts of
+ * the next stage. Execution time of stage in nanoseconds is recorded into
+ * its histogram (CO_hist_t, so min, average, max and percentiles are
+ * available). Cost is some tens of nanoseconds per stage (clock_gettime()
+ * from vDSO and CO_hist_record()), well below 1 % of 1 ms realtime cycle.
+ * Stages are recorded from the thread, which runs them: realtime thread for
+ * CO_PROF_SYNC ... CO_PROF_TPDO, mainline for others.
+ */
+#ifndef CO_CONFIG_PROFILE
+#define CO_CONFIG_PROFILE   1
+#endif
+
+
+/**
+ * Profiled stages.
+ */
+typedef enum{
+    CO_PROF_SYNC = 0,       /**< CO_SYNC_process() in CO_process_SYNC_RPDO() */
+    CO_PROF_RPDO = 1,       /**< CO_RPDO_process() of all RPDOs */
+    CO_PROF_RT_APP = 2,     /**< Application code in realtime cycle, between RPDOs and TPDOs */
+    CO_PROF_TPDO = 3,       /**< CO_process_TPDO() */
+    CO_PROF_SDO = 4,        /**< SDO servers in CO_process() or CO_process_signaled() */
+    CO_PROF_EMCY = 5,       /**< CO_EM_process() */
+    CO_PROF_NMT = 6,        /**< CO_NMT_process() */
+    CO_PROF_HB_CONS = 7,    /**< CO_HBconsumer_process() */
+    CO_PROF_MAIN_APP = 8,   /**< Application tasks in mainline, CO_async_process() */
+    CO_PROF_STAGES = 9      /**< Number of stages */
+}CO_profStage_t;
+
+
+/**
+ * Profile of one CANopen object, see CO_t::prof.
+ */
+typedef struct{
+    CO_hist_t   stage[CO_PROF_STAGES];   /**< Execution time in nanoseconds */
+    CO_hist_t   snapshot[CO_PROF_STAGES];/**< Last snapshot read through OD */
+}CO_prof_t;
+
+
+#if CO_CONFIG_PROFILE
+/** Current time in nanoseconds. */
+static inline uint64_t CO_prof_now(void){
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &t);
+    return (uint64_t)t.tv_sec * 1000000000U + (uint64_t)t.tv_nsec;
+}
+
+/** Record time since *t into stage and set *t to now. */
+static inline void CO_prof_stage(CO_prof_t *prof, CO_profStage_t stage, uint64_t *t){
+    uint64_t now = CO_prof_now();
+    uint64_t ns = now - *t;
+
+    CO_hist_record(&prof->stage[stage], (ns > CO_HIST_MAX_VALUE) ? CO_HIST_MAX_VALUE : (uint32_t)ns);
+    *t = now;
+}
+
+/** Declare timestamp variable t and take start of the first stage. */
+#define CO_PROF_BEGIN(t)                uint64_t t = CO_prof_now()
+/** End of stage of CANopen object CO, which started at t. */
+#define CO_PROF_STAGE(CO, stage, t)     CO_prof_stage((CO)->prof, (stage), &(t))
+#else
+#define CO_PROF_BEGIN(t)
+#define CO_PROF_STAGE(CO, stage, t)
+#endif
+
+
+#if CO_CONFIG_PROFILE
+/**
+ * Register profile to Object Dictionary entry 0x2143, UNSIGNED32 array.
+ *
+ * Reading sub-index 1 takes snapshot of all stages, resets them and returns
+ * number of recorded realtime cycles (CO_PROF_TPDO). Sub-indexes 2 + 4 *
+ * stage ... 5 + 4 * stage return minimum, average, p99 and maximum execution
+ * time of the stage in nanoseconds from that snapshot, see
+ * ODA_cycleProfile_xxx in CO_OD.h. Must be called after each CO_init().
+ *
+ * @param SDO SDO server object.
+ * @param prof Profile of the same CANopen object.
+ */
+void CO_prof_configureOD(CO_SDO_t *SDO, CO_prof_t *prof);
+#endif
+
+
+#endif
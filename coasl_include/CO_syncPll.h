@@ -0,0 +1,105 @@
+/**
+ * Software PLL, which follows period and phase of received SYNC.
+ *
+ * @file        CO_syncPll.h
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * CANopenNode is free and open source software: you can redistribute
+ * it and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef CO_SYNC_PLL_H
+#define CO_SYNC_PLL_H
+
+#include "CO_driver.h"
+#include "CO_hist.h"
+
+
+/**
+ * Receive time of each SYNC is compared with its prediction. Prediction of
+ * the next SYNC is corrected by 1/4 of the error (phase) and the period
+ * estimate by 1/32 of the error (frequency). Times are in nanoseconds of
+ * CLOCK_MONOTONIC.
+ *
+ * PLL is locked after CO_SYNC_PLL_LOCK_COUNT consecutive SYNCs with error
+ * within 1/32 of the period. Error above 1/4 of the period (for example
+ * SYNC producer changed) restarts acquisition. Missing SYNCs are bridged
+ * with the period estimate, after CO_SYNC_PLL_HOLDOVER periods without
+ * SYNC lock is lost.
+ */
+#define CO_SYNC_PLL_LOCK_COUNT  8U
+#define CO_SYNC_PLL_HOLDOVER    3
+
+
+/** No SYNC received yet or SYNC is lost */
+#define CO_SYNC_PLL_IDLE        0U
+/** Period is measured, error is not yet small enough */
+#define CO_SYNC_PLL_ACQUIRING   1U
+/** Deadlines may be derived from prediction */
+#define CO_SYNC_PLL_LOCKED      2U
+
+
+/**
+ * PLL object. Updated and read from one thread. Object filled with zeros is
+ * valid and idle.
+ */
+typedef struct{
+    uint8_t     state;          /**< CO_SYNC_PLL_IDLE ... */
+    uint8_t     good;           /**< Consecutive SYNCs inside lock window */
+    int64_t     last_ns;        /**< Receive time of the last SYNC */
+    int64_t     next_ns;        /**< Predicted time of the next SYNC */
+    int64_t     period_ns;      /**< Period estimate, 0 if unknown */
+    int64_t     residual_ns;    /**< Prediction error of the last SYNC */
+    uint32_t    lockLost;       /**< Number of lost locks, informative */
+    CO_hist_t   residual;       /**< Absolute prediction error in locked state, microseconds */
+}CO_syncPll_t;
+
+
+/**
+ * Restart PLL, it waits for the first SYNC. Statistics (lockLost, residual)
+ * are kept.
+ *
+ * @param pll This object.
+ */
+void CO_syncPll_init(CO_syncPll_t *pll);
+
+
+/**
+ * Update PLL with receive time of SYNC.
+ *
+ * @param pll This object.
+ * @param t_ns Receive time.
+ */
+void CO_syncPll_update(CO_syncPll_t *pll, int64_t t_ns);
+
+
+/**
+ * Get next deadline, which is offset after predicted SYNC.
+ *
+ * @param pll This object.
+ * @param now_ns Current time. Lock is lost here, if SYNC is missing for
+ * too long.
+ * @param offset_ns Offset after SYNC, smaller than period.
+ * @param [out] deadline_ns Earliest time after now_ns, which is offset_ns
+ * after last or predicted SYNC.
+ *
+ * @return true, if PLL is locked and deadline_ns is valid.
+ */
+bool_t CO_syncPll_deadline(CO_syncPll_t *pll, int64_t now_ns, int64_t offset_ns, int64_t *deadline_ns);
+
+
+#endif
@@ -0,0 +1,161 @@
+/**
+ * Hierarchical timer wheel for CANopen protocol timers.
+ *
+ * @file        CO_tmrWheel.h
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * CANopenNode is free and open source software: you can redistribute
+ * it and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef CO_TMR_WHEEL_H
+#define CO_TMR_WHEEL_H
+
+#include <stdint.h>
+#include "Karsh.h"
+
+
+/**
+ * Wheel layout.
+ *
+ * Time is in microseconds. Each level has 64 slots, level 0 slot is 1 us wide,
+ * level 1 slot 64 us and so on. Five levels cover about 17 minutes, timers
+ * further away are kept on overflow list and sorted in, when they come closer.
+ * A timer moves only towards lower levels, so it is touched at most
+ * CO_TMR_WHEEL_LEVELS times before it expires.
+ */
+#define CO_TMR_WHEEL_BITS       6
+#define CO_TMR_WHEEL_SLOTS      (1U << CO_TMR_WHEEL_BITS)
+#define CO_TMR_WHEEL_LEVELS     5
+
+
+/**
+ * Timer object. It is usually a member of the object, which owns the timer.
+ * Object filled with zeros is a stopped timer without callback.
+ */
+typedef struct CO_tmr{
+    struct CO_tmr      *next;           /**< Next timer in the same list */
+    struct CO_tmr      *prev;           /**< Previous timer in the same list */
+    struct CO_tmr     **list;           /**< Head of the list, NULL if timer is stopped */
+    uint64_t            expires;        /**< Absolute expiration time in [microseconds] */
+    void               *object;         /**< From CO_tmr_init() */
+    void              (*pFunct)(void *object); /**< From CO_tmr_init() */
+}CO_tmr_t;
+
+
+/**
+ * Timer wheel object.
+ *
+ * Wheel and its timers must be used from one thread only.
+ */
+typedef struct{
+    uint64_t            now;            /**< Current time in [microseconds], starts with 0 */
+    uint64_t            slotUsed[CO_TMR_WHEEL_LEVELS]; /**< Bit is set for non-empty slot */
+    CO_tmr_t           *slot[CO_TMR_WHEEL_LEVELS][CO_TMR_WHEEL_SLOTS]; /**< Lists of timers */
+    CO_tmr_t           *overflow;       /**< Timers beyond the highest level */
+    CO_tmr_t           *expired;        /**< Timers to be called by the next CO_tmrWheel_advance() */
+    uint32_t            count;          /**< Number of running timers, informative */
+}CO_tmrWheel_t;
+
+
+/**
+ * Initialize timer wheel. Time is set to 0 and all timers are forgotten.
+ *
+ * @param wheel This object will be initialized.
+ */
+void CO_tmrWheel_init(CO_tmrWheel_t *wheel);
+
+
+/**
+ * Advance time and call functions of expired timers.
+ *
+ * Cost does not depend on number of running timers, only on number of timers,
+ * which expire or move to lower level. Callback may start timers again. Timer
+ * started with expiration not after current time is called by the next
+ * CO_tmrWheel_advance(), so zero timeDifference_us may be used for that.
+ *
+ * @param wheel This object.
+ * @param timeDifference_us Time since previous call in [microseconds].
+ */
+void CO_tmrWheel_advance(CO_tmrWheel_t *wheel, uint32_t timeDifference_us);
+
+
+/**
+ * Get time to the first expiration.
+ *
+ * @param wheel This object.
+ * @param limit Returned, if there is no timer running or if it expires later.
+ *
+ * @return Time in [microseconds] after which CO_tmrWheel_advance() should be
+ * called. 0, if some timer is already expired.
+ */
+uint32_t CO_tmrWheel_next(CO_tmrWheel_t *wheel, uint32_t limit);
+
+
+/**
+ * Initialize timer. Timer is stopped.
+ *
+ * @param tmr This object will be initialized.
+ * @param object Argument for pFunct.
+ * @param pFunct Function called from CO_tmrWheel_advance(), when timer expires.
+ */
+void CO_tmr_init(CO_tmr_t *tmr, void *object, void (*pFunct)(void *object));
+
+
+/**
+ * Start timer, which expires at absolute time. Running timer is restarted.
+ *
+ * @param wheel Timer wheel.
+ * @param tmr This object.
+ * @param expires Expiration time in [microseconds], same time base as
+ * CO_tmrWheel_t::now.
+ */
+void CO_tmr_startAt(CO_tmrWheel_t *wheel, CO_tmr_t *tmr, uint64_t expires);
+
+
+/**
+ * Start timer, which expires after delay from current wheel time.
+ *
+ * @param wheel Timer wheel.
+ * @param tmr This object.
+ * @param delay_us Delay in [microseconds].
+ */
+void CO_tmr_start(CO_tmrWheel_t *wheel, CO_tmr_t *tmr, uint32_t delay_us);
+
+
+/**
+ * Stop timer. Nothing happens, if timer is not running.
+ *
+ * @param wheel Timer wheel, on which timer was started.
+ * @param tmr This object.
+ */
+void CO_tmr_stop(CO_tmrWheel_t *wheel, CO_tmr_t *tmr);
+
+
+/**
+ * Check if timer is running (started and not yet called).
+ *
+ * @param tmr This object.
+ *
+ * @return True if running.
+ */
+static inline bool_t CO_tmr_isActive(const CO_tmr_t *tmr){
+    return tmr->list != NULL;
+}
+
+
+#endif
@@ -102,6 +102,10 @@
  * Critical sections must be protected. Eather by disabling scheduler or
  * interrupts or by mutexes or semaphores.
  *
+ * Mutexes are members of CO_CANmodule_t, so each CANopen object (see CO_new())
+ * has own critical sections and objects in different threads do not block
+ * each other. Macros get the CAN module of the calling object.
+ *
  * ####Object Dictionary variables.
  * In general, there are two threads, which accesses OD variables: mainline and
  * timer. CANopenNode initialization and SDO server runs in mainline. PDOs runs
@@ -111,13 +115,42 @@
  * that not all variables are allowed to be mapped to PDOs, so they may not need
  * to be protected. SDO server protects sections with access to OD variables.
  *
+ * Timer thread does not take CO_LOCK_OD, so it never waits for mainline.
+ * Instead PDO mappable variables are protected by seqlock of the CAN module
+ * (CO_OD_seqReadBegin() ... CO_OD_seqWriteEnd()). Timer thread writes RPDO
+ * data only, if no other writer is inside, otherwise it retries in the next
+ * cycle. It reads TPDO data optimistically and sends previous data, if read
+ * was not consistent. Mainline writers of mappable variables take CO_LOCK_OD,
+ * which serializes them, and additionally CO_OD_seqWriteBegin(). Mainline
+ * readers retry, while they overlap with writer. CO_LOCK_OD alone still
+ * protects all other OD variables.
+ *
  * ####CAN receive thread.
  * It partially processes received CAN data and puts them into appropriate
  * objects. Objects are later processed. It does not need protection of
  * critical sections. There is one circumstance, where CANrx should be disabled:
  * After presence of SYNC message on CANopen bus, CANrx should be temporary
  * disabled until all receive PDOs are processed. See also CO_SYNC.h file and
- * CO_SYNC_initCallback() function.
+ * CO_SYNC_initCallback() function. Realtime task of this port does it with
+ * CANrx_lockCbSync() and CO_CANrxNext().
+ *
+ * Received data are handed over with flags (CANrxNew and similar), which are
+ * accessed only with CO_FLAG_READ(), CO_FLAG_SET() and CO_FLAG_CLEAR(). Writer
+ * of data sets the flag with release, so reader, which sees the flag with
+ * acquire, also sees the data. Reader clears the flag with release after it
+ * is done with the data, before receive writes them again. RPDO receive does
+ * not wait for the reader and overwrites its buffer, so the buffer has also a
+ * sequence counter (CO_RPDO_t::CANrxSeq) and torn frame is never copied into
+ * Object Dictionary. So receive may run on other core than processing also on
+ * weakly ordered CPUs.
+ *
+ * Fields written by the CAN receive callback (or by application, for
+ * CO_TPDO_t::sendRequest) are grouped at the end of the object (CO_RPDO_t,
+ * CO_TPDO_t, CO_SYNC_t, CO_HBconsNode_t, CO_SDO_t) and start on own cache
+ * line with CO_CACHE_ALIGNED. Realtime thread receives,
+ * but SDO server and Heartbeat consumer run in mainline on other core, so
+ * received frame does not invalidate configuration and state, which the
+ * other thread reads. CO_new() allocates such objects aligned.
  * @{
  */
 
@@ -130,6 +163,7 @@
 
 #ifndef CO_SINGLE_THREAD
 #include <pthread.h>
+#include <sched.h>
 #endif
 #include <net/if.h>
 #include <sys/ioctl.h>
@@ -141,36 +175,54 @@
 /* general configuration */
  //   #define CO_LOG_CAN_MESSAGES   /* Call external function for each received or transmitted CAN message. */
 #define CO_SDO_BUFFER_SIZE   889    /* Override default SDO buffer size. */
+ //   #define CO_USE_LEDS           /* Process CANopen status LEDs, mainline then wakes each 50 ms. */
 
 
 
+/* Flags between CAN receive and processing, see CAN receive thread above. */
+#ifdef CO_SINGLE_THREAD
+    #define CO_FLAG_READ(rxNew)     (rxNew)
+    #define CO_FLAG_SET(rxNew)      ((rxNew) = true)
+    #define CO_FLAG_CLEAR(rxNew)    ((rxNew) = false)
+#else
+    #define CO_FLAG_READ(rxNew)     __atomic_load_n(&(rxNew), __ATOMIC_ACQUIRE)
+    #define CO_FLAG_SET(rxNew)      __atomic_store_n(&(rxNew), true, __ATOMIC_RELEASE)
+    #define CO_FLAG_CLEAR(rxNew)    __atomic_store_n(&(rxNew), false, __ATOMIC_RELEASE)
+#endif
+
+
+/* Cache line size in bytes, alignment of fields written by other thread */
+#ifndef CO_CACHE_LINE
+    #define CO_CACHE_LINE   64
+#endif
+#define CO_CACHE_ALIGNED    __attribute__((aligned(CO_CACHE_LINE)))
+
+
 /* Critical sections */
 
 
 #ifdef CO_SINGLE_THREAD
 
-    #define CO_LOCK_CAN_SEND()
-    #define CO_UNLOCK_CAN_SEND()
+    #define CO_LOCK_CAN_SEND(CAN_MODULE)
+    #define CO_UNLOCK_CAN_SEND(CAN_MODULE)
 
-    #define CO_LOCK_EMCY()
-    #define CO_UNLOCK_EMCY()
+    #define CO_LOCK_EMCY(CAN_MODULE)
+    #define CO_UNLOCK_EMCY(CAN_MODULE)
 
-    #define CO_LOCK_OD()
-    #define CO_UNLOCK_OD()
+    #define CO_LOCK_OD(CAN_MODULE)
+    #define CO_UNLOCK_OD(CAN_MODULE)
 
 #else
 
 
-    #define CO_LOCK_CAN_SEND()      /* not needed */
-    #define CO_UNLOCK_CAN_SEND()
+    #define CO_LOCK_CAN_SEND(CAN_MODULE)    /* not needed */
+    #define CO_UNLOCK_CAN_SEND(CAN_MODULE)
 
-    extern pthread_mutex_t CO_EMCY_mtx;
-    #define CO_LOCK_EMCY()          {if(pthread_mutex_lock(&CO_EMCY_mtx) != 0) CO_errExit("Mutex lock CO_EMCY_mtx failed");}
-    #define CO_UNLOCK_EMCY()        {if(pthread_mutex_unlock(&CO_EMCY_mtx) != 0) CO_errExit("Mutex unlock CO_EMCY_mtx failed");}
+    #define CO_LOCK_EMCY(CAN_MODULE)    {if(pthread_mutex_lock(&(CAN_MODULE)->EMCY_mtx) != 0) CO_errExit("Mutex lock EMCY_mtx failed");}
+    #define CO_UNLOCK_EMCY(CAN_MODULE)  {if(pthread_mutex_unlock(&(CAN_MODULE)->EMCY_mtx) != 0) CO_errExit("Mutex unlock EMCY_mtx failed");}
 
-    extern pthread_mutex_t CO_OD_mtx;
-    #define CO_LOCK_OD()            {if(pthread_mutex_lock(&CO_OD_mtx) != 0) CO_errExit("Mutex lock CO_OD_mtx failed");}
-    #define CO_UNLOCK_OD()          {if(pthread_mutex_unlock(&CO_OD_mtx) != 0) CO_errExit("Mutex unlock CO_OD_mtx failed");}
+    #define CO_LOCK_OD(CAN_MODULE)      {if(pthread_mutex_lock(&(CAN_MODULE)->OD_mtx) != 0) CO_errExit("Mutex lock OD_mtx failed");}
+    #define CO_UNLOCK_OD(CAN_MODULE)    {if(pthread_mutex_unlock(&(CAN_MODULE)->OD_mtx) != 0) CO_errExit("Mutex unlock OD_mtx failed");}
 
  #endif
 
@@ -229,8 +281,8 @@ typedef struct{
     uint32_t            ident;
     uint8_t             DLC;
     uint8_t             data[8] __attribute__((aligned(8)));
-    volatile bool_t     bufferFull;
-    volatile bool_t     syncFlag;
+    bool_t              bufferFull;  //CO_FLAG_xxx
+    bool_t              syncFlag;
 }CO_CANtx_t;
 
 
@@ -252,7 +304,7 @@ typedef struct{
     uint16_t            wasConfigured; //Zero only on first run of CO_CANmodule_init
     int                 fd;          //CAN_RAW socket file descriptor
     struct can_filter  *filter;      //array of CAN filters of size rxSize
-    volatile bool_t     CANnormal;
+    bool_t              CANnormal;   //CO_FLAG_xxx, written by mainline, read by CAN receive
     volatile bool_t     useCANrxFilters;
     volatile bool_t     bufferInhibitFlag;
     volatile bool_t     firstCANtxMessage;
@@ -260,9 +312,61 @@ typedef struct{
     volatile uint16_t   CANtxCount;
     uint32_t            errOld;
     void               *em;
+#ifndef CO_SINGLE_THREAD
+    pthread_mutex_t     EMCY_mtx;    //CO_LOCK_EMCY, initialized with socket
+    pthread_mutex_t     OD_mtx;      //CO_LOCK_OD, initialized with socket
+#endif
+    uint32_t            OD_seq;      //Seqlock of PDO mappable OD variables, odd while written
+    logSite_t           rxNoMatchSite; //Rate limited log of received CAN-ID without rxArray element
 }CO_CANmodule_t;
 
 
+/* Seqlock of PDO mappable OD variables, see Critical sections above. */
+#ifdef CO_SINGLE_THREAD
+static inline uint32_t CO_OD_seqReadBegin(CO_CANmodule_t *CANmodule){(void)CANmodule; return 0;}
+static inline bool_t CO_OD_seqReadRetry(CO_CANmodule_t *CANmodule, uint32_t seq){(void)CANmodule; (void)seq; return false;}
+static inline bool_t CO_OD_seqTryWriteBegin(CO_CANmodule_t *CANmodule){(void)CANmodule; return true;}
+static inline void CO_OD_seqWriteBegin(CO_CANmodule_t *CANmodule){(void)CANmodule;}
+static inline void CO_OD_seqWriteEnd(CO_CANmodule_t *CANmodule){(void)CANmodule;}
+#else
+/* Start of read, returns sequence for CO_OD_seqReadRetry(). */
+static inline uint32_t CO_OD_seqReadBegin(CO_CANmodule_t *CANmodule){
+    return __atomic_load_n(&CANmodule->OD_seq, __ATOMIC_ACQUIRE);
+}
+
+/* End of read, true if data read since CO_OD_seqReadBegin() may be inconsistent. */
+static inline bool_t CO_OD_seqReadRetry(CO_CANmodule_t *CANmodule, uint32_t seq){
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return (seq & 1U) != 0U || __atomic_load_n(&CANmodule->OD_seq, __ATOMIC_RELAXED) != seq;
+}
+
+/* Start of write, which does not wait. Returns false, if other writer is inside. */
+static inline bool_t CO_OD_seqTryWriteBegin(CO_CANmodule_t *CANmodule){
+    uint32_t seq = __atomic_load_n(&CANmodule->OD_seq, __ATOMIC_RELAXED);
+
+    if((seq & 1U) != 0U || !__atomic_compare_exchange_n(&CANmodule->OD_seq, &seq, seq + 1U,
+                                false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)){
+        return false;
+    }
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    return true;
+}
+
+/* Start of write from mainline, called inside CO_LOCK_OD. Other writer can
+ * only be timer thread, which stays inside for a copy of one PDO. */
+static inline void CO_OD_seqWriteBegin(CO_CANmodule_t *CANmodule){
+    while(!CO_OD_seqTryWriteBegin(CANmodule)){
+        sched_yield();
+    }
+}
+
+/* End of write. */
+static inline void CO_OD_seqWriteEnd(CO_CANmodule_t *CANmodule){
+    __atomic_fetch_add(&CANmodule->OD_seq, 1U, __ATOMIC_RELEASE);
+}
+#endif
+
+
 
 /* Endianes */
 #ifdef BYTE_ORDER
@@ -274,8 +378,9 @@ typedef struct{
 #endif
 
 
-/* Helper function, must be defined externally. */
+/* Helper functions, must be defined externally. */
 void CO_errExit(char* msg);
+void CO_error(const uint32_t info);
 
 
 /* Request CAN configuration or normal mode */
@@ -341,4 +446,14 @@ void CO_CANverifyErrors(CO_CANmodule_t *CANmodule);
  */
 void CO_CANrxWait(CO_CANmodule_t *CANmodule);
 
+
+/* Function receives one CAN message, if one is waiting in the socket. It is
+ * not blocking.
+ *
+ * @param CANmodule This object.
+ *
+ * @return true, if message was read (and processed in normal mode).
+ */
+bool_t CO_CANrxNext(CO_CANmodule_t *CANmodule);
+
 #endif
@@ -0,0 +1,150 @@
+/*
+ * LogFormat.h
+ *
+ *  Binary log file layout, shared by Logger.c and tools/logdecode.c
+ *
+ *      Author: karsh
+ */
+/*
+ * FILE LAYOUT:
+ * 			log_<time>[_<n>].bin  : one logBinHeader_t, then logBinRecord_t records
+ * 			                        in timestamp order (all records are 64 bytes).
+ * 			sites_<runId>.txt     : one line per event site, written when the site
+ * 			                        is first hit:
+ * 			                        <id>\t<module>\t<file>\t<function>\t<format>\n
+ * 			                        (backslash and newline in format are escaped).
+ *
+ * 			LOG_BIN_LOG/LOG_BIN_ERROR records are events: site says which format
+ * 			string belongs to them, args[0..nargs-1] are its numeric arguments.
+ * 			LOG_BIN_TEXT/LOG_BIN_TEXT_ERROR records carry lines printed with
+ * 			logPrint(). A line is split into chunks of up to 40 bytes, flags has
+ * 			LOG_BIN_FLAG_MORE set on every chunk except the last.
+ */
+
+#ifndef COASL_INCLUDE_LOGFORMAT_H_
+#define COASL_INCLUDE_LOGFORMAT_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+//*********************************************
+//Definitions
+//*********************************************
+#define LOG_BIN_MAGIC		"COLOGBIN"
+#define LOG_BIN_VERSION		1
+
+//Record types
+#define LOG_BIN_LOG			0
+#define LOG_BIN_ERROR		1
+#define LOG_BIN_TEXT		2
+#define LOG_BIN_TEXT_ERROR	3
+
+#define LOG_BIN_FLAG_MORE	0x01
+#define LOG_BIN_MAX_ARGS	4
+#define LOG_BIN_TEXT_CHUNK	40
+
+//File header, same size as one record
+typedef struct{
+	char		magic[8];		//LOG_BIN_MAGIC, not terminated
+	uint16_t	version;		//LOG_BIN_VERSION
+	uint16_t	recordSize;		//sizeof(logBinRecord_t)
+	uint32_t	runId;			//startLogger() time, names the sites file
+	uint64_t	monoStart;		//CLOCK_MONOTONIC at startLogger(), ns
+	uint64_t	realStart;		//CLOCK_REALTIME at startLogger(), ns
+	uint8_t		reserved[32];
+}logBinHeader_t;
+
+//One record
+typedef struct{
+	uint64_t	timestamp;		//CLOCK_MONOTONIC, ns
+	uint32_t	tid;			//Linux thread id
+	uint16_t	site;			//event site id, 0 for text records
+	uint8_t		module;			//LOG_MOD_xxx
+	uint8_t		type;			//LOG_BIN_xxx
+	uint8_t		nargs;			//events: used args, text: bytes in this chunk
+	uint8_t		flags;			//LOG_BIN_FLAG_xxx
+	uint8_t		reserved[6];
+	union{
+		int64_t	args[LOG_BIN_MAX_ARGS];
+		char	text[LOG_BIN_TEXT_CHUNK];
+	};
+}logBinRecord_t;
+
+typedef char logBinRecordSizeCheck[(sizeof(logBinRecord_t)==64 && sizeof(logBinHeader_t)==64) ? 1 : -1];
+
+//*********************************************
+//Function list
+//*********************************************
+/*
+ * Renders an event format with numeric args into out. Supports the integer
+ * conversions d, i, u, x, X, o and c with flags, width and length modifiers.
+ * Without l/ll/j/z the arg is printed as 32 bit, like printf would for an int.
+ * Other conversions print "?".
+ * Returns length written (truncated to outSize-1).
+ */
+static inline int logRenderEvent(char *out,size_t outSize,const char *fmt,int nargs,const int64_t *args)
+{
+	size_t len = 0;
+	int argNo = 0;
+
+	if(outSize==0) return 0;
+	while(*fmt && len+1<outSize)
+	{
+		char spec[24];
+		size_t specLen = 0;
+		int wide = 0;
+		int n;
+
+		if(*fmt!='%')
+		{
+			out[len++]=*fmt++;
+			continue;
+		}
+		if(fmt[1]=='%')
+		{
+			out[len++]='%';
+			fmt+=2;
+			continue;
+		}
+
+		//copy flags and width, drop length modifiers, add "ll"
+		spec[specLen++]=*fmt++;
+		while(*fmt && strchr("-+ #0123456789.",*fmt) && specLen<sizeof(spec)-4) spec[specLen++]=*fmt++;
+		while(*fmt && strchr("hlLqjzt",*fmt))
+		{
+			if(strchr("lLqjzt",*fmt)) wide=1;
+			fmt++;
+		}
+		if(*fmt==0) break;
+
+		if(argNo>=nargs || strchr("diuxXoc",*fmt)==NULL)
+		{
+			n=snprintf(out+len,outSize-len,"?");
+		}
+		else if(*fmt=='c')
+		{
+			spec[specLen++]='c';
+			spec[specLen]=0;
+			n=snprintf(out+len,outSize-len,spec,(int)args[argNo]);
+		}
+		else
+		{
+			spec[specLen++]='l';
+			spec[specLen++]='l';
+			spec[specLen++]=*fmt;
+			spec[specLen]=0;
+			if(*fmt=='d' || *fmt=='i')
+				n=snprintf(out+len,outSize-len,spec,wide ? (long long)args[argNo] : (long long)(int32_t)args[argNo]);
+			else
+				n=snprintf(out+len,outSize-len,spec,wide ? (unsigned long long)args[argNo] : (unsigned long long)(uint32_t)args[argNo]);
+		}
+		argNo++;
+		fmt++;
+		if(n>0) len+=((size_t)n<outSize-len) ? (size_t)n : outSize-len-1;
+	}
+	out[len]=0;
+	return (int)len;
+}
+
+#endif /* COASL_INCLUDE_LOGFORMAT_H_ */
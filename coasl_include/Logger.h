@@ -16,6 +16,17 @@
  *
  */
 //   if(LEVEL_1){sprintf(logline,"sbb acncbdcc");   logPrint(ERROR,logline);}
+/*
+ * RUNTIME LEVELS:
+ * 			Every source file tags its log sites with a module by defining
+ * 			LOG_MODULE before the first #include, e.g.
+ * 				#define LOG_MODULE LOG_MOD_SDO
+ * 			LEVEL_n is then true only if DEBUG_LEVEL>=n (compile time) and
+ * 			the runtime level of that module is >=n. Runtime levels are set from
+ * 			the CO_LOG_LEVEL environment variable in startLogger()
+ * 			(e.g. CO_LOG_LEVEL="2" or CO_LOG_LEVEL="*=1,sdo=3,pdo=0", applied left to right)
+ * 			and from OD entry 0x2140 (one sub-index per module).
+ */
 
 
 
@@ -27,23 +38,46 @@
 #include <time.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <stdint.h>
 
 
 #define WHERE printf("\n\n I AM HERE \n\n")
 //LogIDs for logging
 #define LOG 0
 #define ERROR 1
+//*********************************************
+//Module IDs for runtime log levels
+#define LOG_MOD_MAIN	0	//CANopen.c, main, application and anything untagged
+#define LOG_MOD_DRIVER	1	//CO_driver.c
+#define LOG_MOD_SDO		2	//SDO server and client
+#define LOG_MOD_PDO		3	//PDO and SYNC
+#define LOG_MOD_NMT		4	//NMT, heartbeat producer and consumer
+#define LOG_MOD_EMCY	5	//Emergency
+#define LOG_MOD_STORAGE	6	//OD storage
+#define LOG_MOD_TASKS	7	//Linux task layer
+#define LOG_MOD_COUNT	8
+
+#ifndef LOG_MODULE
+#define LOG_MODULE LOG_MOD_MAIN
+#endif
+
 //*********************************************
 //These are the Log Level options.
-#define LEVEL_1 DEBUG_LEVEL>0
-#define LEVEL_2 DEBUG_LEVEL>1
-#define LEVEL_3 DEBUG_LEVEL>2
-#define LEVEL_4 DEBUG_LEVEL>4
-#define LEVEL_5 DEBUG_LEVEL>5
-#define LEVEL_6 DEBUG_LEVEL>6
-#define LEVEL_7 DEBUG_LEVEL>7
-#define LEVEL_8 DEBUG_LEVEL>8
-#define LEVEL_9 DEBUG_LEVEL>9
+//First term is folded by the compiler, second is a single byte compare.
+#define LOG_LEVEL_ON(n) (DEBUG_LEVEL>=(n) && __builtin_expect(logModuleLevel[LOG_MODULE]>=(n),0))
+#define LEVEL_1 LOG_LEVEL_ON(1)
+#define LEVEL_2 LOG_LEVEL_ON(2)
+#define LEVEL_3 LOG_LEVEL_ON(3)
+#define LEVEL_4 LOG_LEVEL_ON(4)
+#define LEVEL_5 LOG_LEVEL_ON(5)
+#define LEVEL_6 LOG_LEVEL_ON(6)
+#define LEVEL_7 LOG_LEVEL_ON(7)
+#define LEVEL_8 LOG_LEVEL_ON(8)
+#define LEVEL_9 LOG_LEVEL_ON(9)
+
+//These are log file formats
+#define LOG_FORMAT_TEXT 0		//"FILE: ...||CALL: ...\nMSG: ..." lines
+#define LOG_FORMAT_BINARY 1		//fixed size records, see LogFormat.h and tools/logdecode.c
 
 //These are log print options
 #define NO_LOG 0
@@ -56,20 +90,126 @@
 //*********************************************
 //Change setting for changing debug level
 
-	//This is Debug print is available for level
-	#define DEBUG_LEVEL 1
+	//This is the highest level compiled in. Sites above it cost nothing.
+	//Levels up to it are switched at runtime per module.
+	#define DEBUG_LEVEL 9
+
+	//Runtime level of every module at startup, before CO_LOG_LEVEL is applied.
+	#define LOG_DEFAULT_LEVEL 1
 
 //Change setting for changing Print options
 	//Print option is set to following
 	#define PRINT_DEBUG PRINT_ON_BOTH
 
+//Change setting for log file format. CO_LOG_FORMAT=text|binary overrides it.
+	#ifndef LOG_FORMAT
+	#define LOG_FORMAT LOG_FORMAT_TEXT
+	#endif
+
+//Change setting for the log writer thread
+	//Directory where log_<time>.log and Error_<time>.log are created
+	#ifndef LOG_DIR
+	#define LOG_DIR "/home"
+	#endif
+	//Records queued between logPrint() and the writer. Full queue drops records.
+	#ifndef LOG_QUEUE_LEN
+	#define LOG_QUEUE_LEN 1024
+	#endif
+	//Writer wakes at least this often and writes whatever is queued
+	#ifndef LOG_FLUSH_INTERVAL_MS
+	#define LOG_FLUSH_INTERVAL_MS 200
+	#endif
+	//Writer is woken early once this many records are queued
+	#ifndef LOG_FLUSH_BATCH
+	#define LOG_FLUSH_BATCH 256
+	#endif
+	//A new file is started when the current one exceeds size or age (0 disables)
+	#ifndef LOG_ROTATE_SIZE
+	#define LOG_ROTATE_SIZE (16UL*1024UL*1024UL)
+	#endif
+	#ifndef LOG_ROTATE_AGE_S
+	#define LOG_ROTATE_AGE_S (60*60)
+	#endif
+	//Oldest files are deleted when all log files together exceed this
+	#ifndef LOG_MAX_TOTAL_SIZE
+	#define LOG_MAX_TOTAL_SIZE (256UL*1024UL*1024UL)
+	#endif
+
+//Change setting for rate limited log sites (see logSiteAllow)
+	//Length of one rate limit window
+	#ifndef LOG_SITE_WINDOW_MS
+	#define LOG_SITE_WINDOW_MS 1000
+	#endif
+	//Max records printed by one site per window
+	#ifndef LOG_SITE_BURST
+	#define LOG_SITE_BURST 5
+	#endif
+
+//*********************************************
+//Rate limited log site
+//*********************************************
+/*
+ * USAGE on hot paths:
+ * 			static logSite_t site;
+ * 			if(LEVEL_1 && logSiteAllow(&site)){
+ * 				 sprintf(logLine,"sbb acncbdcc");
+ * 				 logPrintSite(&site,ERROR,logLine);}
+ *
+ * A site prints at most LOG_SITE_BURST records per LOG_SITE_WINDOW_MS, and a
+ * record identical to the previous one from the same site is not printed again.
+ * Once a record repeats, further hits in that window are skipped by
+ * logSiteAllow() without formatting. Skipped hits are counted and reported with
+ * the next printed record as "[previous message repeated N times in T ms]"
+ * (or "[N more from this site suppressed in T ms]" if rate limiting kicked in).
+ * A site must be used by one thread. On paths, which several CANopen objects
+ * or threads run, keep the site in the object instead of a static.
+ */
+		typedef struct{
+			uint32_t	windowStart;	//ms, start of current rate limit window
+			uint16_t	printed;		//records printed in current window
+			uint32_t	limited;		//hits skipped by rate limit since last print
+			uint32_t	repeated;		//identical records skipped since last print
+			uint32_t	skipStart;		//ms, first skipped hit since last print
+			uint32_t	lastHash;		//hash of last printed record
+		}logSite_t;
+
+//*********************************************
+//Structured log events
+//*********************************************
+/*
+ * USAGE:
+ * 			LOG_EVENT(1,ERROR,"CO_CANsend","CAN send failed, ident=0x%X, err=%d",ident,err);
+ *
+ * Format may use only integer conversions (d, i, u, x, X, o, c) and up to 4
+ * integer args. In text format the event is printed like a sprintf()+logPrint()
+ * site. In binary format only site id and args are stored, the format string
+ * is written once per run to the sites file and rendered by tools/logdecode.
+ */
+		typedef struct{
+			uint8_t		module;			//LOG_MOD_xxx
+			const char	*file;
+			const char	*func;
+			const char	*fmt;
+			uint16_t	id;				//assigned on first binary record, 0 before
+		}logEventSite_t;
+
+#define LOG_EVENT(n,logid,func,fmt,...) do{ \
+		if(LEVEL_##n){ \
+			static logEventSite_t logEventSite_ = {LOG_MODULE, __FILE__, func, fmt, 0}; \
+			const int64_t logEventArgs_[] = {0, ##__VA_ARGS__}; \
+			logEvent(&logEventSite_,logid,(int)(sizeof(logEventArgs_)/sizeof(int64_t))-1,&logEventArgs_[1]); \
+		}}while(0)
+
 //*********************************************
 //Global variable settings
 //*********************************************
 		//only single instance of logger can be created.
 		extern int fileDescrpt;
-		//Max of 250 characters can be printed in a message
-		char logLine[250];
+		//Max of 250 characters can be printed in a message. Each thread has
+		//own buffer, so CANopen objects in different threads may log at once.
+		extern __thread char logLine[250];
+		//Runtime level per module. Written by logSetModuleLevel() only.
+		extern uint8_t logModuleLevel[LOG_MOD_COUNT];
 
 //*********************************************
 //Function list
@@ -81,10 +221,38 @@
 			int startLogger();
 
 			//Stoplogger stops the logger.
-			//This is called in the end of the main(). This disables logging.
+			//This is called in the end of the main(). Queued records are written
+			//before files are closed.
 			int stopLogger();
 
-			//This prints the log in different files depending on the logid .
-			void logPrint(int logid,char* logLine);
+			//This queues the log for the writer thread, which prints it in different
+			//files depending on the logid. Never blocks on file I/O.
+			//logPrint() tags the record with LOG_MODULE of the calling file.
+			void logPrintModule(int module,int logid,char* logLine);
+			#define logPrint(logid,logLine) logPrintModule(LOG_MODULE,logid,logLine)
+
+			//Queues a structured event, use LOG_EVENT() instead of calling it.
+			void logEvent(logEventSite_t *site,int logid,int nargs,const int64_t *args);
+
+			//Rate limit check for a log site, call before formatting. Returns 0 if skipped.
+			int logSiteAllow(logSite_t *site);
+
+			//Like logPrint(), but skips a record identical to the previous one of
+			//this site and appends the count of skipped hits to the next record.
+			void logPrintSiteModule(int module,logSite_t *site,int logid,char* logLine);
+			#define logPrintSite(site,logid,logLine) logPrintSiteModule(LOG_MODULE,site,logid,logLine)
+
+			//Number of records dropped so far because the queue was full.
+			unsigned long logDroppedCount();
+
+			//Sets runtime level of one module. Returns -1 if module is out of range.
+			int logSetModuleLevel(int module,uint8_t level);
+
+			//Returns runtime level of one module (0 if out of range).
+			uint8_t logGetModuleLevel(int module);
+
+			//Parses "N" or "name=N,name=N,*=N" (names: main, driver, sdo, pdo,
+			//nmt, emcy, storage, tasks). Returns number of settings applied or -1.
+			int logSetLevels(const char *spec);
 
 #endif /* COASL_INCLUDE_LOGGER_H_ */
@@ -109,14 +109,14 @@
  * ###Timer program flow chart
  *
  * @code
-        (Timer interrupt 1 millisecond)
+       (Realtime task cycle, see CO_Linux_tasks.h)
                       |
                       V
               (CANopen read RPDOs)
                       |
                       V
     +------------------------------------+
-    |           program1ms()             |
+    |   program1ms(timeDifference_us)    |
     +------------------------------------+
                       |
                       V
@@ -149,6 +149,15 @@ void programStart(void);
 void communicationReset(void);
 
 
+/**
+ * Called after communicationReset(). Application may start its tasks here.
+ *
+ * @param async Scheduler of tasks, run by mainline, see CO_async.h.
+ */
+struct CO_async;
+void programTasks(struct CO_async *async);
+
+
 /**
  * Called before program end.
  */
@@ -156,7 +165,9 @@ void programEnd(void);
 
 
 /**
- * Called cyclically from main.
+ * Called cyclically from main. On Linux it is called from each cycle of
+ * mainline task, see taskMain_initApp(). Calls longer than app_main_budget_us
+ * are reported by emergency.
  *
  * @param timer1msDiff Time difference since last call
  */
@@ -164,9 +175,16 @@ void programAsync(uint16_t timer1msDiff);
 
 
 /**
- * Called cyclically from 1ms timer task.
+ * Called from each cycle of realtime task, between RPDOs and TPDOs, see
+ * CANrx_taskTmr_initApp(). Cycles run on reception, SYNC and deadlines of
+ * CANopen objects, at most TMR_TASK_INTERVAL of main.c apart, not each
+ * millisecond. Count time with timeDifference_us, not with calls. Calls
+ * longer than app_rt_budget_us are reported by emergency.
+ *
+ * @param timeDifference_us Time difference since last call in microseconds,
+ * may be 0.
  */
-void program1ms(void);
+void program1ms(uint32_t timeDifference_us);
 
 
 /** @} */
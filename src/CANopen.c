@@ -55,24 +55,20 @@
  * CRC16 CCITT checksum. */
 /* #define CO_USE_OWN_CRC16 */
 
+#include <string.h>
 #ifndef CO_USE_GLOBALS
     #include <stdlib.h> /*  for malloc, free */
-    static uint32_t CO_memoryUsed = 0; /* informative */
 #endif
 
 
 /* Global variables ***********************************************************/
     extern const CO_OD_entry_t CO_OD[CO_OD_NoOfElements];  /* Object Dictionary array */
+#ifdef CO_USE_GLOBALS
     static CO_t COO;
-    CO_t *CO = NULL;
-
-    static CO_CANrx_t          *CO_CANmodule_rxArray0;
-    static CO_CANtx_t          *CO_CANmodule_txArray0;
-    static CO_OD_extension_t   *CO_SDO_ODExtensions;
-    static CO_HBconsNode_t     *CO_HBcons_monitoredNodes;
+#endif
+    /* set, if some CANopen object uses global Object Dictionary */
+    static bool_t CO_globalODused = false;
 #if CO_NO_TRACE > 0
-    static uint32_t            *CO_traceTimeBuffers[CO_NO_TRACE];
-    static int32_t             *CO_traceValueBuffers[CO_NO_TRACE];
   #ifdef CO_USE_GLOBALS
   #ifndef CO_TRACE_BUFFER_SIZE_FIXED
     #define CO_TRACE_BUFFER_SIZE_FIXED 100
@@ -102,6 +98,9 @@
     #else
         #define CO_NO_HB_CONS   0
     #endif
+    #if CO_NO_HB_CONS > CO_HB_CONS_PENDING_WORDS * 32
+        #error CO_NO_HB_CONS does not fit into CO_HBconsumer_t::pending
+    #endif
 
     #define CO_RXCAN_NMT       0                                      /*  index for NMT message */
     #define CO_RXCAN_SYNC      1                                      /*  index for SYNC message */
@@ -129,6 +128,7 @@
     static CO_CANtx_t           COO_CANmodule_txArray0[CO_TXCAN_NO_MSGS];
     static CO_SDO_t             COO_SDO[CO_NO_SDO_SERVER];
     static CO_OD_extension_t    COO_SDO_ODExtensions[CO_OD_NoOfElements];
+    static uint16_t             COO_SDO_ODindex[CO_OD_INDEX_TABLE_SIZE];
     static CO_EM_t              COO_EM;
     static CO_EMpr_t            COO_EMpr;
     static CO_NMT_t             COO_NMT;
@@ -137,9 +137,14 @@
     static CO_TPDO_t            COO_TPDO[CO_NO_TPDO];
     static CO_HBconsumer_t      COO_HBcons;
     static CO_HBconsNode_t      COO_HBcons_monitoredNodes[CO_NO_HB_CONS];
+    static CO_tmrWheel_t        COO_tmrMain;
+    static CO_tmrWheel_t        COO_tmrRT;
 #if CO_NO_SDO_CLIENT == 1
     static CO_SDOclient_t       COO_SDOclient;
 #endif
+#if CO_CONFIG_PROFILE
+    static CO_prof_t            COO_prof;
+#endif
 #if CO_NO_TRACE > 0
     static CO_trace_t           COO_trace[CO_NO_TRACE];
     static uint32_t             COO_traceTimeBuffers[CO_NO_TRACE][CO_TRACE_BUFFER_SIZE_FIXED];
@@ -150,8 +155,6 @@
 
 /* Helper function for NMT master *********************************************/
 #if CO_NO_NMT_MASTER == 1
-    CO_CANtx_t *NMTM_txBuff = 0;
-
     uint8_t CO_sendNMTcommand(CO_t *CO, uint8_t command, uint8_t nodeID){
 
     	if(LEVEL_1){sprintf(logLine,
@@ -159,12 +162,12 @@
     			"||CALL: CO_sendNMTcommand"
     			"\nMSG: started"); logPrint(LOG,logLine);}
 
-        if(NMTM_txBuff == 0){
+        if(CO->NMTM_txBuff == 0){
             /* error, CO_CANtxBufferInit() was not called for this buffer. */
             return CO_ERROR_TX_UNCONFIGURED; /* -11 */
         }
-        NMTM_txBuff->data[0] = command;
-        NMTM_txBuff->data[1] = nodeID;
+        CO->NMTM_txBuff->data[0] = command;
+        CO->NMTM_txBuff->data[1] = nodeID;
 
         /* Apply NMT command also to this node, if set so. */
         if(nodeID == 0 || nodeID == CO->NMT->nodeId){
@@ -189,92 +192,227 @@
             }
         }
 
-        return CO_CANsend(CO->CANmodule[0], NMTM_txBuff); /* 0 = success */
+        return CO_CANsend(CO->CANmodule[0], CO->NMTM_txBuff); /* 0 = success */
     }
 #endif
 
 
 
-/******************************************************************************/
-CO_ReturnError_t CO_init(
-        int32_t                 CANbaseAddress,
-        uint8_t                 nodeId,
-        uint16_t                bitRate)
-{
+/* Runtime log levels, OD 0x2140 ********************************************/
+/*
+ * Sub-index N+1 maps to logger module N (LOG_MOD_xxx in Logger.h).
+ * Reads return the level currently used by the logger, writes apply at once.
+ */
+static CO_SDO_abortCode_t CO_ODF_2140(CO_ODF_arg_t *ODF_arg){
 
-	if(LEVEL_1){sprintf(logLine,
-			"FILE: CANopen.c"
-			"||CALL: CO_init"
-			"\nMSG: started"); logPrint(LOG,logLine);}
+    if(ODF_arg->subIndex == 0U || ODF_arg->subIndex > LOG_MOD_COUNT){
+        return CO_SDO_AB_NONE;
+    }
 
-	if(LEVEL_1){sprintf(logLine,
-						    	"FILE: CANopen.c"
-						    	"||CALL: CO_init"
-						    	"\nMSG: canopen init started"); logPrint(LOG,logLine);}
-	 //karthik did this
-	   CO_SDOclientPar_t OD_SDOClientParameter[1];
-	   OD_SDOClientParameter[0].COB_IDClientToServer=0x600;
-	   OD_SDOClientParameter[0].COB_IDServerToClient=0x580;
-	   OD_SDOClientParameter[0].maxSubIndex=3;
-	   OD_SDOClientParameter[0].nodeIDOfTheSDOServer=1;
+    if(ODF_arg->reading){
+        ODF_arg->data[0] = logGetModuleLevel(ODF_arg->subIndex - 1);
+    }
+    else{
+        logSetModuleLevel(ODF_arg->subIndex - 1, ODF_arg->data[0]);
+    }
 
+    return CO_SDO_AB_NONE;
+}
 
-    int16_t i;
-    CO_ReturnError_t err;
+
+/* Own copy of Object Dictionary *********************************************/
 #ifndef CO_USE_GLOBALS
-    uint16_t errCnt;
-#endif
-#if CO_NO_TRACE > 0
-    uint32_t CO_traceBufferSize[CO_NO_TRACE];
-#endif
+/* If var is inside global OD storage, return its address inside own copy. */
+static void *CO_ODrelocate(const void *var, const void *global, size_t size, void *own){
+    uintptr_t a = (uintptr_t)var;
+    uintptr_t g = (uintptr_t)global;
 
-    /* Verify parameters from CO_OD */
-    if(LEVEL_1){sprintf(logLine,
-        			"FILE: CANopen.c"
-        			"||CALL: CO_init"
-        			"\nMSG: Parmeter verification started"); logPrint(LOG,logLine);}
+    if(own != global && a >= g && a < g + size){
+        return (uint8_t*)own + (a - g);
+    }
+    return NULL;
+}
 
-    if(   sizeof(OD_TPDOCommunicationParameter_t) != sizeof(CO_TPDOCommPar_t)
-       || sizeof(OD_TPDOMappingParameter_t) != sizeof(CO_TPDOMapPar_t)
-       || sizeof(OD_RPDOCommunicationParameter_t) != sizeof(CO_RPDOCommPar_t)
-       || sizeof(OD_RPDOMappingParameter_t) != sizeof(CO_RPDOMapPar_t))
-    {
-    	if(LEVEL_1){sprintf(logLine,
-    			"FILE: CANopen.c"
-    			"||CALL: CO_init"
-    			"\nMSG: Parameter verification failed"
-    			"PARAMETER ERROR"); logPrint(ERROR,logLine);}
-        return CO_ERROR_PARAMETERS;
+
+/*
+ * Copy CO_OD entries and records, pData of each points into own OD storage.
+ * Record is recognised by zero attribute, see CO_OD_entry_t.
+ */
+static CO_ReturnError_t CO_ODcopy(CO_t *CO){
+    CO_OD_entry_t *OD;
+    uint32_t noOfRecords = 0;
+    uint32_t r = 0;
+    uint16_t i;
+
+    CO->ODRAM = (struct sCO_OD_RAM*) malloc(sizeof(CO_OD_RAM));
+    CO->ODEEPROM = (struct sCO_OD_EEPROM*) malloc(sizeof(CO_OD_EEPROM));
+    CO->ODROM = (struct sCO_OD_ROM*) malloc(sizeof(CO_OD_ROM));
+    OD = (CO_OD_entry_t*) malloc(sizeof(CO_OD));
+    CO->OD = OD;
+    if(CO->ODRAM == NULL || CO->ODEEPROM == NULL || CO->ODROM == NULL || OD == NULL){
+        return CO_ERROR_OUT_OF_MEMORY;
+    }
+    memcpy(CO->ODRAM, &CO_OD_RAM, sizeof(CO_OD_RAM));
+    memcpy(CO->ODEEPROM, &CO_OD_EEPROM, sizeof(CO_OD_EEPROM));
+    memcpy(CO->ODROM, &CO_OD_ROM, sizeof(CO_OD_ROM));
+    memcpy(OD, CO_OD, sizeof(CO_OD));
+
+    for(i=0; i<CO_OD_NoOfElements; i++){
+        if(OD[i].maxSubIndex > 0 && OD[i].attribute == 0){
+            noOfRecords += OD[i].maxSubIndex + 1U;
+        }
+    }
+    if(noOfRecords > 0){
+        CO->ODrecords = (CO_OD_entryRecord_t*) malloc(noOfRecords * sizeof(CO_OD_entryRecord_t));
+        if(CO->ODrecords == NULL){
+            return CO_ERROR_OUT_OF_MEMORY;
+        }
     }
 
-    #if CO_NO_SDO_CLIENT == 1
-    // if(sizeof(OD_SDOClientParameter_t) != sizeof(CO_SDOclientPar_t)){
-    //karthik changed: removed _t     OD_SDOClientParameter_t   to 		sOD_SDOClientParameter
-    if(sizeof(OD_SDOClientParameter) != sizeof(CO_SDOclientPar_t)){
-    	if(LEVEL_1){sprintf(logLine,
-    	    			"FILE: CANopen.c"
-    	    			"||CALL: CO_init"
-    	    			"\nMSG: size of SDO client does not match"
-    	    			"PARAMETER ERROR"); logPrint(ERROR,logLine);}
-        return CO_ERROR_PARAMETERS;
+    for(i=0; i<CO_OD_NoOfElements; i++){
+        if(OD[i].maxSubIndex > 0 && OD[i].attribute == 0){
+            const CO_OD_entryRecord_t *rec = (const CO_OD_entryRecord_t*) CO_OD[i].pData;
+            uint16_t j;
+
+            OD[i].pData = &CO->ODrecords[r];
+            for(j=0; j<=OD[i].maxSubIndex; j++){
+                CO->ODrecords[r] = rec[j];
+                CO->ODrecords[r].pData = CO_ODaddress(CO, rec[j].pData);
+                r++;
+            }
+        }
+        else{
+            OD[i].pData = CO_ODaddress(CO, CO_OD[i].pData);
+        }
     }
-    #endif
+
+    CO->memoryUsed += sizeof(CO_OD_RAM) + sizeof(CO_OD_EEPROM) + sizeof(CO_OD_ROM)
+                    + sizeof(CO_OD) + noOfRecords * sizeof(CO_OD_entryRecord_t);
+    return CO_ERROR_NO;
+}
 
 
-    /* Initialize CANopen object */
+/* calloc() for objects with CO_CACHE_ALIGNED fields, memory is freed with
+ * free(). calloc() aligns only to 16 bytes, so fields written by CAN receive
+ * could share cache line with the preceding object. */
+static void *CO_callocAligned(size_t nmemb, size_t size){
+    void *p;
+
+    if(posix_memalign(&p, CO_CACHE_LINE, nmemb * size) != 0){
+        return NULL;
+    }
+    memset(p, 0, nmemb * size);
+    return p;
+}
+
+
+/* Free memory allocated by CO_new(). Pointers, which are not set, are NULL. */
+static void CO_free(CO_t *CO){
+    int16_t i;
+
+  #if CO_NO_TRACE > 0
+    for(i=0; i<CO_NO_TRACE; i++) {
+        free(CO->trace[i]);
+        free(CO->traceTimeBuffers[i]);
+        free(CO->traceValueBuffers[i]);
+    }
+  #endif
+  #if CO_NO_SDO_CLIENT == 1
+    free(CO->SDOclient);
+  #endif
+  #if CO_CONFIG_PROFILE
+    free(CO->prof);
+  #endif
+    free(CO->tmrRT);
+    free(CO->tmrMain);
+    free(CO->HBcons_monitoredNodes);
+    free(CO->HBcons);
+    for(i=0; i<CO_NO_RPDO; i++){
+        free(CO->RPDO[i]);
+    }
+    for(i=0; i<CO_NO_TPDO; i++){
+        free(CO->TPDO[i]);
+    }
+    free(CO->SYNC);
+    free(CO->NMT);
+    free(CO->emPr);
+    free(CO->em);
+    free(CO->ODindex);
+    free(CO->ODExtensions);
+    for(i=0; i<CO_NO_SDO_SERVER; i++){
+        free(CO->SDO[i]);
+    }
+    free(CO->CANmodule_txArray0);
+    free(CO->CANmodule_rxArray0);
+    free(CO->CANmodule[0]);
+
+    if(CO->OD == &CO_OD[0]){
+        CO_globalODused = false;
+    }
+    else{
+        free(CO->ODrecords);
+        free((void*)CO->OD);
+        free(CO->ODROM);
+        free(CO->ODEEPROM);
+        free(CO->ODRAM);
+    }
+    free(CO);
+}
+#endif
+
+
+/******************************************************************************/
+void *CO_ODaddress(const CO_t *CO, const void *ODvariable){
+#ifndef CO_USE_GLOBALS
+    void *own;
+
+    if(CO->OD != &CO_OD[0]){
+        own = CO_ODrelocate(ODvariable, &CO_OD_RAM, sizeof(CO_OD_RAM), CO->ODRAM);
+        if(own != NULL) return own;
+        own = CO_ODrelocate(ODvariable, &CO_OD_EEPROM, sizeof(CO_OD_EEPROM), CO->ODEEPROM);
+        if(own != NULL) return own;
+        own = CO_ODrelocate(ODvariable, &CO_OD_ROM, sizeof(CO_OD_ROM), CO->ODROM);
+        if(own != NULL) return own;
+    }
+#else
+    (void)CO;
+#endif
+    return (void*)ODvariable;
+}
+
+
+/******************************************************************************/
+CO_ReturnError_t CO_new(CO_t **pCO, bool_t ownOD){
+    CO_t *CO;
+    int16_t i;
+#ifndef CO_USE_GLOBALS
+    uint16_t errCnt;
+#endif
+
     if(LEVEL_1){sprintf(logLine,
-            			"FILE: CANopen.c"
-            			"||CALL: CO_init"
-            			"\nMSG: Init CANopen object"); logPrint(LOG,logLine);}
+            "FILE: CANopen.c"
+            "||CALL: CO_new"
+            "\nMSG: started, ownOD=%d", ownOD); logPrint(LOG,logLine);}
+
+    if(pCO == NULL){
+        return CO_ERROR_ILLEGAL_ARGUMENT;
+    }
+    *pCO = NULL;
+
 #ifdef CO_USE_GLOBALS
+    if(ownOD || CO_globalODused){
+        return CO_ERROR_ILLEGAL_ARGUMENT;
+    }
+    CO_globalODused = true;
     CO = &COO;
 
     CO->CANmodule[0]                    = &COO_CANmodule;
-    CO_CANmodule_rxArray0               = &COO_CANmodule_rxArray0[0];
-    CO_CANmodule_txArray0               = &COO_CANmodule_txArray0[0];
+    CO->CANmodule_rxArray0              = &COO_CANmodule_rxArray0[0];
+    CO->CANmodule_txArray0              = &COO_CANmodule_txArray0[0];
     for(i=0; i<CO_NO_SDO_SERVER; i++)
         CO->SDO[i]                      = &COO_SDO[i];
-    CO_SDO_ODExtensions                 = &COO_SDO_ODExtensions[0];
+    CO->ODExtensions                    = &COO_SDO_ODExtensions[0];
+    CO->ODindex                         = &COO_SDO_ODindex[0];
     CO->em                              = &COO_EM;
     CO->emPr                            = &COO_EMpr;
     CO->NMT                             = &COO_NMT;
@@ -284,94 +422,138 @@ CO_ReturnError_t CO_init(
     for(i=0; i<CO_NO_TPDO; i++)
         CO->TPDO[i]                     = &COO_TPDO[i];
     CO->HBcons                          = &COO_HBcons;
-    CO_HBcons_monitoredNodes            = &COO_HBcons_monitoredNodes[0];
+    CO->HBcons_monitoredNodes           = &COO_HBcons_monitoredNodes[0];
+    CO->tmrMain                         = &COO_tmrMain;
+    CO->tmrRT                           = &COO_tmrRT;
   #if CO_NO_SDO_CLIENT == 1
     CO->SDOclient                       = &COO_SDOclient;
   #endif
+  #if CO_CONFIG_PROFILE
+    CO->prof                            = &COO_prof;
+  #endif
   #if CO_NO_TRACE > 0
     for(i=0; i<CO_NO_TRACE; i++) {
         CO->trace[i]                    = &COO_trace[i];
-        CO_traceTimeBuffers[i]          = &COO_traceTimeBuffers[i][0];
-        CO_traceValueBuffers[i]         = &COO_traceValueBuffers[i][0];
-        CO_traceBufferSize[i]           = CO_TRACE_BUFFER_SIZE_FIXED;
+        CO->traceTimeBuffers[i]         = &COO_traceTimeBuffers[i][0];
+        CO->traceValueBuffers[i]        = &COO_traceValueBuffers[i][0];
+        CO->traceBufferSize[i]          = CO_TRACE_BUFFER_SIZE_FIXED;
     }
   #endif
+    CO->OD = &CO_OD[0];
+    CO->ODRAM = &CO_OD_RAM;
+    CO->ODEEPROM = &CO_OD_EEPROM;
+    CO->ODROM = &CO_OD_ROM;
 #else
 
-    if(CO == NULL){    /* Use malloc only once */
-        CO = &COO;
-        CO->CANmodule[0]                    = (CO_CANmodule_t *)    calloc(1, sizeof(CO_CANmodule_t));
-        CO_CANmodule_rxArray0               = (CO_CANrx_t *)        calloc(CO_RXCAN_NO_MSGS, sizeof(CO_CANrx_t));
-        CO_CANmodule_txArray0               = (CO_CANtx_t *)        calloc(CO_TXCAN_NO_MSGS, sizeof(CO_CANtx_t));
-
-        for(i=0; i<CO_NO_SDO_SERVER; i++){
-            CO->SDO[i]                      = (CO_SDO_t *)          calloc(1, sizeof(CO_SDO_t));
-        }
-
-        CO_SDO_ODExtensions                 = (CO_OD_extension_t*)  calloc(CO_OD_NoOfElements, sizeof(CO_OD_extension_t));
-        CO->em                              = (CO_EM_t *)           calloc(1, sizeof(CO_EM_t));
+    if(!ownOD && CO_globalODused){
+        if(LEVEL_1){sprintf(logLine,
+                "FILE: CANopen.c"
+                "||CALL: CO_new"
+                "\nMSG: global Object Dictionary is already used by other object"); logPrint(ERROR,logLine);}
+        return CO_ERROR_ILLEGAL_ARGUMENT;
+    }
 
-        CO->emPr                            = (CO_EMpr_t*)         calloc(1, sizeof(CO_EMpr_t));
+    CO = (CO_t *) calloc(1, sizeof(CO_t));
+    if(CO == NULL){
+        return CO_ERROR_OUT_OF_MEMORY;
+    }
 
-        CO->NMT                             = (CO_NMT_t *)          calloc(1, sizeof(CO_NMT_t));
-        CO->SYNC                            = (CO_SYNC_t *)         calloc(1, sizeof(CO_SYNC_t));
-        for(i=0; i<CO_NO_RPDO; i++){
-            CO->RPDO[i]                     = (CO_RPDO_t *)         calloc(1, sizeof(CO_RPDO_t));
-        }
-        for(i=0; i<CO_NO_TPDO; i++){
-            CO->TPDO[i]                     = (CO_TPDO_t *)         calloc(1, sizeof(CO_TPDO_t));
+    /* Object Dictionary first, trace buffers depend on it */
+    if(ownOD){
+        if(CO_ODcopy(CO) != CO_ERROR_NO){
+            CO_free(CO);
+            return CO_ERROR_OUT_OF_MEMORY;
         }
-        CO->HBcons                          = (CO_HBconsumer_t *)   calloc(1, sizeof(CO_HBconsumer_t));
-        CO_HBcons_monitoredNodes            = (CO_HBconsNode_t *)   calloc(CO_NO_HB_CONS, sizeof(CO_HBconsNode_t));
-      #if CO_NO_SDO_CLIENT == 1
-        CO->SDOclient                       = (CO_SDOclient_t *)    calloc(1, sizeof(CO_SDOclient_t));
-      #endif
-      #if CO_NO_TRACE > 0
-        for(i=0; i<CO_NO_TRACE; i++) {
-            CO->trace[i]                    = (CO_trace_t *)        calloc(1, sizeof(CO_trace_t));
-            CO_traceTimeBuffers[i]          = (uint32_t *)          calloc(OD_traceConfig[i].size, sizeof(uint32_t));
-            CO_traceValueBuffers[i]         = (int32_t *)           calloc(OD_traceConfig[i].size, sizeof(int32_t));
-            if(CO_traceTimeBuffers[i] != NULL && CO_traceValueBuffers[i] != NULL) {
-                CO_traceBufferSize[i] = OD_traceConfig[i].size;
-            } else {
-                CO_traceBufferSize[i] = 0;
-            }
+    }
+    else{
+        CO_globalODused = true;
+        CO->OD = &CO_OD[0];
+        CO->ODRAM = &CO_OD_RAM;
+        CO->ODEEPROM = &CO_OD_EEPROM;
+        CO->ODROM = &CO_OD_ROM;
+    }
+
+    CO->CANmodule[0]                    = (CO_CANmodule_t *)    calloc(1, sizeof(CO_CANmodule_t));
+    CO->CANmodule_rxArray0              = (CO_CANrx_t *)        calloc(CO_RXCAN_NO_MSGS, sizeof(CO_CANrx_t));
+    CO->CANmodule_txArray0              = (CO_CANtx_t *)        calloc(CO_TXCAN_NO_MSGS, sizeof(CO_CANtx_t));
+    for(i=0; i<CO_NO_SDO_SERVER; i++){
+        CO->SDO[i]                      = (CO_SDO_t *)          CO_callocAligned(1, sizeof(CO_SDO_t));
+    }
+    CO->ODExtensions                    = (CO_OD_extension_t*)  calloc(CO_OD_NoOfElements, sizeof(CO_OD_extension_t));
+    CO->ODindex                         = (uint16_t *)          malloc(CO_OD_INDEX_TABLE_SIZE * sizeof(uint16_t));
+    CO->em                              = (CO_EM_t *)           calloc(1, sizeof(CO_EM_t));
+    CO->emPr                            = (CO_EMpr_t*)          calloc(1, sizeof(CO_EMpr_t));
+    CO->NMT                             = (CO_NMT_t *)          calloc(1, sizeof(CO_NMT_t));
+    CO->SYNC                            = (CO_SYNC_t *)         CO_callocAligned(1, sizeof(CO_SYNC_t));
+    for(i=0; i<CO_NO_RPDO; i++){
+        CO->RPDO[i]                     = (CO_RPDO_t *)         CO_callocAligned(1, sizeof(CO_RPDO_t));
+    }
+    for(i=0; i<CO_NO_TPDO; i++){
+        CO->TPDO[i]                     = (CO_TPDO_t *)         CO_callocAligned(1, sizeof(CO_TPDO_t));
+    }
+    CO->HBcons                          = (CO_HBconsumer_t *)   calloc(1, sizeof(CO_HBconsumer_t));
+    CO->HBcons_monitoredNodes           = (CO_HBconsNode_t *)   CO_callocAligned(CO_NO_HB_CONS, sizeof(CO_HBconsNode_t));
+    CO->tmrMain                         = (CO_tmrWheel_t *)     calloc(1, sizeof(CO_tmrWheel_t));
+    CO->tmrRT                           = (CO_tmrWheel_t *)     calloc(1, sizeof(CO_tmrWheel_t));
+  #if CO_NO_SDO_CLIENT == 1
+    CO->SDOclient                       = (CO_SDOclient_t *)    calloc(1, sizeof(CO_SDOclient_t));
+  #endif
+  #if CO_CONFIG_PROFILE
+    CO->prof                            = (CO_prof_t *)         calloc(1, sizeof(CO_prof_t));
+  #endif
+  #if CO_NO_TRACE > 0
+    for(i=0; i<CO_NO_TRACE; i++) {
+        uint32_t size = CO_ODvar(CO, OD_traceConfig)[i].size;
+
+        CO->trace[i]                    = (CO_trace_t *)        calloc(1, sizeof(CO_trace_t));
+        CO->traceTimeBuffers[i]         = (uint32_t *)          calloc(size, sizeof(uint32_t));
+        CO->traceValueBuffers[i]        = (int32_t *)           calloc(size, sizeof(int32_t));
+        if(CO->traceTimeBuffers[i] != NULL && CO->traceValueBuffers[i] != NULL) {
+            CO->traceBufferSize[i] = size;
+        } else {
+            CO->traceBufferSize[i] = 0;
         }
-      #endif
-    }
-
-    CO_memoryUsed = sizeof(CO_CANmodule_t)
-                  + sizeof(CO_CANrx_t) * CO_RXCAN_NO_MSGS
-                  + sizeof(CO_CANtx_t) * CO_TXCAN_NO_MSGS
-                  + sizeof(CO_SDO_t) * CO_NO_SDO_SERVER
-                  + sizeof(CO_OD_extension_t) * CO_OD_NoOfElements
-                  + sizeof(CO_EM_t)
-                  + sizeof(CO_EMpr_t)
-                  + sizeof(CO_NMT_t)
-                  + sizeof(CO_SYNC_t)
-                  + sizeof(CO_RPDO_t) * CO_NO_RPDO
-                  + sizeof(CO_TPDO_t) * CO_NO_TPDO
-                  + sizeof(CO_HBconsumer_t)
-                  + sizeof(CO_HBconsNode_t) * CO_NO_HB_CONS
+    }
+  #endif
+
+    CO->memoryUsed += sizeof(CO_t)
+                    + sizeof(CO_CANmodule_t)
+                    + sizeof(CO_CANrx_t) * CO_RXCAN_NO_MSGS
+                    + sizeof(CO_CANtx_t) * CO_TXCAN_NO_MSGS
+                    + sizeof(CO_SDO_t) * CO_NO_SDO_SERVER
+                    + sizeof(CO_OD_extension_t) * CO_OD_NoOfElements
+                    + sizeof(CO_EM_t)
+                    + sizeof(CO_EMpr_t)
+                    + sizeof(CO_NMT_t)
+                    + sizeof(CO_SYNC_t)
+                    + sizeof(CO_RPDO_t) * CO_NO_RPDO
+                    + sizeof(CO_TPDO_t) * CO_NO_TPDO
+                    + sizeof(CO_HBconsumer_t)
+                    + sizeof(CO_HBconsNode_t) * CO_NO_HB_CONS
+                    + sizeof(CO_tmrWheel_t) * 2
   #if CO_NO_SDO_CLIENT == 1
-                  + sizeof(CO_SDOclient_t)
+                    + sizeof(CO_SDOclient_t)
+  #endif
+  #if CO_CONFIG_PROFILE
+                    + sizeof(CO_prof_t)
   #endif
-                  + 0;
+                    + 0;
   #if CO_NO_TRACE > 0
-    CO_memoryUsed += sizeof(CO_trace_t) * CO_NO_TRACE;
+    CO->memoryUsed += sizeof(CO_trace_t) * CO_NO_TRACE;
     for(i=0; i<CO_NO_TRACE; i++) {
-        CO_memoryUsed += CO_traceBufferSize[i] * 8;
+        CO->memoryUsed += CO->traceBufferSize[i] * 8;
     }
   #endif
 
     errCnt = 0;
     if(CO->CANmodule[0]                 == NULL) errCnt++;
-    if(CO_CANmodule_rxArray0            == NULL) errCnt++;
-    if(CO_CANmodule_txArray0            == NULL) errCnt++;
+    if(CO->CANmodule_rxArray0           == NULL) errCnt++;
+    if(CO->CANmodule_txArray0           == NULL) errCnt++;
     for(i=0; i<CO_NO_SDO_SERVER; i++){
         if(CO->SDO[i]                   == NULL) errCnt++;
     }
-    if(CO_SDO_ODExtensions              == NULL) errCnt++;
+    if(CO->ODExtensions                 == NULL) errCnt++;
+    if(CO->ODindex                      == NULL) errCnt++;
     if(CO->em                           == NULL) errCnt++;
     if(CO->emPr                         == NULL) errCnt++;
     if(CO->NMT                          == NULL) errCnt++;
@@ -383,10 +565,15 @@ CO_ReturnError_t CO_init(
         if(CO->TPDO[i]                  == NULL) errCnt++;
     }
     if(CO->HBcons                       == NULL) errCnt++;
-    if(CO_HBcons_monitoredNodes         == NULL) errCnt++;
+    if(CO->HBcons_monitoredNodes        == NULL) errCnt++;
+    if(CO->tmrMain                      == NULL) errCnt++;
+    if(CO->tmrRT                        == NULL) errCnt++;
   #if CO_NO_SDO_CLIENT == 1
     if(CO->SDOclient                    == NULL) errCnt++;
   #endif
+  #if CO_CONFIG_PROFILE
+    if(CO->prof                         == NULL) errCnt++;
+  #endif
   #if CO_NO_TRACE > 0
     for(i=0; i<CO_NO_TRACE; i++) {
         if(CO->trace[i]                 == NULL) errCnt++;
@@ -397,16 +584,117 @@ CO_ReturnError_t CO_init(
     {
     	if(LEVEL_1){sprintf(logLine,
     	        			"FILE: CANopen.c"
-    	        			"||CALL: CO_init"
+    	        			"||CALL: CO_new"
     	        			"\nMSG:can open object cannot be allocated. Out of memory"); logPrint(ERROR,logLine);}
+        CO_free(CO);
     	return CO_ERROR_OUT_OF_MEMORY;
     }
 #endif
 
+    *pCO = CO;
+    return CO_ERROR_NO;
+}
+
+
+/* Apply PDO rate groups after PDO objects are initialized. */
+static void CO_PDOgroups_init(CO_t *CO){
+    int16_t i;
+
+    memset(CO->RPDOpending, 0, sizeof(CO->RPDOpending));
+    memset(CO->RPDOgroupMask, 0, sizeof(CO->RPDOgroupMask));
+    memset(CO->RPDOgroupNext, 0, sizeof(CO->RPDOgroupNext));
+    CO->RPDOtime = 0;
+    CO->RPDOgroupsArmed = 0;
+
+    for(i=0; i<CO_NO_RPDO; i++){
+        uint32_t mask = (uint32_t)1 << (i % 32);
+
+        CO->RPDOgroupMask[CO->RPDOgroup[i]][i / 32] |= mask;
+        CO->RPDO[i]->pending = &CO->RPDOpending[i / 32];
+        CO->RPDO[i]->pendingMask = mask;
+    }
+    for(i=0; i<CO_NO_TPDO; i++){
+        uint8_t group = CO->TPDOgroup[i];
+
+        CO->TPDO[i]->cosPoll_us = (group == 0) ? CO_TPDO_COS_POLL_US : CO->PDOgroupPeriod_us[group];
+    }
+}
+
+
+/******************************************************************************/
+CO_ReturnError_t CO_init(
+        CO_t                   *CO,
+        int32_t                 CANbaseAddress,
+        uint8_t                 nodeId,
+        uint16_t                bitRate)
+{
+
+	if(LEVEL_1){sprintf(logLine,
+			"FILE: CANopen.c"
+			"||CALL: CO_init"
+			"\nMSG: started"); logPrint(LOG,logLine);}
+
+	if(LEVEL_1){sprintf(logLine,
+						    	"FILE: CANopen.c"
+						    	"||CALL: CO_init"
+						    	"\nMSG: canopen init started"); logPrint(LOG,logLine);}
+	 //karthik did this
+	   CO_SDOclientPar_t OD_SDOClientParameter[1];
+	   OD_SDOClientParameter[0].COB_IDClientToServer=0x600;
+	   OD_SDOClientParameter[0].COB_IDServerToClient=0x580;
+	   OD_SDOClientParameter[0].maxSubIndex=3;
+	   OD_SDOClientParameter[0].nodeIDOfTheSDOServer=1;
+
+
+    int16_t i;
+    CO_ReturnError_t err;
+
+    if(CO == NULL){
+        return CO_ERROR_ILLEGAL_ARGUMENT;
+    }
+
+    /* Verify parameters from CO_OD */
+    if(LEVEL_1){sprintf(logLine,
+        			"FILE: CANopen.c"
+        			"||CALL: CO_init"
+        			"\nMSG: Parmeter verification started"); logPrint(LOG,logLine);}
+
+    if(   sizeof(OD_TPDOCommunicationParameter_t) != sizeof(CO_TPDOCommPar_t)
+       || sizeof(OD_TPDOMappingParameter_t) != sizeof(CO_TPDOMapPar_t)
+       || sizeof(OD_RPDOCommunicationParameter_t) != sizeof(CO_RPDOCommPar_t)
+       || sizeof(OD_RPDOMappingParameter_t) != sizeof(CO_RPDOMapPar_t))
+    {
+    	if(LEVEL_1){sprintf(logLine,
+    			"FILE: CANopen.c"
+    			"||CALL: CO_init"
+    			"\nMSG: Parameter verification failed"
+    			"PARAMETER ERROR"); logPrint(ERROR,logLine);}
+        return CO_ERROR_PARAMETERS;
+    }
 
-    CO->CANmodule[0]->CANnormal = false;
+    #if CO_NO_SDO_CLIENT == 1
+    // if(sizeof(OD_SDOClientParameter_t) != sizeof(CO_SDOclientPar_t)){
+    //karthik changed: removed _t     OD_SDOClientParameter_t   to 		sOD_SDOClientParameter
+    if(sizeof(OD_SDOClientParameter) != sizeof(CO_SDOclientPar_t)){
+    	if(LEVEL_1){sprintf(logLine,
+    	    			"FILE: CANopen.c"
+    	    			"||CALL: CO_init"
+    	    			"\nMSG: size of SDO client does not match"
+    	    			"PARAMETER ERROR"); logPrint(ERROR,logLine);}
+        return CO_ERROR_PARAMETERS;
+    }
+    #endif
+
+
+    CO_FLAG_CLEAR(CO->CANmodule[0]->CANnormal);
     CO_CANsetConfigurationMode(CANbaseAddress);
 
+    /* Timers of all objects start again, first CO_process_TPDO() processes all TPDOs */
+    CO_tmrWheel_init(CO->tmrMain);
+    CO_tmrWheel_init(CO->tmrRT);
+    CO->TPDOoperatingState = CO_NMT_INITIALIZING;
+    CO->TPDOrestart = 1;
+
     /* Verify CANopen Node-ID */
     if(LEVEL_1){sprintf(logLine,
             			"FILE: CANopen.c"
@@ -419,7 +707,6 @@ CO_ReturnError_t CO_init(
     	            			"FILE: CANopen.c"
     	            			"||CALL: CO_init"
     	            			"\nMSG: Node id is outside the range of 1-127"); logPrint(ERROR,logLine);}
-        CO_delete(CANbaseAddress);
         return CO_ERROR_PARAMETERS;
     }
 
@@ -430,9 +717,9 @@ CO_ReturnError_t CO_init(
     err = CO_CANmodule_init(
             CO->CANmodule[0],
             CANbaseAddress,
-            CO_CANmodule_rxArray0,
+            CO->CANmodule_rxArray0,
             CO_RXCAN_NO_MSGS,
-            CO_CANmodule_txArray0,
+            CO->CANmodule_txArray0,
             CO_TXCAN_NO_MSGS,
             bitRate);
 
@@ -441,8 +728,6 @@ CO_ReturnError_t CO_init(
     			"FILE: CANopen.c"
     			"||CALL: CO_init"
     			"\nMSG: Init CAN module failed. error code=%d",err); logPrint(ERROR,logLine);}
-
-    	CO_delete(CANbaseAddress);
     	return err;}
 
     if(LEVEL_1){sprintf(logLine,
@@ -467,8 +752,8 @@ CO_ReturnError_t CO_init(
         			"FILE: CANopen.c"
         			"||CALL: CO_init"
         			"\nMSG: Take COBID from SDO server parameter array for SDO server communication"); logPrint(LOG,logLine);}
-            COB_IDClientToServer = OD_SDOServerParameter[i].COB_IDClientToServer;
-            COB_IDServerToClient = OD_SDOServerParameter[i].COB_IDServerToClient;
+            COB_IDClientToServer = CO_ODvar(CO, OD_SDOServerParameter)[i].COB_IDClientToServer;
+            COB_IDServerToClient = CO_ODvar(CO, OD_SDOServerParameter)[i].COB_IDServerToClient;
         }
         if(LEVEL_1){sprintf(logLine,
         		"FILE: CANopen.c"
@@ -481,9 +766,10 @@ CO_ReturnError_t CO_init(
                 COB_IDServerToClient,
                 OD_H1200_SDO_SERVER_PARAM+i,
                 i==0 ? 0 : CO->SDO[0],
-               &CO_OD[0],
+                CO->OD,
                 CO_OD_NoOfElements,
-                CO_SDO_ODExtensions,
+                CO->ODExtensions,
+                CO->ODindex,
                 nodeId,
                 CO->CANmodule[0],
                 CO_RXCAN_SDO_SRV+i,
@@ -496,7 +782,13 @@ CO_ReturnError_t CO_init(
         		"FILE: CANopen.c"
         		"||CALL: CO_init"
         		"\nMSG: SDO server init failed. Error code=%d",err); logPrint(ERROR,logLine);}
-    	CO_delete(CANbaseAddress); return err;}
+    	return err;}
+
+    /* log levels may already be set from CO_LOG_LEVEL, mirror them into OD */
+    for(i=0; i<ODL_logLevel_arrayLength && i<LOG_MOD_COUNT; i++){
+        CO_ODvar(CO, OD_logLevel)[i] = logGetModuleLevel(i);
+    }
+    CO_OD_configure(CO->SDO[0], 0x2140, CO_ODF_2140, NULL, 0, 0);
 
     if(LEVEL_1){sprintf(logLine,
     		"FILE: CANopen.c"
@@ -507,10 +799,10 @@ CO_ReturnError_t CO_init(
             CO->em,
             CO->emPr,
             CO->SDO[0],
-           &OD_errorStatusBits[0],
+           &CO_ODvar(CO, OD_errorStatusBits)[0],
             ODL_errorStatusBits_stringLength,
-           &OD_errorRegister,
-           &OD_preDefinedErrorField[0],
+           &CO_ODvar(CO, OD_errorRegister),
+           &CO_ODvar(CO, OD_preDefinedErrorField)[0],
             ODL_preDefinedErrorField_arrayLength,
             CO->CANmodule[0],
             CO_TXCAN_EMERG,
@@ -522,7 +814,7 @@ CO_ReturnError_t CO_init(
     	    		"||CALL: CO_init"
     	    		"\nMSG: Emergency object init failed.Error code=%d",err); logPrint(ERROR,logLine);}
 
-    	CO_delete(CANbaseAddress); return err;}
+    	return err;}
 
     if(LEVEL_1){sprintf(logLine,
         		"FILE: CANopen.c"
@@ -547,11 +839,11 @@ CO_ReturnError_t CO_init(
     	    		"||CALL: CO_init"
     	    		"\nMSG: NMT object init failed.Error code=%d",err); logPrint(ERROR,logLine);}
 
-    	CO_delete(CANbaseAddress); return err;}
+    	return err;}
 
 
 #if CO_NO_NMT_MASTER == 1
-    NMTM_txBuff = CO_CANtxBufferInit(/* return pointer to 8-byte CAN data buffer, which should be populated */
+    CO->NMTM_txBuff = CO_CANtxBufferInit(/* return pointer to 8-byte CAN data buffer, which should be populated */
             CO->CANmodule[0], /* pointer to CAN module used for sending this message */
             CO_TXCAN_NMT,     /* index of specific buffer inside CAN module */
             0x0000,           /* CAN identifier */
@@ -570,9 +862,9 @@ CO_ReturnError_t CO_init(
             CO->em,
             CO->SDO[0],
            &CO->NMT->operatingState,
-            OD_COB_ID_SYNCMessage,
-            OD_communicationCyclePeriod,
-            OD_synchronousCounterOverflowValue,
+            CO_ODvar(CO, OD_COB_ID_SYNCMessage),
+            CO_ODvar(CO, OD_communicationCyclePeriod),
+            CO_ODvar(CO, OD_synchronousCounterOverflowValue),
             CO->CANmodule[0],
             CO_RXCAN_SYNC,
             CO->CANmodule[0],
@@ -583,7 +875,7 @@ CO_ReturnError_t CO_init(
     			"FILE: CANopen.c"
     			"||CALL: CO_init"
     			"\nMSG: SYNC object init failed.Error code=%d",err); logPrint(ERROR,logLine);}
-    	CO_delete(CANbaseAddress); return err;}
+    	return err;}
 
     if(LEVEL_1){sprintf(logLine,
         		"FILE: CANopen.c"
@@ -603,8 +895,8 @@ CO_ReturnError_t CO_init(
                 nodeId,
                 ((i<4) ? (CO_CAN_ID_RPDO_1+i*0x100) : 0),
                 0,
-                (CO_RPDOCommPar_t*) &OD_RPDOCommunicationParameter[i],
-                (CO_RPDOMapPar_t*) &OD_RPDOMappingParameter[i],
+                (CO_RPDOCommPar_t*) &CO_ODvar(CO, OD_RPDOCommunicationParameter)[i],
+                (CO_RPDOMapPar_t*) &CO_ODvar(CO, OD_RPDOMappingParameter)[i],
                 OD_H1400_RXPDO_1_PARAM+i,
                 OD_H1600_RXPDO_1_MAPPING+i,
                 CANdevRx,
@@ -615,7 +907,7 @@ CO_ReturnError_t CO_init(
         			"FILE: CANopen.c"
         			"||CALL: CO_init"
         			"\nMSG: RPDO object init failed.Error code=%d",err); logPrint(ERROR,logLine);}
-        	CO_delete(CANbaseAddress); return err;}
+        	return err;}
     }
 
     if(LEVEL_1){sprintf(logLine,
@@ -632,20 +924,22 @@ CO_ReturnError_t CO_init(
                 nodeId,
                 ((i<4) ? (CO_CAN_ID_TPDO_1+i*0x100) : 0),
                 0,
-                (CO_TPDOCommPar_t*) &OD_TPDOCommunicationParameter[i],
-                (CO_TPDOMapPar_t*) &OD_TPDOMappingParameter[i],
+                (CO_TPDOCommPar_t*) &CO_ODvar(CO, OD_TPDOCommunicationParameter)[i],
+                (CO_TPDOMapPar_t*) &CO_ODvar(CO, OD_TPDOMappingParameter)[i],
                 OD_H1800_TXPDO_1_PARAM+i,
                 OD_H1A00_TXPDO_1_MAPPING+i,
                 CO->CANmodule[0],
-                CO_TXCAN_TPDO+i);
+                CO_TXCAN_TPDO+i,
+                CO->tmrRT);
 
         if(err){
         	if(LEVEL_1){sprintf(logLine,
         			"FILE: CANopen.c"
         			"||CALL: CO_init"
         			"\nMSG: TPDO object init failed.Error code=%d",err); logPrint(ERROR,logLine);}
-        	CO_delete(CANbaseAddress); return err;}
+        	return err;}
     }
+    CO_PDOgroups_init(CO);
 
     if(LEVEL_1){sprintf(logLine,
         		"FILE: CANopen.c"
@@ -656,18 +950,19 @@ CO_ReturnError_t CO_init(
             CO->HBcons,
             CO->em,
             CO->SDO[0],
-           &OD_consumerHeartbeatTime[0],
-            CO_HBcons_monitoredNodes,
+           &CO_ODvar(CO, OD_consumerHeartbeatTime)[0],
+            CO->HBcons_monitoredNodes,
             CO_NO_HB_CONS,
             CO->CANmodule[0],
-            CO_RXCAN_CONS_HB);
+            CO_RXCAN_CONS_HB,
+            CO->tmrMain);
 
     if(err){
     	if(LEVEL_1){sprintf(logLine,
     			"FILE: CANopen.c"
     			"||CALL: CO_init"
     			"\nMSG: HB Consumer object init failed.Error code=%d",err); logPrint(ERROR,logLine);}
-    	CO_delete(CANbaseAddress); return err;}
+    	return err;}
 
 
 
@@ -692,7 +987,7 @@ CO_ReturnError_t CO_init(
     			"FILE: CANopen.c"
     			"||CALL: CO_init"
     			"\nMSG: SDO Client object init failed.Error code=%d",err); logPrint(ERROR,logLine);}
-    	CO_delete(CANbaseAddress); return err;}
+    	return err;}
 #endif
 
 
@@ -701,18 +996,18 @@ CO_ReturnError_t CO_init(
         CO_trace_init(
             CO->trace[i],
             CO->SDO[0],
-            OD_traceConfig[i].axisNo,
-            CO_traceTimeBuffers[i],
-            CO_traceValueBuffers[i],
-            CO_traceBufferSize[i],
-            &OD_traceConfig[i].map,
-            &OD_traceConfig[i].format,
-            &OD_traceConfig[i].trigger,
-            &OD_traceConfig[i].threshold,
-            &OD_trace[i].value,
-            &OD_trace[i].min,
-            &OD_trace[i].max,
-            &OD_trace[i].triggerTime,
+            CO_ODvar(CO, OD_traceConfig)[i].axisNo,
+            CO->traceTimeBuffers[i],
+            CO->traceValueBuffers[i],
+            CO->traceBufferSize[i],
+            &CO_ODvar(CO, OD_traceConfig)[i].map,
+            &CO_ODvar(CO, OD_traceConfig)[i].format,
+            &CO_ODvar(CO, OD_traceConfig)[i].trigger,
+            &CO_ODvar(CO, OD_traceConfig)[i].threshold,
+            &CO_ODvar(CO, OD_trace)[i].value,
+            &CO_ODvar(CO, OD_trace)[i].min,
+            &CO_ODvar(CO, OD_trace)[i].max,
+            &CO_ODvar(CO, OD_trace)[i].triggerTime,
             OD_INDEX_TRACE_CONFIG + i,
             OD_INDEX_TRACE + i);
     }
@@ -727,51 +1022,24 @@ CO_ReturnError_t CO_init(
 
 
 /******************************************************************************/
-void CO_delete(int32_t CANbaseAddress){
+void CO_delete(CO_t *CO, int32_t CANbaseAddress){
 
 	if(LEVEL_1){sprintf(logLine,
 			"FILE: CANopen.c"
 			"||CALL: CO_delete"
 			"\nMSG: started"); logPrint(LOG,logLine);}
 
-#ifndef CO_USE_GLOBALS
-    int16_t i;
-#endif
+    if(CO == NULL){
+        return;
+    }
 
     CO_CANsetConfigurationMode(CANbaseAddress);
     CO_CANmodule_disable(CO->CANmodule[0]);
 
-#ifndef CO_USE_GLOBALS
-  #if CO_NO_TRACE > 0
-      for(i=0; i<CO_NO_TRACE; i++) {
-          free(CO->trace[i]);
-          free(CO_traceTimeBuffers[i]);
-          free(CO_traceValueBuffers[i]);
-      }
-  #endif
-  #if CO_NO_SDO_CLIENT == 1
-    free(CO->SDOclient);
-  #endif
-    free(CO_HBcons_monitoredNodes);
-    free(CO->HBcons);
-    for(i=0; i<CO_NO_RPDO; i++){
-        free(CO->RPDO[i]);
-    }
-    for(i=0; i<CO_NO_TPDO; i++){
-        free(CO->TPDO[i]);
-    }
-    free(CO->SYNC);
-    free(CO->NMT);
-    free(CO->emPr);
-    free(CO->em);
-    free(CO_SDO_ODExtensions);
-    for(i=0; i<CO_NO_SDO_SERVER; i++){
-        free(CO->SDO[i]);
-    }
-    free(CO_CANmodule_txArray0);
-    free(CO_CANmodule_rxArray0);
-    free(CO->CANmodule[0]);
-    CO = NULL;
+#ifdef CO_USE_GLOBALS
+    CO_globalODused = false;
+#else
+    CO_free(CO);
 #endif
 }
 
@@ -780,7 +1048,7 @@ void CO_delete(int32_t CANbaseAddress){
 CO_NMT_reset_cmd_t CO_process(
         CO_t                   *CO,
         uint16_t                timeDifference_ms,
-        uint16_t               *timerNext_ms)
+        uint32_t               *timerNext_us)
 {
 	if(LEVEL_1){sprintf(logLine,
 			"FILE: CANopen.c"
@@ -789,71 +1057,198 @@ CO_NMT_reset_cmd_t CO_process(
     uint8_t i;
     bool_t NMTisPreOrOperational = false;
     CO_NMT_reset_cmd_t reset = CO_RESET_NOT;
-    static uint16_t ms50 = 0;
 
     if(CO->NMT->operatingState == CO_NMT_PRE_OPERATIONAL || CO->NMT->operatingState == CO_NMT_OPERATIONAL)
         NMTisPreOrOperational = true;
 
-    ms50 += timeDifference_ms;
-    if(ms50 >= 50){
-        ms50 -= 50;
+    /* Heartbeat consumer timeouts */
+    CO_tmrWheel_advance(CO->tmrMain, (uint32_t)timeDifference_ms * 1000U);
+
+#ifdef CO_USE_LEDS
+    CO->ms50 += timeDifference_ms;
+    if(CO->ms50 >= 50){
+        CO->ms50 -= 50;
         CO_NMT_blinkingProcess50ms(CO->NMT);
     }
-    if(timerNext_ms != NULL){
-        if(*timerNext_ms > 50){
-            *timerNext_ms = 50;
+    if(timerNext_us != NULL){
+        uint32_t diff = (uint32_t)(50 - CO->ms50) * 1000U;
+        if(*timerNext_us > diff){
+            *timerNext_us = diff;
         }
     }
+#endif
 
 
+    CO_PROF_BEGIN(tProf);
     for(i=0; i<CO_NO_SDO_SERVER; i++){
         CO_SDO_process(
                 CO->SDO[i],
                 NMTisPreOrOperational,
                 timeDifference_ms,
                 1000,
-                timerNext_ms);
+                timerNext_us);
     }
+    CO_PROF_STAGE(CO, CO_PROF_SDO, tProf);
 
     CO_EM_process(
             CO->emPr,
             NMTisPreOrOperational,
             timeDifference_ms * 10,
-            OD_inhibitTimeEMCY);
+            CO_ODvar(CO, OD_inhibitTimeEMCY),
+            timerNext_us);
+    CO_PROF_STAGE(CO, CO_PROF_EMCY, tProf);
 
 
     reset = CO_NMT_process(
             CO->NMT,
             timeDifference_ms,
-            OD_producerHeartbeatTime,
-            OD_NMTStartup,
-            OD_errorRegister,
-            OD_errorBehavior,
-            timerNext_ms);
+            CO_ODvar(CO, OD_producerHeartbeatTime),
+            CO_ODvar(CO, OD_NMTStartup),
+            CO_ODvar(CO, OD_errorRegister),
+            CO_ODvar(CO, OD_errorBehavior),
+            timerNext_us);
+    CO_PROF_STAGE(CO, CO_PROF_NMT, tProf);
 
 
     CO_HBconsumer_process(
             CO->HBcons,
-            NMTisPreOrOperational,
-            timeDifference_ms);
+            NMTisPreOrOperational);
+    CO_PROF_STAGE(CO, CO_PROF_HB_CONS, tProf);
+
+    if(timerNext_us != NULL){
+        *timerNext_us = CO_tmrWheel_next(CO->tmrMain, *timerNext_us);
+    }
 
     return reset;
 }
 
 
+/******************************************************************************/
+CO_NMT_reset_cmd_t CO_process_signaled(
+        CO_t                   *CO,
+        uint32_t                signals,
+        uint32_t               *timerNext_us)
+{
+    uint8_t i;
+    bool_t NMTisPreOrOperational = false;
+    CO_NMT_reset_cmd_t reset = CO_RESET_NOT;
+
+    if(CO->NMT->operatingState == CO_NMT_PRE_OPERATIONAL || CO->NMT->operatingState == CO_NMT_OPERATIONAL)
+        NMTisPreOrOperational = true;
+
+    CO_PROF_BEGIN(tProf);
+    if(signals & CO_SIGNAL_SDO){
+        for(i=0; i<CO_NO_SDO_SERVER; i++){
+            CO_SDO_process(
+                    CO->SDO[i],
+                    NMTisPreOrOperational,
+                    0,
+                    1000,
+                    timerNext_us);
+        }
+        /* SDO may have changed TPDO parameters, which are used by RT thread */
+        __atomic_store_n(&CO->TPDOrestart, 1, __ATOMIC_RELEASE);
+        CO_PROF_STAGE(CO, CO_PROF_SDO, tProf);
+    }
+
+    if(signals & CO_SIGNAL_EMCY){
+        CO_EM_process(
+                CO->emPr,
+                NMTisPreOrOperational,
+                0,
+                CO_ODvar(CO, OD_inhibitTimeEMCY),
+                timerNext_us);
+        CO_PROF_STAGE(CO, CO_PROF_EMCY, tProf);
+    }
+
+    /* Reset command from NMT master is returned without waiting for next cycle */
+    if(signals & CO_SIGNAL_NMT){
+        reset = CO_NMT_process(
+                CO->NMT,
+                0,
+                CO_ODvar(CO, OD_producerHeartbeatTime),
+                CO_ODvar(CO, OD_NMTStartup),
+                CO_ODvar(CO, OD_errorRegister),
+                CO_ODvar(CO, OD_errorBehavior),
+                timerNext_us);
+        CO_PROF_STAGE(CO, CO_PROF_NMT, tProf);
+    }
+
+    /* NMT state may have changed, Heartbeat consumer follows it immediately */
+    if(signals & (CO_SIGNAL_HB_CONSUMER | CO_SIGNAL_NMT)){
+        NMTisPreOrOperational = (CO->NMT->operatingState == CO_NMT_PRE_OPERATIONAL
+                              || CO->NMT->operatingState == CO_NMT_OPERATIONAL);
+        CO_HBconsumer_process(
+                CO->HBcons,
+                NMTisPreOrOperational);
+        CO_PROF_STAGE(CO, CO_PROF_HB_CONS, tProf);
+    }
+
+    if(timerNext_us != NULL){
+        *timerNext_us = CO_tmrWheel_next(CO->tmrMain, *timerNext_us);
+    }
+
+    return reset;
+}
+
+
+/* Process RPDO, whose pending bit was taken. Message, which was not copied,
+ * while mainline wrote Object Dictionary, stays pending. */
+static void CO_RPDO_processPending(CO_RPDO_t *RPDO, bool_t syncWas){
+    CO_RPDO_process(RPDO, syncWas);
+    if(!RPDO->synchronous && CO_FLAG_READ(RPDO->CANrxNew[0])){
+        __atomic_fetch_or(RPDO->pending, RPDO->pendingMask, __ATOMIC_RELAXED);
+    }
+}
+
+
+/* Groups with RPDOs, which may be processed now: group 0, event-only groups
+ * and groups, whose period elapsed. */
+static uint32_t CO_RPDOgroupsDue(CO_t *CO){
+    uint32_t due = 1;
+    uint8_t g;
+
+    for(g=1; g<CO_PDO_GROUPS; g++){
+        if(CO->PDOgroupPeriod_us[g] == 0 || CO->RPDOtime >= CO->RPDOgroupNext[g]){
+            due |= (uint32_t)1 << g;
+        }
+    }
+    return due;
+}
+
+
+/* Bits of RPDOs in groups. */
+static uint32_t CO_RPDOgroupsMask(CO_t *CO, uint32_t groups, uint16_t word){
+    uint32_t mask = 0;
+    uint8_t g;
+
+    for(g=0; g<CO_PDO_GROUPS; g++){
+        if(groups & ((uint32_t)1 << g)){
+            mask |= CO->RPDOgroupMask[g][word];
+        }
+    }
+    return mask;
+}
+
+
 /******************************************************************************/
 bool_t CO_process_SYNC_RPDO(
         CO_t                   *CO,
-        uint32_t                timeDifference_us)
+        uint32_t                timeDifference_us,
+        uint32_t               *timerNext_us)
 {
 	if(LEVEL_1){sprintf(logLine,
 			"FILE: CANopen.c"
 			"||CALL: CO_process_SYNC_RPDO"
 			"\nMSG: started"); logPrint(LOG,logLine);}
     int16_t i;
+    uint16_t w;
+    uint8_t g;
+    uint32_t due;
     bool_t syncWas = false;
 
-    switch(CO_SYNC_process(CO->SYNC, timeDifference_us, OD_synchronousWindowLength)){
+    CO_PROF_BEGIN(tProf);
+    switch(CO_SYNC_process(CO->SYNC, timeDifference_us, CO_ODvar(CO, OD_synchronousWindowLength), timerNext_us)){
         case 1:     //immediately after the SYNC message
             syncWas = true;
             break;
@@ -861,20 +1256,98 @@ bool_t CO_process_SYNC_RPDO(
             CO_CANclearPendingSyncPDOs(CO->CANmodule[0]);
             break;
     }
+    CO_PROF_STAGE(CO, CO_PROF_SYNC, tProf);
 
-    for(i=0; i<CO_NO_RPDO; i++){
-        CO_RPDO_process(CO->RPDO[i], syncWas);
+    CO->RPDOtime += timeDifference_us;
+    if(syncWas){
+        /* Synchronous RPDOs take their data after SYNC, all are processed. */
+        for(w=0; w<CO_RPDO_PENDING_WORDS; w++){
+            (void)__atomic_exchange_n(&CO->RPDOpending[w], 0, __ATOMIC_ACQUIRE);
+        }
+        for(i=0; i<CO_NO_RPDO; i++){
+            CO_RPDO_processPending(CO->RPDO[i], syncWas);
+        }
+        due = (uint32_t)-1;
+    }
+    else{
+        /* Only received RPDOs of due groups */
+        due = CO_RPDOgroupsDue(CO);
+        for(w=0; w<CO_RPDO_PENDING_WORDS; w++){
+            uint32_t pending = __atomic_load_n(&CO->RPDOpending[w], __ATOMIC_RELAXED)
+                             & CO_RPDOgroupsMask(CO, due, w);
+
+            if(pending == 0){
+                continue;
+            }
+            pending &= __atomic_fetch_and(&CO->RPDOpending[w], ~pending, __ATOMIC_ACQUIRE);
+            while(pending != 0){
+                CO_RPDO_t *RPDO = CO->RPDO[w * 32U + (uint16_t)__builtin_ctz(pending)];
+
+                pending &= pending - 1U;
+                CO_RPDO_processPending(RPDO, false);
+            }
+        }
     }
 
+    /* Next processing of periodic groups on the grid of their period.
+     * Groups with received RPDOs wake the task then. */
+    CO->RPDOgroupsArmed = 0;
+    for(g=1; g<CO_PDO_GROUPS; g++){
+        uint32_t period = CO->PDOgroupPeriod_us[g];
+
+        if(period == 0){
+            continue;
+        }
+        if(due & ((uint32_t)1 << g)){
+            CO->RPDOgroupNext[g] = (CO->RPDOtime / period + 1U) * period;
+        }
+        if(timerNext_us != NULL){
+            for(w=0; w<CO_RPDO_PENDING_WORDS; w++){
+                if(__atomic_load_n(&CO->RPDOpending[w], __ATOMIC_RELAXED) & CO->RPDOgroupMask[g][w]){
+                    uint64_t diff = CO->RPDOgroupNext[g] - CO->RPDOtime;
+
+                    if(*timerNext_us > diff){
+                        *timerNext_us = (uint32_t)diff;
+                    }
+                    CO->RPDOgroupsArmed |= (uint32_t)1 << g;
+                    break;
+                }
+            }
+        }
+    }
+    CO_PROF_STAGE(CO, CO_PROF_RPDO, tProf);
+
     return syncWas;
 }
 
 
+/******************************************************************************/
+bool_t CO_process_RT_pending(CO_t *CO){
+    uint32_t wait;
+    uint16_t w;
+
+    if(CO_FLAG_READ(CO->SYNC->CANrxNew) || CO->SYNC->receiveError != 0U){
+        return true;
+    }
+    /* Groups, whose time is already in the timer, wait for it. */
+    wait = CO->RPDOgroupsArmed & ~CO_RPDOgroupsDue(CO);
+    for(w=0; w<CO_RPDO_PENDING_WORDS; w++){
+        uint32_t pending = __atomic_load_n(&CO->RPDOpending[w], __ATOMIC_ACQUIRE);
+
+        if((pending & ~CO_RPDOgroupsMask(CO, wait, w)) != 0){
+            return true;
+        }
+    }
+    return false;
+}
+
+
 /******************************************************************************/
 void CO_process_TPDO(
         CO_t                   *CO,
         bool_t                  syncWas,
-        uint32_t                timeDifference_us)
+        uint32_t                timeDifference_us,
+        uint32_t               *timerNext_us)
 {
 	if(LEVEL_1){sprintf(logLine,
 			"FILE: CANopen.c"
@@ -882,10 +1355,83 @@ void CO_process_TPDO(
 			"\nMSG: started"); logPrint(LOG,logLine);}
 
     int16_t i;
+    bool_t restart = false;
+
+    CO_PROF_BEGIN(tProf);
+    /* Configuration or NMT state may have changed, so all TPDOs are processed
+     * once and restart own timers. */
+    if(CO->TPDOoperatingState != CO->NMT->operatingState){
+        CO->TPDOoperatingState = CO->NMT->operatingState;
+        restart = true;
+    }
+    if(__atomic_exchange_n(&CO->TPDOrestart, 0, __ATOMIC_ACQUIRE) != 0){
+        restart = true;
+    }
+    if(restart){
+        uint8_t slowdown = (uint8_t)__atomic_load_n(&CO->TPDOslowdown, __ATOMIC_RELAXED);
 
-    /* Verify PDO Change Of State and process PDOs */
-    for(i=0; i<CO_NO_TPDO; i++){
-        if(!CO->TPDO[i]->sendRequest) CO->TPDO[i]->sendRequest = CO_TPDOisCOS(CO->TPDO[i]);
-        CO_TPDO_process(CO->TPDO[i], CO->SYNC, syncWas, timeDifference_us);
+        /* Event timer of changed TPDO starts again with the new rate. */
+        for(i=0; i<CO_NO_TPDO; i++){
+            if(CO->TPDO[i]->slowdown != slowdown){
+                CO->TPDO[i]->slowdown = slowdown;
+                CO->TPDO[i]->eventNext = 0;
+            }
+        }
     }
+
+    /* Asynchronous TPDOs with expired timer */
+    CO_tmrWheel_advance(CO->tmrRT, timeDifference_us);
+
+    /* Verify PDO Change Of State and process synchronous PDOs */
+    if(restart || syncWas){
+        for(i=0; i<CO_NO_TPDO; i++){
+            CO_TPDO_t *TPDO = CO->TPDO[i];
+
+            if(restart || TPDO->TPDOCommPar->transmissionType < 253){
+                if(!TPDO->sendRequest) TPDO->sendRequest = CO_TPDOisCOS(TPDO);
+                CO_TPDO_process(TPDO, CO->SYNC, syncWas);
+            }
+        }
+    }
+
+    if(timerNext_us != NULL){
+        *timerNext_us = CO_tmrWheel_next(CO->tmrRT, *timerNext_us);
+    }
+    CO_PROF_STAGE(CO, CO_PROF_TPDO, tProf);
+}
+
+
+/******************************************************************************/
+void CO_setTPDOslowdown(CO_t *CO, uint8_t slowdown){
+    if(slowdown > CO_TPDO_SLOWDOWN_MAX){
+        slowdown = CO_TPDO_SLOWDOWN_MAX;
+    }
+    if(__atomic_exchange_n(&CO->TPDOslowdown, slowdown, __ATOMIC_RELAXED) != slowdown){
+        __atomic_store_n(&CO->TPDOrestart, 1, __ATOMIC_RELEASE);
+    }
+}
+
+
+/******************************************************************************/
+CO_ReturnError_t CO_setPDOgroupPeriod(CO_t *CO, uint8_t group, uint32_t period_us){
+    if(CO == NULL || group == 0 || group >= CO_PDO_GROUPS){
+        return CO_ERROR_ILLEGAL_ARGUMENT;
+    }
+    CO->PDOgroupPeriod_us[group] = period_us;
+    return CO_ERROR_NO;
+}
+
+
+/******************************************************************************/
+CO_ReturnError_t CO_setPDOgroup(CO_t *CO, bool_t tpdo, uint16_t pdo, uint8_t group){
+    if(CO == NULL || group >= CO_PDO_GROUPS || pdo >= (tpdo ? CO_NO_TPDO : CO_NO_RPDO)){
+        return CO_ERROR_ILLEGAL_ARGUMENT;
+    }
+    if(tpdo){
+        CO->TPDOgroup[pdo] = group;
+    }
+    else{
+        CO->RPDOgroup[pdo] = group;
+    }
+    return CO_ERROR_NO;
 }
@@ -45,6 +45,8 @@
 
 
 
+#define LOG_MODULE LOG_MOD_EMCY   /* runtime log level tag, see Logger.h */
+
 #include "CO_SDO.h"
 #include "CO_Emergency.h"
 #include "Logger.h"
@@ -241,6 +243,7 @@ CO_ReturnError_t CO_EM_init(
     em->bufFull                 = 0U;
     em->wrongErrorReport        = 0U;
     em->pFunctSignal            = NULL;
+    em->CANdev                  = CANdev;
     emPr->em                    = em;
     emPr->errorRegister         = errorRegister;
     emPr->preDefErr             = preDefErr;
@@ -288,7 +291,8 @@ CO_ReturnError_t CO_EM_init(
 /******************************************************************************/
 void CO_EM_initCallback(
         CO_EM_t                *em,
-        void                  (*pFunctSignal)(void))
+        void                   *object,
+        void                  (*pFunctSignal)(void *object))
 {
     if(LEVEL_1){
       			 sprintf(logLine,"FILE:CO_Emergency.C||"
@@ -297,6 +301,7 @@ void CO_EM_initCallback(
       			 logPrint(LOG,logLine);}
 
     if(em != NULL){
+        em->functSignalObject = object;
         em->pFunctSignal = pFunctSignal;
     }
 }
@@ -307,7 +312,8 @@ void CO_EM_process(
         CO_EMpr_t              *emPr,
         bool_t                  NMTisPreOrOperational,
         uint16_t                timeDifference_100us,
-        uint16_t                emInhTime)
+        uint16_t                emInhTime,
+        uint32_t               *timerNext_us)
 {
 
 	 if(LEVEL_1){
@@ -359,7 +365,7 @@ void CO_EM_process(
 
     /* send Emergency message. */
     if(     NMTisPreOrOperational &&
-            !emPr->CANtxBuff->bufferFull &&
+            !CO_FLAG_READ(emPr->CANtxBuff->bufferFull) &&
             emPr->inhibitEmTimer >= emInhTime &&
             (em->bufReadPtr != em->bufWritePtr || em->bufFull))
     {
@@ -431,6 +437,19 @@ void CO_EM_process(
         CO_CANsend(emPr->CANdev, emPr->CANtxBuff);
     }
 
+    /* More messages are waiting, next one may be sent after inhibit time. */
+    if(     timerNext_us != NULL &&
+            NMTisPreOrOperational &&
+            !CO_FLAG_READ(emPr->CANtxBuff->bufferFull) &&
+            (em->bufReadPtr != em->bufWritePtr || em->bufFull))
+    {
+        uint32_t diff = (emPr->inhibitEmTimer < emInhTime) ?
+                (uint32_t)(emInhTime - emPr->inhibitEmTimer) * 100U : 0U;
+        if(*timerNext_us > diff){
+            *timerNext_us = diff;
+        }
+    }
+
     return;
 }
 
@@ -454,6 +473,11 @@ void CO_errorReport(CO_EM_t *em, const uint8_t errorBit, const uint16_t errorCod
 						 "Call: CO_errorReport"
 						 "\n, msg:check if em is Null");
 				 logPrint(LOG,logLine);}
+	if(LEVEL_1){
+				 sprintf(logLine,"FILE:CO_Emergency.C||"
+						 "Call: CO_errorReport"
+						 "\n, msg:check if Index > errorStatusBitSize");
+				 logPrint(LOG,logLine);}
 
     if(em == NULL){
     	if(LEVEL_1){
@@ -463,12 +487,6 @@ void CO_errorReport(CO_EM_t *em, const uint8_t errorBit, const uint16_t errorCod
     				 logPrint(ERROR,logLine);}
         sendEmergency = false;
     }
-	if(LEVEL_1){
-				 sprintf(logLine,"FILE:CO_Emergency.C||"
-						 "Call: CO_errorReport"
-						 "\n, msg:check if Index > errorStatusBitSize");
-				 logPrint(LOG,logLine);}
-
     else if(index >= em->errorStatusBitsSize){
         /* if errorBit value not supported, send emergency 'CO_EM_WRONG_ERROR_REPORT' */
 
@@ -510,17 +528,17 @@ void CO_errorReport(CO_EM_t *em, const uint8_t errorBit, const uint16_t errorCod
             CO_memcpySwap4(&bufCopy[4], &infoCode);
 
             /* copy data to the buffer, increment writePtr and verify buffer full */
-            CO_LOCK_EMCY();
+            CO_LOCK_EMCY(em->CANdev);
             CO_memcpy(em->bufWritePtr, &bufCopy[0], 8);
             em->bufWritePtr += 8;
 
             if(em->bufWritePtr == em->bufEnd) em->bufWritePtr = em->buf;
             if(em->bufWritePtr == em->bufReadPtr) em->bufFull = 1;
-            CO_UNLOCK_EMCY();
+            CO_UNLOCK_EMCY(em->CANdev);
 
             /* Optional signal to RTOS, which can resume task, which handles CO_EM_process */
             if(em->pFunctSignal != NULL) {
-                em->pFunctSignal();
+                em->pFunctSignal(em->functSignalObject);
             }
         }
     }
@@ -595,17 +613,17 @@ void CO_errorReset(CO_EM_t *em, const uint8_t errorBit, const uint32_t infoCode)
             CO_memcpySwap4(&bufCopy[4], &infoCode);
 
             /* copy data to the buffer, increment writePtr and verify buffer full */
-            CO_LOCK_EMCY();
+            CO_LOCK_EMCY(em->CANdev);
             CO_memcpy(em->bufWritePtr, &bufCopy[0], 8);
             em->bufWritePtr += 8;
 
             if(em->bufWritePtr == em->bufEnd) em->bufWritePtr = em->buf;
             if(em->bufWritePtr == em->bufReadPtr) em->bufFull = 1;
-            CO_UNLOCK_EMCY();
+            CO_UNLOCK_EMCY(em->CANdev);
 
             /* Optional signal to RTOS, which can resume task, which handles CO_EM_process */
             if(em->pFunctSignal != NULL) {
-                em->pFunctSignal();
+                em->pFunctSignal(em->functSignalObject);
             }
         }
     }
@@ -44,6 +44,8 @@
  */
 
 
+#define LOG_MODULE LOG_MOD_NMT   /* runtime log level tag, see Logger.h */
+
 #include "CO_driver.h"
 #include "CO_SDO.h"
 #include "CO_Emergency.h"
@@ -72,7 +74,38 @@ static void CO_HBcons_receive(void *object, const CO_CANrxMsg_t *msg){
     if(msg->DLC == 1){
         /* copy data and set 'new message' flag. */
         HBconsNode->NMTstate = msg->data[0];
-        HBconsNode->CANrxNew = true;
+        CO_FLAG_SET(HBconsNode->CANrxNew);
+        __atomic_fetch_or(HBconsNode->pending, HBconsNode->pendingMask, __ATOMIC_RELEASE);
+        if(HBconsNode->pFunctSignal != NULL) {
+            HBconsNode->pFunctSignal(HBconsNode->functSignalObject);
+        }
+    }
+}
+
+
+/*
+ * Heartbeat of monitored node is late. Timeout is reported by the next
+ * CO_HBconsumer_process().
+ */
+static void CO_HBcons_tmrExpired(void *object){
+    CO_HBconsNode_t *HBconsNode = (CO_HBconsNode_t*) object;
+
+    HBconsNode->timeout = true;
+    __atomic_fetch_or(HBconsNode->pending, HBconsNode->pendingMask, __ATOMIC_RELEASE);
+}
+
+
+/*
+ * Update allMonitoredOperational from counters.
+ */
+static void CO_HBcons_updateAllOperational(CO_HBconsumer_t *HBcons){
+    // HBcons->allMonitoredOperational is true only in case if all node under monitoring is operational.
+    //or no node is monitored by this node
+    if(HBcons->NMTisPreOrOperational && HBcons->operationalCount == HBcons->monitoredCount){
+        HBcons->allMonitoredOperational = 5;
+    }
+    else{
+        HBcons->allMonitoredOperational = 0;
     }
 }
 
@@ -107,9 +140,19 @@ static void CO_HBcons_monitoredNodeConfig(
 
     NodeID = (uint16_t)((HBconsTime>>16)&0xFF);
     monitoredNode = &HBcons->monitoredNodes[idx];
+
+    /* forget previous configuration */
+    CO_tmr_stop(HBcons->wheel, &monitoredNode->tmr);
+    if(monitoredNode->time) HBcons->monitoredCount--;
+    if(monitoredNode->operational) HBcons->operationalCount--;
+
     monitoredNode->time = (uint16_t)HBconsTime;
     monitoredNode->NMTstate = 0;
     monitoredNode->monStarted = false;
+    monitoredNode->timeout = false;
+    monitoredNode->operational = false;
+    monitoredNode->pFunctSignal = HBcons->pFunctSignal;
+    monitoredNode->functSignalObject = HBcons->functSignalObject;
 
     /* is channel used */
     if(LEVEL_1){sprintf(logLine,
@@ -128,6 +171,8 @@ static void CO_HBcons_monitoredNodeConfig(
         COB_ID = 0;
         monitoredNode->time = 0;
     }
+    if(monitoredNode->time) HBcons->monitoredCount++;
+    CO_HBcons_updateAllOperational(HBcons);
 
 	if(LEVEL_1){sprintf(logLine,
 			"FILE: CO_HBconsumer.c"
@@ -223,7 +268,8 @@ CO_ReturnError_t CO_HBconsumer_init(
         CO_HBconsNode_t         monitoredNodes[],
         uint8_t                 numberOfMonitoredNodes,
         CO_CANmodule_t         *CANdevRx,
-        uint16_t                CANdevRxIdxStart)
+        uint16_t                CANdevRxIdxStart,
+        CO_tmrWheel_t          *wheel)
 {
 	if(LEVEL_1){sprintf(logLine,
 			"FILE: CO_HBconsumer.c"
@@ -234,7 +280,7 @@ CO_ReturnError_t CO_HBconsumer_init(
 
     /* verify arguments */
     if(HBcons==NULL || em==NULL || SDO==NULL || HBconsTime==NULL ||
-        monitoredNodes==NULL || CANdevRx==NULL){
+        monitoredNodes==NULL || CANdevRx==NULL || wheel==NULL){
 
     	if(LEVEL_1){sprintf(logLine,
     			"FILE: CO_HBconsumer.c"
@@ -254,9 +300,26 @@ CO_ReturnError_t CO_HBconsumer_init(
     HBcons->allMonitoredOperational = 0;
     HBcons->CANdevRx = CANdevRx;
     HBcons->CANdevRxIdxStart = CANdevRxIdxStart;
+    HBcons->pFunctSignal = NULL;
+    HBcons->functSignalObject = NULL;
+    HBcons->wheel = wheel;
+    HBcons->monitoredCount = 0;
+    HBcons->operationalCount = 0;
+    HBcons->NMTisPreOrOperational = false;
+    for(i=0; i<CO_HB_CONS_PENDING_WORDS; i++)
+        HBcons->pending[i] = 0;
+
+    for(i=0; i<HBcons->numberOfMonitoredNodes; i++){
+        CO_HBconsNode_t *monitoredNode = &HBcons->monitoredNodes[i];
 
-    for(i=0; i<HBcons->numberOfMonitoredNodes; i++)
+        monitoredNode->time = 0;
+        monitoredNode->operational = false;
+        CO_FLAG_CLEAR(monitoredNode->CANrxNew);
+        monitoredNode->pending = &HBcons->pending[i / 32];
+        monitoredNode->pendingMask = (uint32_t)1 << (i % 32);
+        CO_tmr_init(&monitoredNode->tmr, (void*)monitoredNode, CO_HBcons_tmrExpired);
         CO_HBcons_monitoredNodeConfig(HBcons, i, HBcons->HBconsTime[i]);
+    }
 
 	if(LEVEL_1){sprintf(logLine,
 			"FILE: CO_HBconsumer.c"
@@ -270,11 +333,93 @@ CO_ReturnError_t CO_HBconsumer_init(
 }
 
 
+/******************************************************************************/
+void CO_HBconsumer_initCallback(
+        CO_HBconsumer_t        *HBcons,
+        void                   *object,
+        void                  (*pFunctSignal)(void *object))
+{
+    uint8_t i;
+
+    if(HBcons != NULL){
+        HBcons->functSignalObject = object;
+        HBcons->pFunctSignal = pFunctSignal;
+        for(i=0; i<HBcons->numberOfMonitoredNodes; i++){
+            HBcons->monitoredNodes[i].functSignalObject = object;
+            HBcons->monitoredNodes[i].pFunctSignal = pFunctSignal;
+        }
+    }
+}
+
+
+/*
+ * Process one monitored node, which received message or its timer expired.
+ */
+static void CO_HBcons_processNode(
+        CO_HBconsumer_t        *HBcons,
+        uint8_t                 idx,
+        bool_t                  NMTisPreOrOperational)
+{
+    CO_HBconsNode_t *monitoredNode = &HBcons->monitoredNodes[idx];
+    bool_t operational;
+
+    if(!NMTisPreOrOperational || monitoredNode->time == 0){
+        /* not monitored, message is ignored */
+        CO_FLAG_CLEAR(monitoredNode->CANrxNew);
+        monitoredNode->timeout = false;
+        return;
+    }
+
+    /* Verify if new Consumer Heartbeat message received */
+    if(CO_FLAG_READ(monitoredNode->CANrxNew)){
+        CO_FLAG_CLEAR(monitoredNode->CANrxNew);
+        if(monitoredNode->NMTstate){
+        	if(LEVEL_1){sprintf(logLine,
+        			"FILE: CO_HBconsumer.c"
+        			"||CALL: CO_HBcons_processNode"
+        			"\nMSG: New msg recved is HB msg"); logPrint(LOG,logLine);}
+            /* not a bootup message */
+            monitoredNode->monStarted = true;
+            monitoredNode->timeout = false;
+            CO_tmr_start(HBcons->wheel, &monitoredNode->tmr, (uint32_t)monitoredNode->time * 1000U);
+        }
+        else if(monitoredNode->monStarted && CO_tmr_isActive(&monitoredNode->tmr)){
+        	if(LEVEL_1){sprintf(logLine,
+        			"FILE: CO_HBconsumer.c"
+        			"||CALL: CO_HBcons_processNode"
+        			"\nMSG: There is a boot up message from the monitored node"); logPrint(LOG,logLine);}
+            /* there was a bootup message */
+            CO_errorReport(HBcons->em, CO_EM_HB_CONSUMER_REMOTE_RESET, CO_EMC_HEARTBEAT, idx);
+        }
+    }
+
+    /* Verify timeout */
+    if(monitoredNode->timeout){
+        monitoredNode->timeout = false;
+        if(monitoredNode->monStarted){
+        	if(LEVEL_1){sprintf(logLine,
+        			"FILE: CO_HBconsumer.c"
+        			"||CALL: CO_HBcons_processNode"
+        			"\nMSG: Monitored node TIMED OUT"); logPrint(LOG,logLine);}
+
+            CO_errorReport(HBcons->em, CO_EM_HEARTBEAT_CONSUMER, CO_EMC_HEARTBEAT, idx);
+            monitoredNode->NMTstate = 0;
+        }
+    }
+
+    operational = (monitoredNode->NMTstate == CO_NMT_OPERATIONAL);
+    if(operational != monitoredNode->operational){
+        monitoredNode->operational = operational;
+        if(operational) HBcons->operationalCount++;
+        else            HBcons->operationalCount--;
+    }
+}
+
+
 /******************************************************************************/
 void CO_HBconsumer_process(
         CO_HBconsumer_t        *HBcons,
-        bool_t                  NMTisPreOrOperational,
-        uint16_t                timeDifference_ms)
+        bool_t                  NMTisPreOrOperational)
 {
 	if(LEVEL_1){sprintf(logLine,
 			"FILE: CO_HBconsumer.c"
@@ -282,86 +427,46 @@ void CO_HBconsumer_process(
 			"\nMSG: started"); logPrint(LOG,logLine);}
 
     uint8_t i;
-    uint8_t AllMonitoredOperationalCopy;
-    CO_HBconsNode_t *monitoredNode;
 
-    AllMonitoredOperationalCopy = 5;
-    monitoredNode = &HBcons->monitoredNodes[0];
+    if(NMTisPreOrOperational != HBcons->NMTisPreOrOperational){
+        HBcons->NMTisPreOrOperational = NMTisPreOrOperational;
 
-    if(NMTisPreOrOperational){
-    	if(LEVEL_1){sprintf(logLine,
-    			"FILE: CO_HBconsumer.c"
-    			"||CALL: CO_HBconsumer_process"
-    			"\nMSG: HB consumer active. NMT state of this node is preOper or Oper"); logPrint(LOG,logLine);}
-
-        for(i=0; i<HBcons->numberOfMonitoredNodes; i++){
-            if(monitoredNode->time){/* is node monitored */ //Non zero time means that particular node is monitored
-                /* Verify if new Consumer Heartbeat message received */
-                if(monitoredNode->CANrxNew){
-                    if(monitoredNode->NMTstate){
-                    	if(LEVEL_1){sprintf(logLine,
-                    			"FILE: CO_HBconsumer.c"
-                    			"||CALL: CO_HBconsumer_process"
-                    			"\nMSG: New msg recved is HB msg"); logPrint(LOG,logLine);}
-                        /* not a bootup message */
-                        monitoredNode->monStarted = true;
-                        monitoredNode->timeoutTimer = 0;  /* reset timer */
-                        timeDifference_ms = 0;
-                    }
-                    if(LEVEL_1){sprintf(logLine,
-                    		"FILE: CO_HBconsumer.c"
-                    		"||CALL: CO_HBconsumer_process"
-                    		"\nMSG: New msg recved NOT HB msg. It can be BOOT up msg"); logPrint(LOG,logLine);}
-                    monitoredNode->CANrxNew = false;
-                }
-                /* Verify timeout */
-                if(monitoredNode->timeoutTimer < monitoredNode->time)
-                {
-                	monitoredNode->timeoutTimer += timeDifference_ms;
-                }
-
-                if(monitoredNode->monStarted){
-                    if(monitoredNode->timeoutTimer >= monitoredNode->time){
-
-                    	  if(LEVEL_1){sprintf(logLine,
-                    			  "FILE: CO_HBconsumer.c"
-                    			  "||CALL: CO_HBconsumer_process"
-                    			  "\nMSG: Monitored node TIMED OUT"); logPrint(LOG,logLine);}
-
-                        CO_errorReport(HBcons->em, CO_EM_HEARTBEAT_CONSUMER, CO_EMC_HEARTBEAT, i);
-                        monitoredNode->NMTstate = 0;
-                    }
-                    else if(monitoredNode->NMTstate == 0){
-                  	  if(LEVEL_1){sprintf(logLine,
-                      			  "FILE: CO_HBconsumer.c"
-                      			  "||CALL: CO_HBconsumer_process"
-                      			  "\nMSG: There is a boot up message from the monitored node"); logPrint(LOG,logLine);}
-                        /* there was a bootup message */
-                        CO_errorReport(HBcons->em, CO_EM_HB_CONSUMER_REMOTE_RESET, CO_EMC_HEARTBEAT, i);
-                    }
-                }
-                if(monitoredNode->NMTstate != CO_NMT_OPERATIONAL)
-                    AllMonitoredOperationalCopy = 0;
+        if(!NMTisPreOrOperational){ /* not in (pre)operational state any more */
+        	if(LEVEL_1){sprintf(logLine,
+            			"FILE: CO_HBconsumer.c"
+            			"||CALL: CO_HBconsumer_process"
+            			"\nMSG: This node cannot monitor HB. NMT state of this node is NOT in preOper or Oper"); logPrint(LOG,logLine);}
+            for(i=0; i<HBcons->numberOfMonitoredNodes; i++){
+                CO_HBconsNode_t *monitoredNode = &HBcons->monitoredNodes[i];
+
+                CO_tmr_stop(HBcons->wheel, &monitoredNode->tmr);
+                monitoredNode->NMTstate = 0;
+                CO_FLAG_CLEAR(monitoredNode->CANrxNew);
+                monitoredNode->monStarted = false;
+                monitoredNode->timeout = false;
+                monitoredNode->operational = false;
             }
-            monitoredNode++;
+            HBcons->operationalCount = 0;
         }
     }
-    else{ /* not in (pre)operational state */
-    	if(LEVEL_1){sprintf(logLine,
-        			"FILE: CO_HBconsumer.c"
-        			"||CALL: CO_HBconsumer_process"
-        			"\nMSG: This node cannot monitor HB. NMT state of this node is NOT in preOper or Oper"); logPrint(LOG,logLine);}
-        for(i=0; i<HBcons->numberOfMonitoredNodes; i++)
-        {
-            monitoredNode->NMTstate = 0;
-            monitoredNode->CANrxNew = false;
-            monitoredNode->monStarted = false;
-            monitoredNode++;
+
+    /* Only nodes with received message or expired timer */
+    for(i=0; i<CO_HB_CONS_PENDING_WORDS; i++){
+        uint32_t pending;
+
+        if(__atomic_load_n(&HBcons->pending[i], __ATOMIC_RELAXED) == 0){
+            continue;
+        }
+        pending = __atomic_exchange_n(&HBcons->pending[i], 0, __ATOMIC_ACQUIRE);
+        while(pending != 0){
+            uint32_t idx = i * 32U + (uint32_t)__builtin_ctz(pending);
+
+            pending &= pending - 1U;
+            if(idx < HBcons->numberOfMonitoredNodes){
+                CO_HBcons_processNode(HBcons, (uint8_t)idx, NMTisPreOrOperational);
+            }
         }
-        AllMonitoredOperationalCopy = 0;
     }
 
-    // HBcons->allMonitoredOperational is true only in case if all node under monitoring is operational.
-    //or no node is monitored by this node
-    HBcons->allMonitoredOperational = AllMonitoredOperationalCopy;
+    CO_HBcons_updateAllOperational(HBcons);
 }
@@ -0,0 +1,227 @@
+/*
+ * Clock source of Linux task layer: CLOCK_MONOTONIC or virtual time.
+ *
+ * @file        CO_Linux_clock.c
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * CANopenNode is free and open source software: you can redistribute
+ * it and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "CO_Linux_clock.h"
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+
+#define NSEC_PER_SEC            (1000000000)
+
+
+/* Timer in virtual time. fd is -1 for free entry, expire_ns 0 if disarmed. */
+typedef struct{
+    int         fd;
+    int64_t     expire_ns;
+}CO_clockTimer_t;
+
+
+static bool_t           CO_clock_virtual = false;
+static int64_t          CO_clock_now_ns;
+static CO_clockTimer_t  CO_clock_timers[CO_CLOCK_TIMERS];
+/* Timers may be armed from mainline and realtime thread. */
+static pthread_mutex_t  CO_clock_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+
+static CO_clockTimer_t *CO_clock_find(int fd){
+    int i;
+
+    for(i=0; i<CO_CLOCK_TIMERS; i++){
+        if(CO_clock_timers[i].fd == fd){
+            return &CO_clock_timers[i];
+        }
+    }
+    return NULL;
+}
+
+
+/* Make timer readable, like timerfd after expiration. */
+static void CO_clock_fire(CO_clockTimer_t *tmr){
+    uint64_t one = 1;
+
+    tmr->expire_ns = 0;
+    if(write(tmr->fd, &one, sizeof(one)) == -1)
+        CO_error(0x27100000L + errno);
+}
+
+
+/******************************************************************************/
+void CO_clock_setVirtual(int64_t start_ns){
+    int i;
+
+    for(i=0; i<CO_CLOCK_TIMERS; i++){
+        CO_clock_timers[i].fd = -1;
+        CO_clock_timers[i].expire_ns = 0;
+    }
+    CO_clock_now_ns = start_ns;
+    CO_clock_virtual = true;
+}
+
+
+/******************************************************************************/
+bool_t CO_clock_isVirtual(void){
+    return CO_clock_virtual;
+}
+
+
+/******************************************************************************/
+int CO_clock_gettime(struct timespec *t){
+    int64_t ns;
+
+    if(!CO_clock_virtual){
+        return clock_gettime(CLOCK_MONOTONIC, t);
+    }
+    pthread_mutex_lock(&CO_clock_mtx);
+    ns = CO_clock_now_ns;
+    pthread_mutex_unlock(&CO_clock_mtx);
+    t->tv_sec = (time_t)(ns / NSEC_PER_SEC);
+    t->tv_nsec = (long)(ns % NSEC_PER_SEC);
+    return 0;
+}
+
+
+/******************************************************************************/
+int64_t CO_clock_ns(void){
+    struct timespec t;
+
+    if(CO_clock_gettime(&t) == -1)
+        CO_error(0x27200000L + errno);
+    return (int64_t)t.tv_sec * NSEC_PER_SEC + t.tv_nsec;
+}
+
+
+/******************************************************************************/
+int CO_clock_timerCreate(void){
+    CO_clockTimer_t *tmr;
+    int fd;
+
+    if(!CO_clock_virtual){
+        return timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    }
+
+    fd = eventfd(0, EFD_NONBLOCK);
+    if(fd == -1){
+        return -1;
+    }
+    pthread_mutex_lock(&CO_clock_mtx);
+    tmr = CO_clock_find(-1);
+    if(tmr != NULL){
+        tmr->fd = fd;
+        tmr->expire_ns = 0;
+    }
+    pthread_mutex_unlock(&CO_clock_mtx);
+    if(tmr == NULL){
+        close(fd);
+        errno = ENOMEM;
+        return -1;
+    }
+    return fd;
+}
+
+
+/******************************************************************************/
+int CO_clock_timerSet(int fd, const struct itimerspec *spec){
+    CO_clockTimer_t *tmr;
+    uint64_t count;
+    int64_t expire;
+
+    if(!CO_clock_virtual){
+        return timerfd_settime(fd, TFD_TIMER_ABSTIME, spec, NULL);
+    }
+
+    expire = (int64_t)spec->it_value.tv_sec * NSEC_PER_SEC + spec->it_value.tv_nsec;
+    pthread_mutex_lock(&CO_clock_mtx);
+    tmr = CO_clock_find(fd);
+    if(tmr != NULL){
+        /* timerfd_settime() also clears expirations, which are not read yet. */
+        if(read(fd, &count, sizeof(count)) == -1 && errno != EAGAIN)
+            CO_error(0x27300000L + errno);
+        tmr->expire_ns = expire;
+        if(expire != 0 && expire <= CO_clock_now_ns){
+            CO_clock_fire(tmr);
+        }
+    }
+    pthread_mutex_unlock(&CO_clock_mtx);
+    if(tmr == NULL){
+        errno = EBADF;
+        return -1;
+    }
+    return 0;
+}
+
+
+/******************************************************************************/
+void CO_clock_timerClose(int fd){
+    if(CO_clock_virtual){
+        CO_clockTimer_t *tmr;
+
+        pthread_mutex_lock(&CO_clock_mtx);
+        tmr = CO_clock_find(fd);
+        if(tmr != NULL){
+            tmr->fd = -1;
+        }
+        pthread_mutex_unlock(&CO_clock_mtx);
+    }
+    close(fd);
+}
+
+
+/******************************************************************************/
+bool_t CO_clock_advance(int64_t until_ns){
+    int64_t next = until_ns;
+    bool_t expired = false;
+    int i;
+
+    if(!CO_clock_virtual){
+        return false;
+    }
+
+    pthread_mutex_lock(&CO_clock_mtx);
+    for(i=0; i<CO_CLOCK_TIMERS; i++){
+        CO_clockTimer_t *tmr = &CO_clock_timers[i];
+
+        if(tmr->fd >= 0 && tmr->expire_ns != 0 && tmr->expire_ns <= next){
+            next = tmr->expire_ns;
+            expired = true;
+        }
+    }
+    if(next > CO_clock_now_ns){
+        CO_clock_now_ns = next;
+    }
+    if(expired){
+        for(i=0; i<CO_CLOCK_TIMERS; i++){
+            CO_clockTimer_t *tmr = &CO_clock_timers[i];
+
+            if(tmr->fd >= 0 && tmr->expire_ns != 0 && tmr->expire_ns <= CO_clock_now_ns){
+                CO_clock_fire(tmr);
+            }
+        }
+    }
+    pthread_mutex_unlock(&CO_clock_mtx);
+
+    return expired;
+}
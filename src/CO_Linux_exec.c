@@ -0,0 +1,480 @@
+/*
+ * Executor for several CAN buses: realtime thread per bus and a shared pool
+ * of threads for mainline processing.
+ *
+ * @file        CO_Linux_exec.c
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * CANopenNode is free and open source software: you can redistribute
+ * it and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#define LOG_MODULE LOG_MOD_TASKS   /* runtime log level tag, see Logger.h */
+
+#include "CO_Linux_exec.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+
+#define CO_EXEC_EVENTS      8       /* epoll events taken by worker at once */
+
+
+/* Worker, which runs the calling thread, NULL for other threads. */
+static __thread CO_execWorker_t *CO_exec_self = NULL;
+
+
+/* Deque of worker ************************************************************/
+static void CO_exec_push(CO_execWorker_t *w, CO_execBus_t *bus){
+    pthread_mutex_lock(&w->mtx);
+    w->deque[(w->top + w->count) % w->exec->maxBuses] = bus;
+    w->count++;
+    pthread_mutex_unlock(&w->mtx);
+}
+
+
+/* Owner takes the newest bus, it is still warm in cache. */
+static CO_execBus_t *CO_exec_pop(CO_execWorker_t *w){
+    CO_execBus_t *bus = NULL;
+
+    pthread_mutex_lock(&w->mtx);
+    if(w->count > 0){
+        w->count--;
+        bus = w->deque[(w->top + w->count) % w->exec->maxBuses];
+    }
+    pthread_mutex_unlock(&w->mtx);
+    return bus;
+}
+
+
+/* Thief takes the oldest bus, it waits longest. */
+static CO_execBus_t *CO_exec_steal(CO_execWorker_t *w){
+    CO_execBus_t *bus = NULL;
+
+    pthread_mutex_lock(&w->mtx);
+    if(w->count > 0){
+        bus = w->deque[w->top];
+        w->top = (w->top + 1U) % w->exec->maxBuses;
+        w->count--;
+    }
+    pthread_mutex_unlock(&w->mtx);
+    return bus;
+}
+
+
+/* Own deque first, then other deques, starting with the next worker. */
+static CO_execBus_t *CO_exec_take(CO_execWorker_t *w){
+    CO_exec_t *exec = w->exec;
+    CO_execBus_t *bus = CO_exec_pop(w);
+    uint32_t i;
+
+    for(i=1; bus==NULL && i<exec->noWorkers; i++){
+        bus = CO_exec_steal(&exec->workers[(w->index + i) % exec->noWorkers]);
+        if(bus != NULL){
+            w->stolen++;
+        }
+    }
+    return bus;
+}
+
+
+/* Bus scheduling *************************************************************/
+/*
+ * Mark work pending and queue the bus, unless it is already queued. Bus,
+ * which is processed now, is processed once more by the same worker.
+ */
+static void CO_exec_schedule(CO_execBus_t *bus, uint32_t pending){
+    CO_exec_t *exec = bus->exec;
+    uint32_t state;
+
+    __atomic_fetch_or(&bus->pending, pending, __ATOMIC_SEQ_CST);
+    state = __atomic_load_n(&bus->state, __ATOMIC_SEQ_CST);
+    for(;;){
+        uint32_t next;
+
+        if(state == CO_EXEC_QUEUED || state == CO_EXEC_RERUN){
+            return;
+        }
+        next = (state == CO_EXEC_IDLE) ? CO_EXEC_QUEUED : CO_EXEC_RERUN;
+        if(__atomic_compare_exchange_n(&bus->state, &state, next, false,
+                                       __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)){
+            if(next == CO_EXEC_RERUN){
+                return;
+            }
+            break;
+        }
+    }
+
+    if(CO_exec_self != NULL && CO_exec_self->exec == exec){
+        CO_exec_push(CO_exec_self, bus);
+    }
+    else{
+        CO_exec_push(&exec->workers[bus->home], bus);
+    }
+
+    /* Pairs with increment of idle before the last look into deques. */
+    if(__atomic_load_n(&exec->idle, __ATOMIC_SEQ_CST) > 0){
+        uint64_t one = 1;
+
+        if(write(exec->fdWake, &one, sizeof(one)) == -1 && errno != EAGAIN)
+            CO_error(0x25100000L + errno);
+    }
+}
+
+
+/* Wakeup function of taskMain, called on first signal from CANopen objects. */
+static void CO_exec_cbWake(void *object){
+    CO_exec_schedule((CO_execBus_t*)object, CO_EXEC_PEND_SIGNAL);
+}
+
+
+/* Process mainline of the bus, until no new work arrived meanwhile. */
+static void CO_exec_runBus(CO_execWorker_t *w, CO_execBus_t *bus){
+    uint32_t state;
+
+    do{
+        uint32_t pending;
+        CO_NMT_reset_cmd_t reset = CO_RESET_NOT;
+
+        state = CO_EXEC_RUNNING;
+        __atomic_store_n(&bus->state, CO_EXEC_RUNNING, __ATOMIC_SEQ_CST);
+        pending = __atomic_exchange_n(&bus->pending, 0, __ATOMIC_SEQ_CST);
+        if(bus->stopping){
+            continue;
+        }
+
+        /* Signals first, timer cycle then includes their deadlines. */
+        if(pending & CO_EXEC_PEND_SIGNAL){
+            taskMain_process(&bus->tm, bus->tm.fdEvent, &reset);
+            if(reset != CO_RESET_NOT)
+                __atomic_store_n(&bus->reset, (uint32_t)reset, __ATOMIC_RELEASE);
+        }
+        if(pending & CO_EXEC_PEND_TIMER){
+            taskMain_process(&bus->tm, bus->tm.fdTmr, &reset);
+            if(reset != CO_RESET_NOT)
+                __atomic_store_n(&bus->reset, (uint32_t)reset, __ATOMIC_RELEASE);
+        }
+        w->executed++;
+    }while(!__atomic_compare_exchange_n(&bus->state, &state, CO_EXEC_IDLE, false,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+}
+
+
+/* Worker thread **************************************************************/
+static void *CO_exec_worker(void *arg){
+    CO_execWorker_t *w = (CO_execWorker_t*)arg;
+    CO_exec_t *exec = w->exec;
+
+    CO_exec_self = w;
+    CO_rtThreadApply(exec->rtCfg, &exec->workerCfg);
+
+    while(exec->run){
+        struct epoll_event ev[CO_EXEC_EVENTS];
+        CO_execBus_t *bus;
+        int ready = 0;
+        int i;
+
+        bus = CO_exec_take(w);
+        if(bus == NULL){
+            /* Announce sleep, then look once more, so no push is missed. */
+            __atomic_fetch_add(&exec->idle, 1, __ATOMIC_SEQ_CST);
+            bus = CO_exec_take(w);
+            if(bus == NULL){
+                ready = epoll_wait(exec->fdEpoll, ev, CO_EXEC_EVENTS, -1);
+            }
+            __atomic_fetch_sub(&exec->idle, 1, __ATOMIC_SEQ_CST);
+        }
+        if(bus != NULL){
+            CO_exec_runBus(w, bus);
+            continue;
+        }
+
+        if(ready < 0){
+            if(errno != EINTR)
+                CO_error(0x25200000L + errno);
+            continue;
+        }
+
+        /* Expired timers queue their buses to this worker, others steal. */
+        pthread_rwlock_rdlock(&exec->dispatchLock);
+        for(i=0; i<ready; i++){
+            if(ev[i].data.ptr == NULL){
+                uint64_t count;
+
+                if(read(exec->fdWake, &count, sizeof(count)) == -1 && errno != EAGAIN)
+                    CO_error(0x25300000L + errno);
+            }
+            else{
+                CO_exec_schedule((CO_execBus_t*)ev[i].data.ptr, CO_EXEC_PEND_TIMER);
+            }
+        }
+        pthread_rwlock_unlock(&exec->dispatchLock);
+    }
+
+    /* Wake from CO_exec_close() may be consumed by this worker, pass it on
+     * to the workers, which still sleep. */
+    {
+        uint64_t one = 1;
+
+        if(write(exec->fdWake, &one, sizeof(one)) == -1 && errno != EAGAIN)
+            CO_error(0x25400000L + errno);
+    }
+
+    return NULL;
+}
+
+
+/******************************************************************************/
+int CO_exec_init(
+        CO_exec_t              *exec,
+        uint32_t                noWorkers,
+        uint32_t                maxBuses,
+        const CO_rtCfg_t       *rtCfg,
+        const CO_rtThreadCfg_t *workerCfg)
+{
+    struct epoll_event ev;
+    uint32_t i;
+
+    if(exec == NULL || noWorkers == 0 || maxBuses == 0 || rtCfg == NULL || workerCfg == NULL){
+        errno = EINVAL;
+        return -1;
+    }
+
+    memset(exec, 0, sizeof(*exec));
+    exec->noWorkers = noWorkers;
+    exec->maxBuses = maxBuses;
+    exec->rtCfg = rtCfg;
+    exec->workerCfg = *workerCfg;
+    exec->run = 1;
+    exec->fdEpoll = -1;
+    exec->fdWake = -1;
+
+    exec->workers = (CO_execWorker_t*)calloc(noWorkers, sizeof(CO_execWorker_t));
+    if(exec->workers == NULL){
+        return -1;
+    }
+    for(i=0; i<noWorkers; i++){
+        CO_execWorker_t *w = &exec->workers[i];
+
+        w->exec = exec;
+        w->index = i;
+        w->deque = (CO_execBus_t**)calloc(maxBuses, sizeof(CO_execBus_t*));
+        if(w->deque == NULL || pthread_mutex_init(&w->mtx, NULL) != 0){
+            CO_exec_close(exec);
+            return -1;
+        }
+    }
+    pthread_rwlock_init(&exec->dispatchLock, NULL);
+
+    /* Wake event is level triggered, any sleeping worker may take it. */
+    exec->fdEpoll = epoll_create(4);
+    exec->fdWake = eventfd(0, EFD_NONBLOCK);
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    if(exec->fdEpoll == -1 || exec->fdWake == -1
+        || epoll_ctl(exec->fdEpoll, EPOLL_CTL_ADD, exec->fdWake, &ev) == -1)
+    {
+        CO_exec_close(exec);
+        return -1;
+    }
+
+    for(i=0; i<noWorkers; i++){
+        if(pthread_create(&exec->workers[i].thread, NULL, CO_exec_worker, &exec->workers[i]) != 0){
+            exec->noWorkers = i;
+            CO_exec_close(exec);
+            errno = EAGAIN;
+            return -1;
+        }
+    }
+
+    if(LEVEL_1){sprintf(logLine,
+            "FILE: CO_Linux_exec.c"
+            "||CALL: CO_exec_init"
+            "\nMSG: %u workers for up to %u buses", noWorkers, maxBuses); logPrint(LOG,logLine);}
+    return 0;
+}
+
+
+/******************************************************************************/
+void CO_exec_close(CO_exec_t *exec){
+    uint32_t i;
+
+    if(exec->workers != NULL){
+        exec->run = 0;
+        if(exec->fdWake != -1){
+            uint64_t one = 1;
+
+            if(write(exec->fdWake, &one, sizeof(one)) == -1)
+                CO_error(0x25400000L + errno);
+            for(i=0; i<exec->noWorkers; i++){
+                if(exec->workers[i].thread != 0)
+                    pthread_join(exec->workers[i].thread, NULL);
+            }
+        }
+        for(i=0; i<exec->noWorkers; i++){
+            free(exec->workers[i].deque);
+            pthread_mutex_destroy(&exec->workers[i].mtx);
+        }
+        free(exec->workers);
+        exec->workers = NULL;
+        pthread_rwlock_destroy(&exec->dispatchLock);
+    }
+    if(exec->fdWake != -1)
+        close(exec->fdWake);
+    if(exec->fdEpoll != -1)
+        close(exec->fdEpoll);
+    exec->fdWake = -1;
+    exec->fdEpoll = -1;
+}
+
+
+/* Realtime thread of the bus, CAN receive and tmrTask ************************/
+static void *CO_exec_rtThread(void *arg){
+    CO_execBus_t *bus = (CO_execBus_t*)arg;
+
+    CO_rtThreadApply(bus->exec->rtCfg, &bus->rtThreadCfg);
+
+    while(bus->rtRun){
+        struct epoll_event ev;
+        int ready = epoll_wait(bus->fdEpollRT, &ev, 1, -1);
+
+        if(ready != 1){
+            if(errno != EINTR)
+                CO_error(0x25500000L + errno);
+        }
+        else if(!CANrx_taskTmr_process(&bus->rt, ev.data.fd)){
+            CO_error(0x25600000L + errno);
+        }
+    }
+
+    return NULL;
+}
+
+
+/******************************************************************************/
+int CO_execBus_start(
+        CO_exec_t              *exec,
+        CO_execBus_t           *bus,
+        CO_t                   *CO,
+        const CO_rtThreadCfg_t *rtThreadCfg,
+        long                    intervalns)
+{
+    struct epoll_event ev;
+
+    if(exec == NULL || bus == NULL || CO == NULL || rtThreadCfg == NULL){
+        errno = EINVAL;
+        return -1;
+    }
+    if(__atomic_add_fetch(&exec->noBuses, 1, __ATOMIC_ACQ_REL) > exec->maxBuses){
+        __atomic_sub_fetch(&exec->noBuses, 1, __ATOMIC_ACQ_REL);
+        errno = ENOSPC;
+        return -1;
+    }
+
+    bus->exec = exec;
+    bus->CO = CO;
+    bus->rtThreadCfg = *rtThreadCfg;
+    bus->stopping = 0;
+    bus->rtRun = 0;                 /* CO_execBus_stop() on error paths below */
+    bus->state = CO_EXEC_IDLE;
+    bus->pending = 0;
+    bus->reset = CO_RESET_NOT;
+    bus->home = exec->nextHome;
+    exec->nextHome = (exec->nextHome + 1U) % exec->noWorkers;
+
+    /* Mainline is woken by its signal callbacks and by its timer. */
+    taskMain_init(&bus->tm, CO, -1, NULL);
+    taskMain_initWakeup(&bus->tm, bus, CO_exec_cbWake);
+    CO_EM_initCallback(CO->em, &bus->tm, taskMain_cbSignalEMCY);
+    CO_SDO_initCallback(CO->SDO[0], &bus->tm, taskMain_cbSignalSDO);
+    CO_NMT_initCallbackSignal(CO->NMT, &bus->tm, taskMain_cbSignalNMT);
+    CO_HBconsumer_initCallback(CO->HBcons, &bus->tm, taskMain_cbSignalHBconsumer);
+#if CO_NO_SDO_CLIENT == 1
+    CO_SDOclient_initCallback(CO->SDOclient, &bus->tm, taskMain_cbSignalSDOclient);
+#endif
+
+    /* Edge triggered, so expired timer is dispatched once, not until read.
+     * Timer is already expired by taskMain_init(), which queues the bus now. */
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.ptr = bus;
+    if(epoll_ctl(exec->fdEpoll, EPOLL_CTL_ADD, bus->tm.fdTmr, &ev) == -1){
+        taskMain_close(&bus->tm);
+        __atomic_sub_fetch(&exec->noBuses, 1, __ATOMIC_ACQ_REL);
+        return -1;
+    }
+
+    bus->fdEpollRT = epoll_create(2);
+    if(bus->fdEpollRT == -1){
+        CO_execBus_stop(bus);
+        return -1;
+    }
+    CANrx_taskTmr_init(&bus->rt, CO, bus->fdEpollRT, intervalns, NULL);
+    CANrx_taskTmr_setCatchup(&bus->rt, exec->rtCfg->catchup, exec->rtCfg->catchupMax);
+    CANrx_taskTmr_setSyncPhase(&bus->rt, exec->rtCfg->syncPhase, exec->rtCfg->syncOffset_us);
+
+    bus->rtRun = 1;
+    if(pthread_create(&bus->rtThread, NULL, CO_exec_rtThread, bus) != 0){
+        bus->rtRun = 0;
+        CO_execBus_stop(bus);
+        errno = EAGAIN;
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/******************************************************************************/
+void CO_execBus_stop(CO_execBus_t *bus){
+    CO_exec_t *exec = bus->exec;
+
+    /* Realtime thread wakes at least each interval and sees the flag. */
+    if(bus->rtRun){
+        bus->rtRun = 0;
+        pthread_join(bus->rtThread, NULL);
+    }
+    if(bus->fdEpollRT != -1){
+        CANrx_taskTmr_close(&bus->rt);
+        close(bus->fdEpollRT);
+        bus->fdEpollRT = -1;
+    }
+
+    /* No new timer events, and events already taken from epoll are
+     * dispatched, when write lock is obtained. */
+    bus->stopping = 1;
+    epoll_ctl(exec->fdEpoll, EPOLL_CTL_DEL, bus->tm.fdTmr, NULL);
+    pthread_rwlock_wrlock(&exec->dispatchLock);
+    pthread_rwlock_unlock(&exec->dispatchLock);
+
+    /* Queued bus is taken by some worker, which skips it. */
+    while(__atomic_load_n(&bus->state, __ATOMIC_SEQ_CST) != CO_EXEC_IDLE){
+        usleep(100);
+    }
+
+    taskMain_initWakeup(&bus->tm, NULL, NULL);
+    taskMain_close(&bus->tm);
+    __atomic_sub_fetch(&exec->noBuses, 1, __ATOMIC_ACQ_REL);
+}
+
+
+/******************************************************************************/
+CO_NMT_reset_cmd_t CO_execBus_reset(CO_execBus_t *bus){
+    return (CO_NMT_reset_cmd_t)__atomic_exchange_n(&bus->reset, CO_RESET_NOT, __ATOMIC_ACQ_REL);
+}
@@ -0,0 +1,396 @@
+/*
+ * Realtime configuration of CANopen threads in Linux.
+ *
+ * @file        CO_Linux_rt.c
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * CANopenNode is free and open source software: you can redistribute
+ * it and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#define _GNU_SOURCE                 /* for cpu_set_t and pthread_setaffinity_np */
+#define LOG_MODULE LOG_MOD_TASKS   /* runtime log level tag, see Logger.h */
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <malloc.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "CO_Linux_rt.h"
+
+
+#ifndef SCHED_DEADLINE
+#define SCHED_DEADLINE          6
+#endif
+
+/* glibc has no wrapper for sched_setattr() */
+struct CO_sched_attr {
+    uint32_t size;
+    uint32_t sched_policy;
+    uint64_t sched_flags;
+    int32_t  sched_nice;
+    uint32_t sched_priority;
+    uint64_t sched_runtime;
+    uint64_t sched_deadline;
+    uint64_t sched_period;
+};
+
+
+/******************************************************************************/
+void CO_rtCfg_default(CO_rtCfg_t *cfg){
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->main.policy = CO_RT_POLICY_OTHER;
+    cfg->rt.policy = CO_RT_POLICY_OTHER;
+    cfg->wdog.policy = CO_RT_POLICY_OTHER;
+    cfg->stackPrefault_kB = 64;
+    cfg->catchup = CO_RT_CATCHUP_REPEAT;
+    cfg->catchupMax = 10;
+    cfg->wdogRtTimeout_ms = 250;
+    cfg->wdogMainTimeout_ms = 3000;
+    cfg->wdogEscalate = 3;
+    cfg->wdogSlowdown = 3;
+    cfg->appRtBudget_us = 1000;
+    cfg->appMainBudget_us = 20000;
+}
+
+
+/* Parse CPU list like "0,2-3" into mask. Returns -1 on error. */
+static int CO_rtParseCpus(const char *s, uint64_t *mask){
+    uint64_t m = 0;
+
+    while(*s != 0){
+        char *end;
+        long from, to;
+
+        from = strtol(s, &end, 10);
+        if(end == s) return -1;
+        to = from;
+        s = end;
+        if(*s == '-'){
+            s++;
+            to = strtol(s, &end, 10);
+            if(end == s) return -1;
+            s = end;
+        }
+        if(from < 0 || to > 63 || from > to) return -1;
+        for(; from<=to; from++){
+            m |= (uint64_t)1 << from;
+        }
+        if(*s == ',') s++;
+        else if(*s != 0) return -1;
+    }
+    *mask = m;
+    return 0;
+}
+
+
+/* Parse list of rate groups like "1,1,0,2" into group[count]. Returns -1 on
+ * error. */
+static int CO_rtParseGroups(const char *s, uint8_t *group, int count){
+    int i;
+
+    memset(group, 0, (size_t)count);
+    for(i=0; *s != 0; i++){
+        char *end;
+        long g = strtol(s, &end, 10);
+
+        if(end == s || i >= count || g < 0 || g >= (long)CO_PDO_GROUPS) return -1;
+        group[i] = (uint8_t)g;
+        s = end;
+        if(*s == ',') s++;
+        else if(*s != 0) return -1;
+    }
+    return 0;
+}
+
+
+/* Set one key of thread configuration. Returns -1 on error. */
+static int CO_rtParseThreadKey(CO_rtThreadCfg_t *thread, const char *key, const char *val){
+    char *end;
+    unsigned long n = strtoul(val, &end, 10);
+    bool_t isNumber = (end != val && *end == 0);
+
+    if(strcmp(key, "policy") == 0){
+        if(strcmp(val, "other") == 0)           thread->policy = CO_RT_POLICY_OTHER;
+        else if(strcmp(val, "fifo") == 0)       thread->policy = CO_RT_POLICY_FIFO;
+        else if(strcmp(val, "rr") == 0)         thread->policy = CO_RT_POLICY_RR;
+        else if(strcmp(val, "deadline") == 0)   thread->policy = CO_RT_POLICY_DEADLINE;
+        else return -1;
+    }
+    else if(strcmp(key, "priority") == 0 && isNumber && n >= 1 && n <= 99){
+        thread->priority = (int)n;
+    }
+    else if(strcmp(key, "cpus") == 0){
+        return CO_rtParseCpus(val, &thread->cpuMask);
+    }
+    else if(strcmp(key, "runtime_us") == 0 && isNumber){
+        thread->runtime_us = (uint32_t)n;
+    }
+    else if(strcmp(key, "deadline_us") == 0 && isNumber){
+        thread->deadline_us = (uint32_t)n;
+    }
+    else if(strcmp(key, "period_us") == 0 && isNumber){
+        thread->period_us = (uint32_t)n;
+    }
+    else{
+        return -1;
+    }
+    return 0;
+}
+
+
+/******************************************************************************/
+int CO_rtCfg_load(const char *filename, CO_rtCfg_t *cfg){
+    char line[256];
+    int lineNo = 0;
+    int ret = 0;
+    FILE *fp;
+
+    fp = fopen(filename, "r");
+    if(fp == NULL){
+        return -1;
+    }
+
+    while(ret == 0 && fgets(line, sizeof(line), fp) != NULL){
+        char *key, *val, *c;
+        char *end;
+        unsigned long n;
+        unsigned group;
+        int len = 0;
+
+        lineNo++;
+
+        /* strip comment and white space */
+        c = strchr(line, '#');
+        if(c != NULL) *c = 0;
+        key = line;
+        while(isspace((unsigned char)*key)) key++;
+        if(*key == 0) continue;
+
+        val = strchr(key, '=');
+        if(val == NULL){
+            ret = lineNo;
+            break;
+        }
+        c = val;
+        *val++ = 0;
+        while(c > key && isspace((unsigned char)c[-1])) *--c = 0;
+        while(isspace((unsigned char)*val)) val++;
+        c = val + strlen(val);
+        while(c > val && isspace((unsigned char)c[-1])) *--c = 0;
+
+        n = strtoul(val, &end, 10);
+        if(strncmp(key, "main.", 5) == 0){
+            if(CO_rtParseThreadKey(&cfg->main, key + 5, val) != 0) ret = lineNo;
+        }
+        else if(strncmp(key, "rt.", 3) == 0){
+            if(CO_rtParseThreadKey(&cfg->rt, key + 3, val) != 0) ret = lineNo;
+        }
+        else if(strncmp(key, "wdog.", 5) == 0){
+            if(CO_rtParseThreadKey(&cfg->wdog, key + 5, val) != 0) ret = lineNo;
+        }
+        else if(strcmp(key, "watchdog_device") == 0){
+            if(strlen(val) >= sizeof(cfg->wdogDevice)) ret = lineNo;
+            else strcpy(cfg->wdogDevice, val);
+        }
+        else if(strcmp(key, "rpdo_groups") == 0){
+            if(CO_rtParseGroups(val, cfg->rpdoGroup, CO_NO_RPDO) != 0) ret = lineNo;
+        }
+        else if(strcmp(key, "tpdo_groups") == 0){
+            if(CO_rtParseGroups(val, cfg->tpdoGroup, CO_NO_TPDO) != 0) ret = lineNo;
+        }
+        else if(strcmp(key, "catchup") == 0){
+            if(strcmp(val, "repeat") == 0)          cfg->catchup = CO_RT_CATCHUP_REPEAT;
+            else if(strcmp(val, "accumulate") == 0) cfg->catchup = CO_RT_CATCHUP_ACCUMULATE;
+            else if(strcmp(val, "skip") == 0)       cfg->catchup = CO_RT_CATCHUP_SKIP;
+            else ret = lineNo;
+        }
+        else if(end == val || *end != 0){
+            ret = lineNo;
+        }
+        else if(strcmp(key, "lock_memory") == 0 && n <= 1){
+            cfg->lockMemory = (n == 1);
+        }
+        else if(strcmp(key, "stack_prefault_kb") == 0){
+            cfg->stackPrefault_kB = (uint32_t)n;
+        }
+        else if(strcmp(key, "report_interval_s") == 0){
+            cfg->reportInterval_s = (uint32_t)n;
+        }
+        else if(strcmp(key, "catchup_max") == 0){
+            cfg->catchupMax = (uint32_t)n;
+        }
+        else if(strcmp(key, "sync_phase") == 0 && n <= 1){
+            cfg->syncPhase = (n == 1);
+        }
+        else if(strcmp(key, "sync_offset_us") == 0){
+            cfg->syncOffset_us = (uint32_t)n;
+        }
+        else if(strcmp(key, "watchdog_period_ms") == 0){
+            cfg->wdogPeriod_ms = (uint32_t)n;
+        }
+        else if(strcmp(key, "watchdog_rt_timeout_ms") == 0 && n > 0){
+            cfg->wdogRtTimeout_ms = (uint32_t)n;
+        }
+        else if(strcmp(key, "watchdog_main_timeout_ms") == 0 && n > 0){
+            cfg->wdogMainTimeout_ms = (uint32_t)n;
+        }
+        else if(strcmp(key, "watchdog_escalate") == 0 && n > 0){
+            cfg->wdogEscalate = (uint32_t)n;
+        }
+        else if(strcmp(key, "watchdog_slowdown") == 0 && n <= 4){
+            cfg->wdogSlowdown = (uint32_t)n;
+        }
+        else if(strcmp(key, "app_rt_budget_us") == 0){
+            cfg->appRtBudget_us = (uint32_t)n;
+        }
+        else if(strcmp(key, "app_main_budget_us") == 0){
+            cfg->appMainBudget_us = (uint32_t)n;
+        }
+        else if(sscanf(key, "pdo_group%u_us%n", &group, &len) == 1 && key[len] == 0
+                && group > 0 && group < CO_PDO_GROUPS){
+            cfg->pdoGroupPeriod_us[group] = (uint32_t)n;
+        }
+        else{
+            ret = lineNo;
+        }
+    }
+
+    fclose(fp);
+    return ret;
+}
+
+
+/******************************************************************************/
+int CO_rtMemoryLock(const CO_rtCfg_t *cfg){
+    if(!cfg->lockMemory){
+        return 0;
+    }
+
+    /* Freed memory is kept by malloc and large blocks come from the locked
+     * heap, so no page fault happens after startup. */
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+
+    if(mlockall(MCL_CURRENT | MCL_FUTURE) != 0){
+        if(LEVEL_1){sprintf(logLine,
+                "FILE: CO_Linux_rt.c"
+                "||CALL: CO_rtMemoryLock"
+                "\nMSG: mlockall failed, errno=%d",errno); logPrint(ERROR,logLine);}
+        return -1;
+    }
+    return 0;
+}
+
+
+/* Touch stack, so its pages are mapped and locked before first cycle. */
+static void CO_rtStackPrefault(uint32_t size_kB){
+    size_t size = (size_t)size_kB * 1024;
+    volatile unsigned char *stack;
+    size_t i;
+
+    if(size == 0) return;
+    stack = alloca(size);
+    for(i=0; i<size; i+=1024){
+        stack[i] = 0;
+    }
+}
+
+
+/******************************************************************************/
+int CO_rtThreadApply(const CO_rtCfg_t *cfg, const CO_rtThreadCfg_t *thread){
+    int ret = 0;
+    bool_t policyFailed = false;
+
+    if(thread->cpuMask != 0){
+        cpu_set_t cpus;
+        int i;
+
+        CPU_ZERO(&cpus);
+        for(i=0; i<64; i++){
+            if(thread->cpuMask & ((uint64_t)1 << i)) CPU_SET(i, &cpus);
+        }
+        errno = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if(errno != 0){
+            if(LEVEL_1){sprintf(logLine,
+                    "FILE: CO_Linux_rt.c"
+                    "||CALL: CO_rtThreadApply"
+                    "\nMSG: setting affinity failed, errno=%d",errno); logPrint(ERROR,logLine);}
+            ret = -1;
+        }
+    }
+
+    if(thread->policy == CO_RT_POLICY_FIFO || thread->policy == CO_RT_POLICY_RR){
+        struct sched_param param;
+
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = thread->priority;
+        errno = pthread_setschedparam(pthread_self(),
+                (thread->policy == CO_RT_POLICY_FIFO) ? SCHED_FIFO : SCHED_RR, &param);
+        if(errno != 0){
+            policyFailed = true;
+        }
+    }
+    else if(thread->policy == CO_RT_POLICY_DEADLINE){
+        struct CO_sched_attr attr;
+
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.sched_policy = SCHED_DEADLINE;
+        attr.sched_runtime = (uint64_t)thread->runtime_us * 1000;
+        attr.sched_deadline = (uint64_t)thread->deadline_us * 1000;
+        attr.sched_period = (uint64_t)thread->period_us * 1000;
+        if(syscall(SYS_sched_setattr, 0, &attr, 0) != 0){
+            policyFailed = true;
+        }
+    }
+
+    if(policyFailed){
+        ret = -1;
+        if(LEVEL_1){sprintf(logLine,
+                "FILE: CO_Linux_rt.c"
+                "||CALL: CO_rtThreadApply"
+                "\nMSG: setting scheduling policy %d failed, errno=%d",thread->policy,errno); logPrint(ERROR,logLine);}
+    }
+
+    if(cfg->lockMemory){
+        CO_rtStackPrefault(cfg->stackPrefault_kB);
+    }
+
+    return ret;
+}
+
+
+/******************************************************************************/
+#ifndef CO_SINGLE_THREAD
+int CO_rtMutexInit(pthread_mutex_t *mutex){
+    pthread_mutexattr_t attr;
+    int err;
+
+    err = pthread_mutexattr_init(&attr);
+    if(err == 0) err = pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
+    if(err == 0){
+        err = pthread_mutex_init(mutex, &attr);
+    }
+    pthread_mutexattr_destroy(&attr);
+    return err;
+}
+#endif
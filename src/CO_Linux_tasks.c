@@ -24,16 +24,90 @@
  */
 
 
+#define LOG_MODULE LOG_MOD_TASKS   /* runtime log level tag, see Logger.h */
+
 #include "CANopen.h"
+#include "CO_Linux_tasks.h"
 #include <errno.h>
-#include <fcntl.h>
-#include <sys/timerfd.h>
+#include <sys/eventfd.h>
 #include <sys/epoll.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 
 #define NSEC_PER_SEC            (1000000000)    /* The number of nanoseconds per second. */
 #define NSEC_PER_MSEC           (1000000)       /* The number of nanoseconds per millisecond. */
+#define TASK_MAIN_MAX_INTERVAL_US (1000000)     /* Longest sleep of mainline, if nothing is due. */
+#define CANRX_BATCH_MAX         (16)            /* CAN messages read by realtime task in one wakeup. */
+#define TASK_APP_RECOVER        (100)           /* Calls of application hook within budget, which reset its emergency. */
+#define TASK_RT_RECOVER         (100)           /* Timer wakeups without missed steps, which reset CO_EM_RT_TIMER_MISSED. */
+
+
+/* Time a - b in microseconds. */
+static long timespec_diff_us(const struct timespec *a, const struct timespec *b) {
+    return (a->tv_sec - b->tv_sec) * 1000000L + (a->tv_nsec - b->tv_nsec) / 1000;
+}
+
+
+/* Add time a - b to t. */
+static void timespec_add_diff(struct timespec *t, const struct timespec *a, const struct timespec *b) {
+    t->tv_sec += a->tv_sec - b->tv_sec;
+    t->tv_nsec += a->tv_nsec - b->tv_nsec;
+    if(t->tv_nsec >= NSEC_PER_SEC) {
+        t->tv_nsec -= NSEC_PER_SEC;
+        t->tv_sec++;
+    }
+    else if(t->tv_nsec < 0) {
+        t->tv_nsec += NSEC_PER_SEC;
+        t->tv_sec--;
+    }
+}
+
+
+/* Time in nanoseconds. */
+static int64_t timespec_ns(const struct timespec *t) {
+    return (int64_t)t->tv_sec * NSEC_PER_SEC + t->tv_nsec;
+}
+
+
+/* Add microseconds to time. */
+static void timespec_add_us(struct timespec *t, uint32_t us) {
+    t->tv_sec += us / 1000000U;
+    t->tv_nsec += (long)(us % 1000000U) * 1000L;
+    if(t->tv_nsec >= NSEC_PER_SEC) {
+        t->tv_nsec -= NSEC_PER_SEC;
+        t->tv_sec++;
+    }
+}
+
+
+/* Record microseconds into histogram, negative values as 0. */
+static void hist_record_us(CO_hist_t *hist, long us) {
+    CO_hist_record(hist, (us > 0) ? (uint32_t)us : 0U);
+}
+
+
+/* Record execution time of application hook from start to end. Call longer
+ * than budgetus is counted and reported with errorBit, info code is its time
+ * in microseconds. */
+static void taskApp_account(CO_t *CO, CO_taskStats_t *stats, uint32_t budgetus, uint32_t *good,
+                            uint8_t errorBit, const struct timespec *start, const struct timespec *end)
+{
+    long us = timespec_diff_us(end, start);
+
+    hist_record_us(&stats->app, us);
+    if(budgetus == 0U) {
+        return;
+    }
+    if(us > (long)budgetus) {
+        __atomic_add_fetch(&stats->appOverruns, 1, __ATOMIC_RELAXED);
+        *good = 0;
+        CO_errorReport(CO->em, errorBit, CO_EMC_SOFTWARE_INTERNAL, (uint32_t)us);
+    }
+    else if(*good < TASK_APP_RECOVER && ++(*good) == TASK_APP_RECOVER) {
+        CO_errorReset(CO->em, errorBit, 0);
+    }
+}
 
 
 /* External helper function ***************************************************/
@@ -48,259 +122,552 @@ void CO_error(const uint32_t info)
 
 
 /* Mainline task (taskMain) ***************************************************/
-static struct {
-    int                 fdTmr;          /* file descriptor for taskTmr */
-    int                 fdPipe[2];      /* file descriptors for pipe [0]=read, [1]=write */
-    struct itimerspec   tmrSpec;
-    uint16_t            tmr1msPrev;
-    uint16_t           *maxTime;
-} taskMain;
+/* Arm timer to absolute time base + delay_us. */
+static void taskMain_arm(CO_taskMain_t *tm, const struct timespec *base, uint32_t delay_us) {
+    tm->tmrSpec.it_value = *base;
+    timespec_add_us(&tm->tmrSpec.it_value, delay_us);
+    if(CO_clock_timerSet(tm->fdTmr, &tm->tmrSpec) == -1)
+        CO_error(0x21500000L + errno);
+}
 
 
-void taskMain_init(int fdEpoll, uint16_t *maxTime) {
+void taskMain_init(CO_taskMain_t *tm, CO_t *CO, int fdEpoll, uint16_t *maxTime) {
     struct epoll_event ev;
-    int flags;
 
-    /* Prepare pipe for triggering events. For example, if new SDO request
-     * arrives from CAN network, CANrx callback writes a byte into the pipe.
+    tm->CO = CO;
+
+    /* Prepare eventfd for triggering events. For example, if new SDO request
+     * arrives from CAN network, CANrx callback sets CO_SIGNAL_SDO in
+     * tm->signals and, if no signal was pending yet, writes the eventfd.
      * This immediately triggers (via epoll) processing of SDO server, which
-     * generates response. Read and write ends of pipe are nonblocking.
-     * (See 'self pipe trick'.) */
-    if(pipe(taskMain.fdPipe) == -1)
-        CO_errExit("taskMain_init - pipe failed");
-
-    flags = fcntl(taskMain.fdPipe[0], F_GETFL);
-    if(flags == -1)
-        CO_errExit("taskMain_init - fcntl-F_GETFL[0] failed");
-    flags |= O_NONBLOCK;
-    if(fcntl(taskMain.fdPipe[0], F_SETFL, flags) == -1)
-        CO_errExit("taskMain_init - fcntl-F_SETFL[0] failed");
-
-    flags = fcntl(taskMain.fdPipe[1], F_GETFL);
-    if(flags == -1)
-        CO_errExit("taskMain_init - fcntl-F_GETFL[1] failed");
-    flags |= O_NONBLOCK;
-    if(fcntl(taskMain.fdPipe[1], F_SETFL, flags) == -1)
-        CO_errExit("taskMain_init - fcntl-F_SETFL[1] failed");
+     * generates response. A burst of signals costs one write and one read. */
+    tm->signals = 0;
+    tm->fdEvent = eventfd(0, EFD_NONBLOCK);
+    if(tm->fdEvent == -1)
+        CO_errExit("taskMain_init - eventfd failed");
 
     /* get file descriptor for timer */
-    taskMain.fdTmr = timerfd_create(CLOCK_MONOTONIC, 0);
-    if(taskMain.fdTmr == -1)
+    tm->fdTmr = CO_clock_timerCreate();
+    if(tm->fdTmr == -1)
         CO_errExit("taskMain_init - timerfd_create failed");
 
     /* add events for epoll */
-    ev.events = EPOLLIN;
-    ev.data.fd = taskMain.fdPipe[0];
-    if(epoll_ctl(fdEpoll, EPOLL_CTL_ADD, taskMain.fdPipe[0], &ev) == -1)
-        CO_errExit("taskMain_init - epoll_ctl CANrx failed");
-
-    ev.events = EPOLLIN;
-    ev.data.fd = taskMain.fdTmr;
-    if(epoll_ctl(fdEpoll, EPOLL_CTL_ADD, taskMain.fdTmr, &ev) == -1)
-        CO_errExit("taskMain_init - epoll_ctl taskTmr failed");
+    if(fdEpoll >= 0) {
+        ev.events = EPOLLIN;
+        ev.data.fd = tm->fdEvent;
+        if(epoll_ctl(fdEpoll, EPOLL_CTL_ADD, tm->fdEvent, &ev) == -1)
+            CO_errExit("taskMain_init - epoll_ctl eventfd failed");
+
+        ev.events = EPOLLIN;
+        ev.data.fd = tm->fdTmr;
+        if(epoll_ctl(fdEpoll, EPOLL_CTL_ADD, tm->fdTmr, &ev) == -1)
+            CO_errExit("taskMain_init - epoll_ctl taskTmr failed");
+    }
 
-    /* Prepare timer, use no interval, delay time will be set each cycle. */
-    taskMain.tmrSpec.it_interval.tv_sec = 0;
-    taskMain.tmrSpec.it_interval.tv_nsec = 0;
+    /* Prepare timer, use no interval, expiration is set each cycle to the
+     * earliest deadline reported by CANopen objects. First cycle runs now. */
+    tm->tmrSpec.it_interval.tv_sec = 0;
+    tm->tmrSpec.it_interval.tv_nsec = 0;
 
-    taskMain.tmrSpec.it_value.tv_sec = 0;
-    taskMain.tmrSpec.it_value.tv_nsec = 1;
+    if(CO_clock_gettime(&tm->tmrAccounted) != 0)
+        CO_errExit("taskMain_init - clock_gettime failed");
 
-    if(timerfd_settime(taskMain.fdTmr, 0, &taskMain.tmrSpec, NULL) != 0)
+    tm->tmrSpec.it_value = tm->tmrAccounted;
+    if(CO_clock_timerSet(tm->fdTmr, &tm->tmrSpec) != 0)
         CO_errExit("taskMain_init - timerfd_settime failed");
 
-    taskMain.tmr1msPrev = 0;
-    taskMain.maxTime = maxTime;
+    tm->sleepus = 0;
+    tm->latencyPrevValid = false;
+    tm->maxTime = maxTime;
+    tm->wakeObject = NULL;
+    tm->pFunctWake = NULL;
+    tm->async = NULL;
+    tm->pFunctApp = NULL;
 }
 
 
-void taskMain_close(void) {
-    close(taskMain.fdPipe[0]);
-    close(taskMain.fdPipe[1]);
-    close(taskMain.fdTmr);
+void taskMain_initWakeup(CO_taskMain_t *tm, void *object, void (*pFunctWake)(void *object)) {
+    tm->wakeObject = object;
+    tm->pFunctWake = pFunctWake;
 }
 
 
-bool_t taskMain_process(int fd, CO_NMT_reset_cmd_t *reset, uint16_t timer1ms) {
-    bool_t wasProcessed = true;
+void taskMain_initAsync(CO_taskMain_t *tm, CO_async_t *async) {
+    tm->async = async;
+    if(async != NULL) {
+        CO_async_initCallback(async, tm, taskMain_cbSignal);
+    }
+}
 
-    /* Signal from pipe, consume all bytes. */
-    if(fd == taskMain.fdPipe[0]) {
-        for(;;) {
-            char ch;
-            if(read(taskMain.fdPipe[0], &ch, 1) == -1) {
-                if (errno == EAGAIN)
-                    break;  /* No more bytes. */
-                else
-                    CO_error(0x21100000L + errno);
-            }
+
+void taskMain_initApp(CO_taskMain_t *tm, void (*pFunctApp)(uint16_t timer1msDiff), uint32_t budget_us) {
+    tm->appBudgetus = budget_us;
+    tm->appGood = TASK_APP_RECOVER;     /* CO_init() cleared emergencies */
+    tm->pFunctApp = pFunctApp;
+}
+
+
+void taskMain_close(CO_taskMain_t *tm) {
+    close(tm->fdEvent);
+    CO_clock_timerClose(tm->fdTmr);
+}
+
+
+bool_t taskMain_process(CO_taskMain_t *tm, int fd, CO_NMT_reset_cmd_t *reset) {
+    struct timespec tStart, tEnd;
+    uint32_t signals = 0;
+    uint16_t timer1msDiff;
+    uint32_t timerNext = TASK_MAIN_MAX_INTERVAL_US;
+    long elapsed;
+
+    if(fd != tm->fdEvent && fd != tm->fdTmr) {
+        return false;
+    }
+    if(CO_clock_gettime(&tStart) == -1)
+        CO_error(0x21600000L + errno);
+    *reset = CO_RESET_NOT;
+
+    /* Signal from eventfd. Signaled objects are processed after the timer
+     * cycle, so timers started by them count from the current time. */
+    if(fd == tm->fdEvent) {
+        uint64_t count;
+
+        /* Clear eventfd before taking the signals. Signal set in between is
+         * taken now and only causes one empty wakeup later. */
+        if(read(tm->fdEvent, &count, sizeof(count)) == -1 && errno != EAGAIN)
+            CO_error(0x21100000L + errno);
+        signals = __atomic_exchange_n(&tm->signals, 0, __ATOMIC_ACQ_REL);
+        if(signals == 0) {
+            return true;
         }
     }
 
     /* Timer expired. */
-    else if(fd == taskMain.fdTmr) {
+    else {
         uint64_t tmrExp;
-        if(read(taskMain.fdTmr, &tmrExp, sizeof(tmrExp)) != sizeof(uint64_t))
-            CO_error(0x21200000L + errno);
+        long latency;
+
+        if(read(tm->fdTmr, &tmrExp, sizeof(tmrExp)) != sizeof(uint64_t)) {
+            /* Timer was moved by signaled processing after epoll. */
+            if(errno != EAGAIN)
+                CO_error(0x21200000L + errno);
+            return true;
+        }
+
+        /* Wakeup latency, period jitter and overruns */
+        latency = timespec_diff_us(&tStart, &tm->tmrSpec.it_value);
+        if(latency < 0) {
+            latency = 0;
+        }
+        hist_record_us(&tm->stats.wakeup, latency);
+        if(tm->latencyPrevValid) {
+            hist_record_us(&tm->stats.period, labs(latency - tm->latencyPrev));
+        }
+        tm->latencyPrev = latency;
+        tm->latencyPrevValid = true;
+        if(tm->sleepus > 0 && latency >= (long)tm->sleepus) {
+            tm->stats.overruns++;
+        }
     }
-    else {
-        wasProcessed = false;
+
+    /* Calculate time difference in whole milliseconds. Remainder stays
+     * in tmrAccounted, so deadlines do not drift. */
+    elapsed = timespec_diff_us(&tStart, &tm->tmrAccounted) / 1000;
+    timer1msDiff = (elapsed > 0xFFFF) ? 0xFFFF : (elapsed > 0) ? (uint16_t)elapsed : 0U;
+    timespec_add_us(&tm->tmrAccounted, (uint32_t)timer1msDiff * 1000U);
+
+    /* Calculate maximum interval in milliseconds (informative) */
+    if(tm->maxTime != NULL) {
+        if(timer1msDiff > *tm->maxTime) {
+            *tm->maxTime = timer1msDiff;
+        }
     }
 
-    /* Process mainline. */
-    if(wasProcessed) {
-        uint16_t timer1msDiff;
-        uint16_t timerNext = 50;
 
-        /* Calculate time difference */
-        timer1msDiff = timer1ms - taskMain.tmr1msPrev;
-        taskMain.tmr1msPrev = timer1ms;
+    /* CANopen process. Only objects with expired timers cost time. */
+    *reset = CO_process(tm->CO, timer1msDiff, &timerNext);
+    if(signals != 0) {
+        CO_NMT_reset_cmd_t resetSignaled = CO_process_signaled(tm->CO, signals, &timerNext);
 
-        /* Calculate maximum interval in milliseconds (informative) */
-        if(taskMain.maxTime != NULL) {
-            if(timer1msDiff > *taskMain.maxTime) {
-                *taskMain.maxTime = timer1msDiff;
-            }
+        if(*reset == CO_RESET_NOT) {
+            *reset = resetSignaled;
         }
+    }
 
+    /* Application tasks, their deadlines are included in timerNext. */
+    if(tm->async != NULL || tm->pFunctApp != NULL) {
+        CO_PROF_BEGIN(tProf);
+        if(tm->async != NULL) {
+            CO_async_process(tm->async, (uint32_t)timer1msDiff * 1000U, &timerNext);
+        }
+        if(tm->pFunctApp != NULL) {
+            struct timespec tApp;
+
+            if(CO_clock_gettime(&tApp) == -1)
+                CO_error(0x21600000L + errno);
+            tm->pFunctApp(timer1msDiff);
+            if(CO_clock_gettime(&tEnd) == -1)
+                CO_error(0x21600000L + errno);
+            taskApp_account(tm->CO, &tm->stats, tm->appBudgetus, &tm->appGood,
+                            CO_EM_APP_MAIN_OVERRUN, &tApp, &tEnd);
+        }
+        CO_PROF_STAGE(tm->CO, CO_PROF_MAIN_APP, tProf);
+    }
 
-        /* CANopen process */
-        *reset = CO_process(CO, timer1msDiff, &timerNext);
 
+    /* Sleep until the earliest deadline. */
+    taskMain_arm(tm, &tm->tmrAccounted, timerNext);
+    elapsed = timespec_diff_us(&tm->tmrSpec.it_value, &tStart);
+    tm->sleepus = (elapsed > 0) ? (uint32_t)elapsed : 0U;
 
-        /* Set delay for next sleep. */
-        taskMain.tmrSpec.it_value.tv_nsec = (long)(++timerNext) * NSEC_PER_MSEC;
-        if(timerfd_settime(taskMain.fdTmr, 0, &taskMain.tmrSpec, NULL) == -1)
-            CO_error(0x21500000L + errno);
+    if(CO_clock_gettime(&tEnd) == -1)
+        CO_error(0x21600000L + errno);
+    hist_record_us(&tm->stats.exec, timespec_diff_us(&tEnd, &tStart));
+    __atomic_add_fetch(&tm->progress, 1, __ATOMIC_RELEASE);
 
+    return true;
+}
+
+
+void taskMain_signal(CO_taskMain_t *tm, uint32_t signals) {
+    /* Only the first signal after processing wakes the mainline. */
+    if(__atomic_fetch_or(&tm->signals, signals, __ATOMIC_ACQ_REL) == 0) {
+        uint64_t one = 1;
+        if(tm->pFunctWake != NULL)
+            tm->pFunctWake(tm->wakeObject);
+        else if(write(tm->fdEvent, &one, sizeof(one)) == -1)
+            CO_error(0x23100000L + errno);
     }
+}
 
-    return wasProcessed;
+
+void taskMain_cbSignal(void *object) {
+    taskMain_signal((CO_taskMain_t*)object, CO_SIGNAL_ALL);
+}
+
+
+void taskMain_cbSignalSDO(void *object) {
+    taskMain_signal((CO_taskMain_t*)object, CO_SIGNAL_SDO);
 }
 
 
-void taskMain_cbSignal(void) {
-    if(write(taskMain.fdPipe[1], "x", 1) == -1)
-        CO_error(0x23100000L + errno);
+void taskMain_cbSignalEMCY(void *object) {
+    taskMain_signal((CO_taskMain_t*)object, CO_SIGNAL_EMCY);
+}
+
+
+void taskMain_cbSignalNMT(void *object) {
+    taskMain_signal((CO_taskMain_t*)object, CO_SIGNAL_NMT);
+}
+
+
+void taskMain_cbSignalSDOclient(void *object) {
+    taskMain_signal((CO_taskMain_t*)object, CO_SIGNAL_SDO_CLIENT);
+}
+
+
+void taskMain_cbSignalHBconsumer(void *object) {
+    taskMain_signal((CO_taskMain_t*)object, CO_SIGNAL_HB_CONSUMER);
 }
 
 
 /* Realtime task (taskRT) *****************************************************/
-static struct {
-    int                 fdRx0;          /* file descriptor for CANrx */
-    int                 fdTmr;          /* file descriptor for taskTmr */
-    struct itimerspec   tmrSpec;
-    struct timespec    *tmrVal;
-    long                intervalns;
-    long                intervalus;
-    uint16_t           *maxTime;
-} taskRT;
-
-
-void CANrx_taskTmr_init(int fdEpoll, long intervalns, uint16_t *maxTime) {
+void CANrx_taskTmr_init(CO_taskRT_t *rt, CO_t *CO, int fdEpoll, long intervalns, uint16_t *maxTime) {
     struct epoll_event ev;
 
     /* get file descriptors */
-    taskRT.fdRx0 = CO->CANmodule[0]->fd;
-
-    taskRT.fdTmr = timerfd_create(CLOCK_MONOTONIC, 0);
-    if(taskRT.fdTmr == -1)
+    rt->CO = CO;
+    rt->fdRx0 = CO->CANmodule[0]->fd;
+    rt->CANrxLocked = false;
+    CO_SYNC_initCallback(CO->SYNC, rt, CANrx_lockCbSync);
+    rt->syncPhase = false;
+    CO_syncPll_init(&rt->syncPll);
+
+    rt->fdTmr = CO_clock_timerCreate();
+    if(rt->fdTmr == -1)
         CO_errExit("CANrx_taskTmr_init - timerfd_create failed");
 
     /* add events for epoll */
-    ev.events = EPOLLIN;
-    ev.data.fd = taskRT.fdRx0;
-    if(epoll_ctl(fdEpoll, EPOLL_CTL_ADD, taskRT.fdRx0, &ev) == -1)
-        CO_errExit("CANrx_taskTmr_init - epoll_ctl CANrx failed");
-
-    ev.events = EPOLLIN;
-    ev.data.fd = taskRT.fdTmr;
-    if(epoll_ctl(fdEpoll, EPOLL_CTL_ADD, taskRT.fdTmr, &ev) == -1)
-        CO_errExit("CANrx_taskTmr_init - epoll_ctl taskTmr failed");
+    if(fdEpoll >= 0) {
+        ev.events = EPOLLIN;
+        ev.data.fd = rt->fdRx0;
+        if(epoll_ctl(fdEpoll, EPOLL_CTL_ADD, rt->fdRx0, &ev) == -1)
+            CO_errExit("CANrx_taskTmr_init - epoll_ctl CANrx failed");
+
+        ev.events = EPOLLIN;
+        ev.data.fd = rt->fdTmr;
+        if(epoll_ctl(fdEpoll, EPOLL_CTL_ADD, rt->fdTmr, &ev) == -1)
+            CO_errExit("CANrx_taskTmr_init - epoll_ctl taskTmr failed");
+    }
 
     /* Prepare timer (one shot, each time calculate new expiration time) It is
-     * necessary not to use taskRT.tmrSpec.it_interval, because it is sliding. */
-    taskRT.tmrSpec.it_interval.tv_sec = 0;
-    taskRT.tmrSpec.it_interval.tv_nsec = 0;
+     * necessary not to use rt->tmrSpec.it_interval, because it is sliding. */
+    rt->tmrSpec.it_interval.tv_sec = 0;
+    rt->tmrSpec.it_interval.tv_nsec = 0;
 
-    taskRT.tmrVal = &taskRT.tmrSpec.it_value;
-    if(clock_gettime(CLOCK_MONOTONIC, taskRT.tmrVal) != 0)
+    rt->tmrVal = &rt->tmrSpec.it_value;
+    if(CO_clock_gettime(rt->tmrVal) != 0)
         CO_errExit("CANrx_taskTmr_init - clock_gettime failed");
+    rt->tmrAccounted = *rt->tmrVal;
+    rt->cyclePrev = *rt->tmrVal;
 
-    if(timerfd_settime(taskRT.fdTmr, TFD_TIMER_ABSTIME, &taskRT.tmrSpec, NULL) != 0)
+    if(CO_clock_timerSet(rt->fdTmr, &rt->tmrSpec) != 0)
         CO_errExit("CANrx_taskTmr_init - timerfd_settime failed");
 
-    taskRT.intervalns = intervalns;
-    taskRT.intervalus = intervalns / 1000;
-    taskRT.maxTime = maxTime;
+    rt->intervalus = intervalns / 1000;
+    rt->sleepus = 0;
+    rt->stepus = 0;
+    rt->tmrGood = TASK_RT_RECOVER;      /* CO_init() cleared emergencies */
+    rt->latencyPrevValid = false;
+    rt->maxTime = maxTime;
+    rt->catchup = CO_RT_CATCHUP_REPEAT;
+    rt->catchupMax = 10;
+    rt->pFunctApp = NULL;
 }
 
 
-void CANrx_taskTmr_close(void) {
-    close(taskRT.fdTmr);
+void CANrx_taskTmr_setCatchup(CO_taskRT_t *rt, CO_rtCatchup_t catchup, uint32_t catchupMax) {
+    rt->catchup = catchup;
+    rt->catchupMax = catchupMax;
 }
 
 
-bool_t CANrx_taskTmr_process(int fd) {
-    bool_t wasProcessed = true;
+void CANrx_taskTmr_setSyncPhase(CO_taskRT_t *rt, bool_t enable, uint32_t offset_us) {
+    rt->syncPhase = enable;
+    rt->syncOffsetns = (int64_t)offset_us * 1000;
+}
+
+
+void CANrx_taskTmr_initApp(CO_taskRT_t *rt, void (*pFunctApp)(uint32_t timeDifference_us), uint32_t budget_us) {
+    rt->appBudgetus = budget_us;
+    rt->appGood = TASK_APP_RECOVER;
+    rt->pFunctApp = pFunctApp;
+}
 
-    /* Get received CAN message. */
-    if(fd == taskRT.fdRx0) {
-        CO_CANrxWait(CO->CANmodule[0]);
+
+void CANrx_taskTmr_close(CO_taskRT_t *rt) {
+    CO_SYNC_initCallback(rt->CO->SYNC, NULL, NULL);
+    CO_clock_timerClose(rt->fdTmr);
+}
+
+
+void CANrx_lockCbSync(void *object, bool_t syncReceived) {
+    CO_taskRT_t *rt = (CO_taskRT_t*)object;
+
+    if(syncReceived) {
+        struct timespec now;
+
+        rt->CANrxLocked = true;
+        if(CO_clock_gettime(&now) == -1)
+            CO_error(0x22200000L + errno);
+        CO_syncPll_update(&rt->syncPll, timespec_ns(&now));
     }
+}
 
-    /* Execute taskTmr */
-    else if(fd == taskRT.fdTmr) {
-        uint64_t tmrExp;
 
-        /* Wait for timer to expire */
-        if(read(taskRT.fdTmr, &tmrExp, sizeof(tmrExp)) != sizeof(uint64_t))
-            CO_error(0x22100000L + errno);
+/* Process SYNC, RPDOs and TPDOs and arm timer for their next deadline.
+ * Objects get time up to until. Timer cycle normally gives programmed
+ * expiration, so deadlines do not drift with wakeup latency. Cycle after
+ * reception gives now. */
+static void CANrx_taskTmr_cycle(CO_taskRT_t *rt, const struct timespec *now, const struct timespec *until) {
+    CO_t *CO = rt->CO;
+    uint32_t timerNext = (uint32_t)rt->intervalus;
+    struct timespec tmrEnd;
+    long timeDifference, dt;
+
+    timeDifference = timespec_diff_us(until, &rt->tmrAccounted);
+    if(timeDifference < 0) {
+        timeDifference = 0;
+    }
+    else {
+        rt->tmrAccounted = *until;
+    }
+
+    /* Calculate maximum interval between cycles in microseconds (informative) */
+    dt = timespec_diff_us(now, &rt->cyclePrev);
+    rt->cyclePrev = *now;
+    if(rt->maxTime != NULL) {
+        if(dt > 0xFFFF) {
+            *rt->maxTime = 0xFFFF;
+        }else if(dt > *rt->maxTime) {
+            *rt->maxTime = (uint16_t) dt;
+        }
+    }
+
 
-        /* Calculate maximum interval in microseconds (informative) */
-        if(taskRT.maxTime != NULL) {
-            struct timespec tmrMeasure;
-            if(clock_gettime(CLOCK_MONOTONIC, &tmrMeasure) == -1)
+    /* No CO_LOCK_OD here, so mainline never blocks this thread. PDO mapped
+     * variables are protected by seqlock of the CAN module, see Karsh.h. */
+    if(CO_FLAG_READ(CO->CANmodule[0]->CANnormal)) {
+        bool_t syncWas;
+
+        /* Process Sync and read inputs */
+        syncWas = CO_process_SYNC_RPDO(CO, (uint32_t)timeDifference, &timerNext);
+
+        /* Application code between inputs and outputs, see
+         * CANrx_taskTmr_initApp(). */
+        CO_PROF_BEGIN(tProf);
+        if(rt->pFunctApp != NULL) {
+            struct timespec tApp;
+
+            if(CO_clock_gettime(&tApp) == -1)
                 CO_error(0x22200000L + errno);
-            if(tmrMeasure.tv_sec == taskRT.tmrVal->tv_sec) {
-                long dt = tmrMeasure.tv_nsec - taskRT.tmrVal->tv_nsec;
-                dt /= 1000;
-                dt += taskRT.intervalus;
-                if(dt > 0xFFFF) {
-                    *taskRT.maxTime = 0xFFFF;
-                }else if(dt > *taskRT.maxTime) {
-                    *taskRT.maxTime = (uint16_t) dt;
-                }
+            rt->pFunctApp((uint32_t)timeDifference);
+            if(CO_clock_gettime(&tmrEnd) == -1)
+                CO_error(0x22200000L + errno);
+            taskApp_account(CO, &rt->stats, rt->appBudgetus, &rt->appGood,
+                            CO_EM_APP_RT_OVERRUN, &tApp, &tmrEnd);
+        }
+        CO_PROF_STAGE(CO, CO_PROF_RT_APP, tProf);
+
+        /* Write outputs */
+        CO_process_TPDO(CO, syncWas, (uint32_t)timeDifference, &timerNext);
+    }
+
+    /* RPDOs of the last SYNC are processed, CAN messages after it may follow. */
+    rt->CANrxLocked = false;
+
+
+    /* Sleep until the earliest deadline, at most interval. */
+    if(timerNext > (uint32_t)rt->intervalus) {
+        timerNext = (uint32_t)rt->intervalus;
+    }
+    *rt->tmrVal = rt->tmrAccounted;
+    timespec_add_us(rt->tmrVal, timerNext);
+    if(rt->syncPhase) {
+        int64_t deadline;
+
+        if(CO_syncPll_deadline(&rt->syncPll, timespec_ns(now), rt->syncOffsetns, &deadline)
+            && deadline < timespec_ns(rt->tmrVal))
+        {
+            rt->tmrVal->tv_sec = (time_t)(deadline / NSEC_PER_SEC);
+            rt->tmrVal->tv_nsec = (long)(deadline % NSEC_PER_SEC);
+        }
+    }
+    if(CO_clock_timerSet(rt->fdTmr, &rt->tmrSpec) == -1)
+        CO_error(0x22300000L + errno);
+
+    if(CO_clock_gettime(&tmrEnd) == -1)
+        CO_error(0x22200000L + errno);
+    dt = timespec_diff_us(rt->tmrVal, now);
+    rt->sleepus = (dt > 0) ? (uint32_t)dt : 0U;
+    dt = timespec_diff_us(rt->tmrVal, &rt->tmrAccounted);
+    rt->stepus = (dt > 0) ? (uint32_t)dt : 0U;
+    hist_record_us(&rt->stats.exec, timespec_diff_us(&tmrEnd, now));
+    __atomic_add_fetch(&rt->progress, 1, __ATOMIC_RELEASE);
+}
+
+
+/* Timer cycle after wakeup, which may be late by missed steps. */
+static void CANrx_taskTmr_catchUp(CO_taskRT_t *rt, const struct timespec *now, uint32_t missed) {
+    uint32_t cycles;
+
+    switch(rt->catchup) {
+    case CO_RT_CATCHUP_SKIP:
+        if(missed > 0) {
+            /* Objects get the programmed step only, missed time is lost. */
+            timespec_add_diff(&rt->tmrAccounted, now, rt->tmrVal);
+            CANrx_taskTmr_cycle(rt, now, now);
+        }
+        else {
+            CANrx_taskTmr_cycle(rt, now, rt->tmrVal);
+        }
+        break;
+
+    case CO_RT_CATCHUP_ACCUMULATE:
+        CANrx_taskTmr_cycle(rt, now, (missed > 0) ? now : rt->tmrVal);
+        break;
+
+    default:
+        /* Each cycle arms the next deadline. Run again, while it is already
+         * behind wakeup. */
+        CANrx_taskTmr_cycle(rt, now, rt->tmrVal);
+        for(cycles=0; timespec_diff_us(now, rt->tmrVal) > 0; cycles++) {
+            if(cycles == rt->catchupMax) {
+                /* limit reached, skip the rest */
+                timespec_add_diff(&rt->tmrAccounted, now, rt->tmrVal);
+                CANrx_taskTmr_cycle(rt, now, now);
+                break;
             }
+            CANrx_taskTmr_cycle(rt, now, rt->tmrVal);
         }
+        break;
+    }
+}
 
-        /* Calculate next shot for the timer */
-        taskRT.tmrVal->tv_nsec += taskRT.intervalns;
-        if(taskRT.tmrVal->tv_nsec >= NSEC_PER_SEC) {
-            taskRT.tmrVal->tv_nsec -= NSEC_PER_SEC;
-            taskRT.tmrVal->tv_sec++;
+
+bool_t CANrx_taskTmr_process(CO_taskRT_t *rt, int fd) {
+    CO_t *CO = rt->CO;
+    bool_t wasProcessed = true;
+
+    /* Get received CAN messages, SYNC and RPDOs are processed immediately
+     * after them. Batch ends at SYNC, see CANrx_lockCbSync(). */
+    if(fd == rt->fdRx0) {
+        int i;
+
+        for(i = 0; i < CANRX_BATCH_MAX && !rt->CANrxLocked; i++) {
+            if(!CO_CANrxNext(CO->CANmodule[0]))
+                break;
         }
-        if(timerfd_settime(taskRT.fdTmr, TFD_TIMER_ABSTIME, &taskRT.tmrSpec, NULL) == -1)
-            CO_error(0x22300000L + errno);
 
+        if(CO_process_RT_pending(CO)) {
+            struct timespec now;
 
-        /* Lock PDOs and OD */
-        CO_LOCK_OD();
+            if(CO_clock_gettime(&now) == -1)
+                CO_error(0x22200000L + errno);
+            CANrx_taskTmr_cycle(rt, &now, &now);
+        }
+    }
 
-        if(CO->CANmodule[0]->CANnormal) {
-            bool_t syncWas;
+    /* Execute taskTmr */
+    else if(fd == rt->fdTmr) {
+        uint64_t tmrExp;
 
-            /* Process Sync and read inputs */
-            syncWas = CO_process_SYNC_RPDO(CO, taskRT.intervalus);
+        struct timespec tmrMeasure;
+        long latency;
+        uint32_t missed;
 
-            /* Further I/O or nonblocking application code may go here. */
+        /* Timer may be rearmed by cycle after reception, since epoll. */
+        if(read(rt->fdTmr, &tmrExp, sizeof(tmrExp)) != sizeof(uint64_t)) {
+            if(errno != EAGAIN)
+                CO_error(0x22100000L + errno);
+            return true;
+        }
 
-            /* Write outputs */
-            CO_process_TPDO(CO, syncWas, taskRT.intervalus);
+        /* Wakeup latency against programmed expiration, like cyclictest */
+        if(CO_clock_gettime(&tmrMeasure) == -1)
+            CO_error(0x22200000L + errno);
+        latency = timespec_diff_us(&tmrMeasure, rt->tmrVal);
+        if(latency < 0) {
+            latency = 0;
+        }
+        hist_record_us(&rt->stats.wakeup, latency);
+        if(rt->sleepus > 0 && latency >= (long)rt->sleepus) {
+            rt->stats.overruns++;
+        }
+        if(rt->latencyPrevValid) {
+            hist_record_us(&rt->stats.period, labs(latency - rt->latencyPrev));
+        }
+        rt->latencyPrev = latency;
+        rt->latencyPrevValid = true;
+
+        /* Steps missed by late wakeup, counted against the step of the
+         * armed timer. Timer is one shot, so expiration count is above one
+         * only if someone made it periodic. Emergency is informative,
+         * escalation is left to the watchdog (CO_Linux_wdog.h). */
+        missed = (uint32_t)(tmrExp - 1U);
+        if(rt->stepus > 0U && latency >= (long)rt->stepus) {
+            missed += (uint32_t)(latency / rt->stepus);
+        }
+        if(missed > 0) {
+            __atomic_add_fetch(&rt->stats.missedTicks, missed, __ATOMIC_RELAXED);
+            rt->tmrGood = 0;
+            CO_errorReport(CO->em, CO_EM_RT_TIMER_MISSED, CO_EMC_SOFTWARE_INTERNAL, missed);
+        }
+        else if(rt->tmrGood < TASK_RT_RECOVER && ++rt->tmrGood == TASK_RT_RECOVER) {
+            CO_errorReset(CO->em, CO_EM_RT_TIMER_MISSED, 0);
         }
 
-        /* Unlock */
-        CO_UNLOCK_OD();
+        CANrx_taskTmr_catchUp(rt, &tmrMeasure, missed);
     }
 
     else {
@@ -309,3 +676,71 @@ bool_t CANrx_taskTmr_process(int fd) {
 
     return wasProcessed;
 }
+
+
+CO_taskStats_t *CANrx_taskTmr_stats(CO_taskRT_t *rt) {
+    return &rt->stats;
+}
+
+
+const CO_syncPll_t *CANrx_taskTmr_syncPll(CO_taskRT_t *rt) {
+    return &rt->syncPll;
+}
+
+
+CO_taskStats_t *taskMain_stats(CO_taskMain_t *tm) {
+    return &tm->stats;
+}
+
+
+/* Task statistics in Object Dictionary ***************************************/
+/*
+ * Sub-index 1 takes snapshot and resets histograms of the task, other
+ * sub-indexes read percentiles from the last snapshot. ODF is called from
+ * mainline thread only, so snapshots need no locking.
+ */
+static CO_SDO_abortCode_t taskStats_read(CO_ODF_arg_t *ODF_arg, CO_taskStats_t *stats, CO_taskStats_t *snapshot) {
+    static const uint16_t permille[4] = {500, 990, 999, 1000};
+    const CO_hist_t *hist;
+    uint32_t value;
+
+    if(!ODF_arg->reading || ODF_arg->subIndex == 0U) {
+        return CO_SDO_AB_NONE;
+    }
+
+    if(ODF_arg->subIndex == 1U) {
+        CO_hist_snapshot(&stats->wakeup, &snapshot->wakeup);
+        CO_hist_snapshot(&stats->exec, &snapshot->exec);
+        CO_hist_snapshot(&stats->period, &snapshot->period);
+        value = (uint32_t)snapshot->exec.total;
+    }
+    else {
+        uint8_t i = ODF_arg->subIndex - 2U;
+
+        hist = (i < 4U) ? &snapshot->wakeup : (i < 8U) ? &snapshot->exec : &snapshot->period;
+        value = CO_hist_percentile(hist, permille[i % 4U]);
+    }
+
+    CO_setUint32(ODF_arg->data, value);
+    return CO_SDO_AB_NONE;
+}
+
+
+static CO_SDO_abortCode_t CO_ODF_2141(CO_ODF_arg_t *ODF_arg) {
+    CO_taskRT_t *rt = (CO_taskRT_t*)ODF_arg->object;
+
+    return taskStats_read(ODF_arg, &rt->stats, &rt->snapshot);
+}
+
+
+static CO_SDO_abortCode_t CO_ODF_2142(CO_ODF_arg_t *ODF_arg) {
+    CO_taskMain_t *tm = (CO_taskMain_t*)ODF_arg->object;
+
+    return taskStats_read(ODF_arg, &tm->stats, &tm->snapshot);
+}
+
+
+void taskStats_configureOD(CO_SDO_t *SDO, CO_taskMain_t *tm, CO_taskRT_t *rt) {
+    CO_OD_configure(SDO, 0x2141, CO_ODF_2141, (void*)rt, 0, 0);
+    CO_OD_configure(SDO, 0x2142, CO_ODF_2142, (void*)tm, 0, 0);
+}
@@ -0,0 +1,338 @@
+/*
+ * Deadline watchdog for realtime and mainline task, with escalation.
+ *
+ * @file        CO_Linux_wdog.c
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * CANopenNode is free and open source software: you can redistribute
+ * it and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#define LOG_MODULE LOG_MOD_TASKS   /* runtime log level tag, see Logger.h */
+
+#include "CO_Linux_wdog.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/watchdog.h>
+
+
+static int64_t CO_wdog_now(void){
+    struct timespec t;
+
+    if(clock_gettime(CLOCK_MONOTONIC, &t) == -1)
+        CO_error(0x26100000L + errno);
+    return (int64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+
+/* Send state string to notify socket, if any. */
+static void CO_wdog_notify(CO_wdog_t *wd, const char *state){
+    if(wd->fdNotify >= 0){
+        if(sendto(wd->fdNotify, state, strlen(state), MSG_NOSIGNAL,
+                  (struct sockaddr*)&wd->notifyAddr, wd->notifyAddrLen) == -1)
+            CO_error(0x26200000L + errno);
+    }
+}
+
+
+/* Open notify socket from NOTIFY_SOCKET, '@' is abstract namespace. */
+static void CO_wdog_openNotify(CO_wdog_t *wd){
+    const char *path = getenv("NOTIFY_SOCKET");
+    size_t len;
+
+    if(path == NULL || (path[0] != '/' && path[0] != '@')){
+        return;
+    }
+    len = strlen(path);
+    if(len >= sizeof(wd->notifyAddr.sun_path)){
+        return;
+    }
+    memset(&wd->notifyAddr, 0, sizeof(wd->notifyAddr));
+    wd->notifyAddr.sun_family = AF_UNIX;
+    memcpy(wd->notifyAddr.sun_path, path, len);
+    if(path[0] == '@'){
+        wd->notifyAddr.sun_path[0] = 0;
+        wd->notifyAddrLen = (socklen_t)(offsetof(struct sockaddr_un, sun_path) + len);
+    }
+    else{
+        wd->notifyAddrLen = (socklen_t)(offsetof(struct sockaddr_un, sun_path) + len + 1);
+    }
+    wd->fdNotify = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+}
+
+
+/* Keep system supervisor from resetting. */
+static void CO_wdog_kick(CO_wdog_t *wd){
+    if(wd->fdDev >= 0){
+        if(ioctl(wd->fdDev, WDIOC_KEEPALIVE, 0) == -1)
+            CO_error(0x26300000L + errno);
+    }
+    CO_wdog_notify(wd, "WATCHDOG=1");
+}
+
+
+/* Enter higher escalation levels, one after another. */
+static void CO_wdog_escalate(CO_wdog_t *wd, uint8_t level, uint32_t lateMask){
+    CO_t *CO = wd->CO;
+
+    while(wd->level < level){
+        wd->level++;
+        switch(wd->level){
+        case CO_WDOG_EMCY:
+            CO_errorReport(CO->em, CO_EM_TASK_DEADLINE, CO_EMC_SOFTWARE_INTERNAL, lateMask);
+            break;
+        case CO_WDOG_DEGRADE:
+            CO_setTPDOslowdown(CO, (uint8_t)wd->rtCfg->wdogSlowdown);
+            break;
+        default:
+            /* Same as NMT command, which may come from realtime thread. */
+            CO_errorReport(CO->em, CO_EM_GENERIC_SOFTWARE_ERROR, CO_EMC_SOFTWARE_INTERNAL, lateMask);
+            if(__atomic_load_n(&CO->NMT->operatingState, __ATOMIC_RELAXED) == CO_NMT_OPERATIONAL){
+                __atomic_store_n(&CO->NMT->operatingState, CO_NMT_PRE_OPERATIONAL, __ATOMIC_RELAXED);
+            }
+            break;
+        }
+        if(LEVEL_1){sprintf(logLine,
+                "FILE: CO_Linux_wdog.c"
+                "||CALL: CO_wdog_escalate"
+                "\nMSG: task deadline missed, level=%d, late=0x%02X",wd->level,lateMask); logPrint(ERROR,logLine);}
+    }
+    if(wd->level > wd->maxLevel){
+        wd->maxLevel = wd->level;
+    }
+}
+
+
+/* All tasks are on time again. */
+static void CO_wdog_recover(CO_wdog_t *wd){
+    CO_t *CO = wd->CO;
+
+    if(wd->level >= CO_WDOG_PREOP){
+        CO_errorReset(CO->em, CO_EM_GENERIC_SOFTWARE_ERROR, 0);
+    }
+    if(wd->level >= CO_WDOG_DEGRADE){
+        CO_setTPDOslowdown(CO, 0);
+    }
+    CO_errorReset(CO->em, CO_EM_TASK_DEADLINE, 0);
+    if(LEVEL_1){sprintf(logLine,
+            "FILE: CO_Linux_wdog.c"
+            "||CALL: CO_wdog_recover"
+            "\nMSG: tasks recovered from level=%d",wd->level); logPrint(LOG,logLine);}
+    wd->level = CO_WDOG_OK;
+}
+
+
+/* Compare progress of tasks with their deadlines, called with mtx locked. */
+static void CO_wdog_check(CO_wdog_t *wd, int64_t now){
+    const CO_rtCfg_t *cfg = wd->rtCfg;
+    uint32_t lateMask = 0;
+    uint32_t progress, missed;
+
+    progress = __atomic_load_n(&wd->rt->progress, __ATOMIC_ACQUIRE);
+    if(progress != wd->rtProgress){
+        wd->rtProgress = progress;
+        wd->rtSeen_ns = now;
+    }
+    else if(now - wd->rtSeen_ns > (int64_t)cfg->wdogRtTimeout_ms * 1000000){
+        lateMask |= CO_WDOG_LATE_RT;
+    }
+    missed = __atomic_load_n(&wd->rt->stats.missedTicks, __ATOMIC_RELAXED);
+    if(missed != wd->rtMissed){
+        wd->rtMissed = missed;
+        lateMask |= CO_WDOG_LATE_RT_OVR;
+    }
+
+    progress = __atomic_load_n(&wd->tm->progress, __ATOMIC_ACQUIRE);
+    if(progress != wd->mainProgress){
+        wd->mainProgress = progress;
+        wd->mainSeen_ns = now;
+    }
+    else if(now - wd->mainSeen_ns > (int64_t)cfg->wdogMainTimeout_ms * 1000000){
+        lateMask |= CO_WDOG_LATE_MAIN;
+    }
+
+    if(lateMask != 0){
+        uint32_t level = 1U + wd->late / cfg->wdogEscalate;
+
+        wd->late++;
+        wd->good = 0;
+        wd->lateChecks++;
+        CO_wdog_escalate(wd, (level > CO_WDOG_PREOP) ? CO_WDOG_PREOP : (uint8_t)level, lateMask);
+    }
+    /* Late checks count until recovery, so a task, which is late only
+     * from time to time, escalates too. */
+    else if(wd->late > 0 && ++wd->good >= 2U * cfg->wdogEscalate){
+        wd->late = 0;
+        wd->good = 0;
+        if(wd->level != CO_WDOG_OK){
+            CO_wdog_recover(wd);
+        }
+    }
+}
+
+
+static void *CO_wdog_thread(void *arg){
+    CO_wdog_t *wd = (CO_wdog_t*)arg;
+    int64_t period = (int64_t)wd->rtCfg->wdogPeriod_ms * 1000000;
+    int64_t next;
+
+    CO_rtThreadApply(wd->rtCfg, &wd->rtCfg->wdog);
+
+    next = CO_wdog_now();
+    while(wd->run){
+        struct timespec t;
+        int64_t now;
+        bool_t kick;
+
+        next += period;
+        t.tv_sec = (time_t)(next / 1000000000);
+        t.tv_nsec = (long)(next % 1000000000);
+        while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL) == EINTR);
+        if(!wd->run){
+            break;
+        }
+
+        /* After suspend of the whole system checks do not run back to back. */
+        now = CO_wdog_now();
+        if(now - next > period){
+            next = now;
+        }
+
+        pthread_mutex_lock(&wd->mtx);
+        if(wd->CO != NULL){
+            CO_wdog_check(wd, now);
+        }
+        kick = wd->level < CO_WDOG_PREOP;
+        pthread_mutex_unlock(&wd->mtx);
+
+        if(kick){
+            CO_wdog_kick(wd);
+        }
+    }
+
+    return NULL;
+}
+
+
+/******************************************************************************/
+int CO_wdog_init(CO_wdog_t *wd, const CO_rtCfg_t *rtCfg){
+    int err;
+
+    memset(wd, 0, sizeof(*wd));
+    wd->rtCfg = rtCfg;
+    wd->fdDev = -1;
+    wd->fdNotify = -1;
+    err = pthread_mutex_init(&wd->mtx, NULL);
+    if(err != 0){
+        errno = err;
+        return -1;
+    }
+    if(rtCfg->wdogPeriod_ms == 0){
+        return 0;
+    }
+
+    if(rtCfg->wdogDevice[0] != 0){
+        wd->fdDev = open(rtCfg->wdogDevice, O_WRONLY | O_CLOEXEC);
+        if(wd->fdDev == -1){
+            if(LEVEL_1){sprintf(logLine,
+                    "FILE: CO_Linux_wdog.c"
+                    "||CALL: CO_wdog_init"
+                    "\nMSG: watchdog device %s can not be opened, errno=%d",rtCfg->wdogDevice,errno); logPrint(ERROR,logLine);}
+            return -1;
+        }
+    }
+    CO_wdog_openNotify(wd);
+    CO_wdog_notify(wd, "READY=1");
+
+    wd->run = 1;
+    err = pthread_create(&wd->thread, NULL, CO_wdog_thread, wd);
+    if(err != 0){
+        wd->run = 0;
+        CO_wdog_close(wd);
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+
+/******************************************************************************/
+void CO_wdog_close(CO_wdog_t *wd){
+    if(wd->run){
+        wd->run = 0;
+        pthread_join(wd->thread, NULL);
+    }
+
+    CO_wdog_notify(wd, "STOPPING=1");
+    if(wd->fdNotify >= 0){
+        close(wd->fdNotify);
+        wd->fdNotify = -1;
+    }
+    if(wd->fdDev >= 0){
+        /* Magic close disarms the device, if driver allows it. */
+        if(write(wd->fdDev, "V", 1) == -1)
+            CO_error(0x26300000L + errno);
+        close(wd->fdDev);
+        wd->fdDev = -1;
+    }
+
+    if(wd->lateChecks != 0){
+        if(LEVEL_1){sprintf(logLine,
+                "FILE: CO_Linux_wdog.c"
+                "||CALL: CO_wdog_close"
+                "\nMSG: late checks=%u, highest level=%d",wd->lateChecks,wd->maxLevel); logPrint(LOG,logLine);}
+    }
+    pthread_mutex_destroy(&wd->mtx);
+}
+
+
+/******************************************************************************/
+void CO_wdog_attach(CO_wdog_t *wd, CO_t *CO, CO_taskMain_t *tm, CO_taskRT_t *rt){
+    int64_t now = CO_wdog_now();
+
+    pthread_mutex_lock(&wd->mtx);
+    wd->CO = CO;
+    wd->tm = tm;
+    wd->rt = rt;
+    wd->level = CO_WDOG_OK;
+    wd->late = 0;
+    wd->good = 0;
+    wd->rtProgress = __atomic_load_n(&rt->progress, __ATOMIC_ACQUIRE);
+    wd->mainProgress = __atomic_load_n(&tm->progress, __ATOMIC_ACQUIRE);
+    wd->rtMissed = __atomic_load_n(&rt->stats.missedTicks, __ATOMIC_RELAXED);
+    wd->rtSeen_ns = now;
+    wd->mainSeen_ns = now;
+    pthread_mutex_unlock(&wd->mtx);
+}
+
+
+/******************************************************************************/
+void CO_wdog_detach(CO_wdog_t *wd){
+    pthread_mutex_lock(&wd->mtx);
+    if(wd->CO != NULL && wd->level >= CO_WDOG_DEGRADE){
+        CO_setTPDOslowdown(wd->CO, 0);
+    }
+    wd->CO = NULL;
+    wd->level = CO_WDOG_OK;
+    pthread_mutex_unlock(&wd->mtx);
+}
@@ -44,6 +44,8 @@
  */
 
 
+#define LOG_MODULE LOG_MOD_NMT   /* runtime log level tag, see Logger.h */
+
 #include "CO_driver.h"
 #include "CO_SDO.h"
 #include "CO_Emergency.h"
@@ -133,6 +135,11 @@ static void CO_NMT_receive(void *object, const CO_CANrxMsg_t *msg){
         if(NMT->pFunctNMT!=NULL && currentOperatingState!=NMT->operatingState){
             NMT->pFunctNMT(NMT->operatingState);
         }
+
+        /* Optional signal to RTOS, which can resume task, which handles CO_NMT_process */
+        if(NMT->pFunctSignal != NULL){
+            NMT->pFunctSignal(NMT->functSignalObject);
+        }
     }
 }
 
@@ -178,6 +185,7 @@ CO_ReturnError_t CO_NMT_init(
     NMT->HBproducerTimer        = 0xFFFF;
     NMT->emPr                   = emPr;
     NMT->pFunctNMT              = NULL;
+    NMT->pFunctSignal           = NULL;
 
 	if(LEVEL_1){sprintf(logLine,
 			"FILE: CO_NMT_Heartbeat.c"
@@ -232,6 +240,19 @@ void CO_NMT_initCallback(
 }
 
 
+/******************************************************************************/
+void CO_NMT_initCallbackSignal(
+        CO_NMT_t               *NMT,
+        void                   *object,
+        void                  (*pFunctSignal)(void *object))
+{
+    if(NMT != NULL){
+        NMT->functSignalObject = object;
+        NMT->pFunctSignal = pFunctSignal;
+    }
+}
+
+
 /******************************************************************************/
 void CO_NMT_blinkingProcess50ms(CO_NMT_t *NMT){
 
@@ -280,7 +301,7 @@ CO_NMT_reset_cmd_t CO_NMT_process(
         uint32_t                NMTstartup,
         uint8_t                 errorRegister,
         const uint8_t           errorBehavior[],
-        uint16_t               *timerNext_ms)
+        uint32_t               *timerNext_us)
 {
 	if(LEVEL_1){sprintf(logLine,
 			"FILE: CO_NMT_Heartbeat.c"
@@ -331,20 +352,20 @@ CO_NMT_reset_cmd_t CO_NMT_process(
     }
 
 
-    /* Calculate, when next Heartbeat needs to be send and lower timerNext_ms if necessary. */
+    /* Calculate, when next Heartbeat needs to be send and lower timerNext_us if necessary. */
    	if(LEVEL_1){sprintf(logLine,
     				"FILE: CO_NMT_Heartbeat.c"
     				"||CALL: CO_NMT_process"
     				"\nMSG: Calculate next HB producer time "); logPrint(LOG,logLine);}
 
-    if(HBtime != 0 && timerNext_ms != NULL){
+    if(HBtime != 0 && timerNext_us != NULL){
         if(NMT->HBproducerTimer < HBtime){
-            uint16_t diff = HBtime - NMT->HBproducerTimer;
-            if(*timerNext_ms > diff){
-                *timerNext_ms = diff;
+            uint32_t diff = (uint32_t)(HBtime - NMT->HBproducerTimer) * 1000U;
+            if(*timerNext_us > diff){
+                *timerNext_us = diff;
             }
         }else{
-            *timerNext_ms = 0;
+            *timerNext_us = 0;
         }
     }
 
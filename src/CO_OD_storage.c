@@ -24,6 +24,8 @@
  */
 
 
+#define LOG_MODULE LOG_MOD_STORAGE   /* runtime log level tag, see Logger.h */
+
 #include "CO_driver.h"
 #include "CO_SDO.h"
 #include "CO_Emergency.h"
@@ -94,7 +96,7 @@ if(LEVEL_1){
 			 logPrint(LOG,logLine);}
 
 
-                if(CO_OD_storage_saveSecure(odStor->odAddress, odStor->odSize, odStor->filename) != 0) {
+                if(CO_OD_storage_saveSecure(odStor->odAddress, odStor->odSize, odStor->filename, odStor->CANmodule) != 0) {
                     ret = CO_SDO_AB_HW;
                 }
             }
@@ -185,7 +187,8 @@ if(LEVEL_1){
 int CO_OD_storage_saveSecure(
         uint8_t                *odAddress,
         uint32_t                odSize,
-        char                   *filename)
+        char                   *filename,
+        CO_CANmodule_t         *CANmodule)
 {
 
 	if(LEVEL_1){
@@ -239,19 +242,33 @@ if(LEVEL_1){
         	    	 logPrint(LOG,logLine);}
 
 
-    /* Open a new file and write data to it, including CRC. */
+    /* Open a new file and write data to it, including CRC. Data are copied
+     * first, so CO_LOCK_OD is held only for memcpy. RPDOs do not take it,
+     * copy is repeated, if they wrote meanwhile. */
     if(ret == RETURN_SUCCESS) {
         FILE *fp = fopen(filename, "w");
-        if(fp != NULL) {
+        uint8_t *image = malloc(odSize);
+        if(fp != NULL && image != NULL) {
+            uint32_t seq;
+
+            CO_LOCK_OD(CANmodule);
+            do {
+                seq = CO_OD_seqReadBegin(CANmodule);
+                memcpy(image, odAddress, odSize);
+            } while(CO_OD_seqReadRetry(CANmodule, seq));
+            CO_UNLOCK_OD(CANmodule);
 
-            CO_LOCK_OD();
-            fwrite((const void *)odAddress, 1, odSize, fp);
-            CRC = crc16_ccitt((unsigned char*)odAddress, odSize, 0);
-            CO_UNLOCK_OD();
+            fwrite((const void *)image, 1, odSize, fp);
+            CRC = crc16_ccitt((unsigned char*)image, odSize, 0);
 
             fwrite((const void *)&CRC, 1, 2, fp);
             fclose(fp);
+            free(image);
         } else {
+            if(fp != NULL) {
+                fclose(fp);
+            }
+            free(image);
 
 if(LEVEL_1){
 		 sprintf(logLine,"FILE:CO_OD_storage.C||"
@@ -403,7 +420,8 @@ CO_ReturnError_t CO_OD_storage_init(
         CO_OD_storage_t        *odStor,
         uint8_t                *odAddress,
         uint32_t                odSize,
-        char                   *filename)
+        char                   *filename,
+        CO_CANmodule_t         *CANmodule)
 {
 	if(LEVEL_1){
 			 sprintf(logLine,"FILE:CO_OD_storage.C||"
@@ -424,7 +442,7 @@ CO_ReturnError_t CO_OD_storage_init(
     			 logPrint(LOG,logLine);}
 
 
-    if(odStor==NULL || odAddress==NULL) {
+    if(odStor==NULL || odAddress==NULL || CANmodule==NULL) {
 
 
 
@@ -453,6 +471,7 @@ CO_ReturnError_t CO_OD_storage_init(
         odStor->odAddress = odAddress;
         odStor->odSize = odSize;
         odStor->filename = filename;
+        odStor->CANmodule = CANmodule;
         odStor->fp = NULL;
         odStor->tmr1msPrev = 0;
         odStor->lastSavedMs = 0;
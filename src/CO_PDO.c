@@ -44,6 +44,8 @@
  */
 
 
+#define LOG_MODULE LOG_MOD_PDO   /* runtime log level tag, see Logger.h */
+
 #include "CO_driver.h"
 #include "CO_SDO.h"
 #include "CO_Emergency.h"
@@ -53,6 +55,47 @@
 #include <string.h>
 #include"Logger.h"
 
+
+/* Attempts of consistent read of TPDO mapped variables, see CO_TPDOsend(). */
+#define CO_TPDO_SEQ_TRIES   4U
+
+
+/*
+ * Write received frame into RPDO buffer. Sequence is odd while data are
+ * written, so CO_RPDO_readRx() detects, that receive overwrote the buffer
+ * during its copy. Only receive writes the buffer.
+ */
+static void CO_RPDO_writeRx(CO_RPDO_t *RPDO, uint8_t bufNo, const uint8_t *data){
+    uint32_t seq = __atomic_load_n(&RPDO->CANrxSeq[bufNo], __ATOMIC_RELAXED);
+    int i;
+
+    __atomic_store_n(&RPDO->CANrxSeq[bufNo], seq + 1U, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    for(i=0; i<8; i++){
+        __atomic_store_n(&RPDO->CANrxData[bufNo][i], data[i], __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&RPDO->CANrxSeq[bufNo], seq + 2U, __ATOMIC_RELEASE);
+    CO_FLAG_SET(RPDO->CANrxNew[bufNo]);
+    if(RPDO->pending != NULL){
+        __atomic_fetch_or(RPDO->pending, RPDO->pendingMask, __ATOMIC_RELEASE);
+    }
+}
+
+
+/*
+ * Copy RPDO buffer to data. Returns false, if data are torn.
+ */
+static bool_t CO_RPDO_readRx(CO_RPDO_t *RPDO, uint8_t bufNo, uint8_t *data){
+    uint32_t seq = __atomic_load_n(&RPDO->CANrxSeq[bufNo], __ATOMIC_ACQUIRE);
+    int i;
+
+    for(i=0; i<8; i++){
+        data[i] = __atomic_load_n(&RPDO->CANrxData[bufNo][i], __ATOMIC_RELAXED);
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return (seq & 1U) == 0U && __atomic_load_n(&RPDO->CANrxSeq[bufNo], __ATOMIC_RELAXED) == seq;
+}
+
 /*
  * Read received message from CAN module.
  *
@@ -92,18 +135,9 @@ static void CO_PDO_receive(void *object, const CO_CANrxMsg_t *msg){
     	    	  						 "Call: CO_PDO_receive"
     	    	  						 "\n, msg: check RPDO synchronous or not");
     	    	  			   	 logPrint(LOG,logLine);}
-        if(RPDO->synchronous && RPDO->SYNC->CANrxToggle) {
+        if(RPDO->synchronous && CO_FLAG_READ(RPDO->SYNC->CANrxToggle)) {
             /* copy data into second buffer and set 'new message' flag */
-            RPDO->CANrxData[1][0] = msg->data[0];
-            RPDO->CANrxData[1][1] = msg->data[1];
-            RPDO->CANrxData[1][2] = msg->data[2];
-            RPDO->CANrxData[1][3] = msg->data[3];
-            RPDO->CANrxData[1][4] = msg->data[4];
-            RPDO->CANrxData[1][5] = msg->data[5];
-            RPDO->CANrxData[1][6] = msg->data[6];
-            RPDO->CANrxData[1][7] = msg->data[7];
-
-            RPDO->CANrxNew[1] = true;
+            CO_RPDO_writeRx(RPDO, 1, msg->data);
         }
         else {
 
@@ -112,16 +146,7 @@ static void CO_PDO_receive(void *object, const CO_CANrxMsg_t *msg){
         	    	  						 "\n, msg: copy data into default buffer of RPDO");
         	    	  			   	 logPrint(LOG,logLine);}
             /* copy data into default buffer and set 'new message' flag */
-            RPDO->CANrxData[0][0] = msg->data[0];
-            RPDO->CANrxData[0][1] = msg->data[1];
-            RPDO->CANrxData[0][2] = msg->data[2];
-            RPDO->CANrxData[0][3] = msg->data[3];
-            RPDO->CANrxData[0][4] = msg->data[4];
-            RPDO->CANrxData[0][5] = msg->data[5];
-            RPDO->CANrxData[0][6] = msg->data[6];
-            RPDO->CANrxData[0][7] = msg->data[7];
-
-            RPDO->CANrxNew[0] = true;
+            CO_RPDO_writeRx(RPDO, 0, msg->data);
         }
     }
 }
@@ -176,7 +201,7 @@ static void CO_RPDOconfigCom(CO_RPDO_t* RPDO, uint32_t COB_IDUsedByRPDO){
 
         ID = 0;
         RPDO->valid = false;
-        RPDO->CANrxNew[0] = RPDO->CANrxNew[1] = false;
+        CO_FLAG_CLEAR(RPDO->CANrxNew[0]); CO_FLAG_CLEAR(RPDO->CANrxNew[1]);
     }
 
     if(LEVEL_1){ sprintf(logLine,"FILE:CO_PDO.C||"
@@ -203,7 +228,7 @@ static void CO_RPDOconfigCom(CO_RPDO_t* RPDO, uint32_t COB_IDUsedByRPDO){
 
     if(r != CO_ERROR_NO){
         RPDO->valid = false;
-        RPDO->CANrxNew[0] = RPDO->CANrxNew[1] = false;
+        CO_FLAG_CLEAR(RPDO->CANrxNew[0]); CO_FLAG_CLEAR(RPDO->CANrxNew[1]);
 
     if(LEVEL_1){ sprintf(logLine,"FILE:CO_PDO.C||""Call: CO_RPDOconfigCom"
                 		        	    	  	"\n,msg:RPDO not valid ");
@@ -793,7 +818,7 @@ static CO_SDO_abortCode_t CO_ODF_RPDOcom(CO_ODF_arg_t *ODF_arg){
 
         /* Remove old message from second buffer. */
         if(RPDO->synchronous != synchronousPrev) {
-            RPDO->CANrxNew[1] = false;
+            CO_FLAG_CLEAR(RPDO->CANrxNew[1]);
         }
     }
 
@@ -958,7 +983,7 @@ if(LEVEL_1){ sprintf(logLine,"FILE:CO_PDO.C||"
 
             return CO_SDO_AB_INVALID_VALUE;  /* Invalid value for parameter (download only). */
 
-        TPDO->inhibitTimer = 0;
+        TPDO->inhibitEnd = 0;
     }
 
     if(LEVEL_1){ sprintf(logLine,"FILE:CO_PDO.C||"
@@ -969,9 +994,8 @@ if(LEVEL_1){ sprintf(logLine,"FILE:CO_PDO.C||"
 
 
     else if(ODF_arg->subIndex == 5){   /* Event_Timer */
-        uint16_t *value = (uint16_t*) ODF_arg->data;
-
-        TPDO->eventTimer = ((uint32_t) *value) * 1000;
+        /* restarted with the new value by the next processing */
+        TPDO->eventNext = 0;
     }
 
     if(LEVEL_1){ sprintf(logLine,"FILE:CO_PDO.C||"
@@ -1353,7 +1377,9 @@ CO_ReturnError_t CO_RPDO_init(
     CO_OD_configure(SDO, idx_RPDOMapPar, CO_ODF_RPDOmap, (void*)RPDO, 0, 0);
 
     /* configure communication and mapping */
-    RPDO->CANrxNew[0] = RPDO->CANrxNew[1] = false;
+    CO_FLAG_CLEAR(RPDO->CANrxNew[0]); CO_FLAG_CLEAR(RPDO->CANrxNew[1]);
+    RPDO->CANrxSeq[0] = RPDO->CANrxSeq[1] = 0;
+    RPDO->pending = NULL;
     RPDO->CANdevRx = CANdevRx;
     RPDO->CANdevRxIdx = CANdevRxIdx;
 
@@ -1370,6 +1396,18 @@ CO_ReturnError_t CO_RPDO_init(
 }
 
 
+/*
+ * Timer of asynchronous TPDO expired: event timer, end of inhibit time or
+ * next Change of State check.
+ */
+static void CO_TPDO_tmrExpired(void *object){
+    CO_TPDO_t *TPDO = (CO_TPDO_t*)object;
+
+    if(!TPDO->sendRequest) TPDO->sendRequest = CO_TPDOisCOS(TPDO);
+    CO_TPDO_process(TPDO, NULL, false);
+}
+
+
 /******************************************************************************/
 CO_ReturnError_t CO_TPDO_init(
         CO_TPDO_t              *TPDO,
@@ -1384,7 +1422,8 @@ CO_ReturnError_t CO_TPDO_init(
         uint16_t                idx_TPDOCommPar,
         uint16_t                idx_TPDOMapPar,
         CO_CANmodule_t         *CANdevTx,
-        uint16_t                CANdevTxIdx)
+        uint16_t                CANdevTxIdx,
+        CO_tmrWheel_t          *wheel)
 {
 	 if(LEVEL_1){ sprintf(logLine,"FILE:CO_PDO.C||"
 				  "Call:CO_TPDO_init"
@@ -1395,7 +1434,7 @@ CO_ReturnError_t CO_TPDO_init(
 
     /* verify arguments */
     if(TPDO==NULL || em==NULL || SDO==NULL || operatingState==NULL ||
-        TPDOCommPar==NULL || TPDOMapPar==NULL || CANdevTx==NULL){
+        TPDOCommPar==NULL || TPDOMapPar==NULL || CANdevTx==NULL || wheel==NULL){
 
 
         if(LEVEL_1){ sprintf(logLine,"FILE:CO_PDO.C||"
@@ -1434,8 +1473,12 @@ CO_ReturnError_t CO_TPDO_init(
     TPDO->CANdevTx = CANdevTx;
     TPDO->CANdevTxIdx = CANdevTxIdx;
     TPDO->syncCounter = 255;
-    TPDO->inhibitTimer = 0;
-    TPDO->eventTimer = ((uint32_t) TPDOCommPar->eventTimer) * 1000;
+    TPDO->slowdown = 0;
+    TPDO->cosPoll_us = CO_TPDO_COS_POLL_US;
+    TPDO->inhibitEnd = 0;
+    TPDO->eventNext = 0;
+    TPDO->wheel = wheel;
+    CO_tmr_init(&TPDO->tmr, (void*)TPDO, CO_TPDO_tmrExpired);
 
 
     if(LEVEL_1){ sprintf(logLine,"FILE:CO_PDO.C||"
@@ -1517,6 +1560,8 @@ int16_t CO_TPDOsend(CO_TPDO_t *TPDO){
 					logPrint(LOG,logLine);}
 
     int16_t i;
+    uint8_t tries;
+    uint8_t data[8];
     uint8_t* pPDOdataByte;
     uint8_t** ppODdataByte;
 
@@ -1554,13 +1599,22 @@ int16_t CO_TPDOsend(CO_TPDO_t *TPDO){
         }
     }
 #endif
-    i = TPDO->dataLength;
-    pPDOdataByte = &TPDO->CANtxBuff->data[0];
-    ppODdataByte = &TPDO->mapPointer[0];
-
-    /* Copy data from Object dictionary. */
-    for(; i>0; i--) {
-        *(pPDOdataByte++) = **(ppODdataByte++);
+    /* Copy data from Object dictionary. Mainline may write mapped variables
+     * meanwhile, so copy is repeated few times. If it is still not consistent,
+     * previous data in CANtxBuff are sent. */
+    for(tries=CO_TPDO_SEQ_TRIES; tries>0; tries--) {
+        uint32_t seq = CO_OD_seqReadBegin(TPDO->CANdevTx);
+
+        i = TPDO->dataLength;
+        pPDOdataByte = &data[0];
+        ppODdataByte = &TPDO->mapPointer[0];
+        for(; i>0; i--) {
+            *(pPDOdataByte++) = **(ppODdataByte++);
+        }
+        if(!CO_OD_seqReadRetry(TPDO->CANdevTx, seq)) {
+            memcpy(TPDO->CANtxBuff->data, data, TPDO->dataLength);
+            break;
+        }
     }
 
     TPDO->sendRequest = 0;
@@ -1589,7 +1643,7 @@ void CO_RPDO_process(CO_RPDO_t *RPDO, bool_t syncWas){
 
 	if(!RPDO->valid || !(*RPDO->operatingState == CO_NMT_OPERATIONAL))
     {
-        RPDO->CANrxNew[0] = RPDO->CANrxNew[1] = false;
+        CO_FLAG_CLEAR(RPDO->CANrxNew[0]); CO_FLAG_CLEAR(RPDO->CANrxNew[1]);
     }
     else if(!RPDO->synchronous || syncWas)
     {
@@ -1603,12 +1657,13 @@ void CO_RPDO_process(CO_RPDO_t *RPDO, bool_t syncWas){
 //*********************************************************************************************************/
 
         /* Determine, which of the two rx buffers, contains relevant message. */
-        if(RPDO->synchronous && !RPDO->SYNC->CANrxToggle) {
+        if(RPDO->synchronous && !CO_FLAG_READ(RPDO->SYNC->CANrxToggle)) {
             bufNo = 1;
         }
 
-        while(RPDO->CANrxNew[bufNo]){
+        while(CO_FLAG_READ(RPDO->CANrxNew[bufNo])){
             int16_t i;
+            uint8_t data[8];
             uint8_t* pPDOdataByte;
             uint8_t** ppODdataByte;
 //*********************************************************************************************************/
@@ -1620,15 +1675,27 @@ void CO_RPDO_process(CO_RPDO_t *RPDO, bool_t syncWas){
 //*********************************************************************************************************/
 
             i = RPDO->dataLength;
-            pPDOdataByte = &RPDO->CANrxData[bufNo][0];
+            pPDOdataByte = &data[0];
             ppODdataByte = &RPDO->mapPointer[0];
 
-            /* Copy data to Object dictionary. If between the copy operation CANrxNew
-             * is set to true by receive thread, then copy the latest data again. */
-            RPDO->CANrxNew[bufNo] = false;
+            /* Do not wait for mainline, which writes OD variables. Data stay in
+             * the buffer and are copied in the next cycle. */
+            if(!CO_OD_seqTryWriteBegin(RPDO->CANdevRx)) {
+                break;
+            }
+
+            /* Flag is taken before the copy, so message received meanwhile sets
+             * it again and is copied in the next pass. Torn data are dropped,
+             * receive sets the flag again after it has written the buffer. */
+            (void)__atomic_exchange_n(&RPDO->CANrxNew[bufNo], false, __ATOMIC_ACQ_REL);
+            if(!CO_RPDO_readRx(RPDO, bufNo, data)) {
+                CO_OD_seqWriteEnd(RPDO->CANdevRx);
+                continue;
+            }
             for(; i>0; i--) {
                 **(ppODdataByte++) = *(pPDOdataByte++);
             }
+            CO_OD_seqWriteEnd(RPDO->CANdevRx);
 
 #ifdef RPDO_CALLS_EXTENSION
             if(RPDO->SDO->ODExtensions){
@@ -1662,12 +1729,36 @@ void CO_RPDO_process(CO_RPDO_t *RPDO, bool_t syncWas){
 }
 
 
+/* Event timer of TPDO in microseconds, scaled by slowdown. */
+static uint32_t CO_TPDO_eventTime(CO_TPDO_t *TPDO){
+    return (((uint32_t) TPDO->TPDOCommPar->eventTimer) * 1000) << TPDO->slowdown;
+}
+
+
+/* Inhibit time of TPDO in microseconds, scaled by slowdown. */
+static uint32_t CO_TPDO_inhibitTime(CO_TPDO_t *TPDO){
+    uint32_t inhibit = ((uint32_t) TPDO->TPDOCommPar->inhibitTime) * 100;
+
+    if(TPDO->slowdown > 0 && inhibit < CO_TPDO_COS_POLL_US){
+        inhibit = CO_TPDO_COS_POLL_US;
+    }
+    return inhibit << TPDO->slowdown;
+}
+
+
+/* Number of SYNCs between synchronous cyclic TPDOs, scaled by slowdown. */
+static uint8_t CO_TPDO_syncCount(CO_TPDO_t *TPDO){
+    uint32_t count = ((uint32_t) TPDO->TPDOCommPar->transmissionType) << TPDO->slowdown;
+
+    return (count > 240) ? 240 : (uint8_t) count;
+}
+
+
 /******************************************************************************/
 void CO_TPDO_process(
         CO_TPDO_t              *TPDO,
         CO_SYNC_t              *SYNC,
-        bool_t                  syncWas,
-        uint32_t                timeDifference_us)
+        bool_t                  syncWas)
 {
 	  if(LEVEL_1){ sprintf(logLine,"FILE:CO_PDO.C||"
 			  "Call:CO_TPDO_process"
@@ -1689,25 +1780,60 @@ void CO_TPDO_process(
 
 
         if(TPDO->TPDOCommPar->transmissionType >= 253){
-            if(TPDO->inhibitTimer == 0 && (TPDO->sendRequest || (TPDO->TPDOCommPar->eventTimer && TPDO->eventTimer == 0))){
+            uint64_t now = TPDO->wheel->now;
+            uint64_t next = UINT64_MAX;
+
+            if(TPDO->TPDOCommPar->eventTimer && TPDO->eventNext == 0){
+                TPDO->eventNext = now + CO_TPDO_eventTime(TPDO);
+            }
+            if(TPDO->inhibitEnd <= now && (TPDO->sendRequest || (TPDO->TPDOCommPar->eventTimer && TPDO->eventNext <= now))){
                 if(CO_TPDOsend(TPDO) == CO_ERROR_NO){
                     /* successfully sent */
-                    TPDO->inhibitTimer = ((uint32_t) TPDO->TPDOCommPar->inhibitTime) * 100;
-                    TPDO->eventTimer = ((uint32_t) TPDO->TPDOCommPar->eventTimer) * 1000;
+                    TPDO->inhibitEnd = now + CO_TPDO_inhibitTime(TPDO);
+                    TPDO->eventNext = now + CO_TPDO_eventTime(TPDO);
+                }
+            }
+
+            /* Timer is needed, when event timer expires or when Change of
+             * State (or failed request) is checked again, but not within inhibit time. */
+            if(TPDO->TPDOCommPar->eventTimer){
+                next = TPDO->eventNext;
+            }
+            if(TPDO->sendRequest){
+                if(next > now + CO_TPDO_COS_POLL_US){
+                    next = now + CO_TPDO_COS_POLL_US;
                 }
             }
+            else if(TPDO->TPDOCommPar->transmissionType >= 254 && TPDO->sendIfCOSFlags != 0 && TPDO->cosPoll_us != 0){
+                if(next > now + TPDO->cosPoll_us){
+                    next = now + TPDO->cosPoll_us;
+                }
+            }
+            if(next < TPDO->inhibitEnd){
+                next = TPDO->inhibitEnd;
+            }
+            if(next <= now){
+                /* sending failed, CAN buffer is full */
+                next = now + CO_TPDO_COS_POLL_US;
+            }
+            if(next != UINT64_MAX){
+                CO_tmr_startAt(TPDO->wheel, &TPDO->tmr, next);
+            }
+            else{
+                CO_tmr_stop(TPDO->wheel, &TPDO->tmr);
+            }
         }
-//*********************************************************************************************************/
 
-        if(LEVEL_1){ sprintf(logLine,"FILE:CO_PDO.C||"
-           				  "Call:CO_TPDO_process"
-           				 "\n msg:TPDO is synchronous");
-           					logPrint(LOG,logLine);}
+        /* Synchronous PDOs */
+        else if(SYNC && syncWas){
 //*********************************************************************************************************/
 
+            if(LEVEL_1){ sprintf(logLine,"FILE:CO_PDO.C||"
+               				  "Call:CO_TPDO_process"
+               				 "\n msg:TPDO is synchronous");
+               					logPrint(LOG,logLine);}
+//*********************************************************************************************************/
 
-        /* Synchronous PDOs */
-        else if(SYNC && syncWas){
             /* send synchronous acyclic PDO */
             if(TPDO->TPDOCommPar->transmissionType == 0){
                 if(TPDO->sendRequest) CO_TPDOsend(TPDO);
@@ -1719,40 +1845,37 @@ void CO_TPDO_process(
                     if(SYNC->counterOverflowValue && TPDO->TPDOCommPar->SYNCStartValue)
                         TPDO->syncCounter = 254;   /* SYNCStartValue is in use */
                     else
-                        TPDO->syncCounter = TPDO->TPDOCommPar->transmissionType;
+                        TPDO->syncCounter = CO_TPDO_syncCount(TPDO);
                 }
                 /* if the SYNCStartValue is in use, start first TPDO after SYNC with matched SYNCStartValue. */
                 if(TPDO->syncCounter == 254){
                     if(SYNC->counter == TPDO->TPDOCommPar->SYNCStartValue){
-                        TPDO->syncCounter = TPDO->TPDOCommPar->transmissionType;
+                        TPDO->syncCounter = CO_TPDO_syncCount(TPDO);
                         CO_TPDOsend(TPDO);
                     }
                 }
                 /* Send PDO after every N-th Sync */
                 else if(--TPDO->syncCounter == 0){
-                    TPDO->syncCounter = TPDO->TPDOCommPar->transmissionType;
+                    TPDO->syncCounter = CO_TPDO_syncCount(TPDO);
                     CO_TPDOsend(TPDO);
                 }
             }
         }
 
     }
+    else{
+//*********************************************************************************************************/
 
- //*********************************************************************************************************/
-
-    if(LEVEL_1){ sprintf(logLine,"FILE:CO_PDO.C||"
+        /* fires every cycle until operational, each TPDO has own site */
+        if(LEVEL_1 && logSiteAllow(&TPDO->notOperationalSite)){ sprintf(logLine,"FILE:CO_PDO.C||"
               				  "Call:CO_TPDO_process"
               				 "\n ERROR:TPDO is not operational or not valid");
-              					logPrint(ERROR,logLine);}
+              					logPrintSite(&TPDO->notOperationalSite,ERROR,logLine);}
 //*********************************************************************************************************/
 
-    else{
         /* Not operational or valid. Force TPDO first send after operational or valid. */
         if(TPDO->TPDOCommPar->transmissionType>=254) TPDO->sendRequest = 1;
         else                                         TPDO->sendRequest = 0;
+        CO_tmr_stop(TPDO->wheel, &TPDO->tmr);
     }
-
-    /* update timers */
-    TPDO->inhibitTimer = (TPDO->inhibitTimer > timeDifference_us) ? (TPDO->inhibitTimer - timeDifference_us) : 0;
-    TPDO->eventTimer = (TPDO->eventTimer > timeDifference_us) ? (TPDO->eventTimer - timeDifference_us) : 0;
 }
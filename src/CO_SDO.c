@@ -44,6 +44,8 @@
  */
 
 
+#define LOG_MODULE LOG_MOD_SDO   /* runtime log level tag, see Logger.h */
+
 #include "CO_driver.h"
 #include "CO_SDO.h"
 #include "crc16-ccitt.h"
@@ -194,7 +196,7 @@ static void CO_SDO_receive(void *object, const CO_CANrxMsg_t *msg)
     SDO = (CO_SDO_t*)object;   /* this is the correct pointer type of the first argument */
 
     /* verify message length and message overflow (previous message was not processed yet) */
-    if((msg->DLC == 8U) && (!SDO->CANrxNew)){
+    if((msg->DLC == 8U) && (!CO_FLAG_READ(SDO->CANrxNew))){
     	if(LEVEL_1){sprintf(logLine,
     			"FILE: CO_SDO.c"
     			"||CALL: CO_SDO_receive"
@@ -221,7 +223,7 @@ static void CO_SDO_receive(void *object, const CO_CANrxMsg_t *msg)
         	        			"||CALL: CO_SDO_receive"
         	        			"\nMSG:Copy Data and set New received message flag"); logPrint(LOG,logLine);}
 
-            SDO->CANrxNew = true;
+            CO_FLAG_SET(SDO->CANrxNew);
         }
         else
         {
@@ -256,7 +258,7 @@ static void CO_SDO_receive(void *object, const CO_CANrxMsg_t *msg)
                     if(SDO->bufferOffset >= CO_SDO_BUFFER_SIZE) {
                         /* buffer full, break reception */
                         SDO->state = CO_SDO_ST_DOWNLOAD_BL_SUB_RESP;
-                        SDO->CANrxNew = true;
+                        CO_FLAG_SET(SDO->CANrxNew);
                         break;
                     }
                 }
@@ -270,7 +272,7 @@ static void CO_SDO_receive(void *object, const CO_CANrxMsg_t *msg)
                    			"\nMSG: break reception last segment or block sequence is too large"); logPrint(LOG,logLine);}
 
                    	SDO->state = CO_SDO_ST_DOWNLOAD_BL_SUB_RESP;
-                    SDO->CANrxNew = true;
+                    CO_FLAG_SET(SDO->CANrxNew);
                 }
             }
             else if((seqno == SDO->sequence) || (SDO->sequence == 0U))
@@ -290,17 +292,17 @@ static void CO_SDO_receive(void *object, const CO_CANrxMsg_t *msg)
                    			"\nMSG: sequence number is totally wrong, break reception."); logPrint(LOG,logLine);}
 
                 SDO->state = CO_SDO_ST_DOWNLOAD_BL_SUB_RESP;
-                SDO->CANrxNew = true;
+                CO_FLAG_SET(SDO->CANrxNew);
             }
         }
 
         /* Optional signal to RTOS, which can resume task, which handles SDO server. */
-        if(SDO->CANrxNew && SDO->pFunctSignal != NULL) {
+        if(CO_FLAG_READ(SDO->CANrxNew) && SDO->pFunctSignal != NULL) {
           	if(LEVEL_1){sprintf(logLine,
           			"FILE: CO_SDO.c"
           			"||CALL: CO_SDO_receive"
           			"\nMSG: Calling Registered call back function of SDO server"); logPrint(LOG,logLine);}
-            SDO->pFunctSignal();
+            SDO->pFunctSignal(SDO->functSignalObject);
         }
     }
 }
@@ -350,6 +352,7 @@ CO_ReturnError_t CO_SDO_init(
         const CO_OD_entry_t     OD[],//input
         uint16_t                ODSize,//input
         CO_OD_extension_t      *ODExtensions,//input
+        uint16_t               *ODindex,//input can be null
         uint8_t                 nodeId,//input
         CO_CANmodule_t         *CANdevRx,//input
         uint16_t                CANdevRxIdx,//input
@@ -400,6 +403,19 @@ CO_ReturnError_t CO_SDO_init(
             SDO->ODExtensions[i].object = NULL;
             SDO->ODExtensions[i].flags = NULL;
         }
+
+        /* index table, 0xFFFF for indexes not in OD */
+        SDO->ODindex = ODindex;
+        if(ODindex != NULL){
+            uint32_t idx;
+
+            for(idx=0U; idx<CO_OD_INDEX_TABLE_SIZE; idx++){
+                ODindex[idx] = 0xFFFFU;
+            }
+            for(i=0U; i<ODSize; i++){
+                ODindex[OD[i].index] = i;
+            }
+        }
     }
     /* copy object dictionary from parent */
     else{
@@ -412,12 +428,13 @@ CO_ReturnError_t CO_SDO_init(
         SDO->OD = parentSDO->OD;
         SDO->ODSize = parentSDO->ODSize;
         SDO->ODExtensions = parentSDO->ODExtensions;
+        SDO->ODindex = parentSDO->ODindex;
     }
 
     /* Configure object variables */
     SDO->nodeId = nodeId;//Configure SDO server node id.
     SDO->state = CO_SDO_ST_IDLE;//configure SDO server state to IDLE
-    SDO->CANrxNew = false;//no new message is received by SDO server
+    CO_FLAG_CLEAR(SDO->CANrxNew);//no new message is received by SDO server
     SDO->pFunctSignal = NULL;//callback function for SDO server is set to NULL.
 
 
@@ -483,7 +500,8 @@ CO_ReturnError_t CO_SDO_init(
 /******************************************************************************/
 void CO_SDO_initCallback(
         CO_SDO_t               *SDO,
-        void                  (*pFunctSignal)(void))
+        void                   *object,
+        void                  (*pFunctSignal)(void *object))
 {
 	if(LEVEL_1){sprintf(logLine,
 			"FILE: CO_SDO.c"
@@ -495,6 +513,7 @@ void CO_SDO_initCallback(
     			"FILE: CO_SDO.c"
     			"||CALL: CO_SDO_initCallback"
     			"\nMSG: Call back function attached for SDO server"); logPrint(LOG,logLine);}
+        SDO->functSignalObject = object;
         SDO->pFunctSignal = pFunctSignal;
     }
 }
@@ -560,71 +579,40 @@ void CO_OD_configure(
 
 /******************************************************************************/
 uint16_t CO_OD_find(CO_SDO_t *SDO, uint16_t index){
-    /* Fast search in ordered Object Dictionary. If indexes are mixed, this won't work. */
-    /* If Object Dictionary has up to 2^N entries, then N is max number of loop passes. */
-
-	if(LEVEL_1){sprintf(logLine,
-			"FILE: CO_SDO.c"
-			"||CALL: CO_OD_find"
-			"\nMSG: started"); logPrint(LOG,logLine);}
-
-	uint16_t cur, min, max;
+    uint16_t cur, min, max;
     const CO_OD_entry_t* object;//pointer to the OD entry
 
-    //init min amd max
-    //min to 0
-    //max to SDO server OD size. (Its the total OD indices for SDO server OD)
+    if(SDO->ODindex != NULL){
+        return SDO->ODindex[index];
+    }
+
+    /* Fast search in ordered Object Dictionary. If indexes are mixed, this won't work. */
+    /* If Object Dictionary has up to 2^N entries, then N is max number of loop passes. */
     min = 0U;
     max = SDO->ODSize - 1U;
-	if(LEVEL_1){sprintf(logLine,
-			"FILE: CO_SDO.c"
-			"||CALL: CO_OD_find"
-			"\nMSG: Searching entry value for OD index"); logPrint(LOG,logLine);}
-    //Find algorithm starts here
-			while(min < max)
-			{//min is smaller than max
-
-				cur = (min + max) / 2;//cur is mid point between min and max
-				object = &SDO->OD[cur];// point to the OD entry in accordance with cur
-
-				/* Is object matched */
-				if(index == object->index)
-				{//we got the OD entry which we are searching for
-					if(LEVEL_1){sprintf(logLine,
-							"FILE: CO_SDO.c"
-							"||CALL: CO_OD_find"
-							"\nMSG: Search successful. Entry for OD index found"); logPrint(LOG,logLine);}
-					//successful search. return the place value of the OD entry in the index table.
-					return cur;
-				}
+    while(min < max){
+        cur = (min + max) / 2;//cur is mid point between min and max
+        object = &SDO->OD[cur];
 
-				//we need to search again
-				if(index < object->index)
-				{//index we are searching is smaller than we are pointing now.
-					max = cur;
-					if(max) max--;//set max to (cur-1)
-				}
-				else
-					//index we are searching is greater than we are pointing now
-					min = cur + 1U;//set min to (cur+1)
-			}
-
-			//at one point after few loops, the min amd max become equal
-			if(min == max)
-			{//min is equal to max
-				object = &SDO->OD[min];
-				/* Is object matched */
-				if(index == object->index){
-					return min;
-				}
-			}
+        /* Is object matched */
+        if(index == object->index){
+            return cur;
+        }
+        if(index < object->index){
+            max = cur;
+            if(max) max--;//set max to (cur-1)
+        }
+        else
+            min = cur + 1U;//set min to (cur+1)
+    }
 
-			if(LEVEL_1){sprintf(logLine,
-					"FILE: CO_SDO.c"
-					"||CALL: CO_OD_find"
-					"\nMSG: Search UNSUCCESSFUL. Entry for OD index NOT found"); logPrint(LOG,logLine);}
-	//min is greater than max
-	//unsuccessful search. search terminate with a FFFF value.
+    if(min == max){
+        object = &SDO->OD[min];
+        /* Is object matched */
+        if(index == object->index){
+            return min;
+        }
+    }
     return 0xFFFFU;  /* object does not exist in OD */
 }
 
@@ -884,9 +872,24 @@ uint32_t CO_SDO_readOD(CO_SDO_t *SDO, uint16_t SDOBufferSize){
     			"FILE: CO_SDO.c"
     			"||CALL: CO_SDO_readOD"
     			"\nMSG: Its not domain type. Copy data from OD to SDO buffer"); logPrint(LOG,logLine);}
-        CO_LOCK_OD();
-        while(length--) *(SDObuffer++) = *(ODdata++);
-        CO_UNLOCK_OD();
+        CO_LOCK_OD(SDO->CANdevTx);
+        if((SDO->ODF_arg.attribute & (CO_ODA_RPDO_MAPABLE | CO_ODA_TPDO_MAPABLE)) != 0U){
+            /* RPDO may write the variable meanwhile, then copy it again */
+            uint32_t seq;
+
+            do{
+                uint8_t *dst = SDObuffer;
+                uint8_t *src = ODdata;
+                uint16_t len = length;
+
+                seq = CO_OD_seqReadBegin(SDO->CANdevTx);
+                while(len--) *(dst++) = *(src++);
+            }while(CO_OD_seqReadRetry(SDO->CANdevTx, seq));
+        }
+        else{
+            while(length--) *(SDObuffer++) = *(ODdata++);
+        }
+        CO_UNLOCK_OD(SDO->CANdevTx);
     }
     /* if domain, Object dictionary function MUST exist */
     else
@@ -1037,11 +1040,19 @@ uint32_t CO_SDO_writeOD(CO_SDO_t *SDO, uint16_t length){
 			"||CALL: CO_SDO_writeOD"
 			"\nMSG: Copy data to the OD from SDO buffer"); logPrint(LOG,logLine);}
     if(ODdata != NULL && exception_1003 == false){
-        CO_LOCK_OD();
+        bool_t mappable = (SDO->ODF_arg.attribute & (CO_ODA_RPDO_MAPABLE | CO_ODA_TPDO_MAPABLE)) != 0U;
+
+        CO_LOCK_OD(SDO->CANdevTx);
+        if(mappable){
+            CO_OD_seqWriteBegin(SDO->CANdevTx);
+        }
         while(length--){
             *(ODdata++) = *(SDObuffer++);
         }
-        CO_UNLOCK_OD();
+        if(mappable){
+            CO_OD_seqWriteEnd(SDO->CANdevTx);
+        }
+        CO_UNLOCK_OD(SDO->CANdevTx);
     }
 
     return 0;
@@ -1062,7 +1073,7 @@ static void CO_SDO_abort(CO_SDO_t *SDO, uint32_t code){
     SDO->CANtxBuff->data[3] = SDO->ODF_arg.subIndex;
     CO_memcpySwap4(&SDO->CANtxBuff->data[4], &code);
     SDO->state = CO_SDO_ST_IDLE;
-    SDO->CANrxNew = false;
+    CO_FLAG_CLEAR(SDO->CANrxNew);
     CO_CANsend(SDO->CANdevTx, SDO->CANtxBuff);
 }
 
@@ -1073,7 +1084,7 @@ int8_t CO_SDO_process(
         bool_t                  NMTisPreOrOperational,
         uint16_t                timeDifference_ms,
         uint16_t                SDOtimeoutTime,
-        uint16_t               *timerNext_ms)
+        uint32_t               *timerNext_us)
 {
 
 	if(LEVEL_1){sprintf(logLine,
@@ -1086,7 +1097,7 @@ int8_t CO_SDO_process(
     bool_t sendResponse = false;
 
     /* return if idle */
-    if((SDO->state == CO_SDO_ST_IDLE) && (!SDO->CANrxNew)){
+    if((SDO->state == CO_SDO_ST_IDLE) && (!CO_FLAG_READ(SDO->CANrxNew))){
     	if(LEVEL_1){sprintf(logLine,
     			"FILE: CO_SDO.c"
     			"||CALL: CO_SDO_process"
@@ -1101,12 +1112,12 @@ int8_t CO_SDO_process(
     			"||CALL: CO_SDO_process"
     			"\nMSG: This node is Not in Pre(Operation) mode. SDO is not support in this mode."); logPrint(LOG,logLine);}
         SDO->state = CO_SDO_ST_IDLE;
-        SDO->CANrxNew = false;
+        CO_FLAG_CLEAR(SDO->CANrxNew);
         return 0;
     }
 
     /* Is something new to process? */
-    if((!SDO->CANtxBuff->bufferFull) && ((SDO->CANrxNew) || (SDO->state == CO_SDO_ST_UPLOAD_BL_SUBBLOCK)))
+    if((!CO_FLAG_READ(SDO->CANtxBuff->bufferFull)) && ((CO_FLAG_READ(SDO->CANrxNew)) || (SDO->state == CO_SDO_ST_UPLOAD_BL_SUBBLOCK)))
     {
     	if(LEVEL_1){sprintf(logLine,
     			"FILE: CO_SDO.c"
@@ -1123,9 +1134,9 @@ int8_t CO_SDO_process(
 			SDO->CANtxBuff->data[4] = SDO->CANtxBuff->data[5] = SDO->CANtxBuff->data[6] = SDO->CANtxBuff->data[7] = 0;
 
 			/* Is abort from client? */
-			if((SDO->CANrxNew) && (SDO->CANrxData[0] == CCS_ABORT)){
+			if((CO_FLAG_READ(SDO->CANrxNew)) && (SDO->CANrxData[0] == CCS_ABORT)){
 				SDO->state = CO_SDO_ST_IDLE;
-				SDO->CANrxNew = false;
+				CO_FLAG_CLEAR(SDO->CANrxNew);
 				return -1;
 			}
 
@@ -1200,7 +1211,7 @@ int8_t CO_SDO_process(
         SDO->timeoutTimer += timeDifference_ms;
     }
     if(SDO->timeoutTimer >= SDOtimeoutTime){
-        if((SDO->state == CO_SDO_ST_DOWNLOAD_BL_SUBBLOCK) && (SDO->sequence != 0) && (!SDO->CANtxBuff->bufferFull)){
+        if((SDO->state == CO_SDO_ST_DOWNLOAD_BL_SUBBLOCK) && (SDO->sequence != 0) && (!CO_FLAG_READ(SDO->CANtxBuff->bufferFull))){
             timeoutSubblockDownolad = true;
             state = CO_SDO_ST_DOWNLOAD_BL_SUB_RESP;
         }
@@ -1209,6 +1220,13 @@ int8_t CO_SDO_process(
             return -1;
         }
     }
+    else if(timerNext_us != NULL){
+        /* Transfer is in progress, next call is needed at latest on timeout. */
+        uint32_t diff = (uint32_t)(SDOtimeoutTime - SDO->timeoutTimer) * 1000U;
+        if(*timerNext_us > diff){
+            *timerNext_us = diff;
+        }
+    }
 
     /* return immediately if still idle */
     if(state == CO_SDO_ST_IDLE){
@@ -1682,7 +1700,7 @@ int8_t CO_SDO_process(
             SDO->bufferOffset = 0;
             SDO->sequence = 0;
             SDO->endOfTransfer = false;
-            SDO->CANrxNew = false;
+            CO_FLAG_CLEAR(SDO->CANrxNew);
             SDO->state = CO_SDO_ST_UPLOAD_BL_SUBBLOCK;
             /* continue in next case */
         }
@@ -1693,7 +1711,7 @@ int8_t CO_SDO_process(
         			"||CALL: CO_SDO_process"
         			"\nMSG: SDO Server state: CO_SDO_ST_UPLOAD_BL_SUBBLOCK"); logPrint(LOG,logLine);}
             /* is block confirmation received */
-            if(SDO->CANrxNew){
+            if(CO_FLAG_READ(SDO->CANrxNew)){
                 uint8_t ackseq;
                 uint16_t j;
 
@@ -1772,7 +1790,7 @@ int8_t CO_SDO_process(
                 SDO->endOfTransfer = false;
 
                 /* clear flag here */
-                SDO->CANrxNew = false;
+                CO_FLAG_CLEAR(SDO->CANrxNew);
             }
 
             /* return, if all segments was already transfered or on end of transfer */
@@ -1808,9 +1826,9 @@ int8_t CO_SDO_process(
             /* send response */
             CO_CANsend(SDO->CANdevTx, SDO->CANtxBuff);
 
-            /* Set timerNext_ms to 0 to inform OS to call this function again without delay. */
-            if(timerNext_ms != NULL){
-                *timerNext_ms = 0;
+            /* Set timerNext_us to 0 to inform OS to call this function again without delay. */
+            if(timerNext_us != NULL){
+                *timerNext_us = 0;
             }
 
             /* don't clear the SDO->CANrxNew flag, so return directly */
@@ -1843,7 +1861,7 @@ int8_t CO_SDO_process(
     }
 
     /* free buffer and send message */
-    SDO->CANrxNew = false;
+    CO_FLAG_CLEAR(SDO->CANrxNew);
     if(sendResponse) {
     	if(LEVEL_1){sprintf(logLine,
     			"FILE: CO_SDO.c"
@@ -45,6 +45,8 @@
  */
 
 
+#define LOG_MODULE LOG_MOD_SDO   /* runtime log level tag, see Logger.h */
+
 #include "CO_driver.h"
 #include "CO_SDO.h"
 #include "CO_SDOmaster.h"
@@ -127,7 +129,7 @@ static void CO_SDOclient_receive(void *object, const CO_CANrxMsg_t *msg){
     SDO_C = (CO_SDOclient_t*)object;    /* this is the correct pointer type of the first argument */
 
     /* verify message length and message overflow (previous message was not processed yet) */
-    if((msg->DLC == 8U) && (!SDO_C->CANrxNew) && (SDO_C->state != SDO_STATE_NOTDEFINED)){
+    if((msg->DLC == 8U) && (!CO_FLAG_READ(SDO_C->CANrxNew)) && (SDO_C->state != SDO_STATE_NOTDEFINED)){
 
     	if(LEVEL_1){sprintf(logLine,
 				"FILE: CO_driver.c"
@@ -154,7 +156,7 @@ static void CO_SDOclient_receive(void *object, const CO_CANrxMsg_t *msg){
                 				"FILE: CO_driver.c"
                 				"||CALL: CO_SDOclient_receive"
                 				"\nMSG: Setting new recv SDO client message to true"); logPrint(LOG,logLine);}
-            SDO_C->CANrxNew = true;
+            CO_FLAG_SET(SDO_C->CANrxNew);
         }
         else
         {
@@ -188,7 +190,7 @@ static void CO_SDOclient_receive(void *object, const CO_CANrxMsg_t *msg){
                     if(SDO_C->dataSizeTransfered >= SDO_C->bufferSize) {
                         /* buffer full, break reception */
                         SDO_C->state = SDO_STATE_BLOCKUPLOAD_SUB_END;
-                        SDO_C->CANrxNew = true;
+                        CO_FLAG_SET(SDO_C->CANrxNew);
                         break;
                     }
                 }
@@ -200,7 +202,7 @@ static void CO_SDOclient_receive(void *object, const CO_CANrxMsg_t *msg){
                 			"||CALL: CO_SDOclient_receive"
                 			"\nMSG: break reception last segment or block sequence is too large"); logPrint(LOG,logLine);}
                     SDO_C->state = SDO_STATE_BLOCKUPLOAD_SUB_END;
-                    SDO_C->CANrxNew = true;
+                    CO_FLAG_SET(SDO_C->CANrxNew);
                 }
             }
             else if((seqno == SDO_C->block_seqno) || (SDO_C->block_seqno == 0U)){
@@ -218,18 +220,18 @@ static void CO_SDOclient_receive(void *object, const CO_CANrxMsg_t *msg){
                 			"\nMSG: seqno is totally wrong, break reception."); logPrint(LOG,logLine);}
 
                 SDO_C->state = SDO_STATE_BLOCKUPLOAD_SUB_END;
-                SDO_C->CANrxNew = true;
+                CO_FLAG_SET(SDO_C->CANrxNew);
             }
         }
 
         /* Optional signal to RTOS, which can resume task, which handles SDO client. */
-        if(SDO_C->CANrxNew && SDO_C->pFunctSignal != NULL)
+        if(CO_FLAG_READ(SDO_C->CANrxNew) && SDO_C->pFunctSignal != NULL)
         {
           	if(LEVEL_1){sprintf(logLine,
                 			"FILE: CO_driver.c"
                 			"||CALL: CO_SDOclient_receive"
                 			"\nMSG: Registered Callback function is called for every reception of new message."); logPrint(LOG,logLine);}
-            SDO_C->pFunctSignal();
+            SDO_C->pFunctSignal(SDO_C->functSignalObject);
         }
     }
 }
@@ -266,7 +268,7 @@ CO_ReturnError_t CO_SDOclient_init(
 			"\nMSG: Configuring SDO client object"); logPrint(LOG,logLine);}
     /* Configure object variables */
     SDO_C->state = SDO_STATE_NOTDEFINED;
-    SDO_C->CANrxNew = false;
+    CO_FLAG_CLEAR(SDO_C->CANrxNew);
 
     SDO_C->pst    = 21; /*  block transfer */
     SDO_C->block_size_max = 127; /*  block transfer */
@@ -297,7 +299,8 @@ CO_ReturnError_t CO_SDOclient_init(
 /******************************************************************************/
 void CO_SDOclient_initCallback(
         CO_SDOclient_t         *SDOclient,
-        void                  (*pFunctSignal)(void))
+        void                   *object,
+        void                  (*pFunctSignal)(void *object))
 {
 	if(LEVEL_1){sprintf(logLine,
 			"FILE: CO_driver.c"
@@ -309,6 +312,7 @@ void CO_SDOclient_initCallback(
     			"FILE: CO_driver.c"
     			"||CALL: CO_SDOclient_init"
     			"\nMSG: Call back registered for SDO client"); logPrint(LOG,logLine);}
+        SDOclient->functSignalObject = object;
         SDOclient->pFunctSignal = pFunctSignal;
     }
 }
@@ -342,7 +346,7 @@ CO_SDOclient_return_t CO_SDOclient_setup(
 
     /* Configure object variables */
     SDO_C->state = SDO_STATE_NOTDEFINED;
-    SDO_C->CANrxNew = false;
+    CO_FLAG_CLEAR(SDO_C->CANrxNew);
 
     /* setup Object Dictionary variables */
 
@@ -441,7 +445,7 @@ static void CO_SDOclient_abort(CO_SDOclient_t *SDO_C, uint32_t code){
     CO_memcpySwap4(&SDO_C->CANtxBuff->data[4], &code);
     CO_CANsend(SDO_C->CANdevTx, SDO_C->CANtxBuff);
     SDO_C->state = SDO_STATE_NOTDEFINED;
-    SDO_C->CANrxNew = false;
+    CO_FLAG_CLEAR(SDO_C->CANrxNew);
 }
 
 
@@ -457,7 +461,7 @@ static void CO_SDOTxBufferClear(CO_SDOclient_t *SDO_C) {
     for(i=0; i<8; i++) {
         SDO_C->CANtxBuff->data[i] = 0;
     }
-    SDO_C->CANtxBuff->bufferFull = 0;
+    CO_FLAG_CLEAR(SDO_C->CANtxBuff->bufferFull);
 }
 
 
@@ -540,7 +544,7 @@ CO_SDOclient_return_t CO_SDOclientDownloadInitiate(
     }
 
     /* empty receive buffer, reset timeout timer and send message */
-    SDO_C->CANrxNew = false;
+    CO_FLAG_CLEAR(SDO_C->CANrxNew);
     SDO_C->timeoutTimer = 0;
     CO_CANsend(SDO_C->CANdevTx, SDO_C->CANtxBuff);
 
@@ -573,7 +577,7 @@ CO_SDOclient_return_t CO_SDOclientDownload(
     /* if nodeIDOfTheSDOServer == node-ID of this node, then exchange data with this node */
     if(SDO_C->SDO && SDO_C->SDOClientPar->nodeIDOfTheSDOServer == SDO_C->SDO->nodeId){
         SDO_C->state = SDO_STATE_NOTDEFINED;
-        SDO_C->CANrxNew = false;
+        CO_FLAG_CLEAR(SDO_C->CANrxNew);
 
         /* If SDO server is busy return error */
         if(SDO_C->SDO->state != 0){
@@ -600,14 +604,14 @@ CO_SDOclient_return_t CO_SDOclientDownload(
 
 
 /*  RX data ****************************************************************************************** */
-    if(SDO_C->CANrxNew){
+    if(CO_FLAG_READ(SDO_C->CANrxNew)){
         uint8_t SCS = SDO_C->CANrxData[0]>>5;    /* Client command specifier */
 
         /* ABORT */
         if (SDO_C->CANrxData[0] == (SCS_ABORT<<5)){
             SDO_C->state = SDO_STATE_NOTDEFINED;
             CO_memcpySwap4(pSDOabortCode , &SDO_C->CANrxData[4]);
-            SDO_C->CANrxNew = false;
+            CO_FLAG_CLEAR(SDO_C->CANrxNew);
             return CO_SDOcli_endedWithServerAbort;
         }
 
@@ -619,7 +623,7 @@ CO_SDOclient_return_t CO_SDOclientDownload(
                     if(SDO_C->bufferSize <= 4){
                         /* expedited transfer */
                         SDO_C->state = SDO_STATE_NOTDEFINED;
-                        SDO_C->CANrxNew = false;
+                        CO_FLAG_CLEAR(SDO_C->CANrxNew);
                         return CO_SDOcli_ok_communicationEnd;
                     }
                     else{
@@ -654,7 +658,7 @@ CO_SDOclient_return_t CO_SDOclientDownload(
                     /* is end of transfer? */
                     if(SDO_C->bufferOffset == SDO_C->bufferSize){
                         SDO_C->state = SDO_STATE_NOTDEFINED;
-                        SDO_C->CANrxNew = false;
+                        CO_FLAG_CLEAR(SDO_C->CANrxNew);
                         return CO_SDOcli_ok_communicationEnd;
                     }
                     SDO_C->state = SDO_STATE_DOWNLOAD_REQUEST;
@@ -741,7 +745,7 @@ CO_SDOclient_return_t CO_SDOclientDownload(
                     /*  SDO block download successfully transferred */
                     SDO_C->state = SDO_STATE_NOTDEFINED;
                     SDO_C->timeoutTimer = 0;
-                    SDO_C->CANrxNew = false;
+                    CO_FLAG_CLEAR(SDO_C->CANrxNew);
                     return CO_SDOcli_ok_communicationEnd;
                 }
                 else{
@@ -757,7 +761,7 @@ CO_SDOclient_return_t CO_SDOclientDownload(
             }
         }
         SDO_C->timeoutTimer = 0;
-        SDO_C->CANrxNew = false;
+        CO_FLAG_CLEAR(SDO_C->CANrxNew);
     }
 
 /*  TMO *********************************************************************************************** */
@@ -771,7 +775,7 @@ CO_SDOclient_return_t CO_SDOclientDownload(
     }
 
 /*  TX data ******************************************************************************************* */
-    if(SDO_C->CANtxBuff->bufferFull) {
+    if(CO_FLAG_READ(SDO_C->CANtxBuff->bufferFull)) {
         return CO_SDOcli_transmittBufferFull;
     }
 
@@ -949,7 +953,7 @@ CO_SDOclient_return_t CO_SDOclientUploadInitiate(
     }
 
     /* empty receive buffer, reset timeout timer and send message */
-    SDO_C->CANrxNew = false;
+    CO_FLAG_CLEAR(SDO_C->CANrxNew);
     SDO_C->timeoutTimer = 0;
     SDO_C->timeoutTimerBLOCK =0;
     CO_CANsend(SDO_C->CANdevTx, SDO_C->CANtxBuff);
@@ -986,7 +990,7 @@ CO_SDOclient_return_t CO_SDOclientUpload(
     /* if nodeIDOfTheSDOServer == node-ID of this node, then exchange data with this node */
     if(SDO_C->SDO && SDO_C->SDOClientPar->nodeIDOfTheSDOServer == SDO_C->SDO->nodeId){
         SDO_C->state = SDO_STATE_NOTDEFINED;
-        SDO_C->CANrxNew = false;
+        CO_FLAG_CLEAR(SDO_C->CANrxNew);
 
         /* If SDO server is busy return error */
         if(SDO_C->SDO->state != 0){
@@ -1025,13 +1029,13 @@ CO_SDOclient_return_t CO_SDOclientUpload(
 
 
 /*  RX data ******************************************************************************** */
-    if(SDO_C->CANrxNew){
+    if(CO_FLAG_READ(SDO_C->CANrxNew)){
         uint8_t SCS = SDO_C->CANrxData[0]>>5;    /* Client command specifier */
 
         /*  ABORT */
         if (SDO_C->CANrxData[0] == (SCS_ABORT<<5)){
             SDO_C->state = SDO_STATE_NOTDEFINED;
-            SDO_C->CANrxNew = false;
+            CO_FLAG_CLEAR(SDO_C->CANrxNew);
             CO_memcpySwap4(pSDOabortCode , &SDO_C->CANrxData[4]);
             return CO_SDOcli_endedWithServerAbort;
         }
@@ -1054,7 +1058,7 @@ CO_SDOclient_return_t CO_SDOclientUpload(
                         /* copy data */
                         while(size--) SDO_C->buffer[size] = SDO_C->CANrxData[4+size];
                         SDO_C->state = SDO_STATE_NOTDEFINED;
-                        SDO_C->CANrxNew = false;
+                        CO_FLAG_CLEAR(SDO_C->CANrxNew);
 
                         return CO_SDOcli_ok_communicationEnd;
                     }
@@ -1099,7 +1103,7 @@ CO_SDOclient_return_t CO_SDOclientUpload(
                     if(SDO_C->CANrxData[0] & 0x01){
                         *pDataSize = SDO_C->bufferOffset;
                         SDO_C->state = SDO_STATE_NOTDEFINED;
-                        SDO_C->CANrxNew = false;
+                        CO_FLAG_CLEAR(SDO_C->CANrxNew);
                         return CO_SDOcli_ok_communicationEnd;
                     }
                     /* set state */
@@ -1166,7 +1170,7 @@ CO_SDOclient_return_t CO_SDOclientUpload(
                         /* copy data */
                         while(size--) SDO_C->buffer[size] = SDO_C->CANrxData[4+size];
                         SDO_C->state = SDO_STATE_NOTDEFINED;
-                        SDO_C->CANrxNew = false;
+                        CO_FLAG_CLEAR(SDO_C->CANrxNew);
 
                         return CO_SDOcli_ok_communicationEnd;
                     }
@@ -1253,7 +1257,7 @@ CO_SDOclient_return_t CO_SDOclientUpload(
             }
         }
         SDO_C->timeoutTimer = 0;
-        SDO_C->CANrxNew = false;
+        CO_FLAG_CLEAR(SDO_C->CANrxNew);
     }
 
 /*  TMO *************************************************************************************************** */
@@ -1273,7 +1277,7 @@ CO_SDOclient_return_t CO_SDOclientUpload(
 
 
 /*  TX data ******************************************************************************** */
-    if(SDO_C->CANtxBuff->bufferFull) {
+    if(CO_FLAG_READ(SDO_C->CANtxBuff->bufferFull)) {
         return CO_SDOcli_transmittBufferFull;
     }
 
@@ -44,6 +44,8 @@
  */
 
 
+#define LOG_MODULE LOG_MOD_PDO   /* runtime log level tag, see Logger.h */
+
 #include "CO_driver.h"
 #include "CO_SDO.h"
 #include "CO_Emergency.h"
@@ -99,28 +101,32 @@ static void CO_SYNC_receive(void *object, const CO_CANrxMsg_t *msg){
 				 logPrint(LOG,logLine);}
 
             if(msg->DLC == 0U){
-                SYNC->CANrxNew = true;
+                CO_FLAG_SET(SYNC->CANrxNew);
             }
             else{
                 SYNC->receiveError = (uint16_t)msg->DLC | 0x0100U;
             }
         }
-        if(LEVEL_1){
+        else{
+            if(LEVEL_1){
 	 sprintf(logLine,"FILE:CO_SYNC.C||"
 					 "Call: CO_SYNC_receive"
-					 "\n, msg:when NMT state is different than OPE an PRE_OPE");
+					 "\n, msg:SYNC with counter");
 			 logPrint(LOG,logLine);}
-        else{
             if(msg->DLC == 1U){
                 SYNC->counter = msg->data[0];
-                SYNC->CANrxNew = true;
+                CO_FLAG_SET(SYNC->CANrxNew);
             }
             else{
                 SYNC->receiveError = (uint16_t)msg->DLC | 0x0200U;
             }
         }
-        if(SYNC->CANrxNew) {
-            SYNC->CANrxToggle = SYNC->CANrxToggle ? false : true;
+        if(CO_FLAG_READ(SYNC->CANrxNew)) {
+            if(CO_FLAG_READ(SYNC->CANrxToggle)) CO_FLAG_CLEAR(SYNC->CANrxToggle);
+            else                                CO_FLAG_SET(SYNC->CANrxToggle);
+            if(SYNC->pFunctSignal != NULL) {
+                SYNC->pFunctSignal(SYNC->functSignalObject, true);
+            }
         }
     }
 }
@@ -437,14 +443,16 @@ CO_ReturnError_t CO_SYNC_init(
 
     SYNC->curentSyncTimeIsInsideWindow = true;
 
-    SYNC->CANrxNew = false;
-    SYNC->CANrxToggle = false;
+    CO_FLAG_CLEAR(SYNC->CANrxNew);
+    CO_FLAG_CLEAR(SYNC->CANrxToggle);
     SYNC->timer = 0;
     SYNC->counter = 0;
     SYNC->receiveError = 0U;
 
     SYNC->em = em;
     SYNC->operatingState = operatingState;
+    SYNC->pFunctSignal = NULL;
+    SYNC->functSignalObject = NULL;
 
     SYNC->CANdevRx = CANdevRx;
     SYNC->CANdevRxIdx = CANdevRxIdx;
@@ -503,11 +511,25 @@ CO_ReturnError_t CO_SYNC_init(
 }
 
 
+/******************************************************************************/
+void CO_SYNC_initCallback(
+        CO_SYNC_t              *SYNC,
+        void                   *object,
+        void                  (*pFunctSignal)(void *object, bool_t syncReceived))
+{
+    if(SYNC != NULL){
+        SYNC->functSignalObject = object;
+        SYNC->pFunctSignal = pFunctSignal;
+    }
+}
+
+
 /******************************************************************************/
 uint8_t CO_SYNC_process(
         CO_SYNC_t              *SYNC,
         uint32_t                timeDifference_us,
-        uint32_t                ObjDict_synchronousWindowLength)
+        uint32_t                ObjDict_synchronousWindowLength,
+        uint32_t               *timerNext_us)
 {
 	  if(LEVEL_1){
 	          			sprintf(logLine,"FILE:CO_SYNC.C||"
@@ -538,10 +560,10 @@ uint8_t CO_SYNC_process(
           	          			logPrint(LOG,logLine);}
 
         /* was SYNC just received */
-        if(SYNC->CANrxNew){
+        if(CO_FLAG_READ(SYNC->CANrxNew)){
             SYNC->timer = 0;
             ret = 1;
-            SYNC->CANrxNew = false;
+            CO_FLAG_CLEAR(SYNC->CANrxNew);
         }
 
 
@@ -556,9 +578,13 @@ uint8_t CO_SYNC_process(
                 if(++SYNC->counter > SYNC->counterOverflowValue) SYNC->counter = 1;
                 SYNC->timer = 0;
                 ret = 1;
-                SYNC->CANrxToggle = SYNC->CANrxToggle ? false : true;
+                if(CO_FLAG_READ(SYNC->CANrxToggle)) CO_FLAG_CLEAR(SYNC->CANrxToggle);
+                else                                CO_FLAG_SET(SYNC->CANrxToggle);
                 SYNC->CANtxBuff->data[0] = SYNC->counter;
                 CO_CANsend(SYNC->CANdevTx, SYNC->CANtxBuff);
+                if(SYNC->pFunctSignal != NULL) {
+                    SYNC->pFunctSignal(SYNC->functSignalObject, false);
+                }
             }
         }
 
@@ -592,9 +618,28 @@ uint8_t CO_SYNC_process(
         /* Verify timeout of SYNC */
         if(SYNC->periodTime && SYNC->timer > SYNC->periodTimeoutTime && *SYNC->operatingState == CO_NMT_OPERATIONAL)
             CO_errorReport(SYNC->em, CO_EM_SYNC_TIME_OUT, CO_EMC_COMMUNICATION, SYNC->timer);
+
+        /* Calculate, when SYNC timer reaches next event, and lower timerNext_us if necessary. */
+        if(timerNext_us != NULL){
+            uint32_t diff = UINT32_MAX;
+
+            if(SYNC->isProducer && SYNC->periodTime){
+                diff = SYNC->periodTime - SYNC->timer;
+            }
+            else if(SYNC->periodTime && SYNC->timer <= SYNC->periodTimeoutTime && *SYNC->operatingState == CO_NMT_OPERATIONAL){
+                diff = SYNC->periodTimeoutTime - SYNC->timer + 1;
+            }
+            if(ObjDict_synchronousWindowLength && SYNC->timer <= ObjDict_synchronousWindowLength
+                    && diff > ObjDict_synchronousWindowLength - SYNC->timer + 1){
+                diff = ObjDict_synchronousWindowLength - SYNC->timer + 1;
+            }
+            if(*timerNext_us > diff){
+                *timerNext_us = diff;
+            }
+        }
     }
     else {
-        SYNC->CANrxNew = false;
+        CO_FLAG_CLEAR(SYNC->CANrxNew);
     }
     if(LEVEL_1){
 				sprintf(logLine,"FILE:CO_SYNC.C||"
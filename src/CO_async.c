@@ -0,0 +1,282 @@
+/*
+ * Stackless coroutines for application code, run by the mainline task.
+ *
+ * @file        CO_async.c
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * CANopenNode is free and open source software: you can redistribute
+ * it and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <string.h>
+#include "CO_async.h"
+
+
+/* Timer callback of the task. */
+static void CO_async_tmrExpired(void *object){
+    ((CO_async_task_t*)object)->tmrExpired = true;
+}
+
+
+/* Free resources of the task, which is not running any more. */
+static void CO_async_release(CO_async_task_t *task){
+    CO_async_t *async = task->async;
+
+    CO_tmr_stop(&async->wheel, &task->tmr);
+#if CO_NO_SDO_CLIENT == 1
+    if(async->sdoOwner == task){
+        CO_SDOclientClose(async->CO->SDOclient);
+        async->sdoOwner = NULL;
+        async->runAgain = true;
+    }
+#endif
+}
+
+
+/******************************************************************************/
+void CO_async_init(CO_async_t *async, CO_t *CO){
+    memset(async, 0, sizeof(*async));
+    async->CO = CO;
+    CO_tmrWheel_init(&async->wheel);
+}
+
+
+/******************************************************************************/
+void CO_async_initCallback(CO_async_t *async, void *object, void (*pFunctSignal)(void *object)){
+    async->functSignalObject = object;
+    async->pFunctSignal = pFunctSignal;
+}
+
+
+/******************************************************************************/
+void CO_async_start(
+        CO_async_t             *async,
+        CO_async_task_t        *task,
+        CO_async_fn_t           pFunct,
+        void                   *object,
+        void                  (*pFunctDone)(CO_async_task_t *task))
+{
+    CO_async_task_t **pp = &async->tasks;
+
+    /* Task, which finished or was cancelled, may still be in the list. */
+    while(*pp != NULL && *pp != task){
+        pp = &(*pp)->next;
+    }
+    if(*pp == NULL){
+        task->next = NULL;
+        *pp = task;
+    }
+    else if(task->state == CO_ASYNC_RUNNING){
+        CO_async_release(task);
+    }
+    task->async = async;
+    task->pFunct = pFunct;
+    task->object = object;
+    task->pFunctDone = pFunctDone;
+    task->line = 0;
+    task->tmrExpired = false;
+    CO_tmr_init(&task->tmr, task, CO_async_tmrExpired);
+    task->sdoRet = 0;
+    task->sdoAbortCode = 0;
+    task->sdoSize = 0;
+    task->state = CO_ASYNC_RUNNING;
+
+    if(async->pFunctSignal != NULL){
+        async->pFunctSignal(async->functSignalObject);
+    }
+}
+
+
+/******************************************************************************/
+void CO_async_cancel(CO_async_task_t *task){
+    if(task->state == CO_ASYNC_RUNNING){
+        CO_async_release(task);
+        task->state = CO_ASYNC_IDLE;
+    }
+}
+
+
+/******************************************************************************/
+void CO_async_process(CO_async_t *async, uint32_t timeDifference_us, uint32_t *timerNext_us){
+    CO_async_task_t **pp;
+    uint32_t us = async->remainder_us + timeDifference_us;
+
+    async->timeDifference_ms = (us / 1000U > 0xFFFFU) ? 0xFFFFU : (uint16_t)(us / 1000U);
+    async->remainder_us = us % 1000U;
+    async->runAgain = false;
+    CO_tmrWheel_advance(&async->wheel, timeDifference_us);
+
+    /* Tasks are unlinked only here, so cancel and start from task functions
+     * keep the list consistent. Tasks started now are appended and run. */
+    pp = &async->tasks;
+    while(*pp != NULL){
+        CO_async_task_t *task = *pp;
+
+        if(task->state == CO_ASYNC_RUNNING && task->pFunct(task) == CO_ASYNC_DONE
+            && task->state == CO_ASYNC_RUNNING)
+        {
+            CO_async_release(task);
+            task->state = CO_ASYNC_FINISHED;
+            async->runAgain = true;
+            if(task->pFunctDone != NULL){
+                task->pFunctDone(task);
+            }
+        }
+
+        if(task->state != CO_ASYNC_RUNNING){
+            *pp = task->next;
+        }
+        else{
+            pp = &task->next;
+        }
+    }
+
+    /* Finished task or free SDO client may let others continue. */
+    if(timerNext_us != NULL){
+        if(async->runAgain && async->tasks != NULL){
+            *timerNext_us = 0;
+        }
+        else{
+            *timerNext_us = CO_tmrWheel_next(&async->wheel, *timerNext_us);
+        }
+    }
+}
+
+
+/******************************************************************************/
+void CO_async_delay(CO_async_task_t *task, uint32_t delay_us){
+    task->tmrExpired = false;
+    CO_tmr_start(&task->async->wheel, &task->tmr, delay_us);
+}
+
+
+/******************************************************************************/
+void CO_async_stopDelay(CO_async_task_t *task){
+    CO_tmr_stop(&task->async->wheel, &task->tmr);
+}
+
+
+/******************************************************************************/
+int16_t CO_async_HBstate(CO_async_t *async, uint8_t idx){
+    CO_HBconsumer_t *HBcons = async->CO->HBcons;
+
+    if(idx >= HBcons->numberOfMonitoredNodes || !HBcons->monitoredNodes[idx].monStarted){
+        return -1;
+    }
+    return (int16_t)HBcons->monitoredNodes[idx].NMTstate;
+}
+
+
+#if CO_NO_SDO_CLIENT == 1
+/*
+ * Take SDO client for the task. Returns false, if other task uses it.
+ * Otherwise *ret is result of setup and initiate.
+ */
+static bool_t CO_async_sdoTake(CO_async_task_t *task, uint8_t nodeId, CO_SDOclient_return_t *ret){
+    CO_async_t *async = task->async;
+
+    if(async->sdoOwner == task){
+        return true;
+    }
+    if(async->sdoOwner != NULL){
+        return false;
+    }
+    async->sdoOwner = task;
+    task->sdoSize = 0;
+    task->sdoAbortCode = 0;
+    *ret = CO_SDOclient_setup(async->CO->SDOclient, 0, 0, nodeId);
+    return true;
+}
+
+
+/* Transfer is in progress or finished, ret from client. Returns true, if finished. */
+static bool_t CO_async_sdoResult(CO_async_task_t *task, CO_SDOclient_return_t ret,
+        uint32_t abortCode, uint16_t timeout_ms)
+{
+    if(ret > 0){
+        /* Wake for client timeout, if server does not respond. Restarted
+         * each call, as client restarts its timeout on each response. */
+        CO_async_delay(task, ((uint32_t)timeout_ms + 1U) * 1000U);
+        return false;
+    }
+
+    task->sdoRet = (int16_t)ret;
+    task->sdoAbortCode = abortCode;
+    CO_async_release(task);
+    if(ret < 0){
+        if(LEVEL_1){sprintf(logLine,
+                "FILE: CO_async.c"
+                "||CALL: CO_async_sdoResult"
+                "\nMSG: SDO transfer failed, ret=%d, abort=0x%08X",(int)ret,abortCode); logPrint(LOG,logLine);}
+    }
+    return true;
+}
+
+
+/******************************************************************************/
+bool_t CO_async_sdoDownload(CO_async_task_t *task, uint8_t nodeId, uint16_t index,
+        uint8_t subIndex, uint8_t *data, uint32_t size, uint16_t timeout_ms)
+{
+    CO_SDOclient_t *SDO_C = task->async->CO->SDOclient;
+    CO_SDOclient_return_t ret = CO_SDOcli_waitingServerResponse;
+    uint32_t abortCode = 0;
+    bool_t first = task->async->sdoOwner != task;
+
+    if(!CO_async_sdoTake(task, nodeId, &ret)){
+        return false;
+    }
+    if(first){
+        if(ret == CO_SDOcli_ok_communicationEnd){
+            ret = CO_SDOclientDownloadInitiate(SDO_C, index, subIndex, data, size, 0);
+        }
+        if(ret == CO_SDOcli_ok_communicationEnd){
+            ret = CO_SDOcli_waitingServerResponse;
+        }
+    }
+    else{
+        ret = CO_SDOclientDownload(SDO_C, task->async->timeDifference_ms, timeout_ms, &abortCode);
+    }
+    return CO_async_sdoResult(task, ret, abortCode, timeout_ms);
+}
+
+
+/******************************************************************************/
+bool_t CO_async_sdoUpload(CO_async_task_t *task, uint8_t nodeId, uint16_t index,
+        uint8_t subIndex, uint8_t *data, uint32_t size, uint16_t timeout_ms)
+{
+    CO_SDOclient_t *SDO_C = task->async->CO->SDOclient;
+    CO_SDOclient_return_t ret = CO_SDOcli_waitingServerResponse;
+    uint32_t abortCode = 0;
+    bool_t first = task->async->sdoOwner != task;
+
+    if(!CO_async_sdoTake(task, nodeId, &ret)){
+        return false;
+    }
+    if(first){
+        if(ret == CO_SDOcli_ok_communicationEnd){
+            ret = CO_SDOclientUploadInitiate(SDO_C, index, subIndex, data, size, 0);
+        }
+        if(ret == CO_SDOcli_ok_communicationEnd){
+            ret = CO_SDOcli_waitingServerResponse;
+        }
+    }
+    else{
+        ret = CO_SDOclientUpload(SDO_C, task->async->timeDifference_ms, timeout_ms, &task->sdoSize, &abortCode);
+    }
+    return CO_async_sdoResult(task, ret, abortCode, timeout_ms);
+}
+#endif
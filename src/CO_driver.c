@@ -24,21 +24,17 @@
  */
 
 
+#define LOG_MODULE LOG_MOD_DRIVER   /* runtime log level tag, see Logger.h */
+
 #include "CO_driver.h"
 #include "CO_Emergency.h"
+#include "CO_Linux_rt.h"
 #include <string.h> /* for memcpy */
 #include <stdlib.h> /* for malloc, free */
 #include <errno.h>
 #include <sys/socket.h>
 
 
-/******************************************************************************/
-#ifndef CO_SINGLE_THREAD
-    pthread_mutex_t CO_EMCY_mtx = PTHREAD_MUTEX_INITIALIZER;
-    pthread_mutex_t CO_OD_mtx = PTHREAD_MUTEX_INITIALIZER;
-#endif
-
-
 /** Set socketCAN filters *****************************************************/
     /*
      * This function is used to set socketCAN filters.
@@ -184,7 +180,7 @@ void CO_CANsetNormalMode(CO_CANmodule_t *CANmodule)
     			"\nMSG: CO_CANsetNormalMode failed"); logPrint(ERROR,logLine);}
         CO_errExit("CO_CANsetNormalMode failed");
     }
-    CANmodule->CANnormal = true;
+    CO_FLAG_SET(CANmodule->CANnormal);
 }
 
 
@@ -234,7 +230,7 @@ CO_ReturnError_t CO_CANmodule_init(
         CANmodule->rxSize = rxSize;//size of the receive array is copied
         CANmodule->txArray = txArray;//address of the transmit array is copied
         CANmodule->txSize = txSize;//size of the transmit array is copied
-        CANmodule->CANnormal = false;// setting canmodule to configuration mode
+        CO_FLAG_CLEAR(CANmodule->CANnormal);// setting canmodule to configuration mode
         CANmodule->useCANrxFilters = true;//use hardware filters for receiving the can messages
         CANmodule->bufferInhibitFlag = false;//any sync PDO in the transmit buffer, since NO set to false.
         CANmodule->firstCANtxMessage = true;// do transmit buffer contain boot up message. can module is starting so bootup mode.
@@ -257,7 +253,7 @@ CO_ReturnError_t CO_CANmodule_init(
         }
 //init for txArray
         for(i=0U; i<txSize; i++){
-            txArray[i].bufferFull = false;
+            CO_FLAG_CLEAR(txArray[i].bufferFull);
         }
     }
 
@@ -283,17 +279,9 @@ CO_ReturnError_t CO_CANmodule_init(
                    		"\nMSG: socket creation failed"); logPrint(ERROR,logLine);}
             ret = CO_ERROR_ILLEGAL_ARGUMENT;
         }else{
-        	//karthik started
-        		struct ifreq ifr;
-				//char* canInterfaceName="can0";
-				//copy the can interface to the interface request (ifreq) object name field.
-				strcpy(ifr.ifr_name, "can0");
-
-				//get interface index from the interface name mapping.
-				ioctl(CANmodule->fd, SIOCGIFINDEX, &ifr);
-				CANbaseAddress=ifr.ifr_ifindex;
-
-        	//karthik ended
+            //CANbaseAddress is interface index, see if_nametoindex().
+            //Each CAN module has own socket, so several modules may use
+            //the same or different interfaces.
             sockAddr.can_family = AF_CAN;
             sockAddr.can_ifindex = CANbaseAddress;
             if(bind(CANmodule->fd, (struct sockaddr*)&sockAddr, sizeof(sockAddr)) != 0){
@@ -305,6 +293,28 @@ CO_ReturnError_t CO_CANmodule_init(
             }
         }
 
+#ifndef CO_SINGLE_THREAD
+        /* Critical sections of this CAN module, see Karsh.h */
+        if(ret == CO_ERROR_NO){
+            if(CO_rtMutexInit(&CANmodule->EMCY_mtx) != 0){
+                ret = CO_ERROR_OUT_OF_MEMORY;
+            }
+            else if(CO_rtMutexInit(&CANmodule->OD_mtx) != 0){
+                pthread_mutex_destroy(&CANmodule->EMCY_mtx);
+                ret = CO_ERROR_OUT_OF_MEMORY;
+            }
+        }
+#endif
+        CANmodule->OD_seq = 0;
+
+        /* Next call starts from the beginning, CO_CANmodule_disable() skips it. */
+        if(ret != CO_ERROR_NO){
+            if(CANmodule->fd >= 0){
+                close(CANmodule->fd);
+            }
+            CANmodule->wasConfigured = 0;
+        }
+
         /* allocate memory for filter array */
         /*
          * create a receive filter of size equal to rxArray. Each element of this array is of #can_filter type.
@@ -370,9 +380,17 @@ void CO_CANmodule_disable(CO_CANmodule_t *CANmodule){
            		"FILE: CO_driver.c"
            		"||CALL: CO_CANmodule_disable"
            		"\nMSG: started"); logPrint(LOG,logLine);}
+    if(CANmodule->wasConfigured == 0){
+        return;
+    }
     close(CANmodule->fd);
     free(CANmodule->filter);
     CANmodule->filter = NULL;
+#ifndef CO_SINGLE_THREAD
+    pthread_mutex_destroy(&CANmodule->OD_mtx);
+    pthread_mutex_destroy(&CANmodule->EMCY_mtx);
+#endif
+    CANmodule->wasConfigured = 0;
 }
 
 
@@ -453,7 +471,7 @@ CO_ReturnError_t CO_CANrxBufferInit(
             CANmodule->filter[index].can_mask = buffer->mask;
 
             //set filters only if canmodule is in normal module.That is canmodule is up and running.
-            if(CANmodule->CANnormal){
+            if(CO_FLAG_READ(CANmodule->CANnormal)){
               	 if(LEVEL_1){sprintf(logLine,
               	           		"FILE: CO_driver.c"
               	           		"||CALL: CO_CANrxBufferInit"
@@ -511,7 +529,7 @@ CO_CANtx_t *CO_CANtxBufferInit(
         }
 
         buffer->DLC = noOfBytes;
-        buffer->bufferFull = false;// not an sync PDO.
+        CO_FLAG_CLEAR(buffer->bufferFull);// not an sync PDO.
         buffer->syncFlag = syncFlag;//mention is it a sync message?
     }
     else
@@ -532,20 +550,14 @@ CO_CANtx_t *CO_CANtxBufferInit(
  */
 CO_ReturnError_t CO_CANsend(CO_CANmodule_t *CANmodule, CO_CANtx_t *buffer)
 {
-	if(LEVEL_1){sprintf(logLine,
-			"FILE: CO_driver.c"
-			"||CALL: CO_CANsend"
-			"\nMSG: started"); logPrint(LOG,logLine);}
+	LOG_EVENT(1,LOG,"CO_CANsend","started, ident=0x%X, DLC=%u",buffer->ident,buffer->DLC);
 
     CO_ReturnError_t err = CO_ERROR_NO;
     ssize_t n;
     size_t count = sizeof(struct can_frame);
 
 //write the data in the buffer to the socket
-	if(LEVEL_1){sprintf(logLine,
-			"FILE: CO_driver.c"
-			"||CALL: CO_CANsend"
-			"\nMSG: write message to the buffer"); logPrint(LOG,logLine);}
+	LOG_EVENT(1,LOG,"CO_CANsend","write message to the buffer");
     n = write(CANmodule->fd, buffer, count);
 #ifdef CO_LOG_CAN_MESSAGES
     void CO_logMessage(const CanMsg *msg);
@@ -554,10 +566,8 @@ CO_ReturnError_t CO_CANsend(CO_CANmodule_t *CANmodule, CO_CANtx_t *buffer)
 
 //if error in sending. if checked using the number bytes transferred (n).
     if(n != count){
-    	if(LEVEL_1){sprintf(logLine,
-    			"FILE: CO_driver.c"
-    			"||CALL: CO_CANsend"
-    			"\nMSG: Failed to write message into the socket"); logPrint(ERROR,logLine);}
+    	LOG_EVENT(1,ERROR,"CO_CANsend","Failed to write message into the socket, ident=0x%X, n=%d, errno=%d",
+    			buffer->ident,n,errno);
         CO_errorReport((CO_EM_t*)CANmodule->em, CO_EM_CAN_TX_OVERFLOW, CO_EMC_CAN_OVERRUN, n);
         err = CO_ERROR_TX_OVERFLOW;
     }
@@ -643,13 +653,11 @@ void CO_CANverifyErrors(CO_CANmodule_t *CANmodule){
 /*
  * This functions read a message from the socket and matches it with the rxArray canid.
  * If received message canid matches with the rxArray canid then callback function pointed by the rxArray is called
- * if not matching then exists silently.
+ * if not matching then exists silently. With MSG_DONTWAIT in flags empty socket
+ * is not an error. Returns true, if message was read.
  * */
-void CO_CANrxWait(CO_CANmodule_t *CANmodule){
-	if(LEVEL_1){sprintf(logLine,
-			"FILE: CO_driver.c"
-			"||CALL: CO_CANrxWait"
-			"\nMSG: started"); logPrint(LOG,logLine);}
+static bool_t CO_CANrxRead(CO_CANmodule_t *CANmodule, int flags){
+	LOG_EVENT(1,LOG,"CO_CANrxWait","started");
 
     struct can_frame msg;
     int n, size;
@@ -664,20 +672,18 @@ void CO_CANrxWait(CO_CANmodule_t *CANmodule){
     }
 
     /* Read socket and pre-process message */
-	if(LEVEL_1){sprintf(logLine,
-			"FILE: CO_driver.c"
-			"||CALL: CO_CANrxWait"
-			"\nMSG: read from socket"); logPrint(LOG,logLine);}
+	LOG_EVENT(1,LOG,"CO_CANrxWait","read from socket");
 
     size = sizeof(struct can_frame);
-    n = read(CANmodule->fd, &msg, size);
+    n = recv(CANmodule->fd, &msg, size, flags);
+
+    if(n < 0 && (flags & MSG_DONTWAIT) && (errno == EAGAIN || errno == EWOULDBLOCK)){
+        return false;
+    }
 
-    if(CANmodule->CANnormal){
+    if(CO_FLAG_READ(CANmodule->CANnormal)){
         if(n != size){
-        	if(LEVEL_1){sprintf(logLine,
-        			"FILE: CO_driver.c"
-        			"||CALL: CO_CANrxWait"
-        			"\nMSG: error while reading socket"); logPrint(ERROR,logLine);}
+        	LOG_EVENT(1,ERROR,"CO_CANrxWait","error while reading socket, n=%d, errno=%d",n,errno);
             /* This happens only once after error occurred (network down or something). */
             CO_errorReport((CO_EM_t*)CANmodule->em, CO_EM_CAN_RXB_OVERFLOW, CO_EMC_COMMUNICATION, n);
         }
@@ -693,19 +699,13 @@ void CO_CANrxWait(CO_CANmodule_t *CANmodule){
             rcvMsgIdent = rcvMsg->ident;
 
             /* Search rxArray form CANmodule for the matching CAN-ID. */
-            if(LEVEL_1){sprintf(logLine,
-            		"FILE: CO_driver.c"
-            		"||CALL: CO_CANrxWait"
-            		"\nMSG: Searching rxArray from canModule for matching CAN-ID"); logPrint(LOG,logLine);}
+            LOG_EVENT(1,LOG,"CO_CANrxWait","Searching rxArray from canModule for matching CAN-ID 0x%X",rcvMsgIdent);
 
             buffer = &CANmodule->rxArray[0];
             for(i = CANmodule->rxSize; i > 0U; i--)
             {
                 if(((rcvMsgIdent ^ buffer->ident) & buffer->mask) == 0U){
-                    if(LEVEL_1){sprintf(logLine,
-                    		"FILE: CO_driver.c"
-                    		"||CALL: CO_CANrxWait"
-                    		"\nMSG: CAN ID matched with rxArray element"); logPrint(LOG,logLine);}
+                    LOG_EVENT(1,LOG,"CO_CANrxWait","CAN ID matched with rxArray element %d",CANmodule->rxSize-i);
                     msgMatched = true;
                     break;
                 }
@@ -714,19 +714,17 @@ void CO_CANrxWait(CO_CANmodule_t *CANmodule){
 
             if(msgMatched==false)
             {
-                if(LEVEL_1){sprintf(logLine,
+                /* foreign traffic on a busy bus hits this for every frame */
+                if(LEVEL_1 && logSiteAllow(&CANmodule->rxNoMatchSite)){sprintf(logLine,
                 		"FILE: CO_driver.c"
                 		"||CALL: CO_CANrxWait"
-                		"\nMSG: CAN ID did not match with rxArray element"); logPrint(LOG,logLine);}
+                		"\nMSG: CAN ID did not match with rxArray element"); logPrintSite(&CANmodule->rxNoMatchSite,LOG,logLine);}
             }
 
             /* Call specific function, which will process the message */
             if(msgMatched && (buffer->pFunct != NULL)){
 
-                if(LEVEL_1){sprintf(logLine,
-                		"FILE: CO_driver.c"
-                		"||CALL: CO_CANrxWait"
-                		"\nMSG: Calling function registered to the received message CANID"); logPrint(LOG,logLine);}
+                LOG_EVENT(1,LOG,"CO_CANrxWait","Calling function registered to the received message CANID");
                 buffer->pFunct(buffer->object, rcvMsg);
             }
 
@@ -736,6 +734,19 @@ void CO_CANrxWait(CO_CANmodule_t *CANmodule){
 #endif
         }
     }
+    return n == size;
+}
+
+
+/******************************************************************************/
+void CO_CANrxWait(CO_CANmodule_t *CANmodule){
+    (void)CO_CANrxRead(CANmodule, 0);
+}
+
+
+/******************************************************************************/
+bool_t CO_CANrxNext(CO_CANmodule_t *CANmodule){
+    return CO_CANrxRead(CANmodule, MSG_DONTWAIT);
 }
 
 
@@ -0,0 +1,126 @@
+/*
+ * Latency histogram with logarithmic buckets.
+ *
+ * @file        CO_hist.c
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * CANopenNode is free and open source software: you can redistribute
+ * it and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <string.h>
+#include "CO_hist.h"
+
+
+/* Bucket index of value, see CO_HIST_SUB_BITS. */
+static uint32_t CO_hist_index(uint32_t value){
+    uint32_t msb;
+
+    if(value < CO_HIST_SUB_COUNT){
+        return value;
+    }
+    if(value > CO_HIST_MAX_VALUE){
+        value = CO_HIST_MAX_VALUE;
+    }
+    msb = 31U - (uint32_t)__builtin_clz(value);
+    return (msb - CO_HIST_SUB_BITS + 1U) * CO_HIST_SUB_COUNT
+         + ((value >> (msb - CO_HIST_SUB_BITS)) & (CO_HIST_SUB_COUNT - 1U));
+}
+
+
+/* Highest value, which falls into bucket. */
+static uint32_t CO_hist_bucketTop(uint32_t index){
+    uint32_t shift;
+
+    if(index < CO_HIST_SUB_COUNT){
+        return index;
+    }
+    shift = index / CO_HIST_SUB_COUNT - 1U;
+    return ((CO_HIST_SUB_COUNT + index % CO_HIST_SUB_COUNT + 1U) << shift) - 1U;
+}
+
+
+/******************************************************************************/
+void CO_hist_init(CO_hist_t *hist){
+    memset(hist, 0, sizeof(*hist));
+}
+
+
+/******************************************************************************/
+void CO_hist_record(CO_hist_t *hist, uint32_t value){
+    if(__atomic_load_n(&hist->resetRequest, __ATOMIC_ACQUIRE) != 0){
+        CO_hist_init(hist);
+    }
+
+    if(hist->total == 0 || value < hist->min){
+        hist->min = value;
+    }
+    hist->count[CO_hist_index(value)]++;
+    hist->total++;
+    hist->sum += value;
+    hist->last = value;
+    if(value > hist->max){
+        hist->max = value;
+    }
+}
+
+
+/******************************************************************************/
+void CO_hist_reset(CO_hist_t *hist){
+    __atomic_store_n(&hist->resetRequest, 1, __ATOMIC_RELEASE);
+}
+
+
+/******************************************************************************/
+void CO_hist_snapshot(CO_hist_t *hist, CO_hist_t *snapshot){
+    if(__atomic_load_n(&hist->resetRequest, __ATOMIC_ACQUIRE) != 0){
+        CO_hist_init(snapshot);
+    }
+    else{
+        memcpy(snapshot, hist, sizeof(*snapshot));
+        snapshot->resetRequest = 0;
+    }
+    CO_hist_reset(hist);
+}
+
+
+/******************************************************************************/
+uint32_t CO_hist_percentile(const CO_hist_t *hist, uint16_t permille){
+    uint64_t rank, seen = 0;
+    uint32_t i;
+
+    if(hist->total == 0){
+        return 0;
+    }
+    if(permille >= 1000){
+        return hist->max;
+    }
+
+    /* smallest value, below or equal which are permille of values */
+    rank = (hist->total * permille + 999) / 1000;
+    if(rank == 0){
+        rank = 1;
+    }
+    for(i=0; i<CO_HIST_BUCKETS; i++){
+        seen += hist->count[i];
+        if(seen >= rank){
+            uint32_t top = CO_hist_bucketTop(i);
+            return (top < hist->max) ? top : hist->max;
+        }
+    }
+    return hist->max;
+}
@@ -0,0 +1,76 @@
+/*
+ * Per-stage execution time profile of CANopen processing.
+ *
+ * @file        CO_prof.c
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * CANopenNode is free and open source software: you can redistribute
+ * it and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "CO_prof.h"
+
+#if CO_CONFIG_PROFILE
+
+
+/*
+ * Sub-index 1 takes snapshot and resets histograms, other sub-indexes read
+ * from the last snapshot. ODF is called from mainline thread only.
+ */
+static CO_SDO_abortCode_t CO_ODF_2143(CO_ODF_arg_t *ODF_arg){
+    CO_prof_t *prof = (CO_prof_t*)ODF_arg->object;
+    uint32_t value;
+
+    if(!ODF_arg->reading || ODF_arg->subIndex == 0U){
+        return CO_SDO_AB_NONE;
+    }
+
+    if(ODF_arg->subIndex == 1U){
+        int i;
+
+        for(i=0; i<CO_PROF_STAGES; i++){
+            CO_hist_snapshot(&prof->stage[i], &prof->snapshot[i]);
+        }
+        value = (uint32_t)prof->snapshot[CO_PROF_TPDO].total;
+    }
+    else{
+        uint8_t i = ODF_arg->subIndex - 2U;
+        const CO_hist_t *hist;
+
+        if(i / 4U >= CO_PROF_STAGES){
+            return CO_SDO_AB_SUB_UNKNOWN;
+        }
+        hist = &prof->snapshot[i / 4U];
+        switch(i % 4U){
+            case 0:  value = (hist->total > 0) ? hist->min : 0; break;
+            case 1:  value = (hist->total > 0) ? (uint32_t)(hist->sum / hist->total) : 0; break;
+            case 2:  value = CO_hist_percentile(hist, 990); break;
+            default: value = hist->max; break;
+        }
+    }
+
+    CO_setUint32(ODF_arg->data, value);
+    return CO_SDO_AB_NONE;
+}
+
+
+/******************************************************************************/
+void CO_prof_configureOD(CO_SDO_t *SDO, CO_prof_t *prof){
+    CO_OD_configure(SDO, 0x2143, CO_ODF_2143, (void*)prof, 0, 0);
+}
+
+#endif
@@ -0,0 +1,127 @@
+/*
+ * Software PLL, which follows period and phase of received SYNC.
+ *
+ * @file        CO_syncPll.c
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * CANopenNode is free and open source software: you can redistribute
+ * it and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "CO_syncPll.h"
+
+
+static int64_t abs64(int64_t v){
+    return (v < 0) ? -v : v;
+}
+
+
+/******************************************************************************/
+void CO_syncPll_init(CO_syncPll_t *pll){
+    pll->state = CO_SYNC_PLL_IDLE;
+    pll->good = 0;
+    pll->period_ns = 0;
+    pll->residual_ns = 0;
+}
+
+
+/******************************************************************************/
+void CO_syncPll_update(CO_syncPll_t *pll, int64_t t_ns){
+    int64_t interval = t_ns - pll->last_ns;
+    int64_t err;
+
+    pll->last_ns = t_ns;
+
+    /* First SYNC, period is measured by the next one. */
+    if(pll->state == CO_SYNC_PLL_IDLE){
+        pll->state = CO_SYNC_PLL_ACQUIRING;
+        pll->good = 0;
+        pll->period_ns = 0;
+        return;
+    }
+    if(pll->period_ns == 0){
+        if(interval > 0){
+            pll->period_ns = interval;
+            pll->next_ns = t_ns + interval;
+        }
+        return;
+    }
+
+    /* Missed SYNCs are bridged with the period estimate. */
+    err = t_ns - pll->next_ns;
+    if(err > pll->period_ns / 2){
+        pll->next_ns += (err + pll->period_ns / 2) / pll->period_ns * pll->period_ns;
+        err = t_ns - pll->next_ns;
+    }
+    pll->residual_ns = err;
+
+    if(abs64(err) > pll->period_ns / 4){
+        if(pll->state == CO_SYNC_PLL_LOCKED){
+            pll->lockLost++;
+        }
+        pll->state = CO_SYNC_PLL_ACQUIRING;
+        pll->good = 0;
+        pll->period_ns = 0;
+        return;
+    }
+
+    if(pll->state == CO_SYNC_PLL_LOCKED){
+        CO_hist_record(&pll->residual, (uint32_t)(abs64(err) / 1000));
+    }
+    pll->period_ns += err / 32;
+    pll->next_ns += err / 4 + pll->period_ns;
+
+    if(abs64(err) <= pll->period_ns / 32){
+        if(pll->good < CO_SYNC_PLL_LOCK_COUNT){
+            pll->good++;
+        }
+        if(pll->good >= CO_SYNC_PLL_LOCK_COUNT){
+            pll->state = CO_SYNC_PLL_LOCKED;
+        }
+    }
+    else{
+        pll->good = 0;
+    }
+}
+
+
+/******************************************************************************/
+bool_t CO_syncPll_deadline(CO_syncPll_t *pll, int64_t now_ns, int64_t offset_ns, int64_t *deadline_ns){
+    int64_t d;
+
+    if(pll->state == CO_SYNC_PLL_IDLE || pll->period_ns == 0){
+        return false;
+    }
+    if(now_ns - pll->last_ns > CO_SYNC_PLL_HOLDOVER * pll->period_ns){
+        if(pll->state == CO_SYNC_PLL_LOCKED){
+            pll->lockLost++;
+        }
+        CO_syncPll_init(pll);
+        return false;
+    }
+    if(pll->state != CO_SYNC_PLL_LOCKED){
+        return false;
+    }
+
+    /* next_ns - period_ns is corrected time of the last SYNC */
+    d = pll->next_ns - pll->period_ns + offset_ns;
+    while(d <= now_ns){
+        d += pll->period_ns;
+    }
+    *deadline_ns = d;
+    return true;
+}
@@ -0,0 +1,250 @@
+/*
+ * Hierarchical timer wheel for CANopen protocol timers.
+ *
+ * @file        CO_tmrWheel.c
+ *
+ * This file is part of CANopenNode, an opensource CANopen Stack.
+ * Project home page is <https://github.com/CANopenNode/CANopenNode>.
+ * For more information on CANopen see <http://www.can-cia.org/>.
+ *
+ * CANopenNode is free and open source software: you can redistribute
+ * it and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <string.h>
+#include "CO_tmrWheel.h"
+
+
+/* Bits 0..digit set. */
+static uint64_t CO_tmrWheel_maskUpTo(uint32_t digit){
+    return (digit >= 63U) ? UINT64_MAX : (((uint64_t)1 << (digit + 1U)) - 1U);
+}
+
+
+static void CO_tmr_link(CO_tmr_t **list, CO_tmr_t *tmr){
+    tmr->prev = NULL;
+    tmr->next = *list;
+    if(*list != NULL){
+        (*list)->prev = tmr;
+    }
+    *list = tmr;
+    tmr->list = list;
+}
+
+
+static void CO_tmr_unlink(CO_tmrWheel_t *wheel, CO_tmr_t *tmr){
+    CO_tmr_t **list = tmr->list;
+
+    if(tmr->prev != NULL){
+        tmr->prev->next = tmr->next;
+    }
+    else{
+        *list = tmr->next;
+    }
+    if(tmr->next != NULL){
+        tmr->next->prev = tmr->prev;
+    }
+    tmr->list = NULL;
+
+    /* keep slotUsed exact, CO_tmrWheel_next() relies on it */
+    if(*list == NULL && list >= &wheel->slot[0][0]
+            && list < &wheel->slot[0][0] + CO_TMR_WHEEL_LEVELS * CO_TMR_WHEEL_SLOTS){
+        uint32_t i = (uint32_t)(list - &wheel->slot[0][0]);
+        wheel->slotUsed[i / CO_TMR_WHEEL_SLOTS] &= ~((uint64_t)1 << (i % CO_TMR_WHEEL_SLOTS));
+    }
+}
+
+
+/*
+ * Put timer on the list, which corresponds to its expiration. Level is given
+ * by the highest bit, where expiration differs from current time, so all
+ * timers on one level share higher digits with current time and their slot
+ * is always ahead of current slot.
+ */
+static void CO_tmr_place(CO_tmrWheel_t *wheel, CO_tmr_t *tmr){
+    if(tmr->expires <= wheel->now){
+        CO_tmr_link(&wheel->expired, tmr);
+    }
+    else{
+        uint32_t msb = 63U - (uint32_t)__builtin_clzll(tmr->expires ^ wheel->now);
+        uint32_t level = msb / CO_TMR_WHEEL_BITS;
+
+        if(level >= CO_TMR_WHEEL_LEVELS){
+            CO_tmr_link(&wheel->overflow, tmr);
+        }
+        else{
+            uint32_t s = (uint32_t)(tmr->expires >> (level * CO_TMR_WHEEL_BITS)) & (CO_TMR_WHEEL_SLOTS - 1U);
+
+            CO_tmr_link(&wheel->slot[level][s], tmr);
+            wheel->slotUsed[level] |= (uint64_t)1 << s;
+        }
+    }
+}
+
+
+/* Place again all timers from list, relative to current time. */
+static void CO_tmr_replaceList(CO_tmrWheel_t *wheel, CO_tmr_t *list){
+    while(list != NULL){
+        CO_tmr_t *tmr = list;
+
+        list = tmr->next;
+        CO_tmr_place(wheel, tmr);
+    }
+}
+
+
+/******************************************************************************/
+void CO_tmrWheel_init(CO_tmrWheel_t *wheel){
+    memset(wheel, 0, sizeof(*wheel));
+}
+
+
+/******************************************************************************/
+void CO_tmrWheel_advance(CO_tmrWheel_t *wheel, uint32_t timeDifference_us){
+    uint64_t old = wheel->now;
+    uint64_t new = old + timeDifference_us;
+    CO_tmr_t *fire;
+    uint32_t level;
+
+    wheel->now = new;
+
+    /* Collect slots, which were reached. Their timers either expired or
+     * move to a lower level. Levels above the first unchanged digit are
+     * unchanged too. */
+    for(level=0; level<CO_TMR_WHEEL_LEVELS && timeDifference_us != 0; level++){
+        uint32_t shift = level * CO_TMR_WHEEL_BITS;
+        uint32_t oldDigit = (uint32_t)(old >> shift) & (CO_TMR_WHEEL_SLOTS - 1U);
+        uint64_t mask, reached;
+
+        if((old >> (shift + CO_TMR_WHEEL_BITS)) == (new >> (shift + CO_TMR_WHEEL_BITS))){
+            uint32_t newDigit = (uint32_t)(new >> shift) & (CO_TMR_WHEEL_SLOTS - 1U);
+
+            if(newDigit == oldDigit){
+                break;
+            }
+            mask = CO_tmrWheel_maskUpTo(newDigit) & ~CO_tmrWheel_maskUpTo(oldDigit);
+        }
+        else{
+            mask = ~CO_tmrWheel_maskUpTo(oldDigit);
+        }
+
+        reached = wheel->slotUsed[level] & mask;
+        wheel->slotUsed[level] &= ~mask;
+        while(reached != 0){
+            uint32_t s = (uint32_t)__builtin_ctzll(reached);
+            CO_tmr_t *list = wheel->slot[level][s];
+
+            reached &= reached - 1U;
+            wheel->slot[level][s] = NULL;
+            CO_tmr_replaceList(wheel, list);
+        }
+    }
+
+    if((old >> (CO_TMR_WHEEL_LEVELS * CO_TMR_WHEEL_BITS)) != (new >> (CO_TMR_WHEEL_LEVELS * CO_TMR_WHEEL_BITS))){
+        CO_tmr_t *list = wheel->overflow;
+
+        wheel->overflow = NULL;
+        CO_tmr_replaceList(wheel, list);
+    }
+
+    /* Move expired timers to own list, so timers started from callbacks
+     * wait for the next call and callback may still stop any timer. */
+    fire = wheel->expired;
+    wheel->expired = NULL;
+    if(fire != NULL){
+        CO_tmr_t *tmr;
+
+        for(tmr=fire; tmr!=NULL; tmr=tmr->next){
+            tmr->list = &fire;
+        }
+    }
+    while(fire != NULL){
+        CO_tmr_t *tmr = fire;
+
+        CO_tmr_unlink(wheel, tmr);
+        wheel->count--;
+        if(tmr->pFunct != NULL){
+            tmr->pFunct(tmr->object);
+        }
+    }
+}
+
+
+/******************************************************************************/
+uint32_t CO_tmrWheel_next(CO_tmrWheel_t *wheel, uint32_t limit){
+    CO_tmr_t *tmr = NULL;
+    uint64_t first = UINT64_MAX;
+    uint32_t level;
+
+    if(wheel->expired != NULL){
+        return 0;
+    }
+
+    /* Timers on lower level expire before any timer on higher level. */
+    for(level=0; level<CO_TMR_WHEEL_LEVELS; level++){
+        if(wheel->slotUsed[level] != 0){
+            tmr = wheel->slot[level][__builtin_ctzll(wheel->slotUsed[level])];
+            break;
+        }
+    }
+    if(tmr == NULL){
+        tmr = wheel->overflow;
+    }
+    for(; tmr!=NULL; tmr=tmr->next){
+        if(tmr->expires < first){
+            first = tmr->expires;
+        }
+    }
+
+    if(first == UINT64_MAX || first - wheel->now >= limit){
+        return limit;
+    }
+    return (uint32_t)(first - wheel->now);
+}
+
+
+/******************************************************************************/
+void CO_tmr_init(CO_tmr_t *tmr, void *object, void (*pFunct)(void *object)){
+    memset(tmr, 0, sizeof(*tmr));
+    tmr->object = object;
+    tmr->pFunct = pFunct;
+}
+
+
+/******************************************************************************/
+void CO_tmr_startAt(CO_tmrWheel_t *wheel, CO_tmr_t *tmr, uint64_t expires){
+    if(tmr->list != NULL){
+        CO_tmr_unlink(wheel, tmr);
+    }
+    else{
+        wheel->count++;
+    }
+    tmr->expires = expires;
+    CO_tmr_place(wheel, tmr);
+}
+
+
+/******************************************************************************/
+void CO_tmr_start(CO_tmrWheel_t *wheel, CO_tmr_t *tmr, uint32_t delay_us){
+    CO_tmr_startAt(wheel, tmr, wheel->now + delay_us);
+}
+
+
+/******************************************************************************/
+void CO_tmr_stop(CO_tmrWheel_t *wheel, CO_tmr_t *tmr){
+    if(tmr->list != NULL){
+        CO_tmr_unlink(wheel, tmr);
+        wheel->count--;
+    }
+}
@@ -6,145 +6,824 @@
  */
 
 #include "Logger.h"
+#include "LogFormat.h"
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/syscall.h>
 
 
+//****************************
+//Local definitions
+//****************************
+//"ERROR:\n" + logLine + repeat count of a log site + "\n\n" must fit into one record
+#define LOG_SITE_SUFFIX		64
+#define LOG_RECORD_SIZE		(sizeof(logLine) + LOG_SITE_SUFFIX + 16)
+//Bytes written with one write() call
+#define LOG_BATCH_SIZE		(64*1024)
+//Files remembered for the total size cap
+#define LOG_MAX_FILES		64
+
+typedef struct{
+	uint16_t	length;			//text records: bytes in text
+	uint8_t		isError;
+	uint8_t		isEvent;		//event of site, args are in bin
+	uint8_t		newSite;		//first record of site, writer appends it to the sites file
+	const logEventSite_t *site;
+	logBinRecord_t bin;			//binary format only: header fields of the record
+	char		text[LOG_RECORD_SIZE];
+}logRecord_t;
+
+typedef struct{
+	int			fd;
+	const char	*prefix;		//"log" or "Error"
+	const char	*ext;			//".log" or ".bin"
+	char		path[255];		//current file
+	size_t		size;			//bytes written to current file
+	time_t		opened;			//when current file was created
+	unsigned	sequence;		//rotations so far
+	char		*batch;			//records waiting for one write()
+	size_t		batchLen;
+}logStream_t;
+
+typedef struct{
+	char		path[255];
+	size_t		size;
+}logFile_t;
+
 //****************************
 //Global variables
 //****************************
-FILE * allLog;
-FILE * errLog;
+__thread char			logLine[250];
+static logRecord_t		logQueue[LOG_QUEUE_LEN];
+static unsigned			logHead;		//next record to write, writer only
+static unsigned			logTail;		//next free record, producers under logMtx
+static unsigned long	logDropped;
+static pthread_mutex_t	logMtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	logCond;
+static pthread_t		logThread;
+static volatile int		logRunning;
+
+static logStream_t		allLog = {.fd = -1, .prefix = "log", .ext = ".log"};
+static logStream_t		errLog = {.fd = -1, .prefix = "Error", .ext = ".log"};
+static char				*consoleBatch;
+static size_t			consoleBatchLen;
+
+//Binary format only
+static int				logFormat = LOG_FORMAT;
+static logBinHeader_t	logBinHeader;
+static int				logSitesFd = -1;
+static uint16_t			logSiteCount;
+
+//Files created so far, oldest first. Used for LOG_MAX_TOTAL_SIZE.
+static logFile_t		logFiles[LOG_MAX_FILES];
+static int				logFileCount;
+static size_t			logTotalSize;
+
+uint8_t logModuleLevel[LOG_MOD_COUNT] = {
+		LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL,
+		LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL};
+
+//Names accepted in CO_LOG_LEVEL, indexed by LOG_MOD_xxx
+static const char *logModuleName[LOG_MOD_COUNT] = {
+		"main", "driver", "sdo", "pdo", "nmt", "emcy", "storage", "tasks"};
+
 //****************************
-int startLogger()
+//Writes whole buffer, retrying on short writes. Errors are reported once per call.
+static void logWriteAll(int fd,const char *buf,size_t len)
 {
-	if(DEBUG_LEVEL>0)
+	while(len>0)
 	{
+		ssize_t n = write(fd,buf,len);
+		if(n<0)
+		{
+			if(errno==EINTR) continue;
+			perror("Logger.c : logWriteAll : ## write failed");
+			return;
+		}
+		buf+=n;
+		len-=(size_t)n;
+	}
+}
 
-	    time_t rawtime;
-	    char logFilePath [255];
-	    char errorFilePath [255];
+//****************************
+//Deletes oldest files until all files together fit into LOG_MAX_TOTAL_SIZE.
+//Files currently open are never deleted.
+static void logEnforceTotalSize(void)
+{
+	int i = 0;
 
-	    //getting current timestamp for naming the log.
-	    time (&rawtime);
+	while(i<logFileCount && (logTotalSize>LOG_MAX_TOTAL_SIZE || logFileCount==LOG_MAX_FILES))
+	{
+		if(strcmp(logFiles[i].path,allLog.path)==0 || strcmp(logFiles[i].path,errLog.path)==0)
+		{
+			i++;
+			continue;
+		}
+		unlink(logFiles[i].path);
+		logTotalSize-=logFiles[i].size;
+		logFileCount--;
+		memmove(&logFiles[i],&logFiles[i+1],(logFileCount-i)*sizeof(logFile_t));
+	}
+}
 
-	    //append location where we need to create the log file.
-		sprintf(logFilePath,"/home/log_%d",(int)rawtime);
-		sprintf(errorFilePath,"/home/Error_%d",(int)rawtime);
+//****************************
+//Account bytes written to the current file of this stream
+static void logAccount(logStream_t *stream,size_t len)
+{
+	int i;
 
-		//append .log extension
-		strcat(logFilePath,".log");
-		strcat(errorFilePath,".log");
+	stream->size+=len;
+	logTotalSize+=len;
+	for(i=logFileCount-1;i>=0;i--)
+	{
+		if(strcmp(logFiles[i].path,stream->path)==0)
+		{
+			logFiles[i].size+=len;
+			break;
+		}
+	}
+}
+
+//****************************
+//Closes current file of the stream (if any) and creates the next one.
+static int logOpenStream(logStream_t *stream)
+{
+	char path[255];
+	time_t now = time(NULL);
+	int fd;
 
-		//pointer to the buffer containing name of the log file to be created.
-		char *bufferPtr = logFilePath;
-        char *errorLogPtr=errorFilePath;
+	if(stream->sequence==0)
+		snprintf(path,sizeof(path),"%s/%s_%d%s",LOG_DIR,stream->prefix,(int)now,stream->ext);
+	else
+		snprintf(path,sizeof(path),"%s/%s_%d_%u%s",LOG_DIR,stream->prefix,(int)now,stream->sequence,stream->ext);
 
-        //remove ':' from the timestamp string and replace it with '_'
-		for (; *bufferPtr; ++bufferPtr)
+	fd = open(path,O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC,0644);
+	if(fd<0)
+	{
+		perror("Logger.c : logOpenStream : ## Cannot create Log file. check log path!!!!!");
+		return -1;
+	}
+	if(stream->fd>=0)
+	{
+		close(stream->fd);
+	}
+	stream->fd=fd;
+	strcpy(stream->path,path);
+	stream->size=0;
+	stream->opened=now;
+	stream->sequence++;
+
+	if(logFileCount==LOG_MAX_FILES)
+	{
+		logEnforceTotalSize();
+	}
+	strcpy(logFiles[logFileCount].path,path);
+	logFiles[logFileCount].size=0;
+	logFileCount++;
+
+	//every binary file starts with the header, so it can be decoded on its own
+	if(strcmp(stream->ext,".bin")==0)
+	{
+		logWriteAll(fd,(const char*)&logBinHeader,sizeof(logBinHeader));
+		logAccount(stream,sizeof(logBinHeader));
+	}
+
+	printf("\n %s file path=%s\n",stream->prefix,path);
+	return 1;
+}
+
+//****************************
+//Writes the batch of the stream and rotates the file if it is too big or too old.
+static void logFlushStream(logStream_t *stream)
+{
+	if(stream->fd<0 || stream->batchLen==0)
+	{
+		return;
+	}
+	logWriteAll(stream->fd,stream->batch,stream->batchLen);
+	logAccount(stream,stream->batchLen);
+	stream->batchLen=0;
+
+	if((LOG_ROTATE_SIZE>0 && stream->size>=LOG_ROTATE_SIZE)
+			|| (LOG_ROTATE_AGE_S>0 && time(NULL)-stream->opened>=LOG_ROTATE_AGE_S))
+	{
+		logOpenStream(stream);
+	}
+	logEnforceTotalSize();
+}
+
+//****************************
+//Appends bytes to the batch of the stream, writing the batch first if it is full.
+static void logAppend(logStream_t *stream,const void *data,size_t len)
+{
+	if(stream->batchLen+len>LOG_BATCH_SIZE) logFlushStream(stream);
+	memcpy(stream->batch+stream->batchLen,data,len);
+	stream->batchLen+=len;
+}
+
+//****************************
+//Renders an event into the text format used by the logging sites
+static size_t logRenderText(const logRecord_t *rec,char *out,size_t outSize)
+{
+	const char *file = strrchr(rec->site->file,'/');
+	int len;
+
+	len=snprintf(out,outSize,"%sFILE: %s||CALL: %s\nMSG: ",rec->isError ? "ERROR:\n" : "",
+			(file!=NULL) ? file+1 : rec->site->file,rec->site->func);
+	if(len<0 || (size_t)len>=outSize) return 0;
+	len+=logRenderEvent(out+len,outSize-len,rec->site->fmt,rec->bin.nargs,rec->bin.args);
+	len+=snprintf(out+len,outSize-len,"\n\n");
+	return ((size_t)len<outSize) ? (size_t)len : outSize-1;
+}
+
+//****************************
+//Appends a site to the sites file. Writer thread only.
+static void logWriteSite(const logEventSite_t *site)
+{
+	char line[LOG_RECORD_SIZE];
+	const char *c;
+	int len;
+
+	len=snprintf(line,sizeof(line),"%u\t%u\t%s\t%s\t",site->id,site->module,site->file,site->func);
+	for(c=site->fmt;*c && len<(int)sizeof(line)-3;c++)
+	{
+		if(*c=='\n')		{ line[len++]='\\'; line[len++]='n'; }
+		else if(*c=='\t')	{ line[len++]='\\'; line[len++]='t'; }
+		else if(*c=='\\')	{ line[len++]='\\'; line[len++]='\\'; }
+		else				line[len++]=*c;
+	}
+	line[len++]='\n';
+	if(logSitesFd>=0)
+	{
+		logWriteAll(logSitesFd,line,len);
+	}
+}
+
+//****************************
+//Copies one record into the output batches. Error records go to both files as they are.
+//In binary format the log file gets records, console and error file get text.
+static void logBatchRecord(const logRecord_t *rec)
+{
+	char eventText[LOG_RECORD_SIZE];
+	const char *text = rec->text;
+	size_t length = rec->length;
+
+	if(rec->newSite)
+	{
+		logWriteSite(rec->site);
+	}
+	if(rec->isEvent && (consoleBatch!=NULL || rec->isError || logFormat==LOG_FORMAT_TEXT))
+	{
+		length=logRenderText(rec,eventText,sizeof(eventText));
+		text=eventText;
+	}
+
+	if(consoleBatch!=NULL)
+	{
+		if(consoleBatchLen+length>LOG_BATCH_SIZE)
+		{
+			logWriteAll(STDOUT_FILENO,consoleBatch,consoleBatchLen);
+			consoleBatchLen=0;
+		}
+		memcpy(consoleBatch+consoleBatchLen,text,length);
+		consoleBatchLen+=length;
+	}
+
+	if(allLog.batch!=NULL && logFormat==LOG_FORMAT_BINARY)
+	{
+		if(rec->isEvent)
+		{
+			logAppend(&allLog,&rec->bin,sizeof(logBinRecord_t));
+		}
+		else
+		{
+			//text line split into chunks, all with the header of the original call
+			logBinRecord_t chunk = rec->bin;
+			size_t offset = 0;
+			do{
+				size_t n = rec->length-offset;
+				if(n>LOG_BIN_TEXT_CHUNK) n=LOG_BIN_TEXT_CHUNK;
+				memset(chunk.text,0,sizeof(chunk.text));
+				memcpy(chunk.text,rec->text+offset,n);
+				offset+=n;
+				chunk.nargs=(uint8_t)n;
+				chunk.flags=(offset<rec->length) ? LOG_BIN_FLAG_MORE : 0;
+				logAppend(&allLog,&chunk,sizeof(chunk));
+			}while(offset<rec->length);
+		}
+	}
+	else if(allLog.batch!=NULL)
+	{
+		logAppend(&allLog,text,length);
+	}
+
+	if(errLog.batch!=NULL && rec->isError)
+	{
+		logAppend(&errLog,text,length);
+	}
+}
+
+//****************************
+//Writer thread. Sleeps until LOG_FLUSH_BATCH records are queued or
+//LOG_FLUSH_INTERVAL_MS passes, then writes everything queued with few large writes.
+static void* logWriterThread(void *arg)
+{
+	unsigned long droppedReported = 0;
+	int running = 1;
+
+	(void)arg;
+	while(running)
+	{
+		struct timespec deadline;
+		unsigned tail;
+
+		clock_gettime(CLOCK_MONOTONIC,&deadline);
+		deadline.tv_nsec+=(LOG_FLUSH_INTERVAL_MS%1000)*1000000L;
+		deadline.tv_sec+=LOG_FLUSH_INTERVAL_MS/1000+deadline.tv_nsec/1000000000L;
+		deadline.tv_nsec%=1000000000L;
+
+		pthread_mutex_lock(&logMtx);
+		while(logRunning && logTail-logHead<LOG_FLUSH_BATCH)
 		{
-		    if (*bufferPtr == ' ')
-		     *bufferPtr = '_';
+			if(pthread_cond_timedwait(&logCond,&logMtx,&deadline)==ETIMEDOUT) break;
+		}
+		running=logRunning;
+		tail=logTail;
+		pthread_mutex_unlock(&logMtx);
 
-		    if (*bufferPtr==':')
-		   	 *bufferPtr='_';
+		//records between head and tail are complete and owned by the writer
+		while(logHead!=tail)
+		{
+			logBatchRecord(&logQueue[logHead%LOG_QUEUE_LEN]);
+			__atomic_store_n(&logHead,logHead+1,__ATOMIC_RELEASE);
 		}
 
-		for (; *errorLogPtr; ++errorLogPtr)
+		if(logDroppedCount()!=droppedReported)
 		{
-		    if (*errorLogPtr == ' ')
-		    	*errorLogPtr = '_';
+			logRecord_t rec;
+			unsigned long dropped = logDroppedCount();
+			struct timespec ts;
+			clock_gettime(CLOCK_MONOTONIC,&ts);
+			memset(&rec.bin,0,sizeof(rec.bin));
+			rec.bin.timestamp=(uint64_t)ts.tv_sec*1000000000ULL+(uint64_t)ts.tv_nsec;
+			rec.bin.type=LOG_BIN_TEXT_ERROR;
+			rec.isEvent=0;
+			rec.newSite=0;
+			rec.isError=1;
+			rec.length=(uint16_t)snprintf(rec.text,sizeof(rec.text),
+					"ERROR:\nFILE: Logger.c||CALL: logWriterThread\nMSG: %lu records dropped, queue full\n\n",
+					dropped-droppedReported);
+			droppedReported=dropped;
+			logBatchRecord(&rec);
+		}
 
-		    if (*errorLogPtr==':')
-		    	*errorLogPtr='_';
+		if(consoleBatchLen>0)
+		{
+			logWriteAll(STDOUT_FILENO,consoleBatch,consoleBatchLen);
+			consoleBatchLen=0;
 		}
+		logFlushStream(&allLog);
+		logFlushStream(&errLog);
+	}
+	return NULL;
+}
+
+//****************************
+int startLogger()
+{
+	pthread_condattr_t condAttr;
+	pthread_mutexattr_t mtxAttr;
+
+	//apply runtime levels before anything is logged
+	char *levelSpec = getenv("CO_LOG_LEVEL");
+	if(levelSpec != NULL && logSetLevels(levelSpec) < 0)
+	{
+		printf("\n Logger: ignoring malformed CO_LOG_LEVEL=\"%s\"\n",levelSpec);
+	}
 
-		//Printing log file path
-		printf("\n log file path=%s\n",logFilePath);
-		//Printing Errorlog file path
-		printf("\n Error log file path=%s\n",errorFilePath);
+	//log file format, CO_LOG_FORMAT=text|binary
+	char *formatSpec = getenv("CO_LOG_FORMAT");
+	if(formatSpec != NULL)
+	{
+		if(strcmp(formatSpec,"binary")==0) logFormat=LOG_FORMAT_BINARY;
+		else if(strcmp(formatSpec,"text")==0) logFormat=LOG_FORMAT_TEXT;
+		else printf("\n Logger: ignoring unknown CO_LOG_FORMAT=\"%s\"\n",formatSpec);
+	}
 
-		//Create and open the file with write access.
-		allLog = fopen (logFilePath, "w+");
-		errLog = fopen (errorFilePath, "w+");
-		//check whether file is created or not
-		if(allLog==NULL)
+	if(DEBUG_LEVEL==0 || PRINT_DEBUG==NO_LOG)
+	{
+		return 1;
+	}
+
+	if(PRINT_DEBUG==PRINT_ON_CONSOLE || PRINT_DEBUG==PRINT_ON_BOTH)
+	{
+		consoleBatch = malloc(LOG_BATCH_SIZE);
+		if(consoleBatch==NULL) return -1;
+	}
+	if(PRINT_DEBUG==PRINT_ON_LOGFILE || PRINT_DEBUG==PRINT_ON_BOTH)
+	{
+		allLog.batch = malloc(LOG_BATCH_SIZE);
+		errLog.batch = malloc(LOG_BATCH_SIZE);
+		if(allLog.batch==NULL || errLog.batch==NULL) return -1;
+
+		if(logFormat==LOG_FORMAT_BINARY)
 		{
-			//if file not created. stop execution of the program. With a message
-			perror("Logger.h : StartLogger : ## Cannot create Log file. check log path!!!!!");
-			return -1;
+			struct timespec mono, real;
+			char sitesPath[255];
+
+			clock_gettime(CLOCK_MONOTONIC,&mono);
+			clock_gettime(CLOCK_REALTIME,&real);
+			memcpy(logBinHeader.magic,LOG_BIN_MAGIC,sizeof(logBinHeader.magic));
+			logBinHeader.version=LOG_BIN_VERSION;
+			logBinHeader.recordSize=sizeof(logBinRecord_t);
+			logBinHeader.runId=(uint32_t)real.tv_sec;
+			logBinHeader.monoStart=(uint64_t)mono.tv_sec*1000000000ULL+(uint64_t)mono.tv_nsec;
+			logBinHeader.realStart=(uint64_t)real.tv_sec*1000000000ULL+(uint64_t)real.tv_nsec;
+			allLog.ext=".bin";
+
+			//site formats for the decoder, kept for the whole run (not rotated)
+			snprintf(sitesPath,sizeof(sitesPath),"%s/sites_%u.txt",LOG_DIR,logBinHeader.runId);
+			logSitesFd=open(sitesPath,O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC,0644);
+			if(logSitesFd<0)
+			{
+				perror("Logger.c : startLogger : ## Cannot create sites file. check log path!!!!!");
+				return -1;
+			}
 		}
-		if(errLog==NULL)
+
+		//Create and open the files. If not created, stop with a message.
+		if(logOpenStream(&allLog)<0 || logOpenStream(&errLog)<0)
 		{
-			//if file not created. stop execution of the program. With a message
-			perror("Logger.h : StartLogger : ## Cannot create Error Log file. check log path!!!!!");
 			return -1;
 		}
 	}
 
-	if(PRINT_DEBUG==PRINT_ON_CONSOLE) printf("\n Logger print on CONSOLE only");
-	if(PRINT_DEBUG==PRINT_ON_LOGFILE)fprintf(allLog,"\n Logger print on LOG file only\n");
-	if(PRINT_DEBUG==PRINT_ON_BOTH) {  printf("\n Logger print on CONSOLE and LOG \n");
-									  fprintf(allLog,"\n Logger print on CONSOLE and LOG \n");
-									}
+	//realtime threads queue records too, so the queue lock inherits their priority
+	pthread_mutexattr_init(&mtxAttr);
+	pthread_mutexattr_setprotocol(&mtxAttr,PTHREAD_PRIO_INHERIT);
+	pthread_mutex_init(&logMtx,&mtxAttr);
+	pthread_mutexattr_destroy(&mtxAttr);
 
-	    return 1;
+	pthread_condattr_init(&condAttr);
+	pthread_condattr_setclock(&condAttr,CLOCK_MONOTONIC);
+	pthread_cond_init(&logCond,&condAttr);
+	pthread_condattr_destroy(&condAttr);
+
+	logHead=logTail=0;
+	logRunning=1;
+	if(pthread_create(&logThread,NULL,logWriterThread,NULL)!=0)
+	{
+		logRunning=0;
+		perror("Logger.c : startLogger : ## Cannot start log writer thread");
+		return -1;
+	}
+
+	if(PRINT_DEBUG==PRINT_ON_CONSOLE) logPrint(LOG," Logger print on CONSOLE only");
+	if(PRINT_DEBUG==PRINT_ON_LOGFILE) logPrint(LOG," Logger print on LOG file only");
+	if(PRINT_DEBUG==PRINT_ON_BOTH) logPrint(LOG," Logger print on CONSOLE and LOG");
+
+	return 1;
 }
 
 //****************************
 int stopLogger()
 {
-	if(fclose(allLog)>0)
+	int ret = 1;
+
+	if(!logRunning)
 	{
-		perror("Logger.h: stopLogger : ## cannot close the log file.");
-		return -1;
+		return 1;
+	}
+
+	//writer drains the queue before it exits
+	pthread_mutex_lock(&logMtx);
+	logRunning=0;
+	pthread_cond_signal(&logCond);
+	pthread_mutex_unlock(&logMtx);
+	pthread_join(logThread,NULL);
 
+	if(allLog.fd>=0 && close(allLog.fd)<0)
+	{
+		perror("Logger.c: stopLogger : ## cannot close the log file.");
+		ret=-1;
 	}
-	if(fclose(errLog)>0)
+	if(errLog.fd>=0 && close(errLog.fd)<0)
 	{
-		perror("Logger.h: stopLogger : ## cannot close the log file.");
-		return -1;
+		perror("Logger.c: stopLogger : ## cannot close the log file.");
+		ret=-1;
+	}
+	allLog.fd=errLog.fd=-1;
+	if(logSitesFd>=0)
+	{
+		close(logSitesFd);
+		logSitesFd=-1;
+	}
+	return ret;
+}
 
+//****************************
+//Takes a free queue record with logMtx held. Returns NULL (and unlocks) if full.
+static logRecord_t* logQueueGet(int module,int logid,unsigned *pending)
+{
+	static __thread uint32_t tid;
+	logRecord_t *rec;
+
+	if(tid==0)
+	{
+		tid=(uint32_t)syscall(SYS_gettid);
 	}
+
+	pthread_mutex_lock(&logMtx);
+	*pending=logTail-__atomic_load_n(&logHead,__ATOMIC_ACQUIRE);
+	if(*pending>=LOG_QUEUE_LEN)
+	{
+		logDropped++;
+		pthread_mutex_unlock(&logMtx);
+		return NULL;
+	}
+	rec=&logQueue[logTail%LOG_QUEUE_LEN];
+	rec->isError=(logid==ERROR);
+	rec->isEvent=0;
+	rec->newSite=0;
+	if(logFormat==LOG_FORMAT_BINARY)
+	{
+		//taken under the lock, so records in the file are in timestamp order
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC,&ts);
+		rec->bin.timestamp=(uint64_t)ts.tv_sec*1000000000ULL+(uint64_t)ts.tv_nsec;
+		rec->bin.tid=tid;
+		rec->bin.site=0;
+		rec->bin.module=(uint8_t)module;
+		rec->bin.type=(logid==ERROR) ? LOG_BIN_TEXT_ERROR : LOG_BIN_TEXT;
+		rec->bin.nargs=0;
+		rec->bin.flags=0;
+		memset(rec->bin.reserved,0,sizeof(rec->bin.reserved));
+	}
+	return rec;
+}
+
+//****************************
+//Publishes the record taken by logQueueGet() and unlocks logMtx
+static void logQueuePut(unsigned pending)
+{
+	logTail++;
+
+	//wake the writer only when a batch is ready, otherwise it wakes on its own cadence
+	if(pending+1==LOG_FLUSH_BATCH)
+	{
+		pthread_cond_signal(&logCond);
+	}
+	pthread_mutex_unlock(&logMtx);
+}
+
+//****************************
+void logPrintModule(int module,int logid,char* logLine)
+{
+	logRecord_t *rec;
+	unsigned pending;
+	int len;
+
+	if(!logRunning)
+	{
+		//logger not started (or stopped), keep the old behaviour of printing on console
+		printf((logid==ERROR) ? "ERROR:\n%s\n\n" : "%s\n\n",logLine);
+		return;
+	}
+
+	rec=logQueueGet(module,logid,&pending);
+	if(rec==NULL)
+	{
+		return;
+	}
+
+	//format once. Error records are written to both files from the same text.
+	len=snprintf(rec->text,sizeof(rec->text),(logid==ERROR) ? "ERROR:\n%s\n\n" : "%s\n\n",logLine);
+	if(len<0) len=0;
+	if((size_t)len>=sizeof(rec->text)) len=sizeof(rec->text)-1;
+	rec->length=(uint16_t)len;
+	logQueuePut(pending);
+}
+
+//****************************
+//Assigns an id to the site. Called with logMtx held, so it does no I/O. The writer
+//appends the site to the sites file with its first record, see logWriteSite().
+static int logRegisterSite(logEventSite_t *site)
+{
+	if(logSiteCount==UINT16_MAX)
+	{
+		return 0;
+	}
+	site->id=++logSiteCount;
 	return 1;
 }
 
 //****************************
-void logPrint(int logid,char* logLine)
+void logEvent(logEventSite_t *site,int logid,int nargs,const int64_t *args)
 {
-	switch(logid)
+	logRecord_t *rec;
+	unsigned pending;
+
+	if(nargs>LOG_BIN_MAX_ARGS)
+	{
+		nargs=LOG_BIN_MAX_ARGS;
+	}
+
+	if(!logRunning || logFormat==LOG_FORMAT_TEXT)
+	{
+		//same text as a sprintf()+logPrint() site would produce
+		char line[sizeof(logLine)];
+		const char *file = strrchr(site->file,'/');
+		int len = snprintf(line,sizeof(line),"FILE: %s||CALL: %s\nMSG: ",(file!=NULL) ? file+1 : site->file,site->func);
+		logRenderEvent(line+len,sizeof(line)-len,site->fmt,nargs,args);
+		logPrintModule(site->module,logid,line);
+		return;
+	}
+
+	rec=logQueueGet(site->module,logid,&pending);
+	if(rec==NULL)
 	{
-	case LOG:
-			if(PRINT_DEBUG==PRINT_ON_CONSOLE) printf("%s\n\n",logLine);
-			if(PRINT_DEBUG==PRINT_ON_LOGFILE)fprintf(allLog,"%s\n\n",(char*)logLine);
-			if(PRINT_DEBUG==PRINT_ON_BOTH)
+		return;
+	}
+	if(site->id==0)
+	{
+		rec->newSite=(uint8_t)logRegisterSite(site);
+	}
+	rec->isEvent=1;
+	rec->site=site;
+	rec->length=0;
+	rec->bin.site=site->id;
+	rec->bin.type=(logid==ERROR) ? LOG_BIN_ERROR : LOG_BIN_LOG;
+	rec->bin.nargs=(uint8_t)nargs;
+	memset(rec->bin.args,0,sizeof(rec->bin.args));
+	memcpy(rec->bin.args,args,nargs*sizeof(int64_t));
+	logQueuePut(pending);
+}
+
+//****************************
+static uint32_t logNowMs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC_COARSE,&ts);
+	return (uint32_t)ts.tv_sec*1000U+(uint32_t)(ts.tv_nsec/1000000L);
+}
+
+//****************************
+int logSiteAllow(logSite_t *site)
+{
+	uint32_t now = logNowMs();
+
+	if(now-site->windowStart>=LOG_SITE_WINDOW_MS)
+	{
+		site->windowStart=now;
+		site->printed=0;
+		return 1;
+	}
+	//a site already repeating itself in this window is not formatted again
+	if(site->printed<LOG_SITE_BURST && site->repeated==0)
+	{
+		return 1;
+	}
+	if(site->limited==0 && site->repeated==0)
+	{
+		site->skipStart=now;
+	}
+	site->limited++;
+	return 0;
+}
+
+//****************************
+void logPrintSiteModule(int module,logSite_t *site,int logid,char* text)
+{
+	uint32_t hash = 2166136261U;	//FNV-1a
+	const char *c;
+
+	for(c=text;*c;c++)
+	{
+		hash=(hash^(uint8_t)*c)*16777619U;
+	}
+
+	//run-length: identical to the last printed record, only count it
+	if(hash==site->lastHash && (site->printed>0 || site->repeated>0 || site->limited>0))
+	{
+		if(site->limited==0 && site->repeated==0)
+		{
+			site->skipStart=logNowMs();
+		}
+		//repeats are reported once per window, together with the next print
+		if(logNowMs()-site->skipStart<LOG_SITE_WINDOW_MS)
+		{
+			site->repeated++;
+			return;
+		}
+	}
+
+	site->lastHash=hash;
+	site->printed++;
+	if(site->limited>0 || site->repeated>0)
+	{
+		char line[sizeof(logLine) + LOG_SITE_SUFFIX];
+		if(site->limited==0)
+			snprintf(line,sizeof(line),"%s\n[previous message repeated %u times in %u ms]",
+					text,site->repeated,logNowMs()-site->skipStart);
+		else
+			snprintf(line,sizeof(line),"%s\n[%u more from this site suppressed in %u ms]",
+					text,site->repeated+site->limited,logNowMs()-site->skipStart);
+		site->limited=0;
+		site->repeated=0;
+		logPrintModule(module,logid,line);
+		return;
+	}
+	logPrintModule(module,logid,text);
+}
+
+//****************************
+unsigned long logDroppedCount()
+{
+	unsigned long dropped;
+
+	pthread_mutex_lock(&logMtx);
+	dropped=logDropped;
+	pthread_mutex_unlock(&logMtx);
+	return dropped;
+}
+
+//****************************
+int logSetModuleLevel(int module,uint8_t level)
+{
+	if(module<0 || module>=LOG_MOD_COUNT)
+	{
+		return -1;
+	}
+	logModuleLevel[module]=level;
+	return 1;
+}
+
+//****************************
+uint8_t logGetModuleLevel(int module)
+{
+	if(module<0 || module>=LOG_MOD_COUNT)
+	{
+		return 0;
+	}
+	return logModuleLevel[module];
+}
+
+//****************************
+int logSetLevels(const char *spec)
+{
+	int applied=0;
+
+	while(*spec)
+	{
+		const char *end = strchr(spec,',');
+		const char *eq;
+		size_t len = (end!=NULL) ? (size_t)(end-spec) : strlen(spec);
+		char *numEnd;
+		long level;
+		int module;
+
+		//"N" alone, or "*=N", sets every module
+		eq = memchr(spec,'=',len);
+		level = strtol((eq!=NULL) ? eq+1 : spec,&numEnd,10);
+		if(numEnd==((eq!=NULL) ? eq+1 : spec) || numEnd!=spec+len || level<0 || level>255)
+		{
+			return -1;
+		}
+
+		if(eq==NULL || (eq-spec==1 && *spec=='*'))
+		{
+			for(module=0;module<LOG_MOD_COUNT;module++)
 			{
-				printf("%s\n\n",logLine);
-				fprintf(allLog,"%s\n\n",(char*)logLine);
+				logModuleLevel[module]=(uint8_t)level;
 			}
-			break;
-	case ERROR:
-		   //print error in error file and well as log file.
-			if(PRINT_DEBUG==PRINT_ON_CONSOLE)
-				{
-
-					printf("ERROR:\n%s\n\n",logLine);
-				}
-			if(PRINT_DEBUG==PRINT_ON_LOGFILE)
+		}
+		else
+		{
+			for(module=0;module<LOG_MOD_COUNT;module++)
+			{
+				if(strlen(logModuleName[module])==(size_t)(eq-spec)
+						&& strncmp(logModuleName[module],spec,eq-spec)==0)
 				{
-					fprintf(allLog,"ERROR:\n%s\n\n",(char*)logLine);
-					fprintf(errLog,"ERROR:\n%s\n\n",(char*)logLine);
+					break;
 				}
-			if(PRINT_DEBUG==PRINT_ON_BOTH)
+			}
+			if(module==LOG_MOD_COUNT)
 			{
-				printf("ERROR:\n%s\n\n",logLine);
-				fprintf(allLog,"ERROR:\n%s\n\n",(char*)logLine);
-				fprintf(errLog,"ERROR:\n%s\n\n",(char*)logLine);
+				return -1;
 			}
+			logModuleLevel[module]=(uint8_t)level;
+		}
+		applied++;
+
+		if(end==NULL)
+		{
 			break;
-	default:
-			//print on console by default
-			printf("%s\n\n",logLine);
-		break;
+		}
+		spec=end+1;
 	}
+	return applied;
 }
 //****************************
-
@@ -45,6 +45,7 @@
 
 
 #include "CANopen.h"
+#include "CO_async.h"
 
 
 /*******************************************************************************/
@@ -66,6 +67,17 @@ void communicationReset(void){
 }
 
 
+/*******************************************************************************/
+void programTasks(CO_async_t *async){
+	(void)async;
+	if(LEVEL_1){sprintf(logLine,
+			"FILE: application.c"
+			"||CALL: programTasks"
+			"\nMSG: started"); logPrint(LOG,logLine);}
+
+}
+
+
 /*******************************************************************************/
 void programEnd(void){
 	if(LEVEL_1){sprintf(logLine,
@@ -86,10 +98,9 @@ void programAsync(uint16_t timer1msDiff){
 
 
 /*******************************************************************************/
-void program1ms(void){
-	if(LEVEL_1){sprintf(logLine,
-			"FILE: application.c"
-			"||CALL: program1ms"
-			"\nMSG: started"); logPrint(LOG,logLine);}
+void program1ms(uint32_t timeDifference_us){
+	(void)timeDifference_us;
+	/* Runs in realtime thread between RPDOs and TPDOs, each cycle within
+	 * app_rt_budget_us. Keep it short and non-blocking, no logging per call. */
 
 }
@@ -1,9 +1,10 @@
 /*
- * CANopen main program file.
+ * CANopen main program file for Linux SocketCAN.
  *
- * This file is a template for other microcontrollers.
+ * Mainline and realtime tasks from CO_Linux_tasks.c run in two threads, each
+ * blocked in epoll_wait() until CAN message, timer or signal arrives.
  *
- * @file        main_generic.c
+ * @file        main.c
  * @author      Janez Paternoster
  * @copyright   2004 - 2015 Janez Paternoster
  *
@@ -47,156 +48,366 @@
 
 #include "CANopen.h"
 #include "application.h"
+#include "CO_Linux_tasks.h"
+#include "CO_Linux_rt.h"
+#include "CO_Linux_wdog.h"
 #include "Logger.h"
 #include <stdio.h>
-
-#define TMR_TASK_INTERVAL   (1000)          /* Interval of tmrTask thread in microseconds */
-#define INCREMENT_1MS(var)  (var++)         /* Increment 1ms variable in tmrTask */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <net/if.h>
+
+#define TMR_TASK_INTERVAL   (50000)         /* Longest sleep of tmrTask thread in microseconds */
+#define CAN_INTERFACE       "can0"          /* CAN network interface, its index is CAN module address for CO_init() */
+#define NODE_ID             (10)            /* CANopen Node-ID */
+#define CAN_BIT_RATE        (125)           /* bit rate in kbps */
+#define RT_CONFIG_ENV       "CO_RT_CONFIG"  /* environment variable with name of realtime configuration file */
 
 
 /* Global variables and objects */
     volatile uint16_t   CO_timer1ms = 0U;   /* variable increments each millisecond */
+static volatile sig_atomic_t CO_endProgram = 0; /* set by SIGINT or SIGTERM */
+static volatile sig_atomic_t rtThreadRun = 0;   /* rt_thread runs while set */
+static struct timespec  programStartTime;       /* CO_clock_gettime() at program start */
+static CO_rtCfg_t       rtCfg;                  /* realtime configuration, see CO_Linux_rt.h */
+static CO_wdog_t        wdog;                   /* deadline watchdog of the tasks, see CO_Linux_wdog.h */
+static volatile pid_t   rtThreadTid = 0;        /* Linux thread id of rt_thread, for report */
+static CO_t            *CO = NULL;              /* CANopen object, uses global Object Dictionary */
+static CO_taskMain_t    taskMain;               /* mainline task of CO */
+static CO_taskRT_t      taskRT;                 /* realtime task of CO */
+static CO_async_t       async;                  /* application tasks, see CO_async.h */
+
+
+/* Signal handler for SIGINT and SIGTERM **************************************/
+static void sigHandler(int sig){
+    (void)sig;
+    /* epoll_wait() in mainline returns with EINTR, loop sees the flag. */
+    CO_endProgram = 1;
+}
 
 
-/* main ***********************************************************************/
-int main (void){
-     startLogger();
-
-	 if(LEVEL_1){sprintf(logLine,
-			 "FILE: main.c"
-			 "||CALL: main"
-			 "\nMSG: program started"); logPrint(LOG,logLine);}
-
-
-    CO_NMT_reset_cmd_t reset = CO_RESET_NOT;
-
-    /* Configure microcontroller. */
+/* Update CO_timer1ms from clock of the tasks *********************************/
+static void timer1msUpdate(void){
+    struct timespec now;
 
+    CO_clock_gettime(&now);
+    CO_timer1ms = (uint16_t)((now.tv_sec - programStartTime.tv_sec) * 1000
+                + (now.tv_nsec - programStartTime.tv_nsec) / 1000000);
+}
 
-    /* initialize EEPROM */
 
+/* Print taskRT wakeup latency in cyclictest format ***************************/
+/* Histograms are read live and not reset, OD 0x2141 has reset on read. */
+static void rtJitterReport(void){
+    const CO_taskStats_t *stats = CANrx_taskTmr_stats(&taskRT);
+    const CO_taskStats_t *mainStats = taskMain_stats(&taskMain);
+    const CO_hist_t *wakeup = &stats->wakeup;
+    const CO_syncPll_t *pll = CANrx_taskTmr_syncPll(&taskRT);
 
-    /* increase variable each startup. Variable is stored in EEPROM. */
-    OD_powerOnCounter++;
+    if(wakeup->total == 0){
+        return;
+    }
+    if(LEVEL_1){sprintf(logLine,
+            "FILE: main.c"
+            "||CALL: rtJitterReport"
+            "\nMSG: T: 0 (%5d) P:%2d I:%d C:%9u Min:%7u Act:%5u Avg:%5u Max:%8u P99:%5u Ovr:%u Miss:%u",
+            (int)rtThreadTid, rtCfg.rt.priority, TMR_TASK_INTERVAL, (uint32_t)wakeup->total, wakeup->min,
+            wakeup->last, (uint32_t)(wakeup->sum / wakeup->total), wakeup->max,
+            CO_hist_percentile(wakeup, 990), stats->overruns, stats->missedTicks); logPrint(LOG,logLine);}
+
+    /* Execution time of application hooks against their budgets */
+    if(LEVEL_1){sprintf(logLine,
+            "FILE: main.c"
+            "||CALL: rtJitterReport"
+            "\nMSG: program1ms P99:%u Max:%u Budget:%u Ovr:%u, programAsync P99:%u Max:%u Budget:%u Ovr:%u",
+            CO_hist_percentile(&stats->app, 990), stats->app.max, rtCfg.appRtBudget_us, stats->appOverruns,
+            CO_hist_percentile(&mainStats->app, 990), mainStats->app.max, rtCfg.appMainBudget_us,
+            mainStats->appOverruns); logPrint(LOG,logLine);}
+
+    /* Phase lock to received SYNC, residual is prediction error of SYNC */
+    if((pll->state != CO_SYNC_PLL_IDLE || pll->lockLost != 0) && LEVEL_1){sprintf(logLine,
+            "FILE: main.c"
+            "||CALL: rtJitterReport"
+            "\nMSG: SYNC PLL:%s Period:%u Res:%d P50:%u P99:%u Max:%u Lost:%u",
+            (pll->state == CO_SYNC_PLL_LOCKED) ? "locked" : (pll->state == CO_SYNC_PLL_IDLE) ? "idle" : "acquiring",
+            (uint32_t)(pll->period_ns / 1000), (int)(pll->residual_ns / 1000),
+            CO_hist_percentile(&pll->residual, 500), CO_hist_percentile(&pll->residual, 990),
+            pll->residual.max, pll->lockLost); logPrint(LOG,logLine);}
+}
 
 
-    while(reset != CO_RESET_APP)
-    {
-				/* CANopen communication reset - initialize CANopen objects *******************/
-    			if(LEVEL_1){sprintf(logLine,
-    				 "FILE: main.c"
-    				 "||CALL: main"
-    				 "\nMSG: communication reset"); logPrint(LOG,logLine);}
+/* Realtime thread, CAN receive and tmrTask ***********************************/
+static void* rt_thread(void* arg){
+    int fdEpoll = *(int*)arg;
 
-				CO_ReturnError_t err;
-				uint16_t timer1msPrevious;
+    rtThreadTid = (pid_t)syscall(SYS_gettid);
+    CO_rtThreadApply(&rtCfg, &rtCfg.rt);
 
-				/* disable CAN and CAN interrupts */
+    while(rtThreadRun){
+        struct epoll_event ev;
+        int ready = epoll_wait(fdEpoll, &ev, 1, -1);
 
+        if(ready != 1){
+            if(errno != EINTR){
+                CO_error(0x12100000L + errno);
+            }
+        }
+        else if(!CANrx_taskTmr_process(&taskRT, ev.data.fd)){
+            /* No file descriptor was processed. */
+            CO_error(0x12200000L + errno);
+        }
+    }
 
-				/* initialize CANopen */
-				err = CO_init(1/* CAN module address */, 10/* NodeID */, 125 /* bit rate */);
-				if(err != CO_ERROR_NO)
-				{
-					if(LEVEL_1){sprintf(logLine,
-					    	"FILE: main.c"
-					    	"||CALL: main"
-					    	"\nMSG: canopen cannot be initialized: err=%d",err); logPrint(ERROR,logLine);}
-					return -1;
-					//while(1);
-					/* CO_errorReport(CO->em, CO_EM_MEMORY_ALLOCATION_ERROR, CO_EMC_SOFTWARE_INTERNAL, err); */
-				}
+    return NULL;
+}
 
 
-				/* Configure Timer interrupt function for execution every 1 millisecond */
+/* main ***********************************************************************/
+int main (void){
+    CO_NMT_reset_cmd_t reset = CO_RESET_NOT;
+    bool_t firstRun = true;
+    int fdEpollMain = -1;
+    int exitCode = 0;
+    int32_t CANbaseAddress;
+    uint16_t timer1msPrevious = 0;
+    uint32_t reportTimer = 0;
+    const char *rtCfgFile;
+    sigset_t sigSet;
+    struct sigaction sa;
+    int i;
+
+    CO_clock_gettime(&programStartTime);
+
+    /* SIGINT and SIGTERM are handled by the mainline thread only. They are
+     * blocked before the logger thread starts, so all other threads inherit
+     * the blocked mask. */
+    sigemptyset(&sigSet);
+    sigaddset(&sigSet, SIGINT);
+    sigaddset(&sigSet, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &sigSet, NULL);
+
+    startLogger();
+
+    if(LEVEL_1){sprintf(logLine,
+            "FILE: main.c"
+            "||CALL: main"
+            "\nMSG: program started"); logPrint(LOG,logLine);}
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sigHandler;
+    sigemptyset(&sa.sa_mask);
+    if(sigaction(SIGINT, &sa, NULL) != 0 || sigaction(SIGTERM, &sa, NULL) != 0)
+        CO_errExit("main - sigaction failed");
+    pthread_sigmask(SIG_UNBLOCK, &sigSet, NULL);
+
+    /* Realtime configuration, defaults leave scheduling unchanged. */
+    CO_rtCfg_default(&rtCfg);
+    rtCfgFile = getenv(RT_CONFIG_ENV);
+    if(rtCfgFile != NULL){
+        int line = CO_rtCfg_load(rtCfgFile, &rtCfg);
+        if(line != 0){
+            if(LEVEL_1){sprintf(logLine,
+                    "FILE: main.c"
+                    "||CALL: main"
+                    "\nMSG: invalid realtime configuration %s, line=%d",rtCfgFile,line); logPrint(ERROR,logLine);}
+            stopLogger();
+            return -1;
+        }
+    }
+    CO_rtMemoryLock(&rtCfg);
+    CO_rtThreadApply(&rtCfg, &rtCfg.main);
+
+    /* Watchdog thread inherits blocked SIGINT and SIGTERM. */
+    pthread_sigmask(SIG_BLOCK, &sigSet, NULL);
+    if(CO_wdog_init(&wdog, &rtCfg) != 0){
+        if(LEVEL_1){sprintf(logLine,
+                "FILE: main.c"
+                "||CALL: main"
+                "\nMSG: watchdog cannot be started, errno=%d",errno); logPrint(ERROR,logLine);}
+        stopLogger();
+        return -1;
+    }
+    pthread_sigmask(SIG_UNBLOCK, &sigSet, NULL);
+
+    /* Allocate CANopen object, it lives until program exit. */
+    CANbaseAddress = (int32_t)if_nametoindex(CAN_INTERFACE);
+    if(CANbaseAddress == 0 || CO_new(&CO, false) != CO_ERROR_NO){
+        if(LEVEL_1){sprintf(logLine,
+                "FILE: main.c"
+                "||CALL: main"
+                "\nMSG: canopen cannot be created, interface %s, index=%d",CAN_INTERFACE,CANbaseAddress); logPrint(ERROR,logLine);}
+        CO_wdog_close(&wdog);
+        stopLogger();
+        return -1;
+    }
 
 
-				/* Configure CAN transmit and receive interrupt */
+    /* PDO rate groups, applied by each CO_init() */
+    for(i=1; i<(int)CO_PDO_GROUPS; i++){
+        CO_setPDOgroupPeriod(CO, (uint8_t)i, rtCfg.pdoGroupPeriod_us[i]);
+    }
+    for(i=0; i<CO_NO_RPDO; i++){
+        CO_setPDOgroup(CO, false, (uint16_t)i, rtCfg.rpdoGroup[i]);
+    }
+    for(i=0; i<CO_NO_TPDO; i++){
+        CO_setPDOgroup(CO, true, (uint16_t)i, rtCfg.tpdoGroup[i]);
+    }
 
 
-				/* start CAN */
-				if(LEVEL_1){sprintf(logLine,
-				    	"FILE: main.c"
-				    	"||CALL: main"
-				    	"\nMSG: Setting CAN module in normal mode"); logPrint(LOG,logLine);}
-				CO_CANsetNormalMode(CO->CANmodule[0]);
+    /* increase variable each startup. Variable is stored in EEPROM. */
+    OD_powerOnCounter++;
 
-				reset = CO_RESET_NOT;
-				timer1msPrevious = CO_timer1ms;
+    programStart();
+
+
+    while(reset != CO_RESET_APP && reset != CO_RESET_QUIT && CO_endProgram == 0){
+        /* CANopen communication reset - initialize CANopen objects *******************/
+        CO_ReturnError_t err;
+        int fdEpollRT;
+        pthread_t rtThreadId;
+        sigset_t sigOld;
+
+        if(LEVEL_1){sprintf(logLine,
+                "FILE: main.c"
+                "||CALL: main"
+                "\nMSG: communication reset"); logPrint(LOG,logLine);}
+
+        /* initialize CANopen, rt_thread is not running here */
+        err = CO_init(CO, CANbaseAddress, NODE_ID, CAN_BIT_RATE);
+        if(err != CO_ERROR_NO){
+            if(LEVEL_1){sprintf(logLine,
+                    "FILE: main.c"
+                    "||CALL: main"
+                    "\nMSG: canopen cannot be initialized: err=%d",err); logPrint(ERROR,logLine);}
+            exitCode = -1;
+            break;
+        }
 
-				while(reset == CO_RESET_NOT)
-				{
-					if(LEVEL_1){sprintf(logLine,
-					    	"FILE: main.c"
-					    	"||CALL: main"
-					    	"\nMSG: Non real time loop"); logPrint(LOG,logLine);}
-						/* loop for normal program execution ******************************************/
-						uint16_t timer1msCopy, timer1msDiff;
+        /* First time only initialization of mainline. */
+        if(firstRun){
+            firstRun = false;
 
-						timer1msCopy = CO_timer1ms;
-						timer1msDiff = timer1msCopy - timer1msPrevious;
-						timer1msPrevious = timer1msCopy;
+            fdEpollMain = epoll_create(4);
+            if(fdEpollMain == -1)
+                CO_errExit("main - epoll_create mainline failed");
+            taskMain_init(&taskMain, CO, fdEpollMain, &OD_performance[ODA_performance_mainCycleMaxTime]);
+        }
 
+        taskStats_configureOD(CO->SDO[0], &taskMain, &taskRT);
+#if CO_CONFIG_PROFILE
+        CO_prof_configureOD(CO->SDO[0], CO->prof);
+#endif
+
+        /* Configure callback functions for task control. They are called from
+         * rt_thread on CAN reception and wake up the mainline. */
+        CO_EM_initCallback(CO->em, &taskMain, taskMain_cbSignalEMCY);
+        CO_SDO_initCallback(CO->SDO[0], &taskMain, taskMain_cbSignalSDO);
+        CO_NMT_initCallbackSignal(CO->NMT, &taskMain, taskMain_cbSignalNMT);
+        CO_HBconsumer_initCallback(CO->HBcons, &taskMain, taskMain_cbSignalHBconsumer);
+#if CO_NO_SDO_CLIENT == 1
+        CO_SDOclient_initCallback(CO->SDOclient, &taskMain, taskMain_cbSignalSDOclient);
+#endif
+
+        /* Init realtime task, it gets new epoll instance after each reset. */
+        fdEpollRT = epoll_create(2);
+        if(fdEpollRT == -1)
+            CO_errExit("main - epoll_create rt_thread failed");
+        CANrx_taskTmr_init(&taskRT, CO, fdEpollRT, TMR_TASK_INTERVAL * 1000L, &OD_performance[ODA_performance_timerCycleMaxTime]);
+        CANrx_taskTmr_setCatchup(&taskRT, rtCfg.catchup, rtCfg.catchupMax);
+        CANrx_taskTmr_setSyncPhase(&taskRT, rtCfg.syncPhase, rtCfg.syncOffset_us);
+        OD_performance[ODA_performance_timerCycleTime] = TMR_TASK_INTERVAL; /* informative */
+
+        communicationReset();
+
+        /* Application tasks restart after each communication reset. */
+        CO_async_init(&async, CO);
+        taskMain_initAsync(&taskMain, &async);
+        programTasks(&async);
+        taskMain_initApp(&taskMain, programAsync, rtCfg.appMainBudget_us);
+        CANrx_taskTmr_initApp(&taskRT, program1ms, rtCfg.appRtBudget_us);
+
+        /* start CAN */
+        CO_CANsetNormalMode(CO->CANmodule[0]);
+
+        /* Create rt_thread with SIGINT and SIGTERM blocked. */
+        rtThreadRun = 1;
+        pthread_sigmask(SIG_BLOCK, &sigSet, &sigOld);
+        if(pthread_create(&rtThreadId, NULL, rt_thread, &fdEpollRT) != 0)
+            CO_errExit("main - pthread_create rt_thread failed");
+        pthread_sigmask(SIG_SETMASK, &sigOld, NULL);
+        CO_wdog_attach(&wdog, CO, &taskMain, &taskRT);
+
+        reset = CO_RESET_NOT;
+        timer1msUpdate();
+        timer1msPrevious = CO_timer1ms;
+
+        while(reset == CO_RESET_NOT && CO_endProgram == 0){
+            /* loop for normal program execution ******************************************/
+            struct epoll_event ev;
+            int ready = epoll_wait(fdEpollMain, &ev, 1, -1);
+
+            if(ready != 1){
+                if(errno != EINTR){
+                    CO_error(0x11100000L + errno);
+                }
+                continue;
+            }
 
-						/* CANopen process */
-						reset = CO_process(CO, timer1msDiff, NULL);
-						if(LEVEL_1){sprintf(logLine,
-						    	"FILE: main.c"
-						    	"||CALL: main"
-						    	"\nMSG: CO process returns= %d to the application",reset); logPrint(LOG,logLine);}
-						/* Nonblocking application code may go here. */
+            timer1msUpdate();
+            if(taskMain_process(&taskMain, ev.data.fd, &reset)){
+                uint16_t timer1msDiff = CO_timer1ms - timer1msPrevious;
+                timer1msPrevious = CO_timer1ms;
+
+                if(rtCfg.reportInterval_s != 0){
+                    reportTimer += timer1msDiff;
+                    if(reportTimer >= rtCfg.reportInterval_s * 1000){
+                        reportTimer = 0;
+                        rtJitterReport();
+                    }
+                }
+            }
+            else{
+                /* No file descriptor was processed. */
+                CO_error(0x11200000L + errno);
+            }
+        }
 
-						/* Process EEPROM */
-				}
+        /* Stop rt_thread before CANopen objects are reinitialized or deleted.
+         * Its timer expires at least each TMR_TASK_INTERVAL, so it sees the flag soon. */
+        CO_wdog_detach(&wdog);
+        rtThreadRun = 0;
+        if(pthread_join(rtThreadId, NULL) != 0)
+            CO_errExit("main - pthread_join rt_thread failed");
+        CANrx_taskTmr_close(&taskRT);
+        close(fdEpollRT);
     }
 
 
     /* program exit ***************************************************************/
-    /* stop threads */
+    if(LEVEL_1){sprintf(logLine,
+            "FILE: main.c"
+            "||CALL: main"
+            "\nMSG: program exit, reset=%d, signal=%d",reset,(int)CO_endProgram); logPrint(LOG,logLine);}
 
+    rtJitterReport();
+    CO_wdog_close(&wdog);
+    programEnd();
 
     /* delete objects from memory */
-    CO_delete(0/* CAN module address */);
-
-
-    /* reset */
-    return 0;
-}
-
-
-/* timer thread executes in constant intervals ********************************/
-static void tmrTask_thread(void){
-
-    for(;;) {
-
-        /* sleep for interval */
-
-        INCREMENT_1MS(CO_timer1ms);
-
-        if(CO->CANmodule[0]->CANnormal) {
-            bool_t syncWas;
-
-            /* Process Sync and read inputs */
-            syncWas = CO_process_SYNC_RPDO(CO, TMR_TASK_INTERVAL);
-
-            /* Further I/O or nonblocking application code may go here. */
-
-            /* Write outputs */
-            CO_process_TPDO(CO, syncWas, TMR_TASK_INTERVAL);
-
-            /* verify timer overflow */
-            if(0) {
-                CO_errorReport(CO->em, CO_EM_ISR_TIMER_OVERFLOW, CO_EMC_SOFTWARE_INTERNAL, 0U);
-            }
-        }
+    if(!firstRun){
+        taskMain_close(&taskMain);
+        close(fdEpollMain);
     }
-}
-
-
-/* CAN interrupt function *****************************************************/
-void /* interrupt */ CO_CAN1InterruptHandler(void){
-    //CO_CANinterrupt(CO->CANmodule[0]);
+    CO_delete(CO, CANbaseAddress);
 
+    stopLogger();
 
-    /* clear interrupt flag */
+    return exitCode;
 }
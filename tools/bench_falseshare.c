@@ -0,0 +1,319 @@
+/*
+ * bench_falseshare.c
+ *
+ *  Cross-core cost of fields written by CAN receive next to fields used by
+ *  the other thread (see CO_CACHE_ALIGNED in Karsh.h).
+ *
+ *      Author: karsh
+ */
+/*
+ * BUILD:
+ * 			gcc -O2 -std=gnu11 -Icoasl_include tools/bench_falseshare.c \
+ * 				-o bench_falseshare -lpthread
+ *
+ * USAGE:
+ * 			bench_falseshare [-a cpu] [-b cpu] [-n iterations] [-r runs]
+ *
+ * 			-a   CPU of receive thread, default 0
+ * 			-b   CPU of processing thread, default 1
+ * 			-n   iterations of each thread, default 20000000
+ * 			-r   runs of each case, best is reported, default 5
+ *
+ * Receive thread does, what CAN receive callback does: it copies data into the
+ * object and sets CANrxNew. Processing thread at the same time accesses the
+ * fields, which mainline or realtime cycle uses: SDO server updates its timer
+ * and reads state, Heartbeat consumer reads consumer time and writes its flags
+ * for each monitored node, RPDO reads mapping. Both threads loop -n times over
+ * the same objects, no field is written by both.
+ *
+ * Each case runs with the objects from CANopen headers (separated) and with
+ * copies of the previous layouts (packed), where receive fields shared cache
+ * line with the others. Reported are nanoseconds per iteration of the slower
+ * thread. Threads must run on different cores, otherwise there is nothing
+ * to measure.
+ */
+
+#define _GNU_SOURCE
+#include "CANopen.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+
+
+//****************************
+//Local definitions
+//****************************
+#define HB_NODES		4
+
+//Previous layout of CO_SDO_t, CANrxData first and CANrxNew after state.
+typedef struct{
+	uint8_t				CANrxData[8];
+	uint8_t				databuffer[CO_SDO_BUFFER_SIZE];
+	bool_t				ownOD;
+	const CO_OD_entry_t	*OD;
+	uint16_t			ODSize;
+	CO_OD_extension_t	*ODExtensions;
+	uint16_t			bufferOffset;
+	uint16_t			entryNo;
+	CO_ODF_arg_t		ODF_arg;
+	uint8_t				nodeId;
+	CO_SDO_state_t		state;
+	uint8_t				sequence;
+	uint16_t			timeoutTimer;
+	uint8_t				blksize;
+	bool_t				crcEnabled;
+	uint16_t			crc;
+	uint8_t				lastLen;
+	bool_t				endOfTransfer;
+	bool_t				CANrxNew;
+	void				(*pFunctSignal)(void *object);
+	void				*functSignalObject;
+	CO_CANmodule_t		*CANdevTx;
+	CO_CANtx_t			*CANtxBuff;
+}sdoPacked_t;
+
+//Previous layout of CO_HBconsNode_t, nodes are consecutive in array.
+typedef struct{
+	uint8_t				NMTstate;
+	bool_t				monStarted;
+	bool_t				timeout;
+	bool_t				operational;
+	uint16_t			time;
+	bool_t				CANrxNew;
+	void				(*pFunctSignal)(void *object);
+	void				*functSignalObject;
+	CO_tmr_t			tmr;
+	uint32_t			*pending;
+	uint32_t			pendingMask;
+}hbPacked_t;
+
+//Previous layout of CO_RPDO_t, CANrxNew and CANrxData after mapPointer.
+typedef struct{
+	CO_EM_t				*em;
+	CO_SDO_t			*SDO;
+	CO_SYNC_t			*SYNC;
+	const CO_RPDOCommPar_t *RPDOCommPar;
+	const CO_RPDOMapPar_t  *RPDOMapPar;
+	uint8_t				*operatingState;
+	uint8_t				nodeId;
+	uint16_t			defaultCOB_ID;
+	uint8_t				restrictionFlags;
+	bool_t				valid;
+	bool_t				synchronous;
+	uint8_t				dataLength;
+	uint8_t				*mapPointer[8];
+	volatile bool_t		CANrxNew[2];
+	uint8_t				CANrxData[2][8];
+	CO_CANmodule_t		*CANdevRx;
+	uint16_t			CANdevRxIdx;
+}rpdoPacked_t;
+
+typedef struct{
+	const char	*name;
+	size_t		size;			//of one object
+	int			count;			//objects in array
+	void		(*receive)(void *obj,int k,uint32_t i);
+	uint32_t	(*process)(void *obj,int k);
+}case_t;
+
+typedef struct{
+	const case_t		*c;
+	void				*obj;
+	int					cpu;
+	long				iterations;
+	pthread_barrier_t	*start;
+	double				seconds;
+	uint32_t			sum;
+}thread_t;
+
+
+//****************************
+//Local functions
+//****************************
+//Receive and processing of one object type, for the given layout.
+#define SDO_CASE(T, sfx) \
+static void sdoReceive_##sfx(void *obj,int k,uint32_t i){ \
+	T *p = (T*)obj + k; \
+	memset(p->CANrxData, (int)i, sizeof(p->CANrxData)); \
+	__atomic_store_n(&p->CANrxNew, true, __ATOMIC_RELEASE); \
+} \
+static uint32_t sdoProcess_##sfx(void *obj,int k){ \
+	volatile T *p = (T*)obj + k; \
+	p->timeoutTimer++; \
+	return (uint32_t)p->state + p->bufferOffset + p->sequence; \
+}
+
+#define HB_CASE(T, sfx) \
+static void hbReceive_##sfx(void *obj,int k,uint32_t i){ \
+	T *p = (T*)obj + k; \
+	p->NMTstate = (uint8_t)i; \
+	__atomic_store_n(&p->CANrxNew, true, __ATOMIC_RELEASE); \
+} \
+static uint32_t hbProcess_##sfx(void *obj,int k){ \
+	volatile T *p = (T*)obj + k; \
+	p->timeout = !p->timeout; \
+	p->operational = p->monStarted; \
+	return p->time; \
+}
+
+#define RPDO_CASE(T, sfx) \
+static void rpdoReceive_##sfx(void *obj,int k,uint32_t i){ \
+	T *p = (T*)obj + k; \
+	memset(p->CANrxData[i & 1], (int)i, 8); \
+	__atomic_store_n(&p->CANrxNew[i & 1], true, __ATOMIC_RELEASE); \
+} \
+static uint32_t rpdoProcess_##sfx(void *obj,int k){ \
+	volatile T *p = (T*)obj + k; \
+	return (uint32_t)p->valid + p->dataLength + (uint32_t)(uintptr_t)p->mapPointer[7]; \
+}
+
+SDO_CASE(sdoPacked_t, packed)
+SDO_CASE(CO_SDO_t, separated)
+HB_CASE(hbPacked_t, packed)
+HB_CASE(CO_HBconsNode_t, separated)
+RPDO_CASE(rpdoPacked_t, packed)
+RPDO_CASE(CO_RPDO_t, separated)
+
+static const case_t cases[] = {
+	{"SDO server, packed", sizeof(sdoPacked_t), 1, sdoReceive_packed, sdoProcess_packed},
+	{"SDO server, separated", sizeof(CO_SDO_t), 1, sdoReceive_separated, sdoProcess_separated},
+	{"HB consumer, packed", sizeof(hbPacked_t), HB_NODES, hbReceive_packed, hbProcess_packed},
+	{"HB consumer, separated", sizeof(CO_HBconsNode_t), HB_NODES, hbReceive_separated, hbProcess_separated},
+	{"RPDO, packed", sizeof(rpdoPacked_t), 1, rpdoReceive_packed, rpdoProcess_packed},
+	{"RPDO, separated", sizeof(CO_RPDO_t), 1, rpdoReceive_separated, rpdoProcess_separated},
+};
+
+static double now(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void pin(int cpu)
+{
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if(pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+		fprintf(stderr, "warning: can not pin thread to CPU %d\n", cpu);
+}
+
+static void *receiveThread(void *arg)
+{
+	thread_t *t = (thread_t*)arg;
+	const case_t *c = t->c;
+	double start;
+	long i;
+
+	pin(t->cpu);
+	pthread_barrier_wait(t->start);
+	start = now();
+	for(i=0; i<t->iterations; i++)
+		c->receive(t->obj, (int)(i % c->count), (uint32_t)i);
+	t->seconds = now() - start;
+	return NULL;
+}
+
+static void *processThread(void *arg)
+{
+	thread_t *t = (thread_t*)arg;
+	const case_t *c = t->c;
+	double start;
+	long i;
+
+	pin(t->cpu);
+	pthread_barrier_wait(t->start);
+	start = now();
+	for(i=0; i<t->iterations; i++)
+		t->sum += c->process(t->obj, (int)(i % c->count));
+	t->seconds = now() - start;
+	return NULL;
+}
+
+//One run, returns nanoseconds per iteration of the slower thread.
+static double runCase(const case_t *c,int cpuA,int cpuB,long iterations)
+{
+	pthread_barrier_t start;
+	pthread_t thA, thB;
+	thread_t a, b;
+	void *obj;
+
+	if(posix_memalign(&obj, CO_CACHE_LINE, c->size * c->count) != 0){
+		perror("posix_memalign");
+		exit(1);
+	}
+	memset(obj, 0, c->size * c->count);
+	pthread_barrier_init(&start, NULL, 2);
+	memset(&a, 0, sizeof(a));
+	a.c = c;
+	a.obj = obj;
+	a.iterations = iterations;
+	a.start = &start;
+	b = a;
+	a.cpu = cpuA;
+	b.cpu = cpuB;
+
+	pthread_create(&thA, NULL, receiveThread, &a);
+	pthread_create(&thB, NULL, processThread, &b);
+	pthread_join(thA, NULL);
+	pthread_join(thB, NULL);
+	pthread_barrier_destroy(&start);
+	free(obj);
+
+	return (a.seconds > b.seconds ? a.seconds : b.seconds) * 1e9 / iterations;
+}
+
+
+//****************************
+//Main
+//****************************
+int main(int argc,char *argv[])
+{
+	int cpuA = 0, cpuB = 1, runs = 5, opt, i, r;
+	long iterations = 20000000L;
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	while((opt = getopt(argc, argv, "a:b:n:r:")) != -1){
+		switch(opt){
+		case 'a': cpuA = atoi(optarg); break;
+		case 'b': cpuB = atoi(optarg); break;
+		case 'n': iterations = atol(optarg); break;
+		case 'r': runs = atoi(optarg); break;
+		default:
+			fprintf(stderr, "usage: %s [-a cpu] [-b cpu] [-n iterations] [-r runs]\n", argv[0]);
+			return 1;
+		}
+	}
+	if(iterations <= 0 || runs <= 0){
+		fprintf(stderr, "iterations and runs must be positive\n");
+		return 1;
+	}
+	if(cpuA >= cpus || cpuB >= cpus){
+		fprintf(stderr, "warning: %ld CPU online, both threads run on CPU 0, "
+				"there is no cross-core traffic\n", cpus);
+		cpuA = cpuB = 0;
+	}
+
+	printf("receive on CPU %d, processing on CPU %d, %ld iterations, best of %d\n",
+			cpuA, cpuB, iterations, runs);
+	printf("%-24s %8s %14s\n", "case", "bytes", "ns/iteration");
+	for(i=0; i<(int)(sizeof(cases)/sizeof(cases[0])); i++){
+		double best = 0;
+
+		for(r=0; r<runs; r++){
+			double ns = runCase(&cases[i], cpuA, cpuB, iterations);
+
+			if(r == 0 || ns < best)
+				best = ns;
+		}
+		printf("%-24s %8zu %14.2f\n", cases[i].name, cases[i].size, best);
+	}
+	return 0;
+}
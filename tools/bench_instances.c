@@ -0,0 +1,328 @@
+/*
+ * bench_instances.c
+ *
+ *  Scaling benchmark for several CANopen objects in one process (see CO_new()).
+ *
+ *      Author: karsh
+ */
+/*
+ * BUILD:
+ * 			gcc -O2 -std=gnu11 -fcommon -Icoasl_include tools/bench_instances.c \
+ * 				$(find src -name '*.c' ! -name main.c) -o bench_instances -lpthread
+ *
+ * USAGE:
+ * 			bench_instances [-i interface] [-n max_instances] [-d seconds] [-p workers]
+ *
+ * 			-i   CAN interface, default vcan0
+ * 			-n   largest number of instances, default 8. Runs with 1, 2, 4 ...
+ * 			     instances up to this number.
+ * 			-d   duration of each run in seconds, default 2
+ * 			-p   run instances on executor (CO_Linux_exec.h) with this number
+ * 			     of mainline workers, default is one thread per instance
+ *
+ * Each instance has own Object Dictionary, node-ID 1..N and own thread, which
+ * serves its mainline and realtime task from one epoll. With -p each instance
+ * has own realtime thread and mainlines share the workers. Main thread as client sends
+ * SDO expedited upload of 0x1017 to all nodes, waits for all responses and
+ * repeats. Reported are responses per second and latency percentiles from
+ * request to response in microseconds and CPU time of the process in percent
+ * of one CPU, during the run and during one second without requests before
+ * it. Logging is disabled.
+ *
+ * For example on a virtual CAN interface:
+ * 			ip link add dev vcan0 type vcan && ip link set up vcan0
+ */
+
+#include "CANopen.h"
+#include "CO_Linux_tasks.h"
+#include "CO_Linux_exec.h"
+#include "CO_hist.h"
+#include "Logger.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+
+
+//****************************
+//Local definitions
+//****************************
+#define MAX_INSTANCES	127
+#define BIT_RATE		125
+#define RT_INTERVAL_NS	(50000L * 1000L)
+#define RESPONSE_TIMEOUT_US	100000L
+
+typedef struct{
+	CO_t			*CO;
+	CO_taskMain_t	tm;
+	CO_taskRT_t		rt;
+	int				fdEpoll;
+	pthread_t		thread;
+	CO_execBus_t	bus;
+}instance_t;
+
+//****************************
+//Global variables
+//****************************
+static volatile int	run;
+static int			ifIndex;
+static int			noWorkers;
+static CO_exec_t	exec;
+static CO_rtCfg_t	rtCfg;
+
+
+//****************************
+//Local functions
+//****************************
+static long diffUs(const struct timespec *a,const struct timespec *b)
+{
+	return (a->tv_sec - b->tv_sec) * 1000000L + (a->tv_nsec - b->tv_nsec) / 1000;
+}
+
+//User and system time of the process in microseconds.
+static long cpuUs(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000L
+			+ ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+//Thread of one instance, mainline and realtime task share its epoll.
+static void *instanceThread(void *arg)
+{
+	instance_t *inst = (instance_t*)arg;
+
+	while(run){
+		struct epoll_event ev;
+		CO_NMT_reset_cmd_t reset;
+
+		if(epoll_wait(inst->fdEpoll, &ev, 1, 100) != 1)
+			continue;
+		if(!taskMain_process(&inst->tm, ev.data.fd, &reset))
+			CANrx_taskTmr_process(&inst->rt, ev.data.fd);
+	}
+	return NULL;
+}
+
+static int instanceStart(instance_t *inst,uint8_t nodeId)
+{
+	CO_ReturnError_t err;
+
+	memset(inst, 0, sizeof(*inst));
+	err = CO_new(&inst->CO, true);
+	if(err == CO_ERROR_NO)
+		err = CO_init(inst->CO, ifIndex, nodeId, BIT_RATE);
+	if(err != CO_ERROR_NO){
+		fprintf(stderr, "instance %u: CO_new/CO_init failed, err=%d\n", nodeId, err);
+		return -1;
+	}
+
+	if(noWorkers > 0){
+		if(CO_execBus_start(&exec, &inst->bus, inst->CO, &rtCfg.rt, RT_INTERVAL_NS) != 0){
+			perror("CO_execBus_start");
+			return -1;
+		}
+		CO_CANsetNormalMode(inst->CO->CANmodule[0]);
+		return 0;
+	}
+
+	inst->fdEpoll = epoll_create(4);
+	if(inst->fdEpoll == -1){
+		perror("epoll_create");
+		return -1;
+	}
+	taskMain_init(&inst->tm, inst->CO, inst->fdEpoll, NULL);
+	CANrx_taskTmr_init(&inst->rt, inst->CO, inst->fdEpoll, RT_INTERVAL_NS, NULL);
+	CO_EM_initCallback(inst->CO->em, &inst->tm, taskMain_cbSignalEMCY);
+	CO_SDO_initCallback(inst->CO->SDO[0], &inst->tm, taskMain_cbSignalSDO);
+	CO_NMT_initCallbackSignal(inst->CO->NMT, &inst->tm, taskMain_cbSignalNMT);
+	CO_HBconsumer_initCallback(inst->CO->HBcons, &inst->tm, taskMain_cbSignalHBconsumer);
+	CO_CANsetNormalMode(inst->CO->CANmodule[0]);
+
+	if(pthread_create(&inst->thread, NULL, instanceThread, inst) != 0){
+		perror("pthread_create");
+		return -1;
+	}
+	return 0;
+}
+
+static void instanceStop(instance_t *inst)
+{
+	if(noWorkers > 0){
+		CO_execBus_stop(&inst->bus);
+		CO_delete(inst->CO, ifIndex);
+		return;
+	}
+	pthread_join(inst->thread, NULL);
+	CANrx_taskTmr_close(&inst->rt);
+	taskMain_close(&inst->tm);
+	close(inst->fdEpoll);
+	CO_delete(inst->CO, ifIndex);
+}
+
+static int clientOpen(void)
+{
+	struct sockaddr_can addr;
+	struct can_filter filter;
+	int fd = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+
+	if(fd < 0){
+		perror("socket");
+		return -1;
+	}
+	//SDO responses only
+	filter.can_id = CO_CAN_ID_TSDO;
+	filter.can_mask = 0x780;
+	setsockopt(fd, SOL_CAN_RAW, CAN_RAW_FILTER, &filter, sizeof(filter));
+
+	memset(&addr, 0, sizeof(addr));
+	addr.can_family = AF_CAN;
+	addr.can_ifindex = ifIndex;
+	if(bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0){
+		perror("bind");
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+//Rounds of one request to each node, until duration expires.
+static void clientRun(int fd,int n,int seconds,CO_hist_t *hist,uint64_t *responses,uint64_t *timeouts)
+{
+	struct timespec start, now, sent[MAX_INSTANCES + 1];
+	uint8_t pending[MAX_INSTANCES + 1];
+	struct can_frame f;
+	int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	do{
+		int left = n;
+
+		for(i=1; i<=n; i++){
+			memset(&f, 0, sizeof(f));
+			f.can_id = CO_CAN_ID_RSDO + i;
+			f.can_dlc = 8;
+			f.data[0] = 0x40;
+			f.data[1] = 0x17;
+			f.data[2] = 0x10;
+			clock_gettime(CLOCK_MONOTONIC, &sent[i]);
+			pending[i] = (write(fd, &f, sizeof(f)) == sizeof(f));
+			if(!pending[i])
+				left--;
+		}
+
+		while(left > 0){
+			struct timeval tv = {0, RESPONSE_TIMEOUT_US};
+			fd_set set;
+			int id;
+
+			FD_ZERO(&set);
+			FD_SET(fd, &set);
+			if(select(fd + 1, &set, NULL, NULL, &tv) <= 0){
+				*timeouts += left;
+				break;
+			}
+			if(read(fd, &f, sizeof(f)) != sizeof(f))
+				continue;
+			id = (int)(f.can_id & CAN_SFF_MASK) - CO_CAN_ID_TSDO;
+			if(id < 1 || id > n || !pending[id])
+				continue;
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			CO_hist_record(hist, (uint32_t)diffUs(&now, &sent[id]));
+			pending[id] = 0;
+			(*responses)++;
+			left--;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &now);
+	}while(diffUs(&now, &start) < seconds * 1000000L);
+}
+
+
+//****************************
+//Main
+//****************************
+int main(int argc,char *argv[])
+{
+	const char *ifName = "vcan0";
+	int maxInstances = 8;
+	int seconds = 2;
+	static instance_t inst[MAX_INSTANCES];
+	static CO_hist_t hist;
+	int n, i, opt;
+
+	while((opt = getopt(argc, argv, "i:n:d:p:")) != -1){
+		switch(opt){
+		case 'i': ifName = optarg; break;
+		case 'n': maxInstances = atoi(optarg); break;
+		case 'd': seconds = atoi(optarg); break;
+		case 'p': noWorkers = atoi(optarg); break;
+		default:
+			fprintf(stderr, "usage: %s [-i interface] [-n max_instances] [-d seconds] [-p workers]\n", argv[0]);
+			return 1;
+		}
+	}
+	if(maxInstances < 1 || maxInstances > MAX_INSTANCES || seconds < 1){
+		fprintf(stderr, "max_instances must be 1..%d, seconds at least 1\n", MAX_INSTANCES);
+		return 1;
+	}
+	ifIndex = (int)if_nametoindex(ifName);
+	if(ifIndex == 0){
+		fprintf(stderr, "interface %s: %s\n", ifName, strerror(errno));
+		return 1;
+	}
+	for(i=0; i<LOG_MOD_COUNT; i++)
+		logSetModuleLevel(i, 0);
+	CO_rtCfg_default(&rtCfg);
+	if(noWorkers > 0 && CO_exec_init(&exec, (uint32_t)noWorkers, (uint32_t)maxInstances, &rtCfg, &rtCfg.main) != 0){
+		perror("CO_exec_init");
+		return 1;
+	}
+
+	printf("%9s %12s %10s %10s %10s %10s %9s %7s %8s\n", "instances", "responses/s",
+			"p50[us]", "p99[us]", "p99.9[us]", "max[us]", "timeouts", "cpu[%]", "idle[%]");
+	for(n=1; n<=maxInstances; n=(n*2 > maxInstances && n < maxInstances) ? maxInstances : n*2){
+		uint64_t responses = 0, timeouts = 0;
+		long cpu, cpuIdle;
+		int fd;
+
+		run = 1;
+		for(i=0; i<n; i++){
+			if(instanceStart(&inst[i], (uint8_t)(i + 1)) != 0)
+				return 1;
+		}
+		fd = clientOpen();
+		if(fd < 0)
+			return 1;
+		//nodes send boot-up, then only heartbeats and timers run
+		cpuIdle = cpuUs();
+		sleep(1);
+		cpuIdle = cpuUs() - cpuIdle;
+
+		CO_hist_init(&hist);
+		cpu = cpuUs();
+		clientRun(fd, n, seconds, &hist, &responses, &timeouts);
+		cpu = cpuUs() - cpu;
+
+		run = 0;
+		close(fd);
+		for(i=0; i<n; i++)
+			instanceStop(&inst[i]);
+
+		printf("%9d %12.0f %10u %10u %10u %10u %9llu %7.1f %8.2f\n", n, (double)responses / seconds,
+				CO_hist_percentile(&hist, 500), CO_hist_percentile(&hist, 990),
+				CO_hist_percentile(&hist, 999), hist.max, (unsigned long long)timeouts,
+				cpu / (seconds * 10000.0), cpuIdle / 10000.0);
+	}
+	if(noWorkers > 0)
+		CO_exec_close(&exec);
+	return 0;
+}
@@ -0,0 +1,213 @@
+/*
+ * bench_odfind.c
+ *
+ *  Object Dictionary lookup with index table against binary search (see
+ *  CO_OD_find()).
+ *
+ *      Author: karsh
+ */
+/*
+ * BUILD:
+ * 			gcc -O2 -std=gnu11 -fcommon -Icoasl_include tools/bench_odfind.c \
+ * 				$(find src -name '*.c' ! -name main.c) -o bench_odfind -lpthread
+ *
+ * USAGE:
+ * 			bench_odfind [-n lookups] [-r runs]
+ *
+ * 			-n   lookups in each run, default 20000000
+ * 			-r   runs of each case, best is reported, default 5
+ *
+ * Cases are the Object Dictionary of this node (CO_OD) and generated
+ * dictionaries of 55, 1000 and 10000 entries with indexes spread from
+ * 0x1000 to 0xFFFF. Each is given to CO_SDO_init() once with index table and
+ * once without, then CO_OD_find() is called for a fixed pseudo random
+ * sequence of indexes, one of eight is below an entry and mostly not in the
+ * dictionary. Both must give the same entries. Reported are
+ * nanoseconds per lookup and time of CO_SDO_init(), which fills the table.
+ * Logging is disabled. No CAN interface is needed.
+ */
+
+#include "CANopen.h"
+#include "Logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+
+//****************************
+//Local definitions
+//****************************
+#define LOOKUPS_MASK	4095		//size of lookup sequence - 1
+
+extern const CO_OD_entry_t CO_OD[CO_OD_NoOfElements];	//Object Dictionary array
+
+typedef struct{
+	const char		*name;
+	uint16_t		size;			//entries, 0 for CO_OD
+}case_t;
+
+static const case_t cases[] = {
+	{"CO_OD", 0},
+	{"generated 55", 55},
+	{"generated 1000", 1000},
+	{"generated 10000", 10000},
+};
+
+static uint16_t lookup[LOOKUPS_MASK + 1];
+static volatile uint32_t sink;
+
+
+//****************************
+//Local functions
+//****************************
+static double now(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static uint32_t xorshift(uint32_t *s)
+{
+	*s ^= *s << 13;
+	*s ^= *s >> 17;
+	*s ^= *s << 5;
+	return *s;
+}
+
+//Sorted dictionary of size entries, indexes from 0x1000 with equal steps.
+static CO_OD_entry_t *generate(uint16_t size)
+{
+	static uint32_t dummy;
+	CO_OD_entry_t *OD = calloc(size, sizeof(CO_OD_entry_t));
+	uint32_t step = 0xF000UL / size, i;
+
+	if(OD == NULL){
+		perror("calloc");
+		exit(1);
+	}
+	for(i=0; i<size; i++){
+		OD[i].index = (uint16_t)(0x1000UL + i * step);
+		OD[i].attribute = CO_ODA_READABLE | CO_ODA_WRITEABLE;
+		OD[i].length = sizeof(dummy);
+		OD[i].pData = &dummy;
+	}
+	return OD;
+}
+
+//Indexes to look up, each eighth is one below an entry.
+static void prepare(const CO_OD_entry_t *OD, uint16_t size)
+{
+	uint32_t s = 2463534242UL, i;
+
+	for(i=0; i<=LOOKUPS_MASK; i++){
+		const CO_OD_entry_t *e = &OD[xorshift(&s) % size];
+
+		lookup[i] = (i % 8 == 7) ? (uint16_t)(e->index - 1U) : e->index;
+	}
+}
+
+//Returns nanoseconds per lookup, best of runs.
+static double runLookups(CO_SDO_t *SDO, long lookups, int runs)
+{
+	double best = 0;
+	int r;
+
+	for(r=0; r<runs; r++){
+		uint32_t sum = 0;
+		double start = now(), ns;
+		long i;
+
+		for(i=0; i<lookups; i++)
+			sum += CO_OD_find(SDO, lookup[i & LOOKUPS_MASK]);
+		ns = (now() - start) * 1e9 / lookups;
+		sink += sum;
+		if(r == 0 || ns < best)
+			best = ns;
+	}
+	return best;
+}
+
+static void initSDO(CO_SDO_t *SDO, CO_CANmodule_t *CANmodule, const CO_OD_entry_t *OD,
+		uint16_t size, CO_OD_extension_t *ext, uint16_t *ODindex)
+{
+	memset(SDO, 0, sizeof(*SDO));
+	if(CO_SDO_init(SDO, 0x80000000UL, 0x80000000UL, 0, NULL, OD, size, ext,
+			ODindex, 1, CANmodule, 0, CANmodule, 0) != CO_ERROR_NO){
+		fprintf(stderr, "CO_SDO_init failed\n");
+		exit(1);
+	}
+}
+
+
+//****************************
+//Main
+//****************************
+int main(int argc,char *argv[])
+{
+	static CO_CANmodule_t CANmodule;		//without buffers, SDO does not use CAN
+	long lookups = 20000000L;
+	int runs = 5, opt, i;
+	uint16_t *ODindex = malloc(CO_OD_INDEX_TABLE_SIZE * sizeof(uint16_t));
+
+	while((opt = getopt(argc, argv, "n:r:")) != -1){
+		switch(opt){
+		case 'n': lookups = atol(optarg); break;
+		case 'r': runs = atoi(optarg); break;
+		default:
+			fprintf(stderr, "usage: %s [-n lookups] [-r runs]\n", argv[0]);
+			return 1;
+		}
+	}
+	if(lookups <= 0 || runs <= 0){
+		fprintf(stderr, "lookups and runs must be positive\n");
+		return 1;
+	}
+	if(ODindex == NULL){
+		perror("malloc");
+		return 1;
+	}
+	for(i=0; i<LOG_MOD_COUNT; i++)
+		logSetModuleLevel(i, 0);
+
+	printf("%ld lookups, best of %d\n", lookups, runs);
+	printf("%-18s %8s %14s %14s %10s\n", "case", "entries", "binary ns", "table ns", "init us");
+	for(i=0; i<(int)(sizeof(cases)/sizeof(cases[0])); i++){
+		const case_t *c = &cases[i];
+		uint16_t size = (c->size != 0) ? c->size : CO_OD_NoOfElements;
+		const CO_OD_entry_t *OD = (c->size != 0) ? generate(size) : CO_OD;
+		CO_OD_extension_t *ext = calloc(size, sizeof(CO_OD_extension_t));
+		CO_SDO_t binary, table;
+		double start, initUs, nsBinary, nsTable;
+		long j;
+
+		if(ext == NULL){
+			perror("calloc");
+			return 1;
+		}
+		prepare(OD, size);
+		initSDO(&binary, &CANmodule, OD, size, ext, NULL);
+		start = now();
+		initSDO(&table, &CANmodule, OD, size, ext, ODindex);
+		initUs = (now() - start) * 1e6;
+
+		for(j=0; j<=LOOKUPS_MASK; j++){
+			if(CO_OD_find(&binary, lookup[j]) != CO_OD_find(&table, lookup[j])){
+				fprintf(stderr, "%s: lookup of %04X differs\n", c->name, lookup[j]);
+				return 1;
+			}
+		}
+		nsBinary = runLookups(&binary, lookups, runs);
+		nsTable = runLookups(&table, lookups, runs);
+		printf("%-18s %8u %14.2f %14.2f %10.1f\n", c->name, size, nsBinary, nsTable, initUs);
+
+		free(ext);
+		if(c->size != 0)
+			free((void*)OD);
+	}
+	free(ODindex);
+	return 0;
+}
@@ -0,0 +1,349 @@
+/*
+ * logdecode.c
+ *
+ *  Decoder for binary logs written with CO_LOG_FORMAT=binary (see LogFormat.h).
+ *
+ *      Author: karsh
+ */
+/*
+ * BUILD:
+ * 			gcc -O2 -Icoasl_include tools/logdecode.c -o logdecode
+ *
+ * USAGE:
+ * 			logdecode [-c] [-m module[,module..]] [-f from_s] [-t to_s] [-s sites.txt] log.bin...
+ *
+ * 			-c   CSV output instead of text
+ * 			-m   only these modules (main, driver, sdo, pdo, nmt, emcy, storage, tasks)
+ * 			-f   skip records older than from_s seconds after startLogger()
+ * 			-t   stop at records newer than to_s seconds after startLogger()
+ * 			-s   sites file, default is sites_<runId>.txt next to the log
+ *
+ * Files are mmap'ed. Records are in timestamp order, so the start of the time
+ * range is found by binary search and only the range itself is read.
+ */
+
+#include "LogFormat.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+//****************************
+//Local definitions
+//****************************
+#define MODULE_COUNT	8
+#define LINE_SIZE		1024
+
+typedef struct{
+	char	*file;
+	char	*func;
+	char	*fmt;
+	uint8_t	module;
+}site_t;
+
+static const char *moduleName[MODULE_COUNT] = {
+		"main", "driver", "sdo", "pdo", "nmt", "emcy", "storage", "tasks"};
+
+//****************************
+//Global variables
+//****************************
+static site_t	*sites;
+static unsigned	siteCount;
+static int		csv;
+static unsigned	moduleMask = 0xFFFFFFFFU;
+static double	fromSec = -1.0;
+static double	toSec = -1.0;
+static char		*sitesPath;
+
+//****************************
+//Reads the sites file: <id>\t<module>\t<file>\t<func>\t<fmt>
+static int loadSites(const char *path)
+{
+	char line[LINE_SIZE];
+	FILE *f = fopen(path,"r");
+
+	if(f==NULL)
+	{
+		fprintf(stderr,"logdecode: cannot open sites file %s: %s\n",path,strerror(errno));
+		return -1;
+	}
+	while(fgets(line,sizeof(line),f)!=NULL)
+	{
+		char *field[5];
+		char *c = line;
+		unsigned id;
+		int i;
+
+		for(i=0;i<5;i++)
+		{
+			field[i]=c;
+			c=strchr(c,(i<4) ? '\t' : '\n');
+			if(c==NULL) break;
+			*c++=0;
+		}
+		if(i<4) continue;
+
+		//unescape format
+		{
+			char *r = field[4], *w = field[4];
+			while(*r)
+			{
+				if(*r=='\\' && r[1]=='n')		{ *w++='\n'; r+=2; }
+				else if(*r=='\\' && r[1]=='t')	{ *w++='\t'; r+=2; }
+				else if(*r=='\\' && r[1]=='\\')	{ *w++='\\'; r+=2; }
+				else							*w++=*r++;
+			}
+			*w=0;
+		}
+
+		id=(unsigned)atoi(field[0]);
+		if(id>=siteCount)
+		{
+			site_t *grown = realloc(sites,(id+64)*sizeof(site_t));
+			if(grown==NULL) break;
+			memset(grown+siteCount,0,(id+64-siteCount)*sizeof(site_t));
+			sites=grown;
+			siteCount=id+64;
+		}
+		sites[id].module=(uint8_t)atoi(field[1]);
+		sites[id].file=strdup(field[2]);
+		sites[id].func=strdup(field[3]);
+		sites[id].fmt=strdup(field[4]);
+	}
+	fclose(f);
+	return 0;
+}
+
+//****************************
+//Prints one CSV field, quoted
+static void csvField(const char *s,int last)
+{
+	putchar('"');
+	for(;*s;s++)
+	{
+		if(*s=='"') putchar('"');
+		putchar(*s);
+	}
+	putchar('"');
+	putchar(last ? '\n' : ',');
+}
+
+//****************************
+//Prints a decoded record. msg is the message without "ERROR:" prefix or trailing newlines.
+static void printRecord(const logBinHeader_t *hdr,const logBinRecord_t *rec,int isError,
+		const char *file,const char *func,const char *msg)
+{
+	double t = (double)(int64_t)(rec->timestamp-hdr->monoStart)/1e9;
+	const char *mod = (rec->module<MODULE_COUNT) ? moduleName[rec->module] : "?";
+
+	if(csv)
+	{
+		uint64_t wall = hdr->realStart+(rec->timestamp-hdr->monoStart);
+		printf("%.9f,%llu.%09llu,%u,%s,%s,%u,",t,
+				(unsigned long long)(wall/1000000000ULL),(unsigned long long)(wall%1000000000ULL),
+				rec->tid,mod,isError ? "ERROR" : "LOG",rec->site);
+		csvField(file,0);
+		csvField(func,0);
+		csvField(msg,1);
+	}
+	else
+	{
+		const char *c;
+		printf("%14.6f %7u %-7s %-5s ",t,rec->tid,mod,isError ? "ERROR" : "LOG");
+		if(*file) printf("%s:%s: ",file,func);
+		//multi-line messages are printed on one line
+		for(c=msg;*c;c++) putchar((*c=='\n') ? ' ' : *c);
+		putchar('\n');
+	}
+}
+
+//****************************
+//Decodes one mapped file
+static int decodeFile(const char *path)
+{
+	struct stat st;
+	const logBinHeader_t *hdr;
+	const logBinRecord_t *rec;
+	size_t count, lo, hi, i;
+	char text[LINE_SIZE];
+	size_t textLen = 0;
+	void *map;
+	int fd;
+
+	fd=open(path,O_RDONLY);
+	if(fd<0 || fstat(fd,&st)<0)
+	{
+		fprintf(stderr,"logdecode: cannot open %s: %s\n",path,strerror(errno));
+		if(fd>=0) close(fd);
+		return -1;
+	}
+	if((size_t)st.st_size<sizeof(logBinHeader_t))
+	{
+		fprintf(stderr,"logdecode: %s is too short\n",path);
+		close(fd);
+		return -1;
+	}
+	map=mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+	close(fd);
+	if(map==MAP_FAILED)
+	{
+		fprintf(stderr,"logdecode: cannot map %s: %s\n",path,strerror(errno));
+		return -1;
+	}
+
+	hdr=(const logBinHeader_t*)map;
+	if(memcmp(hdr->magic,LOG_BIN_MAGIC,sizeof(hdr->magic))!=0
+			|| hdr->version!=LOG_BIN_VERSION || hdr->recordSize!=sizeof(logBinRecord_t))
+	{
+		fprintf(stderr,"logdecode: %s is not a binary log of version %d\n",path,LOG_BIN_VERSION);
+		munmap(map,st.st_size);
+		return -1;
+	}
+
+	if(sites==NULL)
+	{
+		char defaultPath[4096];
+		if(sitesPath==NULL)
+		{
+			const char *slash = strrchr(path,'/');
+			int dirLen = (slash!=NULL) ? (int)(slash-path+1) : 0;
+			snprintf(defaultPath,sizeof(defaultPath),"%.*ssites_%u.txt",dirLen,path,hdr->runId);
+		}
+		//a log with text records only is still decodable without sites
+		loadSites((sitesPath!=NULL) ? sitesPath : defaultPath);
+	}
+
+	rec=(const logBinRecord_t*)(hdr+1);
+	count=(st.st_size-sizeof(logBinHeader_t))/sizeof(logBinRecord_t);
+	madvise(map,st.st_size,MADV_SEQUENTIAL);
+
+	//binary search for the first record inside the time range
+	lo=0;
+	hi=count;
+	if(fromSec>=0)
+	{
+		uint64_t from = hdr->monoStart+(uint64_t)(fromSec*1e9);
+		while(lo<hi)
+		{
+			size_t mid = lo+(hi-lo)/2;
+			if(rec[mid].timestamp<from) lo=mid+1;
+			else hi=mid;
+		}
+	}
+
+	for(i=lo;i<count;i++)
+	{
+		const logBinRecord_t *r = &rec[i];
+
+		if(toSec>=0 && r->timestamp>hdr->monoStart+(uint64_t)(toSec*1e9)) break;
+
+		if(r->type==LOG_BIN_TEXT || r->type==LOG_BIN_TEXT_ERROR)
+		{
+			size_t n = (r->nargs<=LOG_BIN_TEXT_CHUNK) ? r->nargs : LOG_BIN_TEXT_CHUNK;
+			if(textLen+n<sizeof(text))
+			{
+				memcpy(text+textLen,r->text,n);
+				textLen+=n;
+			}
+			if(r->flags & LOG_BIN_FLAG_MORE) continue;
+
+			text[textLen]=0;
+			textLen=0;
+			if((moduleMask & (1U<<r->module))==0) continue;
+			{
+				char *msg = text;
+				char *end;
+				if(strncmp(msg,"ERROR:\n",7)==0) msg+=7;
+				end=msg+strlen(msg);
+				while(end>msg && end[-1]=='\n') *--end=0;
+				printRecord(hdr,r,r->type==LOG_BIN_TEXT_ERROR,"","",msg);
+			}
+		}
+		else if(r->type==LOG_BIN_LOG || r->type==LOG_BIN_ERROR)
+		{
+			char msg[LINE_SIZE];
+			const site_t *s = (r->site<siteCount && sites[r->site].fmt!=NULL) ? &sites[r->site] : NULL;
+
+			if((moduleMask & (1U<<r->module))==0) continue;
+			if(s!=NULL)
+			{
+				const char *file = strrchr(s->file,'/');
+				logRenderEvent(msg,sizeof(msg),s->fmt,r->nargs,r->args);
+				printRecord(hdr,r,r->type==LOG_BIN_ERROR,(file!=NULL) ? file+1 : s->file,s->func,msg);
+			}
+			else
+			{
+				snprintf(msg,sizeof(msg),"unknown site %u, args %lld %lld %lld %lld",r->site,
+						(long long)r->args[0],(long long)r->args[1],(long long)r->args[2],(long long)r->args[3]);
+				printRecord(hdr,r,r->type==LOG_BIN_ERROR,"","",msg);
+			}
+		}
+	}
+
+	munmap(map,st.st_size);
+	return 0;
+}
+
+//****************************
+//Parses "sdo,pdo" into a module bit mask
+static int parseModules(char *list)
+{
+	char *name;
+
+	moduleMask=0;
+	for(name=strtok(list,",");name!=NULL;name=strtok(NULL,","))
+	{
+		int m;
+		for(m=0;m<MODULE_COUNT;m++)
+		{
+			if(strcmp(name,moduleName[m])==0) break;
+		}
+		if(m==MODULE_COUNT)
+		{
+			fprintf(stderr,"logdecode: unknown module %s\n",name);
+			return -1;
+		}
+		moduleMask|=1U<<m;
+	}
+	return 0;
+}
+
+//****************************
+int main(int argc,char *argv[])
+{
+	int opt, ret = 0;
+
+	while((opt=getopt(argc,argv,"cm:f:t:s:"))!=-1)
+	{
+		switch(opt)
+		{
+		case 'c':	csv=1; break;
+		case 'm':	if(parseModules(optarg)<0) return 2; break;
+		case 'f':	fromSec=atof(optarg); break;
+		case 't':	toSec=atof(optarg); break;
+		case 's':	sitesPath=optarg; break;
+		default:
+			fprintf(stderr,"usage: %s [-c] [-m module[,module..]] [-f from_s] [-t to_s] [-s sites.txt] log.bin...\n",argv[0]);
+			return 2;
+		}
+	}
+	if(optind>=argc)
+	{
+		fprintf(stderr,"usage: %s [-c] [-m module[,module..]] [-f from_s] [-t to_s] [-s sites.txt] log.bin...\n",argv[0]);
+		return 2;
+	}
+
+	if(csv)
+	{
+		printf("time_s,wall_time,tid,module,level,site,file,function,message\n");
+	}
+	for(;optind<argc;optind++)
+	{
+		if(decodeFile(argv[optind])<0) ret=1;
+	}
+	return ret;
+}
@@ -0,0 +1,291 @@
+/*
+ * sim_vclock.c
+ *
+ *  Faster than real time simulation of one node in virtual time (see
+ *  CO_Linux_clock.h).
+ *
+ *      Author: karsh
+ */
+/*
+ * BUILD:
+ * 			gcc -O2 -std=gnu11 -fcommon -Icoasl_include tools/sim_vclock.c \
+ * 				$(find src -name '*.c' ! -name main.c) -o sim_vclock -lpthread
+ *
+ * USAGE:
+ * 			sim_vclock [-i interface] [-d seconds] [-s seconds]
+ *
+ * 			-i   CAN interface, default vcan0
+ * 			-d   simulated duration in seconds, default 3600
+ * 			-s   simulated peer stops its heartbeat after this time, default
+ * 			     half of the duration
+ *
+ * Node 1 produces SYNC each 10 ms and heartbeat each second and consumes
+ * heartbeat of node 2 with 500 ms timeout. Node 2 is simulated by this
+ * program on a raw CAN socket, it sends heartbeat each 400 ms until it
+ * stops. Mainline task, realtime task and simulated peer run from one
+ * thread. Virtual time advances to the next timer only when no file
+ * descriptor is ready, so CAN traffic of hours takes seconds and runs
+ * are reproducible.
+ *
+ * Frames on the bus are counted and their virtual receive time, identifier
+ * and data are hashed (FNV-1a). Emergency messages are printed with virtual
+ * time. The same build gives the same hash on each run, also on a loaded
+ * machine. Interface must be quiet, for example virtual CAN:
+ * 			ip link add dev vcan0 type vcan && ip link set up vcan0
+ */
+
+#include "CANopen.h"
+#include "CO_Linux_tasks.h"
+#include "CO_Linux_clock.h"
+#include "Logger.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+
+
+//****************************
+//Local definitions
+//****************************
+#define NODE_ID			1
+#define PEER_ID			2
+#define BIT_RATE		125
+#define RT_INTERVAL_NS	(50000L * 1000L)
+#define START_NS		(1000000000LL)		//virtual time at start, must not be 0
+#define PEER_HB_NS		(400000000LL)		//heartbeat period of simulated node 2
+#define FNV_OFFSET		14695981039346656037ULL
+#define FNV_PRIME		1099511628211ULL
+
+typedef struct{
+	uint64_t	sync;
+	uint64_t	heartbeat;
+	uint64_t	emergency;
+	uint64_t	other;
+	uint64_t	hash;
+}busStats_t;
+
+
+//****************************
+//Local functions
+//****************************
+static void hashBytes(uint64_t *hash,const void *data,size_t len)
+{
+	const uint8_t *p = (const uint8_t*)data;
+
+	while(len-- > 0){
+		*hash ^= *p++;
+		*hash *= FNV_PRIME;
+	}
+}
+
+static int peerOpen(int ifIndex)
+{
+	struct sockaddr_can addr;
+	int fd = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+
+	if(fd < 0){
+		perror("socket");
+		return -1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.can_family = AF_CAN;
+	addr.can_ifindex = ifIndex;
+	if(bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0){
+		perror("bind");
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+//Frame from node 1, stamped with virtual time.
+static void peerReceive(int fd,busStats_t *bus)
+{
+	struct can_frame f;
+	int64_t t = CO_clock_ns() - START_NS;
+	uint32_t id;
+
+	if(read(fd, &f, sizeof(f)) != sizeof(f))
+		return;
+	id = f.can_id & CAN_SFF_MASK;
+	hashBytes(&bus->hash, &t, sizeof(t));
+	hashBytes(&bus->hash, &id, sizeof(id));
+	hashBytes(&bus->hash, &f.can_dlc, 1);
+	hashBytes(&bus->hash, f.data, f.can_dlc);
+
+	if(id == CO_CAN_ID_SYNC)
+		bus->sync++;
+	else if(id == CO_CAN_ID_HEARTBEAT + NODE_ID)
+		bus->heartbeat++;
+	else if(id == CO_CAN_ID_EMERGENCY + NODE_ID){
+		bus->emergency++;
+		printf("%12.6f s EMCY %02X%02X reg=%02X bit=%02X\n", t / 1e9,
+				f.data[1], f.data[0], f.data[2], f.data[3]);
+	}
+	else
+		bus->other++;
+}
+
+//Heartbeat of node 2 and next expiration of its timer.
+static void peerHeartbeat(int fd,int fdTmr,int64_t stop_ns)
+{
+	struct can_frame f;
+	struct itimerspec spec;
+	uint64_t count;
+	int64_t next;
+
+	if(read(fdTmr, &count, sizeof(count)) != sizeof(count))
+		return;
+	memset(&f, 0, sizeof(f));
+	f.can_id = CO_CAN_ID_HEARTBEAT + PEER_ID;
+	f.can_dlc = 1;
+	f.data[0] = CO_NMT_OPERATIONAL;
+	if(write(fd, &f, sizeof(f)) != sizeof(f))
+		perror("write");
+
+	next = CO_clock_ns() + PEER_HB_NS;
+	memset(&spec, 0, sizeof(spec));
+	if(next < stop_ns){
+		spec.it_value.tv_sec = (time_t)(next / 1000000000);
+		spec.it_value.tv_nsec = (long)(next % 1000000000);
+	}
+	CO_clock_timerSet(fdTmr, &spec);
+}
+
+
+//****************************
+//Main
+//****************************
+int main(int argc,char *argv[])
+{
+	const char *ifName = "vcan0";
+	double seconds = 3600, stopSeconds = -1;
+	static CO_taskMain_t tm;
+	static CO_taskRT_t rt;
+	static busStats_t bus;
+	struct itimerspec spec;
+	struct timespec wallStart, wallEnd;
+	CO_t *CO = NULL;
+	CO_ReturnError_t err;
+	int64_t end_ns, stop_ns;
+	int ifIndex, fdPeer, fdPeerTmr, i, opt;
+	double wall;
+
+	while((opt = getopt(argc, argv, "i:d:s:")) != -1){
+		switch(opt){
+		case 'i': ifName = optarg; break;
+		case 'd': seconds = atof(optarg); break;
+		case 's': stopSeconds = atof(optarg); break;
+		default:
+			fprintf(stderr, "usage: %s [-i interface] [-d seconds] [-s seconds]\n", argv[0]);
+			return 1;
+		}
+	}
+	if(seconds <= 0){
+		fprintf(stderr, "duration must be positive\n");
+		return 1;
+	}
+	if(stopSeconds < 0)
+		stopSeconds = seconds / 2;
+	ifIndex = (int)if_nametoindex(ifName);
+	if(ifIndex == 0){
+		fprintf(stderr, "interface %s: %s\n", ifName, strerror(errno));
+		return 1;
+	}
+	for(i=0; i<LOG_MOD_COUNT; i++)
+		logSetModuleLevel(i, 0);
+
+	//Clock is virtual before any task or timer exists.
+	CO_clock_setVirtual(START_NS);
+	end_ns = START_NS + (int64_t)(seconds * 1e9);
+	stop_ns = START_NS + (int64_t)(stopSeconds * 1e9);
+
+	err = CO_new(&CO, true);
+	if(err == CO_ERROR_NO){
+		CO->ODROM->COB_ID_SYNCMessage = 0x40000000UL | CO_CAN_ID_SYNC;
+		CO->ODROM->communicationCyclePeriod = 10000;
+		CO->ODROM->producerHeartbeatTime = 1000;
+		CO->ODROM->consumerHeartbeatTime[0] = ((uint32_t)PEER_ID << 16) | 500;
+		err = CO_init(CO, ifIndex, NODE_ID, BIT_RATE);
+	}
+	if(err != CO_ERROR_NO){
+		fprintf(stderr, "CO_new/CO_init failed, err=%d\n", err);
+		return 1;
+	}
+	fdPeer = peerOpen(ifIndex);
+	fdPeerTmr = CO_clock_timerCreate();
+	if(fdPeer < 0 || fdPeerTmr < 0){
+		perror("peer");
+		return 1;
+	}
+
+	taskMain_init(&tm, CO, -1, NULL);
+	CANrx_taskTmr_init(&rt, CO, -1, RT_INTERVAL_NS, NULL);
+	CO_EM_initCallback(CO->em, &tm, taskMain_cbSignalEMCY);
+	CO_SDO_initCallback(CO->SDO[0], &tm, taskMain_cbSignalSDO);
+	CO_NMT_initCallbackSignal(CO->NMT, &tm, taskMain_cbSignalNMT);
+	CO_HBconsumer_initCallback(CO->HBcons, &tm, taskMain_cbSignalHBconsumer);
+	CO_CANsetNormalMode(CO->CANmodule[0]);
+
+	memset(&spec, 0, sizeof(spec));
+	spec.it_value.tv_sec = START_NS / 1000000000;
+	CO_clock_timerSet(fdPeerTmr, &spec);
+
+	//Ready descriptors are served in fixed order, one at a time.
+	clock_gettime(CLOCK_MONOTONIC, &wallStart);
+	bus.hash = FNV_OFFSET;
+	for(;;){
+		struct pollfd p[6];
+		CO_NMT_reset_cmd_t reset;
+		int ready;
+
+		p[0].fd = fdPeer;		p[1].fd = rt.fdRx0;
+		p[2].fd = rt.fdTmr;		p[3].fd = tm.fdEvent;
+		p[4].fd = tm.fdTmr;		p[5].fd = fdPeerTmr;
+		for(i=0; i<6; i++){
+			p[i].events = POLLIN;
+			p[i].revents = 0;
+		}
+		if(poll(p, 6, 0) < 0){
+			perror("poll");
+			break;
+		}
+		for(ready=-1, i=0; i<6 && ready<0; i++){
+			if(p[i].revents & POLLIN)
+				ready = i;
+		}
+
+		if(ready < 0){
+			if(!CO_clock_advance(end_ns) && CO_clock_ns() >= end_ns)
+				break;
+		}
+		else if(ready == 0)
+			peerReceive(fdPeer, &bus);
+		else if(ready <= 2)
+			CANrx_taskTmr_process(&rt, p[ready].fd);
+		else if(ready <= 4)
+			taskMain_process(&tm, p[ready].fd, &reset);
+		else
+			peerHeartbeat(fdPeer, fdPeerTmr, stop_ns);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &wallEnd);
+	wall = (wallEnd.tv_sec - wallStart.tv_sec) + (wallEnd.tv_nsec - wallStart.tv_nsec) / 1e9;
+
+	printf("simulated %.3f s in %.3f s (x%.0f)\n", seconds, wall, seconds / wall);
+	printf("frames: SYNC %llu, heartbeat %llu, emergency %llu, other %llu\n",
+			(unsigned long long)bus.sync, (unsigned long long)bus.heartbeat,
+			(unsigned long long)bus.emergency, (unsigned long long)bus.other);
+	printf("hash %016llx\n", (unsigned long long)bus.hash);
+
+	CANrx_taskTmr_close(&rt);
+	taskMain_close(&tm);
+	CO_clock_timerClose(fdPeerTmr);
+	close(fdPeer);
+	CO_delete(CO, ifIndex);
+	return 0;
+}
@@ -0,0 +1,216 @@
+/*
+ * stress_rpdo.c
+ *
+ *  Handoff of received RPDO frames between CAN receive and RPDO processing
+ *  (see CANrxSeq in CO_PDO.h and CO_FLAG_xxx in Karsh.h).
+ *
+ *      Author: karsh
+ */
+/*
+ * BUILD:
+ * 			gcc -O2 -std=gnu11 -fcommon -Icoasl_include tools/stress_rpdo.c \
+ * 				$(find src -name '*.c' ! -name main.c ! -name CO_PDO.c) -o stress_rpdo -lpthread
+ *
+ * USAGE:
+ * 			stress_rpdo [-a cpu] [-b cpu] [-n frames]
+ *
+ * 			-a   CPU of receive thread, default 0
+ * 			-b   CPU of processing thread, default 1
+ * 			-n   frames written by receive thread, default 20000000
+ *
+ * CO_PDO.c is included, so its static CO_RPDO_writeRx() and CO_RPDO_readRx()
+ * are used as they are. Receive thread writes numbered frames into one RPDO
+ * buffer as fast as it can, like CO_PDO_receive(). Each frame carries its
+ * number in bytes 0..3 and the inverted number in bytes 4..7. Processing
+ * thread takes CANrxNew and copies the buffer, like CO_RPDO_process().
+ *
+ * Reported are frames taken, torn copies detected and dropped, accepted
+ * copies with mixed bytes of two frames and frames older than a frame taken
+ * before. After receive ends, the last frame must still be pending. Exit
+ * status is 1, if any accepted copy was inconsistent or the last frame was
+ * lost. Torn copies need receive and processing on different cores.
+ */
+
+#define _GNU_SOURCE
+#include "../src/CO_PDO.c"
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+
+//****************************
+//Local definitions
+//****************************
+typedef struct{
+	CO_RPDO_t			*RPDO;
+	int					cpu;
+	long				frames;
+	volatile int		*done;
+	pthread_barrier_t	*start;
+	long				taken;			//copies accepted
+	long				torn;			//copies dropped by sequence check
+	long				inconsistent;	//accepted copies with bytes of two frames
+	long				older;			//accepted frames older than previous one
+	uint32_t			last;			//number of last accepted frame
+}thread_t;
+
+
+//****************************
+//Local functions
+//****************************
+static void pin(int cpu)
+{
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if(pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+		fprintf(stderr, "warning: can not pin thread to CPU %d\n", cpu);
+}
+
+static void frameFill(uint8_t *data, uint32_t n)
+{
+	int i;
+
+	for(i=0; i<4; i++){
+		data[i] = (uint8_t)(n >> (8 * i));
+		data[i + 4] = (uint8_t)~data[i];
+	}
+}
+
+//Returns false, if bytes are not from one frame.
+static bool_t frameCheck(const uint8_t *data, uint32_t *n)
+{
+	int i;
+
+	*n = 0;
+	for(i=0; i<4; i++){
+		if(data[i + 4] != (uint8_t)~data[i])
+			return false;
+		*n |= (uint32_t)data[i] << (8 * i);
+	}
+	return true;
+}
+
+//Same steps as CO_RPDO_process() for one buffer.
+static void processTake(thread_t *t)
+{
+	uint8_t data[8];
+	uint32_t n;
+
+	(void)__atomic_exchange_n(&t->RPDO->CANrxNew[0], false, __ATOMIC_ACQ_REL);
+	if(!CO_RPDO_readRx(t->RPDO, 0, data)){
+		t->torn++;
+		return;
+	}
+	t->taken++;
+	if(!frameCheck(data, &n)){
+		t->inconsistent++;
+		return;
+	}
+	if(t->taken > 1 && n < t->last)
+		t->older++;
+	t->last = n;
+}
+
+static void *receiveThread(void *arg)
+{
+	thread_t *t = (thread_t*)arg;
+	uint8_t data[8];
+	long i;
+
+	pin(t->cpu);
+	pthread_barrier_wait(t->start);
+	for(i=1; i<=t->frames; i++){
+		frameFill(data, (uint32_t)i);
+		CO_RPDO_writeRx(t->RPDO, 0, data);
+	}
+	__atomic_store_n(t->done, 1, __ATOMIC_RELEASE);
+	return NULL;
+}
+
+static void *processThread(void *arg)
+{
+	thread_t *t = (thread_t*)arg;
+
+	pin(t->cpu);
+	pthread_barrier_wait(t->start);
+	while(!__atomic_load_n(t->done, __ATOMIC_ACQUIRE)){
+		if(CO_FLAG_READ(t->RPDO->CANrxNew[0]))
+			processTake(t);
+	}
+	return NULL;
+}
+
+
+//****************************
+//Main
+//****************************
+int main(int argc,char *argv[])
+{
+	int cpuA = 0, cpuB = 1, opt, i;
+	long frames = 20000000L;
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	volatile int done = 0;
+	pthread_barrier_t start;
+	pthread_t thA, thB;
+	thread_t a, b;
+	bool_t lastLost;
+	void *obj;
+
+	while((opt = getopt(argc, argv, "a:b:n:")) != -1){
+		switch(opt){
+		case 'a': cpuA = atoi(optarg); break;
+		case 'b': cpuB = atoi(optarg); break;
+		case 'n': frames = atol(optarg); break;
+		default:
+			fprintf(stderr, "usage: %s [-a cpu] [-b cpu] [-n frames]\n", argv[0]);
+			return 1;
+		}
+	}
+	if(frames <= 0 || frames > (long)UINT32_MAX){
+		fprintf(stderr, "frames must be positive and fit into 32 bits\n");
+		return 1;
+	}
+	if(cpuA >= cpus || cpuB >= cpus){
+		fprintf(stderr, "warning: %ld CPU online, both threads run on CPU 0, "
+				"copies are torn only by preemption\n", cpus);
+		cpuA = cpuB = 0;
+	}
+	for(i=0; i<LOG_MOD_COUNT; i++)
+		logSetModuleLevel(i, 0);
+
+	if(posix_memalign(&obj, CO_CACHE_LINE, sizeof(CO_RPDO_t)) != 0){
+		perror("posix_memalign");
+		return 1;
+	}
+	memset(obj, 0, sizeof(CO_RPDO_t));
+	pthread_barrier_init(&start, NULL, 2);
+	memset(&a, 0, sizeof(a));
+	a.RPDO = (CO_RPDO_t*)obj;
+	a.frames = frames;
+	a.done = &done;
+	a.start = &start;
+	b = a;
+	a.cpu = cpuA;
+	b.cpu = cpuB;
+
+	pthread_create(&thA, NULL, receiveThread, &a);
+	pthread_create(&thB, NULL, processThread, &b);
+	pthread_join(thA, NULL);
+	pthread_join(thB, NULL);
+	pthread_barrier_destroy(&start);
+
+	//frame, which tore the last copy, must have set the flag again
+	if(CO_FLAG_READ(b.RPDO->CANrxNew[0]))
+		processTake(&b);
+	lastLost = b.last != (uint32_t)frames;
+	free(obj);
+
+	printf("receive on CPU %d, processing on CPU %d, %ld frames\n", cpuA, cpuB, frames);
+	printf("taken %ld, torn %ld, inconsistent %ld, older %ld, last frame %s\n",
+			b.taken, b.torn, b.inconsistent, b.older, lastLost ? "lost" : "taken");
+	return (b.inconsistent != 0 || b.older != 0 || lastLost) ? 1 : 0;
+}